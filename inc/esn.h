@@ -10,11 +10,13 @@
 
 #include "eigenvalues/nsevd.h"
 #include <network.h>
+#include <vector>
+#include <string>
 
+//! The scalar type of ESN and Trial, TemplateESN<T> is instantiated for float, double and the
+//! storage formats aNetwork::half and aNetwork::bfloat16 as well
 typedef float WEIGHT_TYPE;
 
-//typedef double WEIGHT_TYPE;
-
 enum ESNParameter
 {
 	INPUT_SIZE,
@@ -50,6 +52,18 @@ enum SimulationType
 	PREDICTION // temporary, will be removed!
 };
 
+/**
+ * How saveESN() stores the reservoir weights: as a matrix, only the nonzero weights, or not at
+ * all (generated again from the seed on load), STORE_AUTO picks the smaller of the first two.
+ */
+enum ModelStorage
+{
+	STORE_AUTO,
+	STORE_DENSE,
+	STORE_SPARSE,
+	STORE_SEED_ONLY
+};
+
 /**
  * The struct "Trial" contains all state information of the ESN for a given all_trials.
  * From the same time series it is namely possible to create several trials. And
@@ -62,14 +76,15 @@ enum SimulationType
  * @field classId
  * @field inputSize			The number of input neurons
  */
-struct Trial
+template<class T>
+struct TemplateTrial
 {
 	// Values of all the neurons in the reservoir over time
 	// Double array: t * reservoirSize + n (bundled per time step)
-	WEIGHT_TYPE *neuronVal;
+	T *neuronVal;
 
 	// The inputs to the reservoir
-	WEIGHT_TYPE const *inputVal;
+	T const *inputVal;
 
 	// The number of neurons in the reservoir
 	int stateSize;
@@ -81,7 +96,7 @@ struct Trial
 	int classId;
 
 	// Array to store output values OR teacher values
-	WEIGHT_TYPE *outputVal;
+	T *outputVal;
 
 	// Number of teacher values before ESN needs to predict on itself in test case
 	int teacherTestSize;
@@ -90,29 +105,42 @@ struct Trial
 	int inputSize;
 
 	// Debug values, might be all kind of stuff...
-	WEIGHT_TYPE *debug;
+	T *debug;
 
 	// Destructor removes state array
-	~Trial() {
+	~TemplateTrial() {
 		if (neuronVal != NULL) delete [] neuronVal;
 	}
 };
 
+typedef TemplateTrial<WEIGHT_TYPE> Trial;
+
 /**
  * An echo state reservoir.
+ *
+ * The weights and states are stored as T, the parameters and the arithmetic are in Compute.
+ * With the storage formats half and bfloat16 (computing in float) the reservoir takes half
+ * the memory and bandwidth of float, at the cost of about 3 and 2 significant digits.
  */
-class ESN
+template<class T>
+class TemplateESN
 {
 public:
+	//! The type of the parameters and the arithmetic
+	typedef typename aNetwork::ScalarTraits<T>::Compute Compute;
 
 	//! Create default reservoir 2->10->2 with connectivity 0.8
-	ESN();
+	TemplateESN();
 
 	//! Create flexible reservoir
-	ESN(int inputSize, int outputSize, int networkSize, float connectivity);
+	TemplateESN(int inputSize, int outputSize, int networkSize, float connectivity);
 
 	//! Run the reservoir with the given parameters
-	void Run(Trial *trial, SimulationType simType);
+	void Run(TemplateTrial<T> *trial, SimulationType simType);
+
+	//! Same as Run() for a linear reservoir, with the time steps divided over nofChunks
+	//! threads (0 is all of them)
+	void RunParallel(TemplateTrial<T> *trial, SimulationType simType, int nofChunks = 0);
 
 	//! First initialise the reservoir
 	void init();
@@ -120,14 +148,20 @@ public:
 	//! Print all the relevant parameters to stdout
 	void printStats();
 
-	//! Store the ESN to a file
-	void saveESN(std::string filename);
+	//! Store the ESN to a file, in a format that loadESN() can map into memory
+	void saveESN(std::string filename, ModelStorage storage = STORE_AUTO);
+
+	//! Load the ESN from a file, mapped into memory, with verify all checksums are checked;
+	//! false if it cannot be loaded, the ESN is then empty
+	bool loadESN(std::string filename, bool verify = false);
 
-	//! Load the ESN from a file
-	void loadESN(std::string filename);
+	//! Keep the budget neurons that contribute most to the readout, |W_out| times scale (e.g.
+	//! the magnitude of their states, NULL is 1), and remove the others from all weights; the
+	//! readout has to be trained again
+	void Prune(int budget, const Compute *scale = NULL);
 
 	//! Destruct ESN
-	virtual ~ESN();
+	virtual ~TemplateESN();
 
 	//! Set all parameters from size to ...
 	void setParameter(ESNParameter param, void *value);
@@ -136,22 +170,22 @@ public:
 
 	void setOutputActivation(ActivationFunction outputActivation);
 
-	WEIGHT_TYPE getDecayRate() const
+	Compute getDecayRate() const
 	{
 		return d_decayRate;
 	}
 
-	void setDecayRate(WEIGHT_TYPE decayRate)
+	void setDecayRate(Compute decayRate)
 	{
 		this->d_decayRate = decayRate;
 	}
 
-	WEIGHT_TYPE getTimeConstant() const
+	Compute getTimeConstant() const
 	{
 		return d_timeConstant;
 	}
 
-	void setTimeConstant(WEIGHT_TYPE timeConstant)
+	void setTimeConstant(Compute timeConstant)
 	{
 		this->d_timeConstant = timeConstant;
 	}
@@ -191,170 +225,280 @@ public:
 		return d_reservoirActivation;
 	}
 
+	inline ActivationFunction getOutputActivation() const
+	{
+		return d_outputActivation;
+	}
+
+	//! Number of steps a heaviside neuron cannot spike after a spike (default 0)
+	inline void setRefractoryPeriod(int refractoryPeriod)
+	{
+		this->d_refractoryPeriod = refractoryPeriod;
+	}
+
+	inline int getRefractoryPeriod() const
+	{
+		return d_refractoryPeriod;
+	}
+
+	//! Topology of the reservoir, see aNetwork::Mode, call before init()
+	inline void setTopology(aNetwork::Mode topology)
+	{
+		this->d_topology = topology;
+	}
+
+	inline aNetwork::Mode getTopology() const
+	{
+		return d_topology;
+	}
 
-	inline  WEIGHT_TYPE getConnectivity() const
+	//! Seed for all random weights, 0 picks a seed based on the time, call before init()
+	inline void setSeed(unsigned int seed)
+	{
+		this->d_seed = seed;
+	}
+
+	inline unsigned int getSeed() const
+	{
+		return d_seed;
+	}
+
+	//! Directory to reuse reservoirs generated before with the same parameters and (nonzero)
+	//! seed, default is the environment variable ESN_RESERVOIR_CACHE, empty disables it
+	inline void setCacheDirectory(const std::string & directory)
+	{
+		this->d_cacheDirectory = directory;
+	}
+
+	//! Renumber the neurons after generation for cache locality, call before init()
+	inline void setReorder(bool reorder)
+	{
+		this->d_reorder = reorder;
+	}
+
+	//! Random reservoir and feedback weights of one magnitude, ±1 before scaling, like the
+	//! input weights of Jaeger (DEFAULT_INPUT_SCALE 0); the network then stores the reservoir
+	//! as bit planes and updates it with adds only, call before init()
+	inline void setTernaryWeights(bool ternary)
+	{
+		this->d_ternary = ternary;
+	}
+
+	inline bool getTernaryWeights() const
+	{
+		return d_ternary;
+	}
+
+	//! The neuron order, getPermutation()[n] is the original index of state n
+	inline const std::vector<int> & getPermutation() const
+	{
+		return d_permutation;
+	}
+
+	//! The network for topology specific parameters (e.g. aNetwork::MODULE_SIZE)
+	inline aNetwork::TemplateNetwork<T> & getReservoir()
+	{
+		return reservoir;
+	}
+
+
+	inline  Compute getConnectivity() const
 	{
 		return d_connectivity;
 	}
 
-	inline void setConnectivity(WEIGHT_TYPE d_connectivity)
+	inline void setConnectivity(Compute d_connectivity)
 	{
 		this->d_connectivity = d_connectivity;
 	}
 
-	inline WEIGHT_TYPE getInConnectivity() const
+	inline Compute getInConnectivity() const
 	{
 		return d_inConnectivity;
 	}
 
-	inline void setInConnectivity(WEIGHT_TYPE d_inConnectivity)
+	inline void setInConnectivity(Compute d_inConnectivity)
 	{
 		this->d_inConnectivity = d_inConnectivity;
 	}
 
-	inline WEIGHT_TYPE getFbConnectivity() const
+	inline Compute getFbConnectivity() const
 	{
 		return d_fbConnectivity;
 	}
 
-	inline void setFbConnectivity(WEIGHT_TYPE d_fbConnectivity)
+	inline void setFbConnectivity(Compute d_fbConnectivity)
 	{
 		this->d_fbConnectivity = d_fbConnectivity;
 	}
 
-	inline WEIGHT_TYPE getSpectralRadius() const
+	inline Compute getSpectralRadius() const
 	{
 		return d_spectralRadius;
 	}
 
-	inline void setSpectralRadius(WEIGHT_TYPE d_spectralRadius)
+	inline void setSpectralRadius(Compute d_spectralRadius)
 	{
 		this->d_spectralRadius = d_spectralRadius;
 	}
 
-	inline WEIGHT_TYPE getInputScale() const
+	inline Compute getInputScale() const
 	{
 		return d_inputScale;
 	}
 
-	inline void setInputScale(WEIGHT_TYPE d_inputScale)
+	inline void setInputScale(Compute d_inputScale)
 	{
 		this->d_inputScale = d_inputScale;
 	}
 
-	inline WEIGHT_TYPE getFeedbackScale() const
+	inline Compute getFeedbackScale() const
 	{
 		return d_feedbackScale;
 	}
 
-	inline void setFeedbackScale(WEIGHT_TYPE d_feedbackScale)
+	inline void setFeedbackScale(Compute d_feedbackScale)
 	{
 		this->d_feedbackScale = d_feedbackScale;
 	}
 
-	inline WEIGHT_TYPE getInputShift() const
+	inline Compute getInputShift() const
 	{
 		return d_inputShift;
 	}
 
-	inline void setInputShift(WEIGHT_TYPE d_inputShift)
+	inline void setInputShift(Compute d_inputShift)
 	{
 		this->d_inputShift = d_inputShift;
 	}
 
-	inline WEIGHT_TYPE getFeedbackShift() const
+	inline Compute getFeedbackShift() const
 	{
 		return d_feedbackShift;
 	}
 
-	inline void setFeedbackShift(WEIGHT_TYPE d_feedbackShift)
+	inline void setFeedbackShift(Compute d_feedbackShift)
 	{
 		this->d_feedbackShift = d_feedbackShift;
 	}
 
-	inline WEIGHT_TYPE *getInputWeights() const
+	inline T *getInputWeights() const
 	{
 		return d_inputWeights;
 	}
 
-	inline  WEIGHT_TYPE *getOutputWeights() const
+	inline  T *getOutputWeights() const
 	{
 		return d_outputWeights;
 	}
 
-	void setOutputWeights( WEIGHT_TYPE *weights, int len);
+	void setOutputWeights( T *weights, int len);
 
-	inline WEIGHT_TYPE *getFeedbackWeights() const
+	inline T *getFeedbackWeights() const
 	{
 		return d_feedbackWeights;
 	}
 
-	inline WEIGHT_TYPE *getReservoirWeights() const
+	inline T *getReservoirWeights() const
 	{
 		return d_reservoirWeights;
 	}
 
+	inline T *getThresholds() const
+	{
+		return d_thresholds;
+	}
+
 protected:
-	WEIGHT_TYPE (ESN::* resActFunc)(WEIGHT_TYPE value);
-	WEIGHT_TYPE (ESN::* outActFunc)(WEIGHT_TYPE value);
-	WEIGHT_TYPE (ESN::* outInvActFunc)(WEIGHT_TYPE value);
+	Compute (TemplateESN::* resActFunc)(Compute value);
+	Compute (TemplateESN::* outActFunc)(Compute value);
+	Compute (TemplateESN::* outInvActFunc)(Compute value);
 
-	WEIGHT_TYPE act_heaviside(WEIGHT_TYPE value);
-	WEIGHT_TYPE act_logistic(WEIGHT_TYPE value);
-	WEIGHT_TYPE act_invlogistic(WEIGHT_TYPE value);
-	WEIGHT_TYPE act_tanh(WEIGHT_TYPE value);
-	WEIGHT_TYPE act_invtanh(WEIGHT_TYPE value);
+	Compute act_heaviside(Compute value);
+	Compute act_logistic(Compute value);
+	Compute act_invlogistic(Compute value);
+	Compute act_tanh(Compute value);
+	Compute act_invtanh(Compute value);
 
-	inline WEIGHT_TYPE act_identity(WEIGHT_TYPE value) { return value; 	}
+	inline Compute act_identity(Compute value) { return value; 	}
 
-	inline WEIGHT_TYPE act_invidentity(WEIGHT_TYPE value) { return value; }
+	inline Compute act_invidentity(Compute value) { return value; }
 
-	void generateReservoirConnections();
+	//! Generate (or load from the cache) the reservoir for the seed init() uses
+	void generateReservoirConnections(unsigned int seed);
+
+	void reorderNeurons();
 private:
 	int d_inputSize;
 	int d_outputSize;
 	int d_reservoirSize;
 	ActivationFunction d_reservoirActivation, d_outputActivation;
 
-	WEIGHT_TYPE d_connectivity;
-	WEIGHT_TYPE d_inConnectivity;
-	WEIGHT_TYPE d_fbConnectivity;
+	Compute d_connectivity;
+	Compute d_inConnectivity;
+	Compute d_fbConnectivity;
 
-	WEIGHT_TYPE d_spectralRadius;
+	Compute d_spectralRadius;
 
-	WEIGHT_TYPE d_inputScale;
-	WEIGHT_TYPE d_feedbackScale;
+	Compute d_inputScale;
+	Compute d_feedbackScale;
 
-	WEIGHT_TYPE d_inputShift;
-	WEIGHT_TYPE d_feedbackShift;
+	Compute d_inputShift;
+	Compute d_feedbackShift;
 
-	WEIGHT_TYPE *d_inputWeights;
-	WEIGHT_TYPE *d_outputWeights;
-	WEIGHT_TYPE *d_feedbackWeights;
+	T *d_inputWeights;
+	T *d_outputWeights;
+	T *d_feedbackWeights;
 
 	//! Incoming weights retrieved as d_reservoirWeights[this*d_reservoirSize + other]
 	//! So, incoming weights are stored row-wise, outgoing weights are stored column-wise
-	WEIGHT_TYPE *d_reservoirWeights;
+	T *d_reservoirWeights;
 
-	WEIGHT_TYPE *d_output;
+	T *d_output;
 
 	// A threshold per neuron, needed for heaviside activation function
-	WEIGHT_TYPE *d_thresholds;
+	T *d_thresholds;
+
+	Compute d_timeConstant;
+	Compute d_decayRate;
+
+	Compute d_excitatory;
+
+	aNetwork::Mode d_topology;
 
-	WEIGHT_TYPE d_timeConstant;
-	WEIGHT_TYPE d_decayRate;
+	bool d_reorder;
 
-	WEIGHT_TYPE d_excitatory;
+	bool d_ternary;
 
-	aNetwork::Network reservoir;
+	int d_refractoryPeriod;
+
+	unsigned int d_seed;
+
+	std::string d_cacheDirectory;
+
+	std::vector<int> d_permutation;
+
+	aNetwork::TemplateNetwork<T> reservoir;
+
+	//! Scratch space for the recurrent input W x(t-1) of all neurons
+	Compute *d_recurrent;
+
+	//! The model file the weights are in after loadESN(), NULL if they are allocated
+	void *d_mapping;
+	size_t d_mappingSize;
 
 	void destroy();
-	void scaleAndShift(WEIGHT_TYPE * weights, int weightSize, WEIGHT_TYPE scale, WEIGHT_TYPE shift);
-	void generateConnections(WEIGHT_TYPE connectivity, int weightSize, WEIGHT_TYPE * weights, WEIGHT_TYPE min = -1, WEIGHT_TYPE max = +1);
-//	bool spectralRadius(WEIGHT_TYPE* reservoirWeights, int reservoirSize, WEIGHT_TYPE* spectralRadius);
-	void uniform(WEIGHT_TYPE *value, float min=-1, float max=1);
-	void saveWeights(std::ofstream *outputFile, int matrixSize, WEIGHT_TYPE *matrix);
-	void loadWeights(std::ifstream *inputFile, int matrixSize, WEIGHT_TYPE *matrix);
+	void scaleAndShift(T * weights, int weightSize, Compute scale, Compute shift);
+	void generateConnections(Compute connectivity, int weightSize, T * weights, Compute min = -1, Compute max = +1);
+//	bool spectralRadius(Compute* reservoirWeights, int reservoirSize, Compute* spectralRadius);
+	void uniform(T *value, float min=-1, float max=1);
+	void loadWeights(std::ifstream *inputFile, int matrixSize, T *matrix);
+	bool loadLegacyESN(std::string filename);
+
+	//! Whether the array is part of the model file mapping
+	bool isMapped(const void *array) const;
 };
 
+typedef TemplateESN<WEIGHT_TYPE> ESN;
+
 #endif /* ESN_H_ */
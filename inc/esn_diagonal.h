@@ -0,0 +1,113 @@
+/**
+ * @file esn_diagonal.h
+ * @brief Inference with a linear echo state network in the basis of the eigenvectors of its reservoir
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object against this software used by the military, in the
+ * bio-industry, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2010 Anne van Rossum <anne@almende.com>
+ *
+ * @author 	Anne C. van Rossum
+ * @date	Oct 18, 2026
+ * @project	Replicator FP7
+ * @company	Almende B.V.
+ * @case
+ */
+
+
+#ifndef ESN_DIAGONAL_H_
+#define ESN_DIAGONAL_H_
+
+// General files
+#include <esn.h>
+#include <vector>
+#include <complex>
+
+/* **************************************************************************************
+ * Interface of DiagonalESN
+ * **************************************************************************************/
+
+/**
+ * A trained ESN with the identity as reservoir activation is a linear system,
+ * x(t) = A x(t-1) + W_in u(t) + W_back y(t-1) - θ with A = (1 − δCa) I + δC W. With the
+ * eigenvectors of W, W = V Λ V^-1, the modal state z = V^-1 x follows
+ * z(t) = μ z(t-1) + V^-1 (W_in u(t) + W_back y(t-1) - θ), element by element, with
+ * μ = (1 − δCa) + δC Λ, and the readout becomes W_out V. A time step then costs O(n) times
+ * the number of inputs and outputs instead of O(n^2).
+ *
+ * The eigenvalues of a real matrix are real or come in complex conjugate pairs, and so do
+ * the modes, so only one mode of every pair is kept. The eigenvectors are computed once, in
+ * the constructor; if W is (close to) defective, the modes are not independent of each
+ * other in float, and Run() falls back to ESN::Run. The states x(t) are only written to the
+ * trial with setKeepStates(), at O(n^2) per step.
+ */
+template<class T>
+class TemplateDiagonalESN {
+public:
+	//! The type of the parameters and the arithmetic
+	typedef typename aNetwork::ScalarTraits<T>::Compute Compute;
+
+	//! The modal quantities
+	typedef std::complex<Compute> Complex;
+
+	//! Diagonalize the reservoir of the given (initialized and trained) ESN, which is used by
+	//! Run() itself when its activation is not the identity or when the condition number of
+	//! an eigenvalue exceeds maxCondition
+	TemplateDiagonalESN(TemplateESN<T> & esn, Compute maxCondition = 1e4);
+
+	//! Destructor ~DiagonalESN
+	virtual ~TemplateDiagonalESN();
+
+	//! Same as ESN::Run for a linear reservoir, in the modal basis
+	void Run(TemplateTrial<T> *trial, SimulationType simType);
+
+	//! Whether Run() uses the modal basis (false means it falls back to ESN::Run)
+	inline bool IsDiagonal() const { return d_diagonal; }
+
+	//! Largest condition number of an eigenvalue, |u||v|/|u'v| with u and v its left and
+	//! right eigenvector
+	inline Compute GetCondition() const { return d_condition; }
+
+	//! Write the states x(t) = V z(t) to the trial as well, default false
+	inline void setKeepStates(bool keepStates) { d_keepStates = keepStates; }
+protected:
+	//! Eigenvectors of the reservoir and the projections of the other weights
+	bool diagonalize(Compute maxCondition);
+private:
+	TemplateESN<T> & d_esn;
+
+	int d_inputSize;
+	int d_outputSize;
+	int d_reservoirSize;
+
+	//! Number of modes, a pair of complex conjugate ones counts once
+	int d_nofModes;
+
+	bool d_diagonal;
+	bool d_keepStates;
+	Compute d_condition;
+
+	//! Per mode: the factor μ, the rows of V^-1 W_in and V^-1 W_back, and V^-1 θ
+	std::vector<Complex> d_factors, d_input, d_feedback, d_thresholds;
+
+	//! Per output the row of W_out V, doubled for pairs, and the part for the inputs
+	std::vector<Complex> d_readout;
+	std::vector<Compute> d_inputReadout;
+
+	//! Per mode its right eigenvector, doubled for pairs (only with setKeepStates)
+	std::vector<Complex> d_eigenvectors;
+
+	//! The modal state
+	std::vector<Complex> d_modes;
+};
+
+typedef TemplateDiagonalESN<WEIGHT_TYPE> DiagonalESN;
+
+#endif /* ESN_DIAGONAL_H_ */
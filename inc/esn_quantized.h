@@ -0,0 +1,122 @@
+/**
+ * @file esn_quantized.h
+ * @brief Inference with an echo state network of which the weights are quantized to int8
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object against this software used by the military, in the
+ * bio-industry, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2010 Anne van Rossum <anne@almende.com>
+ *
+ * @author 	Anne C. van Rossum
+ * @date	Oct 18, 2026
+ * @project	Replicator FP7
+ * @company	Almende B.V.
+ * @case
+ */
+
+
+#ifndef ESN_QUANTIZED_H_
+#define ESN_QUANTIZED_H_
+
+// General files
+#include <esn.h>
+#include <vector>
+#include <stdint.h>
+
+/* **************************************************************************************
+ * Interface of QuantizedESN
+ * **************************************************************************************/
+
+/**
+ * A copy of a trained ESN for inference only, with the reservoir, input, feedback and output
+ * weights quantized to int8 with a scale per row, a quarter of the memory of float weights.
+ * The states, inputs and outputs are quantized to int8 every time step, scaled to their
+ * largest absolute value, so the products are int8 dot products with int32 sums. Only the scaling of the sums, the
+ * thresholds and the activation functions are done in Compute.
+ *
+ * The dot products use the widest integer instructions of this CPU: AVX-512 VNNI, AVX-VNNI,
+ * AVX2, or plain integer code. The environment variable ESN_INT8_SIMD (generic, avx2,
+ * avxvnni or avx512vnni) selects a narrower set, e.g. for benchmarking.
+ *
+ * The reservoir is always stored as a dense matrix, whatever kernel the network of the ESN
+ * uses, and later changes to the ESN (e.g. a new readout) need a new QuantizedESN.
+ */
+template<class T>
+class TemplateQuantizedESN {
+public:
+	//! The type of the parameters and the arithmetic
+	typedef typename aNetwork::ScalarTraits<T>::Compute Compute;
+
+	//! Quantize the weights of the given (initialized and trained) ESN
+	TemplateQuantizedESN(const TemplateESN<T> & esn);
+
+	//! Destructor ~QuantizedESN
+	virtual ~TemplateQuantizedESN();
+
+	//! Same as ESN::Run, with the quantized weights
+	void Run(TemplateTrial<T> *trial, SimulationType simType);
+
+	//! Memory taken by the quantized weights and their scales, in bytes
+	size_t WeightBytes() const;
+
+	//! The dot product kernel in use, e.g. "avx2"
+	static const char *KernelName();
+protected:
+	/**
+	 * A matrix of int8 values with a scale per row, the original row i is about
+	 * scales[i]*values[i*stride..]. The rows are padded with zeros to a multiple of
+	 * QUANTIZED_ALIGNMENT for the dot product kernels, unless they are shorter than that;
+	 * sums are the sums of the rows.
+	 */
+	struct Matrix {
+		int rows, columns, stride;
+		std::vector<int8_t> values;
+		std::vector<Compute> scales;
+		std::vector<int32_t> sums;
+	};
+
+	//! Quantize columns first..first+columns-1 of the rows x ld matrix weights
+	void quantize(const T *weights, int rows, int ld, int first, int columns, Matrix & m);
+
+	//! Quantize the vector x, returns its scale
+	Compute quantize(const Compute *x, int len, int8_t *q);
+
+	//! y = m q, with q quantized with scale
+	void multiply(const Matrix & m, const int8_t *q, Compute scale, Compute *y);
+
+	Compute activate(ActivationFunction function, Compute value) const;
+private:
+	int d_inputSize;
+	int d_outputSize;
+	int d_reservoirSize;
+	ActivationFunction d_reservoirActivation, d_outputActivation;
+
+	Compute d_fbConnectivity;
+	Compute d_timeConstant;
+	Compute d_decayRate;
+
+	//! W, W_in, W_back, and W_out split in the part for the states and for the inputs
+	Matrix reservoir, input, feedback, readout, inputReadout;
+
+	std::vector<Compute> d_thresholds;
+
+	//! The states of the last and of the current time step, and the outputs of the last
+	std::vector<Compute> d_previous, d_current, d_output;
+
+	//! Quantized states, inputs and outputs
+	std::vector<int8_t> d_qStates, d_qInput, d_qOutput;
+
+	//! The kernels keep their own form of the vector here
+	std::vector<int8_t> d_scratch;
+};
+
+typedef TemplateQuantizedESN<WEIGHT_TYPE> QuantizedESN;
+
+#endif /* ESN_QUANTIZED_H_ */
@@ -27,31 +27,74 @@
 
 // General files
 #include <esn.h>
+#include <nvar.h>
 #include <ap.h>
 #include <vector>
 #include <string.h>
+#include <assert.h>
+
+/**
+ * How RidgeRegression solves (A'A + λI) W = A'B:
+ *
+ * RIDGE_CHOLESKY	forms A'A and factors it, O(n^2) memory and O(n^3) time in the number of
+ * 					neurons n
+ * RIDGE_CG			conjugate gradients with only products with A and A', O(n) memory and
+ * 					O(nnz(A)) time per iteration
+ * RIDGE_AUTO		Cholesky up to RIDGE_CG_NEURONS neurons, conjugate gradients above
+ */
+enum RidgeSolver
+{
+	RIDGE_AUTO,
+	RIDGE_CHOLESKY,
+	RIDGE_CG
+};
 
 /* **************************************************************************************
  * Interface of ESNPrediction
  * **************************************************************************************/
 
+struct RidgeRows;
+
 class ESNPrediction {
 public:
 	//! Constructor ESNPrediction
 	ESNPrediction(int reservoirSize, float connectivity);
 
+	//! Constructor ESNPrediction with the features of an NVAR instead of a reservoir, the ESN
+	//! is an uninitialized placeholder that GetESN() and Prune() refuse; the NVAR is not copied
+	ESNPrediction(NVAR *nvar);
+
 	//! Destructor ~ESNPrediction
 	virtual ~ESNPrediction();
 
 	//! Apply ridge regression on given set
 	void RidgeRegression(std::vector<Trial*> & trials, ap::real_2d_array *W);
 
+	//! Solve the ridge regression in single precision (default is double)
+	inline void SetSinglePrecision(bool single) { singlePrecision = single; }
+
+	//! Regularization λ of the ridge regression (default 0.2), it depends on the scale of
+	//! the states or features
+	inline void SetRidgeLambda(double lambda) { ridgeLambda = lambda; }
+
+	//! Solver of the ridge regression (default RIDGE_AUTO)
+	inline void SetRidgeSolver(RidgeSolver solver) { ridgeSolver = solver; }
+
+	//! Options of RIDGE_CG: stop after maxIterations or when the residual relative to A'B is
+	//! below tolerance; precondition with the diagonal of A'A + λI; start from the given W
+	void SetCGOptions(int maxIterations, double tolerance, bool jacobi = true,
+			bool warmStart = true);
+
 	//! Add all_trials
 	void AddTrial(WEIGHT_TYPE *input, WEIGHT_TYPE *output, int len, int id = -1);
 
 	//! Run trials
 	void RunTrials();
 
+	//! After RunTrials(), keep the budget neurons that contribute most to the readout over the
+	//! training set, and train the readout of the smaller reservoir again on the same set
+	void Prune(int budget);
+
 	//! Run a test from the test set
 	void RunTest(int index, float *input, float *result);
 
@@ -61,19 +104,57 @@ public:
 	//! Get results from test set
 	std::vector<Trial*> & GetTestSet();
 
-	inline ESN & GetESN() { return esn; }
+	//! The trained ESN, not available with an NVAR (it is a placeholder without weights then)
+	inline ESN & GetESN() { assert (nvar == NULL); return esn; }
 
 protected:
 	//! Divide all trials in test and training sets
 	void InitSets();
 
+	//! Run the training set and set the readout, without dividing the trials again
+	void Train();
+
 	std::vector<Trial*> & GetTrainingSet();
 
 	void WriteToFile(ap::real_2d_array *W, std::string file);
 private:
+	//! RidgeRegression in the precision of T
+	template<class T>
+	void RidgeRegression(std::vector<Trial*> & trials, ap::template_2d_array<T,true> *W);
+
+	//! Ridge regression by Cholesky factorisation of A'A + λI, false if it is not positive
+	//! definite
+	template<class T>
+	bool RidgeCholesky(const RidgeRows & rows, T lambda, ap::template_2d_array<T,true> *W);
+
+	//! Ridge regression by conjugate gradients on A'A + λI, streaming A in row blocks
+	template<class T>
+	void RidgeCG(const RidgeRows & rows, T lambda, ap::template_2d_array<T,true> *W);
+
+	//! Precision of the ridge regression
+	bool singlePrecision;
+
+	//! Solver of the ridge regression
+	RidgeSolver ridgeSolver;
+
+	//! Options of RIDGE_CG
+	int cgMaxIterations;
+	double cgTolerance;
+	bool cgJacobi;
+	bool cgWarmStart;
+
+	//! Regularization of the ridge regression
+	double ridgeLambda;
+
+	//! The readout of the last RunTrials(), the start of the next one with cgWarmStart
+	ap::real_2d_array readout;
+
 	//! The echo state reservoir
 	ESN esn;
 
+	//! The feature engine instead of the reservoir, NULL if the ESN is used
+	NVAR *nvar;
+
 	//! A series of "trials", pieces of the same time series
 	std::vector<Trial*> all_trials;
 
@@ -0,0 +1,95 @@
+/**
+ * @file linalg_backend.h
+ * @brief
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object against this software used by the military, in the
+ * bio-industry, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2010 Anne van Rossum <anne@almende.com>
+ *
+ * @author 	Anne C. van Rossum
+ * @date	Oct 18, 2026
+ * @project	Replicator FP7
+ * @company	Almende B.V.
+ * @case
+ */
+
+
+#ifndef LINALG_BACKEND_H_
+#define LINALG_BACKEND_H_
+
+// General files
+#include <vector>
+
+namespace aNetwork {
+
+/* **************************************************************************************
+ * Interface of LinalgBackend
+ * **************************************************************************************/
+
+/**
+ * The dense linear algebra under the ridge regression and the spectral radius. All matrices
+ * are row-major with rows "ld" elements apart, like the ap arrays (see getstride()).
+ *
+ * There are two implementations: "thd", the bundled ALGLIB code, which is always there, and
+ * "lapack", the system BLAS/LAPACK, which is only there when CMake found one. The default is
+ * the fastest one that is compiled in; the environment variable ESN_BACKEND (thd or lapack)
+ * or Select() overrides it, e.g. to compare the two.
+ *
+ * The backends keep workspace between calls, so use them from one thread at a time.
+ */
+template<class T>
+class LinalgBackend {
+public:
+	//! Destructor ~LinalgBackend
+	virtual ~LinalgBackend() {}
+
+	//! Name of the backend, "thd" or "lapack"
+	virtual const char *Name() const = 0;
+
+	//! C := alpha*op(A)*op(B) + beta*C, with op(A) mxk, op(B) kxn
+	virtual void Gemm(bool transa, bool transb, int m, int n, int k, T alpha, const T *a, int lda,
+			const T *b, int ldb, T beta, T *c, int ldc) = 0;
+
+	//! C := alpha*A'*A + beta*C if trans, else alpha*A*A' + beta*C; C is nxn, only its upper
+	//! triangle is guaranteed to be written
+	virtual void Syrk(bool trans, int n, int k, T alpha, const T *a, int lda, T beta,
+			T *c, int ldc) = 0;
+
+	//! Cholesky factorisation A = U'*U of the upper triangle of the nxn matrix A, U replaces
+	//! it; false if A is not positive definite
+	virtual bool Potrf(int n, T *a, int lda) = 0;
+
+	//! Solves A*X = B with the factor U of Potrf, X replaces the nxnrhs matrix B
+	virtual void Potrs(int n, int nrhs, const T *a, int lda, T *b, int ldb) = 0;
+
+	//! Eigenvalues wr + i*wi of the nxn matrix A, which is destroyed; false if the QR
+	//! algorithm did not converge
+	virtual bool Geev(int n, T *a, int lda, T *wr, T *wi) = 0;
+
+	//! Largest absolute eigenvalue of A by power iteration with Gemm, at most maxIter
+	//! products; false if it did not settle within tol (relative). Only a cheap estimate:
+	//! the convergence rate is the ratio of the two largest absolute eigenvalues, which is
+	//! close to one for random reservoirs
+	virtual bool PowerIteration(int n, const T *a, int lda, T & radius, int maxIter = 1000,
+			T tol = 1e-4);
+
+	//! The backend in use
+	static LinalgBackend<T> & Get();
+
+	//! Use the backend with the given name, false if it is not compiled in
+	static bool Select(const char *name);
+protected:
+	std::vector<T> x, y;
+};
+
+}
+
+#endif /* LINALG_BACKEND_H_ */
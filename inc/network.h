@@ -26,6 +26,9 @@
 #define NETWORK_H_
 
 // General files
+#include <vector>
+#include <stdint.h>
+#include <scalar.h>
 
 namespace aNetwork {
 
@@ -34,34 +37,56 @@ namespace aNetwork {
  * **************************************************************************************/
 
 /**
- * Different modes of operation.
+ * Different modes of operation. The minimum complexity topologies (simple cycle, delay line,
+ * delay line with feedback) have an analytically known spectral radius, so they do not need
+ * NORMALIZE_SPECTRUM afterwards [1].
+ *
+ * [1] Minimum Complexity Echo State Network (2011), Rodan, Tino
  */
-enum Mode {CREATE_RANDOM, SCALE_FREE, NORMALIZE_SPECTRUM, CREATE_BALANCED_NETWORK};
+enum Mode {CREATE_RANDOM, SCALE_FREE, NORMALIZE_SPECTRUM, CREATE_BALANCED_NETWORK,
+	CREATE_SIMPLE_CYCLE, CREATE_DELAY_LINE, CREATE_DELAY_LINE_FEEDBACK, CREATE_MODULAR,
+	CREATE_SPATIAL};
 
 enum NetworkParameter {
 	CONNECTIVITY,
 	SPECTRAL_RADIUS,
-	EXCITATORY_RATIO
+	EXCITATORY_RATIO,
+	BACKWARD_RATIO,
+	MODULE_SIZE,
+	INTER_CONNECTIVITY,
+	COUPLING_STRENGTH,
+	GRID_WIDTH,
+	GRID_HEIGHT,
+	GRID_DEPTH,
+	RADIUS,
+	TERNARY
 };
 
-//! Actually I'd prefer template < typename WEIGHT_TYPE > however, then separation between
-//! .h and .cpp files gets lost and compilation time goes up...
+//! The default scalar type, see Network
 typedef float WEIGHT_TYPE;
 
 /**
  * Network with weights on the edges / bonds. The representation is in double array format,
  * so fits better fully connected networks than sparsely connected networks.
+ *
+ * The weights are stored as T, the parameters and all sums are in ScalarTraits<T>::Compute.
+ * The implementation stays in network.cpp, it is instantiated there for float, double, half
+ * and bfloat16 (the latter two computing in float), so no other type can be used.
  */
-class Network {
+template<class T>
+class TemplateNetwork {
 public:
+	//! The type of the parameters and the arithmetic
+	typedef typename ScalarTraits<T>::Compute Compute;
+
 	//! Constructor reservoir
-	Network();
+	TemplateNetwork();
 
 	//! Destructor ~reservoir
-	virtual ~Network();
+	virtual ~TemplateNetwork();
 
 	//! Initialize reservoir with size width*height
-	void Init(WEIGHT_TYPE *weights, int width, int height);
+	void Init(T *weights, int width, int height);
 
 	//! Fill reservoir
 	bool Run();
@@ -69,7 +94,51 @@ public:
 	//! Set connectivity type
 	inline void SetMode(const Mode mode) { this->mode = mode; }
 
-	//! One function for all possible reservoir settings (different sets per reservoir type)
+	//! The topology the weights have been created with (used to pick the kernel)
+	inline Mode GetStructure() const { return structure; }
+
+	//! Set topology explicitly, e.g. for weights loaded from file, call Pack() afterwards
+	inline void SetStructure(const Mode structure) { this->structure = structure; }
+
+	//! Extract the kernel parameters from the weight matrix for the given structure
+	void Pack();
+
+	//! Calculates y = W x with a kernel that fits the structure of the network
+	void Multiply(const T *x, Compute *y) const;
+
+	//! Adds W s to y for the binary vector s, bit-packed with neuron n in bit n%64 of word
+	//! n/64, in time proportional to the number of ones in s
+	void MultiplyEvents(const uint64_t *s, Compute *y);
+
+	//! Renumber the neurons with reverse Cuthill-McKee, permutation[new] = old
+	void Reorder(std::vector<int> & permutation);
+
+	//! Approximates W by a rank r (at most maxRank) part U V' plus a sparse residual, within
+	//! about tolerance times the spectral norm of W (estimated, not guaranteed), for Multiply()
+	//! until the next Pack(); false, and the kernel unchanged, if that is not cheaper than the
+	//! kernel of the structure
+	bool Factorize(Compute tolerance, int maxRank);
+
+	//! Rank of the factorization in use, 0 if there is none
+	inline int GetRank() const { return factored ? lowRankV.size() / width : 0; }
+
+	//! Number of weights in the sparse residual of the factorization in use
+	inline long GetResidualSize() const { return factored ? residualWeights.size() : 0; }
+
+	//! Estimated spectral norm of W minus its factorization, relative to that of W, of the
+	//! last Factorize(), also when the factorization was not kept
+	inline Compute GetFactorError() const { return d_factorError; }
+
+	//! Hash of all parameters that go into generating a network of the given mode
+	uint64_t Fingerprint(Mode mode, uint64_t hash) const;
+
+	//! Spectral radius after generation and normalization (negative if unknown)
+	inline Compute GetSpectralRadius() const { return d_measuredRadius; }
+
+	inline void SetSpectralRadius(Compute spectralRadius) { d_measuredRadius = spectralRadius; }
+
+	//! One function for all possible reservoir settings (different sets per reservoir type),
+	//! real valued ones are read as Compute
 	void SetParameter(NetworkParameter param, void *value);
 protected:
 	//! Randomly connected reservoir
@@ -79,10 +148,31 @@ protected:
 
 	bool createBalancedNetwork();
 
-	bool spectralRadius(WEIGHT_TYPE & spectralRadius);
+	//! Ring with all weights equal to the spectral radius
+	bool createSimpleCycle();
+
+	//! Chain of neurons, with optional backward connections
+	bool createDelayLine(bool feedback);
+
+	//! Small dense modules on the diagonal, sparsely coupled with each other
+	bool createModular();
+
+	//! Neurons on a 2D/3D grid, connected to all neighbours within a radius
+	bool createSpatial();
+
+	//! Shuffle the array of indices, which is created on first use
+	void shuffleIndices();
+
+	//! Derive grid dimensions and neighbour offsets
+	bool initGrid();
+
+	//! Spectral radius of the square block that starts at row and column "offset"
+	bool blockSpectralRadius(int offset, int nof_nodes, Compute & spectralRadius);
+
+	bool spectralRadius(Compute & spectralRadius);
 
 	//! Random variable between min and max
-	void uniform(WEIGHT_TYPE *value, float min=-1, float max=1);
+	void uniform(T *value, float min=-1, float max=1);
 
 	void printWeights(int type = 0);
 
@@ -91,27 +181,103 @@ protected:
 	void printDegrees();
 private:
 	//! Array with reservoir weights
-	WEIGHT_TYPE *weights;
+	T *weights;
 
 	//! Network connectivity (default CREATE_RANDOM)
 	Mode mode;
 
 	//! Connectivity
-	WEIGHT_TYPE d_connectivity;
+	Compute d_connectivity;
 
 	//! Spectral radius can be used for normalisation
-	WEIGHT_TYPE d_spectralRadius;
+	Compute d_spectralRadius;
+
+	//! Spectral radius of the weights as they are now
+	Compute d_measuredRadius;
 
 	//! Ratio of excitatory neurons
-	WEIGHT_TYPE d_excitatoryRatio;
+	Compute d_excitatoryRatio;
+
+	//! Ratio of backward versus forward weight in a delay line with feedback
+	Compute d_backwardRatio;
+
+	//! Topology of the weights, default CREATE_RANDOM (dense kernel)
+	Mode structure;
+
+	//! Forward and backward weight of the cycle and delay line kernels
+	Compute d_forward, d_backward;
+
+	//! Number of neurons per module, the last module may be smaller
+	int d_moduleSize;
+
+	//! Connectivity between modules, relative to the off-diagonal area
+	Compute d_interConnectivity;
+
+	//! Coupling weights are drawn from [-1,1] * coupling strength * spectral radius
+	Compute d_couplingStrength;
+
+	//! The modules of the modular kernel packed one after the other, row-wise per module
+	std::vector<T> blocks;
+
+	//! Sparse part of the kernel in compressed sparse row format, the connections between
+	//! modules, or the entire matrix of a sparse random network
+	std::vector<int> sparseRows, sparseCols;
+	std::vector<T> sparseWeights;
+
+	//! Random networks with a lower fraction of nonzero weights use the sparse kernel
+	bool sparse;
+
+	//! Random weights are -1 or +1 (before normalization) instead of uniform in [-1,1]
+	bool d_ternary;
+
+	//! Random networks with weights 0 and ±scale only use the ternary kernel, with a bit per
+	//! weight in the mask plane, and a bit for a negative weight in the sign plane, the
+	//! rows (n+63)/64 words apart
+	bool ternary;
+	std::vector<uint64_t> ternaryMask, ternarySign;
+	Compute d_ternaryScale;
+
+	//! Multiply() uses W ~ U V' + S, with the rows of U and V (u_r, v_r with |v_r| = 1) one
+	//! after the other, and S in compressed sparse row format
+	bool factored;
+	std::vector<T> lowRankU, lowRankV;
+	std::vector<int> residualRows, residualCols;
+	std::vector<T> residualWeights;
+	Compute d_factorError;
+
+	//! Grid dimensions, with width*height*depth the number of neurons (0 = derive from size)
+	int d_gridWidth, d_gridHeight, d_gridDepth;
+
+	//! Grid width and height in use, derived from the settings above by initGrid()
+	int gridWidth, gridHeight;
+
+	//! Neurons are connected within this (Euclidean) distance on the grid
+	Compute d_radius;
+
+	//! Neighbour offsets (dx,dy,dz) of the stencil
+	std::vector<int> stencil;
+
+	//! The outgoing weights of every neuron in compressed sparse column format, for
+	//! MultiplyEvents(), created on first use after Pack()
+	std::vector<int> eventColumns, eventRows;
+	std::vector<T> eventWeights;
+
+	//! Weight planes, one per offset: incoming weight of every neuron from that neighbour
+	std::vector<T> planes;
 
 	//! Keep an array of indices around
 	int *indices;
 
+	//! Matrices and temporaries of the eigenvalue solver, kept between calls
+	struct EigenWorkspace;
+	EigenWorkspace *eigen;
+
 	//! Width, height, and size of matrix
 	int width, height, size;
 };
 
+typedef TemplateNetwork<WEIGHT_TYPE> Network;
+
 }
 
 #endif /* NETWORK_H_ */
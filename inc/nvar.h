@@ -0,0 +1,109 @@
+/**
+ * @file nvar.h
+ * @brief Nonlinear vector autoregression, a feature engine without a reservoir
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object against this software used by the military, in the
+ * bio-industry, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2010 Anne van Rossum <anne@almende.com>
+ *
+ * @author 	Anne C. van Rossum
+ * @date	Oct 18, 2026
+ * @project	Replicator FP7
+ * @company	Almende B.V.
+ * @case
+ */
+
+
+#ifndef NVAR_H_
+#define NVAR_H_
+
+// General files
+#include <esn.h>
+#include <vector>
+
+/* **************************************************************************************
+ * Interface of NVAR
+ * **************************************************************************************/
+
+/**
+ * Next generation reservoir computing [1]: the features are the inputs and the fed back
+ * outputs of the last "delays" time steps, "stride" steps apart, together the linear part
+ * v(t) = [u(t); y(t-1); u(t-s); y(t-1-s); ...], followed by all quadratic monomials
+ * v_i(t) v_j(t) with i <= j. A readout on them is trained like that of an ESN: Run() writes
+ * the features of a trial where the ESN writes its states, so the same ridge regression
+ * (ESNPrediction) applies. There is no reservoir to generate, no spectral radius and no
+ * warm up beyond the (delays-1)*stride steps the delay line needs to fill.
+ *
+ * Features are computed a time step at a time from the inputs and outputs of the trial,
+ * so outputs generated during TEACHER_TESTING are fed back as with an ESN. The readout is
+ * linear: y(t) = W_out [features(t); u(t)].
+ *
+ * [1] Next generation reservoir computing (2021), Gauthier, Bollt, Griffith, Barbosa
+ */
+template<class T>
+class TemplateNVAR {
+public:
+	//! The type of the parameters and the arithmetic
+	typedef typename aNetwork::ScalarTraits<T>::Compute Compute;
+
+	//! Constructor NVAR, with delays >= 1 copies of the inputs and outputs, stride apart
+	TemplateNVAR(int inputSize, int outputSize, int delays, int stride = 1);
+
+	//! Destructor ~NVAR
+	virtual ~TemplateNVAR();
+
+	//! Same as ESN::Run, with the features as states, trial->stateSize == getFeatureSize()
+	void Run(TemplateTrial<T> *trial, SimulationType simType);
+
+	//! Number of features, the linear part and the quadratic monomials
+	inline int getFeatureSize() const
+	{
+		return d_linearSize + d_linearSize * (d_linearSize + 1) / 2;
+	}
+
+	inline int getInputSize() const
+	{
+		return d_inputSize;
+	}
+
+	inline int getOutputSize() const
+	{
+		return d_outputSize;
+	}
+
+	//! The readout, outputSize x (getFeatureSize() + inputSize), row after row
+	void setOutputWeights(T *weights, int len);
+
+	inline const T *getOutputWeights() const
+	{
+		return &d_outputWeights[0];
+	}
+protected:
+	//! Write the linear part and the monomials for time step t to features
+	void features(const TemplateTrial<T> *trial, int t, Compute *features) const;
+private:
+	int d_inputSize;
+	int d_outputSize;
+	int d_delays;
+	int d_stride;
+
+	//! Length of the linear part, delays*(inputSize + outputSize)
+	int d_linearSize;
+
+	std::vector<T> d_outputWeights;
+
+	//! Features of the current time step
+	std::vector<Compute> d_features;
+};
+
+typedef TemplateNVAR<WEIGHT_TYPE> NVAR;
+
+#endif /* NVAR_H_ */
@@ -0,0 +1,75 @@
+/**
+ * @file reservoir_cache.h
+ * @brief 
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common 
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from 
+ * thread pools and TCP/IP components to control architectures and learning algorithms. 
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object against this software used by the military, in the
+ * bio-industry, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2010 Anne van Rossum <anne@almende.com>
+ *
+ * @author 	Anne C. van Rossum
+ * @date	Oct 18, 2026
+ * @project	Replicator FP7
+ * @company	Almende B.V.
+ * @case	
+ */
+
+
+#ifndef RESERVOIR_CACHE_H_
+#define RESERVOIR_CACHE_H_
+
+// General files
+#include <network.h>
+#include <string>
+#include <stdint.h>
+
+namespace aNetwork {
+
+/* **************************************************************************************
+ * Interface of ReservoirCache
+ * **************************************************************************************/
+
+/**
+ * Directory with generated (and normalized) reservoirs. Every file is named after a hash of
+ * all parameters that went into the generation, including the random seed, so the same
+ * reservoir is never generated twice. A file consists of a header of 64 bytes, followed by
+ * the weights, so it can be mapped into memory as is.
+ */
+class ReservoirCache {
+public:
+	//! Constructor ReservoirCache, an empty directory disables the cache
+	ReservoirCache(const std::string & directory);
+
+	//! Destructor ~ReservoirCache
+	virtual ~ReservoirCache();
+
+	//! FNV-1a hash, chain calls by passing the previous hash
+	static uint64_t Hash(const void *data, int len, uint64_t hash = 14695981039346656037ULL);
+
+	//! Copy weights of a size x size reservoir from the cache, false if not present
+	template<class T>
+	bool Load(uint64_t key, T *weights, int size,
+			typename ScalarTraits<T>::Compute & spectralRadius);
+
+	//! Store weights of a size x size reservoir in the cache
+	template<class T>
+	bool Store(uint64_t key, const T *weights, int size,
+			typename ScalarTraits<T>::Compute spectralRadius);
+
+	inline bool Enabled() const { return !directory.empty(); }
+protected:
+	std::string FileName(uint64_t key);
+private:
+	std::string directory;
+};
+
+}
+
+#endif /* RESERVOIR_CACHE_H_ */
@@ -0,0 +1,174 @@
+/**
+ * @file scalar.h
+ * @brief Scalar types the network and the echo state network can be instantiated for
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object against this software used by the military, in the
+ * bio-industry, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2010 Anne van Rossum <anne@almende.com>
+ *
+ * @author 	Anne C. van Rossum
+ * @date	Oct 18, 2026
+ * @project	Replicator FP7
+ * @company	Almende B.V.
+ * @case
+ */
+
+
+#ifndef SCALAR_H_
+#define SCALAR_H_
+
+// General files
+#include <string.h>
+#include <stdint.h>
+
+namespace aNetwork {
+
+/* **************************************************************************************
+ * Interface of half and bfloat16
+ * **************************************************************************************/
+
+/**
+ * IEEE 754 half precision (binary16): 5 exponent and 10 mantissa bits, so about 3 decimal
+ * digits in [6e-5, 65504]. Only a storage format, it converts to float for every operation
+ * and is rounded to nearest even when assigned.
+ */
+struct half {
+	uint16_t bits;
+
+	half(): bits(0) {}
+
+	half(float value): bits(FromFloat(value)) {}
+
+	inline operator float() const { return ToFloat(bits); }
+
+	static inline uint16_t FromFloat(float value) {
+		uint32_t u; memcpy(&u, &value, sizeof(u));
+		uint32_t sign = u & 0x80000000u;
+		u ^= sign;
+		uint16_t h;
+		if (u >= (127u + 16) << 23) {
+			// too large for a half, infinity, or NaN (quiet)
+			h = (u > 255u << 23) ? 0x7e00 : 0x7c00;
+		} else if (u < 113u << 23) {
+			// subnormal or zero, the float addition aligns and rounds the mantissa
+			const uint32_t magic = ((127 - 15) + (23 - 10) + 1) << 23;
+			float f, m;
+			memcpy(&f, &u, sizeof(f));
+			memcpy(&m, &magic, sizeof(m));
+			f += m;
+			memcpy(&u, &f, sizeof(u));
+			h = u - magic;
+		} else {
+			// rebias the exponent, and round the 13 dropped bits to nearest even
+			uint32_t odd = (u >> 13) & 1;
+			u += ((uint32_t)(15 - 127) << 23) + 0xfff + odd;
+			h = u >> 13;
+		}
+		return h | (sign >> 16);
+	}
+
+	static inline float ToFloat(uint16_t h) {
+		const uint32_t shifted = 0x7c00u << 13;
+		uint32_t u = (h & 0x7fffu) << 13;
+		uint32_t exponent = u & shifted;
+		u += (127 - 15) << 23;
+		float f;
+		if (exponent == shifted) {
+			// infinity or NaN
+			u += (128 - 16) << 23;
+			memcpy(&f, &u, sizeof(f));
+		} else if (exponent == 0) {
+			// subnormal or zero, renormalize by a float subtraction
+			const uint32_t magic = 113u << 23;
+			float m;
+			u += 1 << 23;
+			memcpy(&f, &u, sizeof(f));
+			memcpy(&m, &magic, sizeof(m));
+			f -= m;
+		} else {
+			memcpy(&f, &u, sizeof(f));
+		}
+		uint32_t sign = (uint32_t)(h & 0x8000u) << 16;
+		memcpy(&u, &f, sizeof(u));
+		u |= sign;
+		memcpy(&f, &u, sizeof(f));
+		return f;
+	}
+};
+
+/**
+ * Brain floating point: the upper half of a float, so the range of a float with 8 mantissa
+ * bits, about 2 decimal digits. Only a storage format, like half.
+ */
+struct bfloat16 {
+	uint16_t bits;
+
+	bfloat16(): bits(0) {}
+
+	bfloat16(float value): bits(FromFloat(value)) {}
+
+	inline operator float() const { return ToFloat(bits); }
+
+	static inline uint16_t FromFloat(float value) {
+		uint32_t u; memcpy(&u, &value, sizeof(u));
+		if ((u & 0x7fffffffu) > 0x7f800000u) return (u >> 16) | 0x40;
+		u += 0x7fff + ((u >> 16) & 1);
+		return u >> 16;
+	}
+
+	static inline float ToFloat(uint16_t b) {
+		uint32_t u = (uint32_t)b << 16;
+		float f; memcpy(&f, &u, sizeof(f));
+		return f;
+	}
+};
+
+/* **************************************************************************************
+ * Interface of ScalarTraits
+ * **************************************************************************************/
+
+/**
+ * The type the arithmetic on a weight or state of type T is done in, sums and parameters are
+ * kept in it as well. That is T itself, except for the storage formats half and bfloat16,
+ * which are computed with in float.
+ */
+template<class T>
+struct ScalarTraits {
+	typedef T Compute;
+};
+
+template<>
+struct ScalarTraits<float> {
+	typedef float Compute;
+	static const char *Name() { return "float"; }
+};
+
+template<>
+struct ScalarTraits<double> {
+	typedef double Compute;
+	static const char *Name() { return "double"; }
+};
+
+template<>
+struct ScalarTraits<half> {
+	typedef float Compute;
+	static const char *Name() { return "half"; }
+};
+
+template<>
+struct ScalarTraits<bfloat16> {
+	typedef float Compute;
+	static const char *Name() { return "bfloat16"; }
+};
+
+}
+
+#endif /* SCALAR_H_ */
@@ -9,13 +9,25 @@
  */
 
 #include "esn.h"
+#include <reservoir_cache.h>
+#include <linalg_backend.h>
 #include <time.h>
 #include <stdlib.h>
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <functional>
 #include <iostream>
 #include <fstream>
 #include <assert.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 
@@ -29,8 +41,11 @@ using namespace std;
 // without leftover it does not work...
 #define DEFAULT_LEFTOVER		1
 
-// Reservoir type can be a random (1) or inhibitory/excitatory balanced network (0)
-#define RESERVOIR_TYPE			1
+// Reservoir type can be a random network (CREATE_RANDOM), an inhibitory/excitatory balanced
+// network (CREATE_BALANCED_NETWORK), or one of the minimum complexity topologies
+// (CREATE_SIMPLE_CYCLE, CREATE_DELAY_LINE, CREATE_DELAY_LINE_FEEDBACK), or a modular
+// network of small dense modules (CREATE_MODULAR), or neurons on a grid (CREATE_SPATIAL)
+#define RESERVOIR_TYPE			aNetwork::CREATE_RANDOM
 
 // HEAVISIDE_ACTIVATION or TANH_ACTIVATION
 
@@ -44,6 +59,90 @@ using namespace std;
 
 //#define ADD_NOISE
 
+// Magic number and version of a model file, files without the magic number are of the
+// format before (version 1)
+#define MODEL_MAGIC				"ESNMDL"
+#define MODEL_VERSION			2
+
+// Written as is, so a model from a machine with the other byte order can be recognized
+#define MODEL_BYTE_ORDER		0x01020304
+
+// The sections start after the header and at multiples of the alignment
+#define MODEL_HEADER_SIZE		1024
+#define MODEL_ALIGNMENT			64
+
+// Room in the section table for sections of later versions
+#define MODEL_MAX_SECTIONS		16
+
+enum ModelSectionType {
+	MODEL_INPUT_WEIGHTS,
+	MODEL_FEEDBACK_WEIGHTS,
+	MODEL_OUTPUT_WEIGHTS,
+	MODEL_RESERVOIR_WEIGHTS,
+	MODEL_THRESHOLDS,
+	MODEL_PERMUTATION,
+	MODEL_RESERVOIR_ROWS,
+	MODEL_RESERVOIR_COLUMNS,
+	MODEL_RESERVOIR_VALUES,
+	NOF_MODEL_SECTIONS
+};
+
+// The sections of the first files of version 2
+#define NOF_MODEL_SECTIONS_V2	(MODEL_PERMUTATION + 1)
+
+// Bits of ModelHeader::flags
+#define MODEL_REORDERED			0x1
+#define MODEL_TERNARY			0x2
+
+// Offset and size in bytes, and FNV-1a hash of a section
+struct ModelSection {
+	uint64_t offset;
+	uint64_t size;
+	uint64_t checksum;
+};
+
+// The parameters are stored as double, whatever the type of the ESN
+struct ModelHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	char type[16];
+	uint32_t weightSize;
+	int32_t inputSize;
+	int32_t outputSize;
+	int32_t reservoirSize;
+	int32_t reservoirActivation;
+	int32_t outputActivation;
+	int32_t topology;
+	uint32_t seed;
+	double connectivity;
+	double inConnectivity;
+	double fbConnectivity;
+	double spectralRadius;
+	double inputScale;
+	double feedbackScale;
+	double inputShift;
+	double feedbackShift;
+	double timeConstant;
+	double decayRate;
+	double excitatory;
+	uint32_t nofSections;
+	uint32_t flags;
+	ModelSection sections[MODEL_MAX_SECTIONS];
+	uint64_t checksum;
+};
+
+//! ReservoirCache::Hash over more than 2GB
+static uint64_t Checksum(const void *data, uint64_t size) {
+	const char *bytes = (const char*)data;
+	uint64_t hash = aNetwork::ReservoirCache::Hash(bytes, 0);
+	for (uint64_t done = 0; done < size; done += 1 << 30) {
+		int len = std::min<uint64_t>(size - done, 1 << 30);
+		hash = aNetwork::ReservoirCache::Hash(bytes + done, len, hash);
+	}
+	return hash;
+}
+
 #if DEFAULT_INPUT_CONN == 0
 #undef DEFAULT_INPUT_CONN
 #endif
@@ -57,9 +156,10 @@ using namespace std;
 #endif
 
 
-ESN::ESN()
+template<class T>
+TemplateESN<T>::TemplateESN()
 {
-	ESN(2,2,10,0.8);
+	TemplateESN(2,2,10,0.8);
 }
 
 /**
@@ -70,7 +170,8 @@ ESN::ESN()
  * @param reservoirSize		reservoir size (without input and output neurons)
  * @param connectivity		the degree of connectedness (1.0 is fully connected)
  */
-ESN::ESN(int inputSize, int outputSize, int reservoirSize,
+template<class T>
+TemplateESN<T>::TemplateESN(int inputSize, int outputSize, int reservoirSize,
 		float connectivity):
 		d_inputSize(inputSize),
 		d_outputSize(outputSize),
@@ -87,13 +188,25 @@ ESN::ESN(int inputSize, int outputSize, int reservoirSize,
 		d_feedbackShift(0),
 		d_timeConstant(1),
 		d_decayRate(1), // timeConstant = 1, decayRate = 1, means no leftover...
-		d_excitatory(0.7)
+		d_excitatory(0.7),
+		d_topology(RESERVOIR_TYPE),
+		d_reorder(false),
+		d_ternary(false),
+		d_refractoryPeriod(0),
+		d_seed(0)
 {
+	const char *cacheDirectory = getenv("ESN_RESERVOIR_CACHE");
+	if (cacheDirectory != NULL) d_cacheDirectory = cacheDirectory;
+
 	d_inputWeights 		= NULL;
 	d_outputWeights		= NULL;
 	d_feedbackWeights 	= NULL;
 	d_reservoirWeights 	= NULL;
 	d_output			= NULL;
+	d_recurrent			= NULL;
+	d_thresholds		= NULL;
+	d_mapping			= NULL;
+	d_mappingSize		= 0;
 
 	setReservoirActivation(d_reservoirActivation);
 	setOutputActivation(d_outputActivation);
@@ -102,7 +215,8 @@ ESN::ESN(int inputSize, int outputSize, int reservoirSize,
 	assert(reservoirSize > 1);
 }
 
-void ESN::setParameter(ESNParameter param, void * value)
+template<class T>
+void TemplateESN<T>::setParameter(ESNParameter param, void * value)
 {
 	switch(param)
 	{
@@ -116,28 +230,28 @@ void ESN::setParameter(ESNParameter param, void * value)
 		d_reservoirSize 	= *reinterpret_cast<int*>(value);
 		break;
 	case CONNECTIVITY:
-		d_connectivity 		= *reinterpret_cast<WEIGHT_TYPE*>(value);
+		d_connectivity 		= *reinterpret_cast<Compute*>(value);
 		break;
 	case INPUT_CONNECTIVITY:
-		d_inConnectivity 	= *reinterpret_cast<WEIGHT_TYPE*>(value);
+		d_inConnectivity 	= *reinterpret_cast<Compute*>(value);
 		break;
 	case OUTPUT_CONNECTIVITY:
-		d_fbConnectivity 	= *reinterpret_cast<WEIGHT_TYPE*>(value);
+		d_fbConnectivity 	= *reinterpret_cast<Compute*>(value);
 		break;
 	case SPECTRAL_RADIUS:
-		d_spectralRadius 	= *reinterpret_cast<WEIGHT_TYPE*>(value);
+		d_spectralRadius 	= *reinterpret_cast<Compute*>(value);
 		break;
 	case INPUT_SCALE:
-		d_inputScale 		= *reinterpret_cast<WEIGHT_TYPE*>(value);
+		d_inputScale 		= *reinterpret_cast<Compute*>(value);
 		break;
 	case OUTPUT_SCALE:
-		d_feedbackScale 	= *reinterpret_cast<WEIGHT_TYPE*>(value);
+		d_feedbackScale 	= *reinterpret_cast<Compute*>(value);
 		break;
 	case INPUT_SHIFT:
-		d_inputShift 		= *reinterpret_cast<WEIGHT_TYPE*>(value);
+		d_inputShift 		= *reinterpret_cast<Compute*>(value);
 		break;
 	case OUTPUT_SHIFT:
-		d_feedbackShift		= *reinterpret_cast<WEIGHT_TYPE*>(value);
+		d_feedbackShift		= *reinterpret_cast<Compute*>(value);
 		break;
 	case OUTPUT_ACTIVATION:
 		d_outputActivation 	= *reinterpret_cast<ActivationFunction*>(value);
@@ -152,7 +266,8 @@ void ESN::setParameter(ESNParameter param, void * value)
 // Network Initialization //
 
 
-void ESN::generateConnections(WEIGHT_TYPE connectivity, int weightSize, WEIGHT_TYPE * weights, WEIGHT_TYPE min, WEIGHT_TYPE max)
+template<class T>
+void TemplateESN<T>::generateConnections(Compute connectivity, int weightSize, T * weights, Compute min, Compute max)
 {
 	// Generate  Weights between [-1,1]
 
@@ -162,10 +277,8 @@ void ESN::generateConnections(WEIGHT_TYPE connectivity, int weightSize, WEIGHT_T
 	// the connectivity is then for every neuron the same
 	// but what's the extra cost of using a pair
 
-	srand(time(NULL));
-
 	// Holzmann and Jaeger use -0.5 on the connectionSize
-	int connectionSize = WEIGHT_TYPE(weightSize) * connectivity;
+	int connectionSize = Compute(weightSize) * connectivity;
 
 	for (int x = 0; x < connectionSize; ++x)
 	{
@@ -175,7 +288,7 @@ void ESN::generateConnections(WEIGHT_TYPE connectivity, int weightSize, WEIGHT_T
 			conn = rand() % weightSize;
 			// Maybe exclude options from randomness,
 			// can take for ever to find an empty spot
-			if(weights[conn] != WEIGHT_TYPE(0))
+			if(weights[conn] != T(0))
 			{
 				--x;
 				continue;
@@ -186,12 +299,12 @@ void ESN::generateConnections(WEIGHT_TYPE connectivity, int weightSize, WEIGHT_T
 
 }
 
-void ESN::scaleAndShift(WEIGHT_TYPE * weights, int weightSize, WEIGHT_TYPE scale, WEIGHT_TYPE shift)
+template<class T>
+void TemplateESN<T>::scaleAndShift(T * weights, int weightSize, Compute scale, Compute shift)
 {
 	for (int x = 0; x < weightSize; ++x)
 	{
-		weights[x] *= scale;
-		weights[x] += shift;
+		weights[x] = weights[x] * scale + shift;
 	}
 }
 
@@ -205,15 +318,21 @@ void ESN::scaleAndShift(WEIGHT_TYPE * weights, int weightSize, WEIGHT_TYPE scale
  * from [reservoirsize, reservoirsize+inputsize] all the connection from the input neurons to the 1st output neuron
  *  Optionally an bias for the reservoir can be used, for a constant input to reservoir neurons (D. Verstraeten, K. Braeckman)
  */
-void ESN::init()
+template<class T>
+void TemplateESN<T>::init()
 {
 	destroy();
 
+	// A fixed seed makes the ESN reproducible (and its reservoir cacheable)
+	unsigned int seed = d_seed ? d_seed : time(NULL);
+	srand(seed);
+	srand48(seed);
+
 	// Generate Input Weights between [-1,1]
 	int connectionSize = d_inputSize*d_reservoirSize;
-	d_inputWeights = new WEIGHT_TYPE[connectionSize];
+	d_inputWeights = new T[connectionSize];
 	for (int x = 0; x < connectionSize; ++x)
-		d_inputWeights[x] = WEIGHT_TYPE(0);
+		d_inputWeights[x] = T(0);
 
 #ifdef DEFAULT_INPUT_CONN
 	generateConnections(d_inConnectivity, connectionSize, d_inputWeights);
@@ -250,23 +369,29 @@ void ESN::init()
 
 	// Generate Feedback Weights between [-1,1]
 	connectionSize = d_outputSize*d_reservoirSize;
-	d_feedbackWeights = new WEIGHT_TYPE[connectionSize];
+	d_feedbackWeights = new T[connectionSize];
 	for (int x = 0; x < connectionSize; ++x)
-		d_feedbackWeights[x] = WEIGHT_TYPE(0);
+		d_feedbackWeights[x] = T(0);
 
 	generateConnections(d_fbConnectivity, connectionSize, d_feedbackWeights);
+	if (d_ternary) {
+		for (int x = 0; x < connectionSize; ++x) {
+			if (d_feedbackWeights[x] != T(0))
+				d_feedbackWeights[x] = (d_feedbackWeights[x] > T(0)) ? T(1) : T(-1);
+		}
+	}
 	if(d_feedbackScale != 1 || d_feedbackShift != 0 )
 		scaleAndShift(d_feedbackWeights, connectionSize, d_feedbackScale, d_feedbackShift);
 
 	// Generate Output Weights between [-1,1]
 	connectionSize = d_outputSize*d_reservoirSize + d_outputSize*d_inputSize;
-	d_outputWeights = new WEIGHT_TYPE[connectionSize];
+	d_outputWeights = new T[connectionSize];
 	for (int x = 0; x < connectionSize; ++x)
-		d_outputWeights[x] = WEIGHT_TYPE(0);
+		d_outputWeights[x] = T(0);
 	generateConnections(1, connectionSize, d_outputWeights);
 
 	// generate thresholds for reservoir neurons
-	d_thresholds = new WEIGHT_TYPE[d_reservoirSize];
+	d_thresholds = new T[d_reservoirSize];
 #ifdef DEFAULT_INPUT_CONN
 	for (int i = 0; i < d_reservoirSize; i++) d_thresholds[i] = THRESHOLD_VALUE;
 #else
@@ -275,51 +400,102 @@ void ESN::init()
 #endif
 
 	// Generate Reservoir Weights between [-1,1]
-	generateReservoirConnections();
+	generateReservoirConnections(seed);
+
+	d_permutation.resize(d_reservoirSize);
+	for (int i = 0; i < d_reservoirSize; i++) d_permutation[i] = i;
+	if (d_reorder) reorderNeurons();
 
 	// settling time (ST) must be reduced for high frequency use but it does
 	// not improve the performance
 
 	// set output values to 0
-	d_output = new WEIGHT_TYPE[d_outputSize];
+	d_output = new T[d_outputSize];
 	for (int x = 0; x < d_outputSize; ++x)
-		d_output[x] = WEIGHT_TYPE(0);
+		d_output[x] = T(0);
+
+	d_recurrent = new Compute[d_reservoirSize];
+}
+
+//! Seed rand() and drand48() from a 64-bit hash
+static void Reseed(uint64_t hash) {
+	srand((unsigned int)(hash ^ (hash >> 32)));
+	srand48((long)hash);
 }
 
 /**
  * The recurrent connections internal to the reservoir are by default independently
  * taken from a uniform distribution [-1 ... 1].
  *
+ * The random generators are seeded again from the seed and the network parameters before
+ * the reservoir is generated, so it does not depend on the weights drawn before it, and
+ * once more afterwards, so the draws after init() are the same whether the reservoir came
+ * from the cache or not.
+ *
  * The eigenvalue has to be near the predefined spectral radius for good echoing
  * Morse divides the weights by the spectral radius + 0.0001
  * Holzmann and Jaeger multiplies the weights with (spectral radius alpha/max Eigenval)
  */
-void ESN::generateReservoirConnections() {
+template<class T>
+void TemplateESN<T>::generateReservoirConnections(unsigned int seed) {
 //	WEIGHT_TYPE maxEigenvalue = 0;
 //	WEIGHT_TYPE max = 0;
 
 	// Size of the reservoir proper
 	int connectionSize = d_reservoirSize*d_reservoirSize;
-	d_reservoirWeights = new WEIGHT_TYPE[connectionSize];
+	d_reservoirWeights = new T[connectionSize];
 
 	reservoir.Init(d_reservoirWeights, d_reservoirSize, d_reservoirSize);
 
 	reservoir.SetParameter(aNetwork::CONNECTIVITY, &d_connectivity);
 	reservoir.SetParameter(aNetwork::SPECTRAL_RADIUS, &d_spectralRadius);
 	reservoir.SetParameter(aNetwork::EXCITATORY_RATIO, &d_excitatory);
+	int ternary = d_ternary;
+	reservoir.SetParameter(aNetwork::TERNARY, &ternary);
+
+	// The key is everything the reservoir depends on; with a seed of 0 (the time) the cache
+	// is disabled
+	aNetwork::ReservoirCache cache(d_seed ? d_cacheDirectory : "");
+	uint64_t key = aNetwork::ReservoirCache::Hash(&seed, sizeof(seed));
+	key = reservoir.Fingerprint(d_topology, key);
+	const char after[] = "after";
+	uint64_t next = aNetwork::ReservoirCache::Hash(after, sizeof(after), key);
+	Compute radius;
+	if (cache.Load(key, d_reservoirWeights, d_reservoirSize, radius)) {
+		reservoir.SetStructure(d_topology);
+		reservoir.SetSpectralRadius(radius);
+		reservoir.Pack();
+		Reseed(next);
+		return;
+	}
+	Reseed(key);
 
 	bool okay = false;
 	while (!okay)
 	{
-		int reservoirType = RESERVOIR_TYPE;
-		switch (reservoirType) {
-		case 0:
+		switch (d_topology) {
+		case aNetwork::CREATE_BALANCED_NETWORK:
 			reservoir.SetMode(aNetwork::CREATE_BALANCED_NETWORK);
 			okay = reservoir.Run();
 			reservoir.SetMode(aNetwork::NORMALIZE_SPECTRUM);
 			okay = okay && reservoir.Run();
 			break;
-		case 1:
+		case aNetwork::CREATE_SIMPLE_CYCLE:
+		case aNetwork::CREATE_DELAY_LINE:
+		case aNetwork::CREATE_DELAY_LINE_FEEDBACK:
+		case aNetwork::CREATE_MODULAR:
+			// spectral radius is set analytically or per module, no eigenvalues of the
+			// entire reservoir needed
+			reservoir.SetMode(d_topology);
+			okay = reservoir.Run();
+			break;
+		case aNetwork::CREATE_SPATIAL:
+			reservoir.SetMode(aNetwork::CREATE_SPATIAL);
+			okay = reservoir.Run();
+			reservoir.SetMode(aNetwork::NORMALIZE_SPECTRUM);
+			okay = okay && reservoir.Run();
+			break;
+		default:
 			reservoir.SetMode(aNetwork::CREATE_RANDOM);
 			reservoir.Run();
 			reservoir.SetMode(aNetwork::NORMALIZE_SPECTRUM);
@@ -327,14 +503,130 @@ void ESN::generateReservoirConnections() {
 			break;
 		}
 	}
+	cache.Store(key, d_reservoirWeights, d_reservoirSize, reservoir.GetSpectralRadius());
+	Reseed(next);
 //	WEIGHT_TYPE new_max = 0;
 //	spectralRadius(d_reservoirWeights, d_reservoirSize, &new_max);
 //	cout << "After scaling the maximum eigen value is " << new_max << endl;
 }
 
-void ESN::uniform(WEIGHT_TYPE * value, float min, float max)
+/**
+ * Renumbers the neurons such that the nonzero reservoir weights of each neuron come from
+ * neurons with nearby indices. All weights indexed by reservoir neuron are permuted in the
+ * same way, so the outputs of the reservoir stay the same. Only the order of the states in
+ * Trial::neuronVal changes, see getPermutation().
+ */
+template<class T>
+void TemplateESN<T>::reorderNeurons()
 {
-	WEIGHT_TYPE tmp = rand() / (WEIGHT_TYPE(RAND_MAX)+1); // between [0|1)
+	reservoir.Reorder(d_permutation);
+
+	int n = d_reservoirSize;
+	std::vector<T> tmp;
+	tmp.assign(d_inputWeights, d_inputWeights + n*d_inputSize);
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < d_inputSize; j++)
+			d_inputWeights[i*d_inputSize + j] = tmp[d_permutation[i]*d_inputSize + j];
+
+	tmp.assign(d_feedbackWeights, d_feedbackWeights + n*d_outputSize);
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < d_outputSize; j++)
+			d_feedbackWeights[i*d_outputSize + j] = tmp[d_permutation[i]*d_outputSize + j];
+
+	int stride = n + d_inputSize;
+	tmp.assign(d_outputWeights, d_outputWeights + d_outputSize*stride);
+	for (int o = 0; o < d_outputSize; o++)
+		for (int i = 0; i < n; i++)
+			d_outputWeights[o*stride + i] = tmp[o*stride + d_permutation[i]];
+
+	tmp.assign(d_thresholds, d_thresholds + n);
+	for (int i = 0; i < n; i++)
+		d_thresholds[i] = tmp[d_permutation[i]];
+}
+
+/**
+ * The contribution of neuron i to the readout is sum_o |W_out(o,i)| scale(i). The kept
+ * neurons stay in the same order, so a reordered reservoir stays banded, and getPermutation()
+ * still gives the original index of every state. The weights from removed neurons to kept
+ * neurons are dropped as well, which changes the states of the kept neurons, so the readout
+ * is only an approximation until it is trained again (see ESNPrediction::Prune).
+ *
+ * The reservoir no longer follows its topology nor the seed: it is packed with the dense,
+ * sparse or ternary kernel, and saveESN() stores the weights instead of the seed.
+ */
+template<class T>
+void TemplateESN<T>::Prune(int budget, const Compute *scale)
+{
+	int n = d_reservoirSize;
+	assert (d_reservoirWeights != NULL);
+	assert (budget > 1);
+	if (budget >= n) return;
+
+	int stride = n + d_inputSize;
+	std::vector<std::pair<Compute,int> > contribution(n);
+	for (int i = 0; i < n; i++) {
+		Compute sum = 0;
+		for (int o = 0; o < d_outputSize; o++) sum += fabs((Compute)d_outputWeights[o*stride + i]);
+		contribution[i] = std::make_pair(sum * (scale != NULL ? scale[i] : 1), i);
+	}
+	std::nth_element(contribution.begin(), contribution.begin() + budget, contribution.end(),
+			std::greater<std::pair<Compute,int> >());
+	std::vector<int> kept(budget);
+	for (int k = 0; k < budget; k++) kept[k] = contribution[k].second;
+	std::sort(kept.begin(), kept.end());
+
+	int m = budget;
+	int newStride = m + d_inputSize;
+	T *inputWeights = new T[m*d_inputSize];
+	T *feedbackWeights = new T[m*d_outputSize];
+	T *outputWeights = new T[d_outputSize*newStride];
+	T *reservoirWeights = new T[m*m];
+	T *thresholds = new T[m];
+	std::vector<int> permutation(m);
+	for (int k = 0; k < m; k++) {
+		int i = kept[k];
+		for (int j = 0; j < d_inputSize; j++)
+			inputWeights[k*d_inputSize + j] = d_inputWeights[i*d_inputSize + j];
+		for (int j = 0; j < d_outputSize; j++)
+			feedbackWeights[k*d_outputSize + j] = d_feedbackWeights[i*d_outputSize + j];
+		for (int l = 0; l < m; l++)
+			reservoirWeights[k*m + l] = d_reservoirWeights[i*n + kept[l]];
+		thresholds[k] = d_thresholds[i];
+		permutation[k] = d_permutation.empty() ? i : d_permutation[i];
+	}
+	for (int o = 0; o < d_outputSize; o++) {
+		for (int k = 0; k < m; k++)
+			outputWeights[o*newStride + k] = d_outputWeights[o*stride + kept[k]];
+		for (int j = 0; j < d_inputSize; j++)
+			outputWeights[o*newStride + m + j] = d_outputWeights[o*stride + n + j];
+	}
+
+	destroy();
+	d_reservoirSize = m;
+	d_inputWeights = inputWeights;
+	d_feedbackWeights = feedbackWeights;
+	d_outputWeights = outputWeights;
+	d_reservoirWeights = reservoirWeights;
+	d_thresholds = thresholds;
+	d_permutation = permutation;
+	d_topology = aNetwork::CREATE_RANDOM;
+	d_seed = 0;
+
+	reservoir.Init(d_reservoirWeights, d_reservoirSize, d_reservoirSize);
+	reservoir.SetStructure(aNetwork::CREATE_RANDOM);
+	reservoir.SetSpectralRadius(-1);
+	reservoir.Pack();
+
+	d_output = new T[d_outputSize];
+	for (int x = 0; x < d_outputSize; ++x)
+		d_output[x] = T(0);
+	d_recurrent = new Compute[d_reservoirSize];
+}
+
+template<class T>
+void TemplateESN<T>::uniform(T * value, float min, float max)
+{
+	Compute tmp = rand() / (Compute(RAND_MAX)+1); // between [0|1)
 	*value = tmp*(max-min) + min;
 }
 // End Network initialization //
@@ -342,71 +634,78 @@ void ESN::uniform(WEIGHT_TYPE * value, float min, float max)
 
 // Activation functions //
 
-WEIGHT_TYPE ESN::act_heaviside(WEIGHT_TYPE value)
+template<class T>
+typename TemplateESN<T>::Compute TemplateESN<T>::act_heaviside(Compute value)
 {
 	return (value > 0 ? 1.0 : 0.0);
 }
 
-WEIGHT_TYPE ESN::act_logistic(WEIGHT_TYPE value)
+template<class T>
+typename TemplateESN<T>::Compute TemplateESN<T>::act_logistic(Compute value)
 {
 	return 1.0 / (1.0 + exp(value) );
 }
 
-WEIGHT_TYPE ESN::act_invlogistic(WEIGHT_TYPE value)
+template<class T>
+typename TemplateESN<T>::Compute TemplateESN<T>::act_invlogistic(Compute value)
 {
 	return log( 1.0/( value) - 1.0 );
 }
 
-WEIGHT_TYPE ESN::act_tanh(WEIGHT_TYPE value)
+template<class T>
+typename TemplateESN<T>::Compute TemplateESN<T>::act_tanh(Compute value)
 {
 	return tanh( value );
 }
 
-WEIGHT_TYPE ESN::act_invtanh(WEIGHT_TYPE value)
+template<class T>
+typename TemplateESN<T>::Compute TemplateESN<T>::act_invtanh(Compute value)
 {
 	return atanh( value );
 }
 
-void ESN::setReservoirActivation(ActivationFunction reservoirActivation)
+template<class T>
+void TemplateESN<T>::setReservoirActivation(ActivationFunction reservoirActivation)
 {
 	this->d_reservoirActivation = reservoirActivation;
 
 	switch(reservoirActivation)
 	{
 	case IDENTITY_ACTIVATION:
-		resActFunc = &ESN::act_identity;
+		resActFunc = &TemplateESN<T>::act_identity;
 		break;
 	case LOGISTIC_ACTIVATION:
-		resActFunc = &ESN::act_logistic;
+		resActFunc = &TemplateESN<T>::act_logistic;
 		break;
 	case TANH_ACTIVATION:
-		resActFunc = &ESN::act_tanh;
+		resActFunc = &TemplateESN<T>::act_tanh;
 		break;
 	case HEAVISIDE_ACTIVATION:
-		resActFunc = &ESN::act_heaviside;
+		resActFunc = &TemplateESN<T>::act_heaviside;
 		break;
 	default:
 		cout << "Activation function is unknown" << endl;
 	}
 }
 
-void ESN::setOutputActivation(ActivationFunction outputActivation)
+template<class T>
+void TemplateESN<T>::setOutputActivation(ActivationFunction outputActivation)
 {
 	this->d_outputActivation = outputActivation;
 
 	switch(outputActivation)
 	{
 	case IDENTITY_ACTIVATION:
-		outInvActFunc = &ESN::act_invidentity;
-		outActFunc = &ESN::act_identity;
+		outInvActFunc = &TemplateESN<T>::act_invidentity;
+		outActFunc = &TemplateESN<T>::act_identity;
 		break;
 	case LOGISTIC_ACTIVATION:
-		outActFunc = &ESN::act_logistic;
-		outInvActFunc = &ESN::act_invlogistic;
+		outActFunc = &TemplateESN<T>::act_logistic;
+		outInvActFunc = &TemplateESN<T>::act_invlogistic;
 		break;
 	case TANH_ACTIVATION:
-		outActFunc = &ESN::act_tanh;
-		outInvActFunc = &ESN::act_invtanh;
+		outActFunc = &TemplateESN<T>::act_tanh;
+		outInvActFunc = &TemplateESN<T>::act_invtanh;
 		break;
 	default:
 		cout << "Activation function is unknown" << endl;
@@ -421,42 +720,71 @@ void ESN::setOutputActivation(ActivationFunction outputActivation)
  * in this function, the ESN is just run. You will need to adapt the weights by e.g. linear
  * regression after you got the response of the reservoir on the given input.
  * This function uses the generic methods of Jaeger, with Holzmann parameters
+ *
+ * With the heaviside activation the neurons only spike now and then, so W x(t-1) is not
+ * computed as a whole, but kept up to date: with the leftover a the state is
+ * x(t) = a x(t-1) + s(t), with s(t) the spikes, so W x(t) = a W x(t-1) + W s(t), and only the
+ * weights of the neurons that spiked are added. A spiking neuron is silent for the
+ * refractory period afterwards, see setRefractoryPeriod().
  */
-void ESN::Run(Trial *trial, SimulationType simType)
+template<class T>
+void TemplateESN<T>::Run(TemplateTrial<T> *trial, SimulationType simType)
 {
 	assert (trial != NULL);
 
-	WEIGHT_TYPE const * const input		= trial->inputVal;
+	T const * const input		= trial->inputVal;
 	int inputSize 						= trial->inputSize;
 	int timespan	 					= trial->sampleSize;
 	int reservoirSize					= trial->stateSize;
-	WEIGHT_TYPE * output				= trial->outputVal;
-	WEIGHT_TYPE * states				= trial->neuronVal;
+	T * output				= trial->outputVal;
+	T * states				= trial->neuronVal;
 
 	assert (input != NULL);
 	assert (output != NULL);
 	assert (states != NULL);
 	assert (d_thresholds != NULL);
 
+	assert (d_recurrent != NULL);
+
+	// The spikes of the last step, bit-packed, and the steps neurons still have to wait
+	bool events = (d_reservoirActivation == HEAVISIDE_ACTIVATION);
+	std::vector<uint64_t> spikes;
+	std::vector<int> refractory;
+	Compute leak = 0;
+	if (events) {
+		spikes.assign((reservoirSize + 63) / 64, 0);
+		refractory.assign(reservoirSize, 0);
+#ifdef DEFAULT_LEFTOVER
+		leak = 1-d_timeConstant*d_decayRate;
+#endif
+		for (int n = 0; n < reservoirSize; ++n) d_recurrent[n] = 0;
+	}
+
 	// For all the samples compute the states of all the Reservoir neurons
 	for (int t = 0; t < timespan; ++t) {
 
+		// From reservoir neurons also add one state..., W x(t-1), the network picks the
+		// kernel that fits its topology
+		if (t > 0 && events) {
+			for (int n = 0; n < reservoirSize; ++n) d_recurrent[n] = leak * d_recurrent[n];
+			reservoir.MultiplyEvents(&spikes[0], d_recurrent);
+			std::fill(spikes.begin(), spikes.end(), 0);
+		} else if (t > 0)
+			reservoir.Multiply(states + (t-1)*d_reservoirSize, d_recurrent);
+
 		// For all the reservoirs neurons compute their activation
 		for (int n = 0; n < reservoirSize; ++n) {
-			WEIGHT_TYPE input2ResVal 	= 0;
-			WEIGHT_TYPE res2ResVal 		= 0;
-			WEIGHT_TYPE fb2ResVal 		= 0;
+			Compute input2ResVal 	= 0;
+			Compute res2ResVal 		= 0;
+			Compute fb2ResVal 		= 0;
 
 			// Compute the input from all the input neurons, W_in u(t)
 			for (int inputNr = 0; inputNr < inputSize; ++inputNr) {
 				input2ResVal += input[(t*inputSize) + inputNr]*d_inputWeights[(n*inputSize) + inputNr];
 			}
 
-			// From reservoir neurons also add one state..., W x(t-1)
-			for (int innerResNr = 0; innerResNr < d_reservoirSize; ++innerResNr) {
-				if(t > 0)
-					res2ResVal += states[((t-1)*d_reservoirSize)+innerResNr] * d_reservoirWeights[(n*d_reservoirSize) + innerResNr];
-			}
+			if(t > 0)
+				res2ResVal = d_recurrent[n];
 
 			// Compute the input from the output neurons (Feedback), W_back y(t-1)
 			if(d_fbConnectivity > 0)
@@ -471,17 +799,27 @@ void ESN::Run(Trial *trial, SimulationType simType)
 			// Verstraeten: Left over of the last state is used, thats normal, then the leak rate is multiplied with the new activation,
 			// thats the part that got away. But Holzmann does not use the leak part as quotient for the inner reservoir neuron values
 			// leftover = (1 − δCa)x(t-1)
-			WEIGHT_TYPE leftOver = 0;
+			Compute leftOver = 0;
 #ifdef DEFAULT_LEFTOVER
 			if(t > 0) leftOver = (1-d_timeConstant*d_decayRate) * states[((t-1)*d_reservoirSize) + n];
 #endif
-			WEIGHT_TYPE noise = 0;
+			Compute noise = 0;
 #ifdef ADD_NOISE
 			if (simType == TEACHER_FORCING) noise = (drand48() - 0.5) / 5000;
 #endif
 			// x(t) = (1 − δCa)x(t-1) + δC(f (W_in u(t) + W x(t-1) + W_back y(t-1) + ν(t-1))
 			// forget noise for now, also assume δ=1
-			WEIGHT_TYPE total_input = (*this.*resActFunc)(input2ResVal + res2ResVal*d_timeConstant + fb2ResVal - d_thresholds[n] + noise);
+			Compute total_input = (*this.*resActFunc)(input2ResVal + res2ResVal*d_timeConstant + fb2ResVal - d_thresholds[n] + noise);
+
+			if (events) {
+				if (refractory[n] > 0) {
+					refractory[n]--;
+					total_input = 0;
+				} else if (total_input != 0) {
+					refractory[n] = d_refractoryPeriod;
+					spikes[n / 64] |= (uint64_t)1 << (n % 64);
+				}
+			}
 
 			// For now a spike event is registered as interesting for debugging visually
 			trial->debug[(t*d_reservoirSize)+n] = total_input;
@@ -496,8 +834,8 @@ void ESN::Run(Trial *trial, SimulationType simType)
 		if ((simType == TEACHER_TESTING) && (t < trial->teacherTestSize)) setOutput = false;
 		if ( setOutput ) {
 			for (int outputNNr = 0; outputNNr < d_outputSize; ++outputNNr) {
-				WEIGHT_TYPE res2outputVal 	= 0;
-				WEIGHT_TYPE input2outputVal = 0;
+				Compute res2outputVal 	= 0;
+				Compute input2outputVal = 0;
 
 				for (int resNNr = 0; resNNr < d_reservoirSize; ++resNNr) {
 					res2outputVal += states[(t*d_reservoirSize)+ resNNr]*d_outputWeights[(outputNNr*(d_reservoirSize + d_inputSize))+resNNr];
@@ -515,10 +853,139 @@ void ESN::Run(Trial *trial, SimulationType simType)
 	}
 }
 
-void ESN::printStats()
+/**
+ * Same as Run() for a linear reservoir (IDENTITY_ACTIVATION) of which the outputs are not fed
+ * back, or given (TEACHER_FORCING), so every state is a linear function of the inputs:
+ * x(t) = A x(t-1) + b(t), with A = (1 − δCa) I + δC W and b(t) = W_in u(t) + W_back y(t-1) - θ.
+ * The time steps are cut into chunks, by default one per thread, that are run in parallel
+ * twice:
+ *
+ * 1. every chunk from a zero state, which gives x(t) - A^(t-s+1) x(s-1), with s the first
+ *    step of the chunk
+ * 2. after the last states of the chunks are corrected one after the other with the
+ *    propagator A^L of a chunk of L steps, every chunk adds A^(t-s+1) x(s-1) to its states
+ *
+ * That is twice the work of Run(), plus A^L by repeated squaring, O(n^3 log L), so it pays
+ * off for long sequences on several cores. Anything else is left to Run().
+ */
+template<class T>
+void TemplateESN<T>::RunParallel(TemplateTrial<T> *trial, SimulationType simType, int nofChunks)
+{
+	assert (trial != NULL);
+
+	T const * const input		= trial->inputVal;
+	int inputSize 				= trial->inputSize;
+	int timespan	 			= trial->sampleSize;
+	T * output					= trial->outputVal;
+	T * states					= trial->neuronVal;
+	int n						= d_reservoirSize;
+
+	if (nofChunks <= 0) {
+#ifdef _OPENMP
+		nofChunks = omp_get_max_threads();
+#else
+		nofChunks = 1;
+#endif
+	}
+	int length = (timespan + nofChunks - 1) / std::max(nofChunks, 1);
+	bool linear = (d_reservoirActivation == IDENTITY_ACTIVATION) &&
+			(d_fbConnectivity <= 0 || simType == TEACHER_FORCING);
+	if (!linear || nofChunks <= 1 || length < 2) {
+		Run(trial, simType);
+		return;
+	}
+	nofChunks = (timespan + length - 1) / length;
+
+	assert (input != NULL);
+	assert (output != NULL);
+	assert (states != NULL);
+	assert (trial->stateSize == n);
+
+	Compute leftOver = 0;
+#ifdef DEFAULT_LEFTOVER
+	leftOver = 1-d_timeConstant*d_decayRate;
+#endif
+
+	// The last state of every chunk, run from a zero state
+	std::vector<Compute> last((long)nofChunks * n);
+#pragma omp parallel for schedule(static, 1)
+	for (int c = 0; c < nofChunks; ++c) {
+		int begin = c * length, end = std::min(timespan, begin + length);
+		std::vector<Compute> previous(n, 0), recurrent(n, 0);
+		for (int t = begin; t < end; ++t) {
+			if (t > begin) reservoir.Multiply(states + (t-1)*n, &recurrent[0]);
+			for (int i = 0; i < n; ++i) {
+				Compute value = -(Compute)d_thresholds[i];
+				for (int k = 0; k < inputSize; ++k)
+					value += input[t*inputSize + k] * d_inputWeights[i*inputSize + k];
+				if (d_fbConnectivity > 0 && t > 0)
+					for (int o = 0; o < d_outputSize; ++o)
+						value += output[(t-1)*d_outputSize + o] * d_feedbackWeights[i*d_outputSize + o];
+				if (t > begin) value += leftOver * previous[i] + d_timeConstant * recurrent[i];
+				previous[i] = value;
+				states[t*n + i] = value;
+			}
+		}
+		std::copy(previous.begin(), previous.end(), last.begin() + (long)c * n);
+	}
+
+	// A^length, with A dense
+	aNetwork::LinalgBackend<Compute> & blas = aNetwork::LinalgBackend<Compute>::Get();
+	std::vector<Compute> power((long)n * n), propagator((long)n * n, 0), product((long)n * n);
+	for (long i = 0; i < (long)n * n; ++i) power[i] = d_timeConstant * d_reservoirWeights[i];
+	for (int i = 0; i < n; ++i) {
+		power[(long)i*n + i] += leftOver;
+		propagator[(long)i*n + i] = 1;
+	}
+	for (int k = length; k > 0; k >>= 1) {
+		if (k & 1) {
+			blas.Gemm(false, false, n, n, n, 1, &power[0], n, &propagator[0], n, 0, &product[0], n);
+			propagator.swap(product);
+		}
+		if (k > 1) {
+			blas.Gemm(false, false, n, n, n, 1, &power[0], n, &power[0], n, 0, &product[0], n);
+			power.swap(product);
+		}
+	}
+
+	// The true last state of every chunk, x(s+L-1) = last + A^L x(s-1)
+	for (int c = 1; c < nofChunks - 1; ++c)
+		blas.Gemm(false, false, n, 1, n, 1, &propagator[0], n, &last[(long)(c-1) * n], 1, 1,
+				&last[(long)c * n], 1);
+
+#pragma omp parallel for schedule(static, 1)
+	for (int c = 0; c < nofChunks; ++c) {
+		int begin = c * length, end = std::min(timespan, begin + length);
+		std::vector<Compute> carry(n, 0), recurrent(n);
+		std::vector<T> stored(n);
+		if (c > 0) std::copy(last.begin() + (long)(c-1) * n, last.begin() + (long)c * n, carry.begin());
+		std::vector<Compute> previous(carry);
+		for (int t = begin; t < end; ++t) {
+			if (c > 0) {
+				// carry = A^(t-s+1) x(s-1)
+				for (int i = 0; i < n; ++i) stored[i] = carry[i];
+				reservoir.Multiply(&stored[0], &recurrent[0]);
+				for (int i = 0; i < n; ++i) {
+					carry[i] = leftOver * carry[i] + d_timeConstant * recurrent[i];
+					states[t*n + i] = (Compute)states[t*n + i] + carry[i];
+				}
+			}
+			// the activation, as Run() keeps it
+			for (int i = 0; i < n; ++i) {
+				Compute value = states[t*n + i];
+				trial->debug[t*n + i] = value - (t > 0 ? leftOver * previous[i] : 0);
+				previous[i] = value;
+			}
+		}
+	}
+}
+
+template<class T>
+void TemplateESN<T>::printStats()
 {
 	cout<< "___________Echo State Network__________"		<< endl
 			<< "Reservoir size: " 			<< d_reservoirSize 		<< endl
+			<< "Topology: " 				<< d_topology 			<< endl
 			<< "Connectivity: " 			<< d_connectivity 		<< endl
 			<< "Spectral Radius: " 			<< d_spectralRadius		<< endl
 			<< "Activation function: " 		<< d_reservoirActivation<< endl
@@ -534,49 +1001,149 @@ void ESN::printStats()
 			<< "_______________________________________"		<< endl;
 }
 
-/* Saves the ESN to a binary file
+/**
+ * Saves the ESN to a binary file that loadESN() can map into memory as is. The file is a
+ * header of MODEL_HEADER_SIZE bytes with all parameters and a table of sections, followed
+ * by the sections (the weight arrays, the thresholds and the neuron order), each aligned to
+ * MODEL_ALIGNMENT bytes. The weights are stored as T in the byte order of this machine,
+ * which the header records, so a model can only be loaded into an ESN of the same type.
+ *
+ * The reservoir weights, by far the largest part, are stored according to storage:
+ *
+ * STORE_DENSE		the n x n matrix, loaded without a copy
+ * STORE_SPARSE		only the nonzero weights, in compressed sparse row sections
+ * STORE_SEED_ONLY	nothing, loadESN() generates the reservoir again from the seed and the
+ * 					parameters, so only the trained readout (and the other small arrays)
+ * 					are stored. The checksum of the weights is kept to check that the
+ * 					reservoir that is generated is the same. Needs a seed set with
+ * 					setSeed(), otherwise the weights are stored as with STORE_AUTO
+ * STORE_AUTO		sparse if that is smaller than dense
  *
+ * The file is written under a temporary name first and then renamed, so a process that maps
+ * the model never sees a partially written one.
  */
-void ESN::saveESN(string filename)
+template<class T>
+void TemplateESN<T>::saveESN(string filename, ModelStorage storage)
 {
-	ofstream outputFile(filename.c_str(), ios::out | ios::binary);
-	if(!outputFile)
-		printf( "Cannot open output file.\n");
-	else
-	{
-		outputFile.write((char *) &d_inputSize, sizeof(int));
-		outputFile.write((char *) &d_outputSize, sizeof(int));
-		outputFile.write((char *) &d_reservoirSize, sizeof(int));
-
-		outputFile.write((char *) &d_reservoirActivation, sizeof(ActivationFunction));
-		outputFile.write((char *) &d_outputActivation, sizeof(ActivationFunction));
-
-		outputFile.write((char *) &d_connectivity, sizeof(WEIGHT_TYPE));
-		outputFile.write((char *) &d_inConnectivity, sizeof(WEIGHT_TYPE));
-		outputFile.write((char *) &d_fbConnectivity, sizeof(WEIGHT_TYPE));
-
-		outputFile.write((char *) &d_spectralRadius, sizeof(WEIGHT_TYPE));
-
-		outputFile.write((char *) &d_inputScale, sizeof(WEIGHT_TYPE));
-		outputFile.write((char *) &d_feedbackScale, sizeof(WEIGHT_TYPE));
-
-		outputFile.write((char *) &d_inputShift, sizeof(WEIGHT_TYPE));
-		outputFile.write((char *) &d_feedbackShift, sizeof(WEIGHT_TYPE));
+	uint64_t n = d_reservoirSize;
+	if (storage == STORE_SEED_ONLY && d_seed == 0) {
+		cerr << "Without a seed the reservoir cannot be generated again, it is stored" << endl;
+		storage = STORE_AUTO;
+	}
 
-		outputFile.write((char *) &d_timeConstant, sizeof(WEIGHT_TYPE));
+	// Compressed sparse row representation of the reservoir
+	std::vector<int> rows, columns;
+	std::vector<T> values;
+	if (storage == STORE_AUTO || storage == STORE_SPARSE) {
+		rows.reserve(n + 1);
+		rows.push_back(0);
+		for (uint64_t i = 0; i < n; i++) {
+			const T *row = d_reservoirWeights + i*n;
+			for (uint64_t j = 0; j < n; j++) {
+				if (row[j] == 0) continue;
+				columns.push_back(j);
+				values.push_back(row[j]);
+			}
+			rows.push_back(columns.size());
+		}
+		uint64_t sparseSize = rows.size()*sizeof(int) + columns.size()*(sizeof(int) + sizeof(T));
+		if (storage == STORE_AUTO)
+			storage = (sparseSize < n*n*sizeof(T)) ? STORE_SPARSE : STORE_DENSE;
+	}
 
-		outputFile.write((char *) &d_feedbackScale, sizeof(WEIGHT_TYPE));
+	uint64_t sizes[NOF_MODEL_SECTIONS];
+	const void *data[NOF_MODEL_SECTIONS];
+	for (int s = 0; s < NOF_MODEL_SECTIONS; s++) {
+		sizes[s] = 0;
+		data[s] = NULL;
+	}
+	sizes[MODEL_INPUT_WEIGHTS] = d_inputSize*n*sizeof(T);
+	data[MODEL_INPUT_WEIGHTS] = d_inputWeights;
+	sizes[MODEL_FEEDBACK_WEIGHTS] = d_outputSize*n*sizeof(T);
+	data[MODEL_FEEDBACK_WEIGHTS] = d_feedbackWeights;
+	sizes[MODEL_OUTPUT_WEIGHTS] = d_outputSize*(n + d_inputSize)*sizeof(T);
+	data[MODEL_OUTPUT_WEIGHTS] = d_outputWeights;
+	if (storage == STORE_DENSE) {
+		sizes[MODEL_RESERVOIR_WEIGHTS] = n*n*sizeof(T);
+		data[MODEL_RESERVOIR_WEIGHTS] = d_reservoirWeights;
+	}
+	sizes[MODEL_THRESHOLDS] = n*sizeof(T);
+	data[MODEL_THRESHOLDS] = d_thresholds;
+	sizes[MODEL_PERMUTATION] = d_permutation.size()*sizeof(int);
+	data[MODEL_PERMUTATION] = d_permutation.empty() ? NULL : &d_permutation[0];
+	if (storage == STORE_SPARSE) {
+		sizes[MODEL_RESERVOIR_ROWS] = rows.size()*sizeof(int);
+		data[MODEL_RESERVOIR_ROWS] = &rows[0];
+		sizes[MODEL_RESERVOIR_COLUMNS] = columns.size()*sizeof(int);
+		data[MODEL_RESERVOIR_COLUMNS] = columns.empty() ? NULL : &columns[0];
+		sizes[MODEL_RESERVOIR_VALUES] = values.size()*sizeof(T);
+		data[MODEL_RESERVOIR_VALUES] = values.empty() ? NULL : &values[0];
+	}
 
-		// Store the weights
-		saveWeights(&outputFile, d_inputSize*d_reservoirSize, d_inputWeights);
-		saveWeights(&outputFile, d_outputSize*d_reservoirSize, d_feedbackWeights);
-		saveWeights(&outputFile, d_outputSize*d_reservoirSize + d_outputSize*d_inputSize, d_outputWeights);
-		saveWeights(&outputFile, d_reservoirSize*d_reservoirSize, d_reservoirWeights);
-		outputFile.close();
+	ModelHeader header;
+	memset(&header, 0, sizeof(header));
+	strncpy(header.magic, MODEL_MAGIC, sizeof(header.magic));
+	header.version = MODEL_VERSION;
+	header.byteOrder = MODEL_BYTE_ORDER;
+	strncpy(header.type, aNetwork::ScalarTraits<T>::Name(), sizeof(header.type) - 1);
+	header.weightSize = sizeof(T);
+	header.inputSize = d_inputSize;
+	header.outputSize = d_outputSize;
+	header.reservoirSize = d_reservoirSize;
+	header.reservoirActivation = d_reservoirActivation;
+	header.outputActivation = d_outputActivation;
+	header.topology = d_topology;
+	header.seed = d_seed;
+	header.connectivity = d_connectivity;
+	header.inConnectivity = d_inConnectivity;
+	header.fbConnectivity = d_fbConnectivity;
+	header.spectralRadius = d_spectralRadius;
+	header.inputScale = d_inputScale;
+	header.feedbackScale = d_feedbackScale;
+	header.inputShift = d_inputShift;
+	header.feedbackShift = d_feedbackShift;
+	header.timeConstant = d_timeConstant;
+	header.decayRate = d_decayRate;
+	header.excitatory = d_excitatory;
+	header.nofSections = NOF_MODEL_SECTIONS;
+	header.flags = (d_reorder ? MODEL_REORDERED : 0) | (d_ternary ? MODEL_TERNARY : 0);
+	uint64_t offset = MODEL_HEADER_SIZE;
+	for (int s = 0; s < NOF_MODEL_SECTIONS; s++) {
+		header.sections[s].offset = offset;
+		header.sections[s].size = sizes[s];
+		header.sections[s].checksum = Checksum(data[s], sizes[s]);
+		offset += (sizes[s] + MODEL_ALIGNMENT - 1) / MODEL_ALIGNMENT * MODEL_ALIGNMENT;
+	}
+	// What the reservoir has to look like after it has been generated again
+	if (storage == STORE_SEED_ONLY)
+		header.sections[MODEL_RESERVOIR_WEIGHTS].checksum = Checksum(d_reservoirWeights, n*n*sizeof(T));
+	header.checksum = Checksum(&header, sizeof(header));
+
+	std::string tmp = filename + ".tmp";
+	FILE *stream = fopen(tmp.c_str(), "wb");
+	if (stream == NULL) {
+		printf( "Cannot open output file.\n");
+		return;
+	}
+	char padding[MODEL_HEADER_SIZE];
+	memset(padding, 0, sizeof(padding));
+	bool okay = fwrite(&header, sizeof(header), 1, stream) == 1 &&
+			fwrite(padding, MODEL_HEADER_SIZE - sizeof(header), 1, stream) == 1;
+	for (int s = 0; okay && s < NOF_MODEL_SECTIONS; s++) {
+		int pad = (MODEL_ALIGNMENT - sizes[s] % MODEL_ALIGNMENT) % MODEL_ALIGNMENT;
+		if (sizes[s]) okay = fwrite(data[s], sizes[s], 1, stream) == 1;
+		if (okay && pad) okay = fwrite(padding, pad, 1, stream) == 1;
+	}
+	okay = (fclose(stream) == 0) && okay;
+	if (okay) okay = rename(tmp.c_str(), filename.c_str()) == 0;
+	if (!okay) {
+		unlink(tmp.c_str());
+		printf( "Cannot write output file.\n");
 	}
 }
 
-void ESN::setOutputWeights( WEIGHT_TYPE *weights, int len) {
+template<class T>
+void TemplateESN<T>::setOutputWeights( T *weights, int len) {
 	int nof_output_weights = d_outputSize*d_reservoirSize + d_outputSize*d_inputSize;
 	assert (nof_output_weights == len);
 	for (int i = 0; i < nof_output_weights; i++) {
@@ -584,20 +1151,224 @@ void ESN::setOutputWeights( WEIGHT_TYPE *weights, int len) {
 	}
 }
 
-void ESN::saveWeights(ofstream *outputFile, int matrixSize, WEIGHT_TYPE *matrix)
+/**
+ * Loads an ESN from a file written by saveESN(). The file is mapped copy-on-write and the
+ * weights are used in place, so loading does not depend on the size of the model, and
+ * processes that load the same model share its pages (until they change them, e.g. with
+ * setOutputWeights). The header is always checked; with verify the checksums of the
+ * sections are as well, which does read the entire file.
+ *
+ * Only a dense reservoir is used in place. A sparse one is expanded into a new matrix, and
+ * the reservoir of a model saved with STORE_SEED_ONLY is generated again with init(), using
+ * the network parameters of this ESN (e.g. getReservoir().SetParameter(aNetwork::MODULE_SIZE,
+ * ...)) and the reservoir cache; those have to be the same as when the model was trained,
+ * otherwise its checksum differs and the load fails. The other arrays are the stored ones.
+ *
+ * Files from before the versioned format (without a header) are still read, see
+ * loadLegacyESN().
+ */
+template<class T>
+bool TemplateESN<T>::loadESN(std::string filename, bool verify)
 {
-	for (int x = 0; x < matrixSize; ++x)
-	{
-		(*outputFile).write((char *) &(matrix[x]), sizeof(WEIGHT_TYPE));
+	destroy();
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		printf("Failed loading ESN input file\n");
+		return false;
+	}
+	char magic[8];
+	struct stat info;
+	if (read(fd, magic, sizeof(magic)) != (ssize_t)sizeof(magic) ||
+			strncmp(magic, MODEL_MAGIC, sizeof(magic))) {
+		close(fd);
+		return loadLegacyESN(filename);
+	}
+	if (fstat(fd, &info) != 0 || (size_t)info.st_size < MODEL_HEADER_SIZE) {
+		close(fd);
+		printf("Failed loading ESN input file\n");
+		return false;
+	}
+	size_t len = info.st_size;
+	void *map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		printf("Failed loading ESN input file\n");
+		return false;
+	}
+
+	ModelHeader header;
+	memcpy(&header, map, sizeof(header));
+	uint64_t checksum = header.checksum;
+	header.checksum = 0;
+	const char *error = NULL;
+	if (header.version != MODEL_VERSION) error = "unknown version";
+	else if (header.byteOrder != MODEL_BYTE_ORDER) error = "other byte order";
+	else if (Checksum(&header, sizeof(header)) != checksum)
+		error = "header checksum mismatch";
+	else if (header.weightSize != sizeof(T) ||
+			strncmp(header.type, aNetwork::ScalarTraits<T>::Name(), sizeof(header.type)))
+		error = "weights of another type";
+	else if (header.nofSections < NOF_MODEL_SECTIONS_V2 || header.nofSections > MODEL_MAX_SECTIONS)
+		error = "wrong number of sections";
+	// Sections after the ones in the file are empty
+	for (int s = header.nofSections; !error && s < MODEL_MAX_SECTIONS; s++) {
+		header.sections[s].size = 0;
+	}
+	for (int s = 0; !error && s < NOF_MODEL_SECTIONS; s++) {
+		const ModelSection & section = header.sections[s];
+		if (section.offset % MODEL_ALIGNMENT || section.offset + section.size > len)
+			error = "section outside of the file";
+		else if (verify && section.size &&
+				Checksum((char*)map + section.offset, section.size) != section.checksum)
+			error = "section checksum mismatch";
+	}
+	char *base = (char*)map;
+	uint64_t n = header.reservoirSize;
+	uint64_t nnz = 0;
+	if (!error && header.sections[MODEL_RESERVOIR_ROWS].size == (n + 1)*sizeof(int))
+		nnz = ((const int*)(base + header.sections[MODEL_RESERVOIR_ROWS].offset))[n];
+	uint64_t expected[NOF_MODEL_SECTIONS] = {
+		(uint64_t)header.inputSize*n*sizeof(T),
+		(uint64_t)header.outputSize*n*sizeof(T),
+		(uint64_t)header.outputSize*(n + header.inputSize)*sizeof(T),
+		n*n*sizeof(T),
+		n*sizeof(T),
+		n*sizeof(int),
+		(n + 1)*sizeof(int),
+		nnz*sizeof(int),
+		nnz*sizeof(T) };
+	bool dense = header.sections[MODEL_RESERVOIR_WEIGHTS].size != 0;
+	bool sparse = header.sections[MODEL_RESERVOIR_ROWS].size != 0;
+	for (int s = 0; !error && s < NOF_MODEL_SECTIONS; s++) {
+		uint64_t size = header.sections[s].size;
+		bool optional = (s == MODEL_PERMUTATION) || (s == MODEL_RESERVOIR_WEIGHTS) ||
+				(s >= MODEL_RESERVOIR_ROWS && !sparse);
+		if (size != expected[s] && !(optional && size == 0))
+			error = "section of the wrong size";
+	}
+	if (!error && dense && sparse) error = "both dense and sparse reservoir";
+	if (!error && !dense && !sparse && header.seed == 0) error = "no reservoir and no seed";
+	if (error) {
+		munmap(map, len);
+		printf("Failed loading ESN input file: %s\n", error);
+		return false;
 	}
+
+	d_inputSize = header.inputSize;
+	d_outputSize = header.outputSize;
+	d_reservoirSize = header.reservoirSize;
+	d_topology = (aNetwork::Mode)header.topology;
+	d_seed = header.seed;
+	d_reorder = (header.flags & MODEL_REORDERED) != 0;
+	d_ternary = (header.flags & MODEL_TERNARY) != 0;
+	d_connectivity = header.connectivity;
+	d_inConnectivity = header.inConnectivity;
+	d_fbConnectivity = header.fbConnectivity;
+	d_spectralRadius = header.spectralRadius;
+	d_inputScale = header.inputScale;
+	d_feedbackScale = header.feedbackScale;
+	d_inputShift = header.inputShift;
+	d_feedbackShift = header.feedbackShift;
+	d_timeConstant = header.timeConstant;
+	d_decayRate = header.decayRate;
+	d_excitatory = header.excitatory;
+	setReservoirActivation((ActivationFunction)header.reservoirActivation);
+	setOutputActivation((ActivationFunction)header.outputActivation);
+
+	if (!dense && !sparse) {
+		// Seed only: generate the reservoir again, the other arrays are the stored ones
+		init();
+		if (Checksum(d_reservoirWeights, n*n*sizeof(T)) !=
+				header.sections[MODEL_RESERVOIR_WEIGHTS].checksum) {
+			munmap(map, len);
+			destroy();
+			printf("Failed loading ESN input file: generated reservoir differs from the saved "
+					"one, are the network parameters the same?\n");
+			return false;
+		}
+		T *arrays[] = {d_inputWeights, d_feedbackWeights, d_outputWeights, NULL, d_thresholds};
+		for (int s = MODEL_INPUT_WEIGHTS; s <= MODEL_THRESHOLDS; s++) {
+			if (arrays[s - MODEL_INPUT_WEIGHTS] != NULL)
+				memcpy(arrays[s - MODEL_INPUT_WEIGHTS], base + header.sections[s].offset,
+						header.sections[s].size);
+		}
+		if (header.sections[MODEL_PERMUTATION].size)
+			memcpy(&d_permutation[0], base + header.sections[MODEL_PERMUTATION].offset,
+					header.sections[MODEL_PERMUTATION].size);
+		munmap(map, len);
+		return true;
+	}
+
+	d_mapping = map;
+	d_mappingSize = len;
+	d_inputWeights = (T*)(base + header.sections[MODEL_INPUT_WEIGHTS].offset);
+	d_feedbackWeights = (T*)(base + header.sections[MODEL_FEEDBACK_WEIGHTS].offset);
+	d_outputWeights = (T*)(base + header.sections[MODEL_OUTPUT_WEIGHTS].offset);
+	d_thresholds = (T*)(base + header.sections[MODEL_THRESHOLDS].offset);
+	d_permutation.resize(d_reservoirSize);
+	for (int i = 0; i < d_reservoirSize; i++) d_permutation[i] = i;
+	if (header.sections[MODEL_PERMUTATION].size)
+		memcpy(&d_permutation[0], base + header.sections[MODEL_PERMUTATION].offset,
+				header.sections[MODEL_PERMUTATION].size);
+
+	if (dense) {
+		d_reservoirWeights = (T*)(base + header.sections[MODEL_RESERVOIR_WEIGHTS].offset);
+	} else {
+		// The network works on the full matrix, so the sparse sections are expanded
+		const int *rows = (const int*)(base + header.sections[MODEL_RESERVOIR_ROWS].offset);
+		const int *columns = (const int*)(base + header.sections[MODEL_RESERVOIR_COLUMNS].offset);
+		const T *values = (const T*)(base + header.sections[MODEL_RESERVOIR_VALUES].offset);
+		d_reservoirWeights = new T[n*n];
+		for (uint64_t x = 0; x < n*n; ++x)
+			d_reservoirWeights[x] = T(0);
+		for (uint64_t i = 0; i < n; i++) {
+			if (rows[i] > rows[i+1] || rows[i] < 0 || (uint64_t)rows[i+1] > nnz) {
+				error = "sparse rows out of order";
+				break;
+			}
+			for (int k = rows[i]; k < rows[i+1]; k++) {
+				if (columns[k] < 0 || (uint64_t)columns[k] >= n) {
+					error = "sparse column out of range";
+					break;
+				}
+				d_reservoirWeights[i*n + columns[k]] = values[k];
+			}
+		}
+		if (error) {
+			destroy();
+			printf("Failed loading ESN input file: %s\n", error);
+			return false;
+		}
+	}
+
+	// The minimum complexity topologies are recognized from the weights, the parameters of
+	// the other kernels are not stored, so they fall back to the dense or sparse one
+	reservoir.Init(d_reservoirWeights, d_reservoirSize, d_reservoirSize);
+	switch (d_topology) {
+	case aNetwork::CREATE_SIMPLE_CYCLE:
+	case aNetwork::CREATE_DELAY_LINE:
+	case aNetwork::CREATE_DELAY_LINE_FEEDBACK:
+		reservoir.SetStructure(d_topology);
+		break;
+	default:
+		reservoir.SetStructure(aNetwork::CREATE_RANDOM);
+		break;
+	}
+	reservoir.Pack();
+
+	d_output = new T[d_outputSize];
+	for (int x = 0; x < d_outputSize; ++x)
+		d_output[x] = T(0);
+	d_recurrent = new Compute[d_reservoirSize];
+	return true;
 }
 
-/* Loads an ESN from a binary file
+/* Loads an ESN from a binary file in the format before MODEL_VERSION 2
  *
  */
-void ESN::loadESN(std::string filename)
+template<class T>
+bool TemplateESN<T>::loadLegacyESN(std::string filename)
 {
-	destroy();
 	ifstream inputFile(filename.c_str(),std::ios::in | std::ios::binary);
 
 	// Load from file
@@ -611,49 +1382,98 @@ void ESN::loadESN(std::string filename)
 		inputFile.read((char *) &d_reservoirActivation, sizeof(ActivationFunction));
 		inputFile.read((char *) &d_outputActivation, sizeof(ActivationFunction));
 
-		inputFile.read((char *) &d_connectivity, sizeof(WEIGHT_TYPE));
-		inputFile.read((char *) &d_inConnectivity, sizeof(WEIGHT_TYPE));
-		inputFile.read((char *) &d_fbConnectivity, sizeof(WEIGHT_TYPE));
+		inputFile.read((char *) &d_connectivity, sizeof(Compute));
+		inputFile.read((char *) &d_inConnectivity, sizeof(Compute));
+		inputFile.read((char *) &d_fbConnectivity, sizeof(Compute));
+
+		inputFile.read((char *) &d_spectralRadius, sizeof(Compute));
 
-		inputFile.read((char *) &d_spectralRadius, sizeof(WEIGHT_TYPE));
+		inputFile.read((char *) &d_inputScale, sizeof(Compute));
+		inputFile.read((char *) &d_feedbackScale, sizeof(Compute));
 
-		inputFile.read((char *) &d_inputScale, sizeof(WEIGHT_TYPE));
-		inputFile.read((char *) &d_feedbackScale, sizeof(WEIGHT_TYPE));
+		inputFile.read((char *) &d_inputShift, sizeof(Compute));
+		inputFile.read((char *) &d_feedbackShift, sizeof(Compute));
 
-		inputFile.read((char *) &d_inputShift, sizeof(WEIGHT_TYPE));
-		inputFile.read((char *) &d_feedbackShift, sizeof(WEIGHT_TYPE));
+		inputFile.read((char *) &d_timeConstant, sizeof(Compute));
 
-		inputFile.read((char *) &d_timeConstant, sizeof(WEIGHT_TYPE));
+		// The feedback scale was written twice
+		inputFile.read((char *) &d_feedbackScale, sizeof(Compute));
 
-		inputFile.read((char *) &d_feedbackScale, sizeof(WEIGHT_TYPE));
+		setReservoirActivation(d_reservoirActivation);
+		setOutputActivation(d_outputActivation);
 
 		// Load the weights
-		d_inputWeights = new WEIGHT_TYPE[d_inputSize*d_reservoirSize];
+		d_inputWeights = new T[d_inputSize*d_reservoirSize];
 		loadWeights(&inputFile, d_inputSize*d_reservoirSize, d_inputWeights);
-		d_feedbackWeights = new WEIGHT_TYPE[d_outputSize*d_reservoirSize];
+		d_feedbackWeights = new T[d_outputSize*d_reservoirSize];
 		loadWeights(&inputFile, d_outputSize*d_reservoirSize, d_feedbackWeights);
-		d_outputWeights = new WEIGHT_TYPE[d_outputSize*d_reservoirSize + d_outputSize*d_inputSize];
+		d_outputWeights = new T[d_outputSize*d_reservoirSize + d_outputSize*d_inputSize];
 		loadWeights(&inputFile, d_outputSize*d_reservoirSize + d_outputSize*d_inputSize, d_outputWeights);
-		d_reservoirWeights = new WEIGHT_TYPE[d_reservoirSize*d_reservoirSize];
+		d_reservoirWeights = new T[d_reservoirSize*d_reservoirSize];
 		loadWeights(&inputFile, d_reservoirSize*d_reservoirSize, d_reservoirWeights);
 
+		int permutationSize = 0;
+		inputFile.read((char *) &permutationSize, sizeof(int));
+		if (!inputFile || permutationSize != d_reservoirSize) permutationSize = 0;
+		d_permutation.resize(d_reservoirSize);
+		for (int i = 0; i < d_reservoirSize; i++) d_permutation[i] = i;
+		if (permutationSize)
+			inputFile.read((char *) &d_permutation[0], permutationSize*sizeof(int));
+
+		// The thresholds are not stored, so use the default
+		d_thresholds = new T[d_reservoirSize];
+		for (int i = 0; i < d_reservoirSize; i++) d_thresholds[i] = THRESHOLD_VALUE;
+
+		// The topology is not stored, so use the dense kernel
+		reservoir.Init(d_reservoirWeights, d_reservoirSize, d_reservoirSize);
+		reservoir.SetStructure(aNetwork::CREATE_RANDOM);
+		reservoir.Pack();
+		d_output = new T[d_outputSize];
+		for (int x = 0; x < d_outputSize; ++x)
+			d_output[x] = T(0);
+		d_recurrent = new Compute[d_reservoirSize];
+
 	}
 	else
+	{
 		printf("Failed loading ESN input file\n");
+		return false;
+	}
 
 	inputFile.close();
+	return true;
 }
 
-void ESN::loadWeights(std::ifstream *inputFile, int matrixSize, WEIGHT_TYPE *matrix)
+template<class T>
+void TemplateESN<T>::loadWeights(std::ifstream *inputFile, int matrixSize, T *matrix)
 {
-	for (int x = 0; x < matrixSize; ++x)
-	{
-		(*inputFile).read((char *) &(matrix[x]), sizeof(WEIGHT_TYPE));
-	}
+	(*inputFile).read((char *) matrix, matrixSize*sizeof(T));
 }
 
-void ESN::destroy()
+template<class T>
+bool TemplateESN<T>::isMapped(const void *array) const
+{
+	return d_mapping != NULL && array >= d_mapping &&
+			(const char*)array < (const char*)d_mapping + d_mappingSize;
+}
+
+/**
+ * The weights of a mapped model are part of the mapping, they are released by unmapping it.
+ */
+template<class T>
+void TemplateESN<T>::destroy()
 {
+	if(d_mapping != NULL)
+	{
+		if (isMapped(d_inputWeights)) d_inputWeights = NULL;
+		if (isMapped(d_outputWeights)) d_outputWeights = NULL;
+		if (isMapped(d_feedbackWeights)) d_feedbackWeights = NULL;
+		if (isMapped(d_reservoirWeights)) d_reservoirWeights = NULL;
+		if (isMapped(d_thresholds)) d_thresholds = NULL;
+		munmap(d_mapping, d_mappingSize);
+		d_mapping = NULL;
+	}
+
 	if(d_inputWeights != NULL)
 	{
 		delete [] d_inputWeights;
@@ -683,9 +1503,27 @@ void ESN::destroy()
 		delete [] d_reservoirWeights;
 		d_reservoirWeights = NULL;
 	}
+
+	if(d_thresholds != NULL)
+	{
+		delete [] d_thresholds;
+		d_thresholds = NULL;
+	}
+
+	if(d_recurrent != NULL)
+	{
+		delete [] d_recurrent;
+		d_recurrent = NULL;
+	}
 }
 
-ESN::~ESN()
+template<class T>
+TemplateESN<T>::~TemplateESN()
 {
 	destroy();
 }
+
+template class TemplateESN<float>;
+template class TemplateESN<double>;
+template class TemplateESN<aNetwork::half>;
+template class TemplateESN<aNetwork::bfloat16>;
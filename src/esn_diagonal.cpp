@@ -0,0 +1,252 @@
+/**
+ * @file esn_diagonal.cpp
+ * @brief Inference with a linear echo state network in the basis of the eigenvectors of its reservoir
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object against this software used by the military, in the
+ * bio-industry, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2010 Anne van Rossum <anne@almende.com>
+ *
+ * @author 	Anne C. van Rossum
+ * @date	Oct 18, 2026
+ * @project	Replicator FP7
+ * @company	Almende B.V.
+ * @case
+ */
+
+
+// General files
+#include <stdlib.h>
+#include <math.h>
+#include <assert.h>
+#include <algorithm>
+
+#include <esn_diagonal.h>
+#include <ap.h>
+#include <eigenvalues/nsevd.h>
+
+using namespace std;
+
+//! The output activation, the reservoir activation is the identity
+template<class Compute>
+static Compute Activate(ActivationFunction function, Compute value) {
+	switch (function) {
+	case TANH_ACTIVATION:
+		return tanh(value);
+	case LOGISTIC_ACTIVATION:
+		return 1 / (1 + exp(-value));
+	case HEAVISIDE_ACTIVATION:
+		return value < 0 ? 0 : 1;
+	default:
+		return value;
+	}
+}
+
+/* **************************************************************************************
+ * Implementation of DiagonalESN
+ * **************************************************************************************/
+
+template<class T>
+TemplateDiagonalESN<T>::TemplateDiagonalESN(TemplateESN<T> & esn, Compute maxCondition):
+	d_esn(esn),
+	d_inputSize(esn.getInputSize()),
+	d_outputSize(esn.getOutputSize()),
+	d_reservoirSize(esn.getReservoirSize()),
+	d_nofModes(0),
+	d_diagonal(false),
+	d_keepStates(false),
+	d_condition(0)
+{
+	if (esn.getReservoirActivation() != IDENTITY_ACTIVATION) return;
+	assert (esn.getReservoirWeights() != NULL);
+	d_diagonal = diagonalize(maxCondition);
+}
+
+template<class T>
+TemplateDiagonalESN<T>::~TemplateDiagonalESN() {
+}
+
+/**
+ * The left eigenvectors u_k give the rows of V^-1 without an inversion: u_k' v_j = 0 for
+ * j != k, so z_k = u_k' x / u_k' v_k. That only holds for distinct eigenvalues; the closer
+ * W is to defective, the smaller u_k' v_k, and the larger the condition number of λ_k.
+ */
+template<class T>
+bool TemplateDiagonalESN<T>::diagonalize(Compute maxCondition) {
+	int n = d_reservoirSize;
+	const T *weights = d_esn.getReservoirWeights();
+
+	ap::template_2d_array<Compute,true> a, vl, vr;
+	ap::template_1d_array<Compute,true> wr, wi;
+	a.setlength(n, n);
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < n; j++) a(i,j) = weights[i*n + j];
+	if (!rmatrixevd(a, n, 3, wr, wi, vl, vr)) return false;
+
+	Compute leftOver = 1 - d_esn.getTimeConstant() * d_esn.getDecayRate();
+	std::vector<Complex> u(n), v(n);
+	d_factors.clear();
+	d_input.clear();
+	d_feedback.clear();
+	d_thresholds.clear();
+	d_eigenvectors.clear();
+	d_condition = 0;
+	for (int k = 0; k < n; k++) {
+		// of a pair only the one with the positive imaginary part, in columns k and k+1
+		bool pair = (wi(k) != 0);
+		for (int i = 0; i < n; i++) {
+			u[i] = pair ? Complex(vl(i,k), vl(i,k+1)) : Complex(vl(i,k), 0);
+			v[i] = pair ? Complex(vr(i,k), vr(i,k+1)) : Complex(vr(i,k), 0);
+		}
+		Complex uv = 0;
+		Compute uu = 0, vv = 0;
+		for (int i = 0; i < n; i++) {
+			uv += conj(u[i]) * v[i];
+			uu += norm(u[i]);
+			vv += norm(v[i]);
+		}
+		d_condition = (abs(uv) == 0) ? (Compute)INFINITY : max(d_condition, (Compute)(sqrt(uu * vv) / abs(uv)));
+		if (!(d_condition <= maxCondition)) return false;
+
+		// the row of V^-1
+		for (int i = 0; i < n; i++) u[i] = conj(u[i]) / uv;
+
+		Complex lambda(wr(k), wi(k));
+		d_factors.push_back(leftOver + d_esn.getTimeConstant() * lambda);
+		for (int c = 0; c < d_inputSize; c++) {
+			Complex sum = 0;
+			for (int i = 0; i < n; i++) sum += u[i] * (Compute)d_esn.getInputWeights()[i*d_inputSize + c];
+			d_input.push_back(sum);
+		}
+		for (int c = 0; c < d_outputSize; c++) {
+			Complex sum = 0;
+			for (int i = 0; i < n; i++) sum += u[i] * (Compute)d_esn.getFeedbackWeights()[i*d_outputSize + c];
+			d_feedback.push_back(sum);
+		}
+		Complex sum = 0;
+		for (int i = 0; i < n; i++) sum += u[i] * (Compute)d_esn.getThresholds()[i];
+		d_thresholds.push_back(sum);
+
+		// x = sum of v_k z_k over all modes, which is 2 Re(v_k z_k) for a pair
+		Compute multiplicity = pair ? 2 : 1;
+		for (int i = 0; i < n; i++) d_eigenvectors.push_back(multiplicity * v[i]);
+		if (pair) k++;
+	}
+	d_nofModes = d_factors.size();
+
+	// W_out V, output after output
+	int stride = n + d_inputSize;
+	const T *outputWeights = d_esn.getOutputWeights();
+	d_readout.assign(d_outputSize * d_nofModes, Complex(0));
+	d_inputReadout.resize(d_outputSize * d_inputSize);
+	for (int o = 0; o < d_outputSize; o++) {
+		for (int k = 0; k < d_nofModes; k++) {
+			Complex sum = 0;
+			for (int i = 0; i < n; i++) sum += (Compute)outputWeights[o*stride + i] * d_eigenvectors[k*n + i];
+			d_readout[o*d_nofModes + k] = sum;
+		}
+		for (int c = 0; c < d_inputSize; c++)
+			d_inputReadout[o*d_inputSize + c] = outputWeights[o*stride + n + c];
+	}
+	d_modes.resize(d_nofModes);
+	return true;
+}
+
+/**
+ * See ESN::Run, the same update for the identity as activation, per mode:
+ * z(t) = μ z(t-1) + V^-1 (W_in u(t) + W_back y(t-1) - θ)
+ * y(t) = g(Re(W_out V z(t)) + W_out,u u(t))
+ * The products are written out in real and imaginary parts, std::complex checks for
+ * infinities and NaN on every multiplication.
+ */
+template<class T>
+void TemplateDiagonalESN<T>::Run(TemplateTrial<T> *trial, SimulationType simType)
+{
+	if (!d_diagonal) {
+		d_esn.Run(trial, simType);
+		return;
+	}
+	assert (trial != NULL);
+
+	T const * const inputs	= trial->inputVal;
+	int timespan			= trial->sampleSize;
+	T * outputs				= trial->outputVal;
+	T * states				= trial->neuronVal;
+	int n					= d_reservoirSize;
+	int m					= d_nofModes;
+
+	assert (inputs != NULL);
+	assert (outputs != NULL);
+	assert (trial->inputSize == d_inputSize);
+	assert (trial->stateSize == n);
+	assert (!d_keepStates || states != NULL);
+
+	Compute *z = reinterpret_cast<Compute*>(&d_modes[0]);
+	const Compute *factors = reinterpret_cast<const Compute*>(&d_factors[0]);
+	const Compute *input = reinterpret_cast<const Compute*>(&d_input[0]);
+	const Compute *feedback = reinterpret_cast<const Compute*>(&d_feedback[0]);
+	const Compute *thresholds = reinterpret_cast<const Compute*>(&d_thresholds[0]);
+	const Compute *readout = reinterpret_cast<const Compute*>(&d_readout[0]);
+	const Compute *eigenvectors = reinterpret_cast<const Compute*>(&d_eigenvectors[0]);
+	bool hasFeedback = (d_esn.getFbConnectivity() > 0);
+
+	std::vector<Compute> u(d_inputSize), y(d_outputSize, 0), x(d_keepStates ? n : 0);
+	for (int k = 0; k < 2*m; k++) z[k] = 0;
+
+	for (int t = 0; t < timespan; ++t) {
+		for (int c = 0; c < d_inputSize; c++) u[c] = inputs[t*d_inputSize + c];
+		for (int o = 0; o < d_outputSize; o++)
+			y[o] = (hasFeedback && t > 0) ? (Compute)outputs[(t-1)*d_outputSize + o] : 0;
+
+		for (int k = 0; k < m; k++) {
+			Compute re = factors[2*k] * z[2*k] - factors[2*k+1] * z[2*k+1] - thresholds[2*k];
+			Compute im = factors[2*k] * z[2*k+1] + factors[2*k+1] * z[2*k] - thresholds[2*k+1];
+			const Compute *b = input + 2*k*d_inputSize;
+			for (int c = 0; c < d_inputSize; c++) {
+				re += b[2*c] * u[c];
+				im += b[2*c+1] * u[c];
+			}
+			const Compute *f = feedback + 2*k*d_outputSize;
+			for (int o = 0; o < d_outputSize; o++) {
+				re += f[2*o] * y[o];
+				im += f[2*o+1] * y[o];
+			}
+			z[2*k] = re;
+			z[2*k+1] = im;
+		}
+
+		if (d_keepStates) {
+			std::fill(x.begin(), x.end(), Compute(0));
+			for (int k = 0; k < m; k++) {
+				const Compute *v = eigenvectors + 2*k*n;
+				for (int i = 0; i < n; i++) x[i] += v[2*i] * z[2*k] - v[2*i+1] * z[2*k+1];
+			}
+			for (int i = 0; i < n; i++) states[t*n + i] = x[i];
+		}
+
+		bool setOutput = hasFeedback;
+		if (simType == TEACHER_FORCING) setOutput = false;
+		if ((simType == TEACHER_TESTING) && (t < trial->teacherTestSize)) setOutput = false;
+		if (setOutput) {
+			for (int o = 0; o < d_outputSize; o++) {
+				const Compute *r = readout + 2*o*m;
+				Compute sum = 0;
+				for (int k = 0; k < m; k++) sum += r[2*k] * z[2*k] - r[2*k+1] * z[2*k+1];
+				for (int c = 0; c < d_inputSize; c++) sum += d_inputReadout[o*d_inputSize + c] * u[c];
+				outputs[(t*d_outputSize) + o] = Activate(d_esn.getOutputActivation(), sum);
+			}
+		}
+	}
+}
+
+template class TemplateDiagonalESN<float>;
+template class TemplateDiagonalESN<double>;
+template class TemplateDiagonalESN<aNetwork::half>;
+template class TemplateDiagonalESN<aNetwork::bfloat16>;
@@ -0,0 +1,424 @@
+/**
+ * @file esn_quantized.cpp
+ * @brief Inference with an echo state network of which the weights are quantized to int8
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object against this software used by the military, in the
+ * bio-industry, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2010 Anne van Rossum <anne@almende.com>
+ *
+ * @author 	Anne C. van Rossum
+ * @date	Oct 18, 2026
+ * @project	Replicator FP7
+ * @company	Almende B.V.
+ * @case
+ */
+
+
+// General files
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <algorithm>
+
+#include <esn_quantized.h>
+
+using namespace std;
+
+//! The rows of the quantized matrices and vectors are padded to a multiple of this
+#define QUANTIZED_ALIGNMENT		64
+
+//! Number of multiply-adds above which the rows of a product are divided over threads
+#define QUANTIZED_PARALLEL		(1 << 18)
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define QUANTIZED_X86
+#include <immintrin.h>
+#endif
+
+/* **************************************************************************************
+ * Dot product kernels
+ * **************************************************************************************/
+
+/**
+ * An int8 dot product, in two parts: prepare() brings the vector x, of length n (a multiple
+ * of QUANTIZED_ALIGNMENT), in the form dot() takes, in scratch (2n bytes), once for all
+ * rows; dot() then returns the dot product of a row w with x, given the sum of w.
+ */
+struct Int8Kernel {
+	const char *name;
+	void (*prepare)(const int8_t *x, long n, int8_t *scratch);
+	int32_t (*dot)(const int8_t *w, const int8_t *scratch, long n, int32_t sum);
+};
+
+static void PrepareGeneric(const int8_t *x, long n, int8_t *scratch) {
+	memcpy(scratch, x, n);
+}
+
+//! Only integer arithmetic, for targets without SIMD (or an FPU); x is signed, so the sum of
+//! the row is not needed
+static int32_t DotGeneric(const int8_t *w, const int8_t *x, long n, int32_t) {
+	int32_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	for (long i = 0; i < n; i += 4) {
+		s0 += (int32_t)w[i] * x[i];
+		s1 += (int32_t)w[i+1] * x[i+1];
+		s2 += (int32_t)w[i+2] * x[i+2];
+		s3 += (int32_t)w[i+3] * x[i+3];
+	}
+	return (s0 + s1) + (s2 + s3);
+}
+
+static const Int8Kernel genericKernel = { "generic", PrepareGeneric, DotGeneric };
+
+#ifdef QUANTIZED_X86
+
+#define AVX2 __attribute__((target("avx2")))
+
+//! AVX2 has no signed int8 product, so x is widened to int16 once and every row on the fly
+AVX2 static void PrepareAVX2(const int8_t *x, long n, int8_t *scratch) {
+	int16_t *x16 = (int16_t*)scratch;
+	for (long i = 0; i < n; i += 16) {
+		_mm256_storeu_si256((__m256i*)(x16 + i),
+				_mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(x + i))));
+	}
+}
+
+AVX2 static int32_t DotAVX2(const int8_t *w, const int8_t *scratch, long n, int32_t) {
+	const int16_t *x16 = (const int16_t*)scratch;
+	__m256i s0 = _mm256_setzero_si256(), s1 = _mm256_setzero_si256();
+	for (long i = 0; i < n; i += 32) {
+		__m256i w0 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(w + i)));
+		__m256i w1 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(w + i + 16)));
+		s0 = _mm256_add_epi32(s0, _mm256_madd_epi16(w0, _mm256_loadu_si256((const __m256i*)(x16 + i))));
+		s1 = _mm256_add_epi32(s1, _mm256_madd_epi16(w1, _mm256_loadu_si256((const __m256i*)(x16 + i + 16))));
+	}
+	__m256i s = _mm256_add_epi32(s0, s1);
+	__m128i h = _mm_add_epi32(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+	h = _mm_add_epi32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(1, 0, 3, 2)));
+	h = _mm_add_epi32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(h);
+}
+
+static const Int8Kernel avx2Kernel = { "avx2", PrepareAVX2, DotAVX2 };
+
+/**
+ * VNNI multiplies unsigned with signed bytes, so x is offset to x + 128 and the offset times
+ * the sum of the row is subtracted again.
+ */
+AVX2 static void PrepareVNNI(const int8_t *x, long n, int8_t *scratch) {
+	const __m256i offset = _mm256_set1_epi8((char)0x80);
+	for (long i = 0; i < n; i += 32) {
+		_mm256_storeu_si256((__m256i*)(scratch + i),
+				_mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(x + i)), offset));
+	}
+}
+
+#define AVXVNNI __attribute__((target("avx2,avxvnni")))
+
+AVXVNNI static int32_t DotAVXVNNI(const int8_t *w, const int8_t *xu, long n, int32_t sum) {
+	__m256i s0 = _mm256_setzero_si256(), s1 = _mm256_setzero_si256();
+	for (long i = 0; i < n; i += 64) {
+		s0 = _mm256_dpbusd_avx_epi32(s0, _mm256_loadu_si256((const __m256i*)(xu + i)),
+				_mm256_loadu_si256((const __m256i*)(w + i)));
+		s1 = _mm256_dpbusd_avx_epi32(s1, _mm256_loadu_si256((const __m256i*)(xu + i + 32)),
+				_mm256_loadu_si256((const __m256i*)(w + i + 32)));
+	}
+	__m256i s = _mm256_add_epi32(s0, s1);
+	__m128i h = _mm_add_epi32(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+	h = _mm_add_epi32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(1, 0, 3, 2)));
+	h = _mm_add_epi32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(h) - 128*sum;
+}
+
+static const Int8Kernel avxvnniKernel = { "avxvnni", PrepareVNNI, DotAVXVNNI };
+
+#define AVX512VNNI __attribute__((target("avx512f,avx512vnni")))
+
+AVX512VNNI static int32_t DotAVX512VNNI(const int8_t *w, const int8_t *xu, long n, int32_t sum) {
+	__m512i s0 = _mm512_setzero_si512(), s1 = _mm512_setzero_si512();
+	long i = 0;
+	for (; i + 128 <= n; i += 128) {
+		s0 = _mm512_dpbusd_epi32(s0, _mm512_loadu_si512(xu + i), _mm512_loadu_si512(w + i));
+		s1 = _mm512_dpbusd_epi32(s1, _mm512_loadu_si512(xu + i + 64), _mm512_loadu_si512(w + i + 64));
+	}
+	if (i < n)
+		s0 = _mm512_dpbusd_epi32(s0, _mm512_loadu_si512(xu + i), _mm512_loadu_si512(w + i));
+	return _mm512_reduce_add_epi32(_mm512_add_epi32(s0, s1)) - 128*sum;
+}
+
+static const Int8Kernel avx512vnniKernel = { "avx512vnni", PrepareVNNI, DotAVX512VNNI };
+
+#endif
+
+static const Int8Kernel & DetectKernel() {
+#ifdef QUANTIZED_X86
+	// Widest set the CPU supports, the environment may only narrow it down
+	int level = 0;
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		level = 1;
+	if (level == 1 && __builtin_cpu_supports("avxvnni"))
+		level = 2;
+	if (level >= 1 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vnni"))
+		level = 3;
+
+	const char *env = getenv("ESN_INT8_SIMD");
+	if (env != NULL) {
+		int requested = level;
+		if (!strcmp(env, "generic")) requested = 0;
+		if (!strcmp(env, "avx2")) requested = 1;
+		if (!strcmp(env, "avxvnni")) requested = 2;
+		if (!strcmp(env, "avx512vnni")) requested = 3;
+		// AVX-512 VNNI does not imply AVX-VNNI
+		if (requested == 2 && !__builtin_cpu_supports("avxvnni")) requested = 1;
+		if (requested < level) level = requested;
+	}
+	switch (level) {
+	case 3:
+		return avx512vnniKernel;
+	case 2:
+		return avxvnniKernel;
+	case 1:
+		return avx2Kernel;
+	}
+#endif
+	return genericKernel;
+}
+
+static const Int8Kernel & SelectKernel() {
+	static const Int8Kernel & selected = DetectKernel();
+	return selected;
+}
+
+//! Round up to a multiple of QUANTIZED_ALIGNMENT
+static inline int Padded(int len) {
+	return (len + QUANTIZED_ALIGNMENT - 1) / QUANTIZED_ALIGNMENT * QUANTIZED_ALIGNMENT;
+}
+
+/* **************************************************************************************
+ * Implementation of QuantizedESN
+ * **************************************************************************************/
+
+template<class T>
+TemplateQuantizedESN<T>::TemplateQuantizedESN(const TemplateESN<T> & esn):
+	d_inputSize(esn.getInputSize()),
+	d_outputSize(esn.getOutputSize()),
+	d_reservoirSize(esn.getReservoirSize()),
+	d_reservoirActivation(esn.getReservoirActivation()),
+	d_outputActivation(esn.getOutputActivation()),
+	d_fbConnectivity(esn.getFbConnectivity()),
+	d_timeConstant(esn.getTimeConstant()),
+	d_decayRate(esn.getDecayRate())
+{
+	int n = d_reservoirSize;
+	assert (esn.getReservoirWeights() != NULL);
+	quantize(esn.getReservoirWeights(), n, n, 0, n, reservoir);
+	quantize(esn.getInputWeights(), n, d_inputSize, 0, d_inputSize, input);
+	quantize(esn.getFeedbackWeights(), n, d_outputSize, 0, d_outputSize, feedback);
+	quantize(esn.getOutputWeights(), d_outputSize, n + d_inputSize, 0, n, readout);
+	quantize(esn.getOutputWeights(), d_outputSize, n + d_inputSize, n, d_inputSize, inputReadout);
+
+	d_thresholds.resize(n);
+	for (int i = 0; i < n; i++)
+		d_thresholds[i] = esn.getThresholds()[i];
+
+	d_previous.resize(n);
+	d_current.resize(n);
+	d_output.resize(d_outputSize);
+	d_qStates.assign(Padded(n), 0);
+	d_qInput.assign(Padded(d_inputSize), 0);
+	d_qOutput.assign(Padded(d_outputSize), 0);
+	d_scratch.resize(2*Padded(max(n, max(d_inputSize, d_outputSize))));
+}
+
+template<class T>
+TemplateQuantizedESN<T>::~TemplateQuantizedESN() {
+}
+
+template<class T>
+const char *TemplateQuantizedESN<T>::KernelName() {
+	return SelectKernel().name;
+}
+
+template<class T>
+size_t TemplateQuantizedESN<T>::WeightBytes() const {
+	const Matrix *matrices[] = { &reservoir, &input, &feedback, &readout, &inputReadout };
+	size_t bytes = 0;
+	for (int i = 0; i < 5; i++) {
+		bytes += matrices[i]->values.size() + matrices[i]->scales.size()*sizeof(Compute);
+	}
+	return bytes;
+}
+
+/**
+ * Symmetric quantization of every row: the largest absolute weight becomes ±127.
+ */
+template<class T>
+void TemplateQuantizedESN<T>::quantize(const T *weights, int rows, int ld, int first, int columns,
+		Matrix & m) {
+	m.rows = rows;
+	m.columns = columns;
+	m.stride = (columns < QUANTIZED_ALIGNMENT) ? columns : Padded(columns);
+	m.values.assign((size_t)rows*m.stride, 0);
+	m.scales.assign(rows, 0);
+	m.sums.assign(rows, 0);
+	if (weights == NULL) return;
+	for (int i = 0; i < rows; i++) {
+		const T *row = weights + (size_t)i*ld + first;
+		Compute largest = 0;
+		for (int j = 0; j < columns; j++) {
+			largest = max(largest, (Compute)fabs((Compute)row[j]));
+		}
+		if (largest == 0) continue;
+		Compute scale = largest / 127;
+		int8_t *values = &m.values[(size_t)i*m.stride];
+		int32_t sum = 0;
+		for (int j = 0; j < columns; j++) {
+			values[j] = (int8_t)lrint((Compute)row[j] / scale);
+			sum += values[j];
+		}
+		m.scales[i] = scale;
+		m.sums[i] = sum;
+	}
+}
+
+/**
+ * The largest absolute value becomes ±127. A fixed scale of 1/127 for the states of tanh
+ * neurons, which saves this pass, makes the prediction of Mackey-Glass a lot worse, most
+ * states are much smaller than one.
+ */
+template<class T>
+typename TemplateQuantizedESN<T>::Compute TemplateQuantizedESN<T>::quantize(const Compute *x,
+		int len, int8_t *q) {
+	Compute largest = 0;
+	for (int i = 0; i < len; i++) largest = max(largest, (Compute)fabs(x[i]));
+	if (largest == 0) largest = 1;
+	Compute inverse = 127 / largest;
+	for (int i = 0; i < len; i++) {
+		long value = lrint(x[i] * inverse);
+		q[i] = (int8_t)min(127L, max(-127L, value));
+	}
+	return largest / 127;
+}
+
+template<class T>
+void TemplateQuantizedESN<T>::multiply(const Matrix & m, const int8_t *q, Compute scale,
+		Compute *y) {
+	const int rows = m.rows;
+	const long stride = m.stride;
+	if (stride < QUANTIZED_ALIGNMENT) {
+		// e.g. the input weights, one or a few columns
+		for (int i = 0; i < rows; i++) {
+			int32_t dot = 0;
+			for (int j = 0; j < stride; j++) dot += (int32_t)m.values[i*stride + j] * q[j];
+			y[i] = m.scales[i] * scale * dot;
+		}
+		return;
+	}
+	const Int8Kernel & kernel = SelectKernel();
+	const int8_t *scratch = &d_scratch[0];
+	kernel.prepare(q, stride, &d_scratch[0]);
+#pragma omp parallel for schedule(static) if ((double)rows*stride >= QUANTIZED_PARALLEL)
+	for (int i = 0; i < rows; i++) {
+		int32_t dot = kernel.dot(&m.values[i*stride], scratch, stride, m.sums[i]);
+		y[i] = m.scales[i] * scale * dot;
+	}
+}
+
+template<class T>
+typename TemplateQuantizedESN<T>::Compute TemplateQuantizedESN<T>::activate(
+		ActivationFunction function, Compute value) const {
+	switch (function) {
+	case TANH_ACTIVATION:
+		return tanh(value);
+	case LOGISTIC_ACTIVATION:
+		return 1 / (1 + exp(-value));
+	case HEAVISIDE_ACTIVATION:
+		return value < 0 ? 0 : 1;
+	default:
+		return value;
+	}
+}
+
+/**
+ * See ESN::Run, the same update with int8 products:
+ * x(t) = (1 − δCa)x(t-1) + f(W_in u(t) + δC W x(t-1) + W_back y(t-1) - θ)
+ * y(t) = g(W_out [x(t); u(t)])
+ */
+template<class T>
+void TemplateQuantizedESN<T>::Run(TemplateTrial<T> *trial, SimulationType simType)
+{
+	assert (trial != NULL);
+
+	T const * const inputs	= trial->inputVal;
+	int timespan			= trial->sampleSize;
+	T * outputs				= trial->outputVal;
+	T * states				= trial->neuronVal;
+	int n					= d_reservoirSize;
+
+	assert (inputs != NULL);
+	assert (outputs != NULL);
+	assert (states != NULL);
+	assert (trial->inputSize == d_inputSize);
+	assert (trial->stateSize == n);
+
+	std::vector<Compute> u(d_inputSize), inputPart(n), feedbackPart(n), y(d_outputSize),
+			y2(d_outputSize);
+
+	for (int t = 0; t < timespan; ++t) {
+		for (int i = 0; i < d_inputSize; i++) u[i] = inputs[t*d_inputSize + i];
+		Compute inputScale = quantize(&u[0], d_inputSize, &d_qInput[0]);
+		multiply(input, &d_qInput[0], inputScale, &inputPart[0]);
+
+		if (t > 0) {
+			Compute stateScale = quantize(&d_previous[0], n, &d_qStates[0]);
+			multiply(reservoir, &d_qStates[0], stateScale, &d_current[0]);
+		}
+
+		bool hasFeedback = (d_fbConnectivity > 0) && (t > 0);
+		if (hasFeedback) {
+			for (int o = 0; o < d_outputSize; o++) d_output[o] = outputs[(t-1)*d_outputSize + o];
+			Compute outputScale = quantize(&d_output[0], d_outputSize, &d_qOutput[0]);
+			multiply(feedback, &d_qOutput[0], outputScale, &feedbackPart[0]);
+		}
+
+		for (int i = 0; i < n; i++) {
+			Compute res2ResVal = (t > 0) ? d_current[i] : 0;
+			Compute fb2ResVal = hasFeedback ? feedbackPart[i] : 0;
+			// the leftover of ESN::Run (DEFAULT_LEFTOVER), no noise
+			Compute leftOver = 0;
+			if(t > 0) leftOver = (1-d_timeConstant*d_decayRate) * d_previous[i];
+			Compute total_input = activate(d_reservoirActivation,
+					inputPart[i] + res2ResVal*d_timeConstant + fb2ResVal - d_thresholds[i]);
+			trial->debug[(t*n)+i] = total_input;
+			d_current[i] = leftOver + total_input;
+			states[(t*n)+i] = d_current[i];
+		}
+		d_previous.swap(d_current);
+
+		bool setOutput = (d_fbConnectivity > 0);
+		if (simType == TEACHER_FORCING) setOutput = false;
+		if ((simType == TEACHER_TESTING) && (t < trial->teacherTestSize)) setOutput = false;
+		if (setOutput) {
+			Compute stateScale = quantize(&d_previous[0], n, &d_qStates[0]);
+			multiply(readout, &d_qStates[0], stateScale, &y[0]);
+			multiply(inputReadout, &d_qInput[0], inputScale, &y2[0]);
+			for (int o = 0; o < d_outputSize; o++) {
+				outputs[(t*d_outputSize) + o] = activate(d_outputActivation, y[o] + y2[o]);
+			}
+		}
+	}
+}
+
+template class TemplateQuantizedESN<float>;
+template class TemplateQuantizedESN<double>;
+template class TemplateQuantizedESN<aNetwork::half>;
+template class TemplateQuantizedESN<aNetwork::bfloat16>;
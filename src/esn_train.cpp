@@ -24,15 +24,18 @@
 
 // General files
 #include <assert.h>
+#include <math.h>
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <algorithm>
 
 #include <esn_train.h>
-#include <inv.h>
+#include <linalg_backend.h>
 #include <vector>
 
 using namespace std;
+using namespace aNetwork;
 
 // Show debug information or neuron states
 #define SHOW_DEBUG			0
@@ -41,6 +44,12 @@ using namespace std;
 #undef SHOW_DEBUG
 #endif
 
+// Above this number of neurons RIDGE_AUTO uses conjugate gradients, A'A takes 512MB then
+#define RIDGE_CG_NEURONS	8192
+
+// Rows of A (and B) in memory at once in the ridge regression
+#define RIDGE_BLOCK_ROWS	256
+
 /* **************************************************************************************
  * Implementation of ESNPrediction
  * **************************************************************************************/
@@ -50,7 +59,15 @@ using namespace std;
  */
 ESNPrediction::ESNPrediction(int reservoirSize,
 		float connectivity):
+		singlePrecision(false),
+		ridgeSolver(RIDGE_AUTO),
+		cgMaxIterations(1000),
+		cgTolerance(1e-6),
+		cgJacobi(true),
+		cgWarmStart(true),
+		ridgeLambda(0.2),
 		esn(1, 1, reservoirSize, connectivity),
+		nvar(NULL),
 		all_trials(),
 		set(NULL) {
 	esn.setFbConnectivity(1);
@@ -65,6 +82,23 @@ ESNPrediction::ESNPrediction(int reservoirSize,
 //	cout << "Prediction unit initialised" << endl;
 }
 
+/**
+ * Nothing is generated: the trials, the training, and the tests all go through the NVAR.
+ */
+ESNPrediction::ESNPrediction(NVAR *nvar):
+		singlePrecision(false),
+		ridgeSolver(RIDGE_AUTO),
+		cgMaxIterations(1000),
+		cgTolerance(1e-6),
+		cgJacobi(true),
+		cgWarmStart(true),
+		ridgeLambda(0.2),
+		esn(nvar->getInputSize(), nvar->getOutputSize(), 2, 1),
+		nvar(nvar),
+		all_trials(),
+		set(NULL) {
+}
+
 /**
  * TODO: Remove trials with neuronVal[]s.
  */
@@ -83,15 +117,15 @@ ESNPrediction::~ESNPrediction() {
  */
 void ESNPrediction::AddTrial(WEIGHT_TYPE *input, WEIGHT_TYPE *output, int len, int id) {
 	Trial *t = new Trial();
-	t->stateSize  		= esn.getReservoirSize();
-	t->neuronVal  		= new WEIGHT_TYPE[esn.getReservoirSize()*len];
+	t->stateSize  		= (nvar != NULL) ? nvar->getFeatureSize() : esn.getReservoirSize();
+	t->neuronVal  		= new WEIGHT_TYPE[t->stateSize*len];
 	t->classId			= id; // "misused" for identification purposes
 	t->inputVal			= input;
 	t->inputSize		= 1;
 	t->sampleSize		= len;
 	t->outputVal    	= output;
 	t->teacherTestSize 	= len / 5;
-	t->debug   			= new WEIGHT_TYPE[esn.getReservoirSize()*len];
+	t->debug   			= new WEIGHT_TYPE[t->stateSize*len];
 	all_trials.push_back(t);
 }
 
@@ -157,31 +191,88 @@ std::vector<Trial*> & ESNPrediction::GetTestSet() {
 }
 
 /**
- * Run all trials for training.
+ * The defaults are 1000 iterations and a tolerance of 1e-6, with the Jacobi preconditioner
+ * and warm starts. In single precision a tolerance below about 1e-5 is not reached.
+ */
+void ESNPrediction::SetCGOptions(int maxIterations, double tolerance, bool jacobi,
+		bool warmStart) {
+	cgMaxIterations = maxIterations;
+	cgTolerance = tolerance;
+	cgJacobi = jacobi;
+	cgWarmStart = warmStart;
+}
+
+/**
+ * Run all trials for training. The readout of the previous call is the starting point of
+ * the conjugate gradient solver, see SetCGOptions().
  */
 void ESNPrediction::RunTrials() {
 	InitSets();
+	Train();
+}
+
+/**
+ * Run the training set of the current division into sets, and solve and set the readout.
+ */
+void ESNPrediction::Train() {
 	std::vector<Trial*> & trainSet = GetTrainingSet();
 
 	for (unsigned int i = 0; i < trainSet.size(); i++) {
-		esn.Run(trainSet[i], TEACHER_FORCING);
+		if (nvar != NULL) nvar->Run(trainSet[i], TEACHER_FORCING);
+		else esn.Run(trainSet[i], TEACHER_FORCING);
 	}
 
-	ap::real_2d_array W;
-	RidgeRegression(trainSet,&W);
+	RidgeRegression(trainSet,&readout);
 
-	int len = W.gethighbound(1) - W.getlowbound(1) + 1;
+	int len = readout.gethighbound(1) - readout.getlowbound(1) + 1;
 	float weights[len];
-	for (int i = W.getlowbound(1); i <= W.gethighbound(1); i++) {
-		weights[i] = W(i,0);
+	for (int i = readout.getlowbound(1); i <= readout.gethighbound(1); i++) {
+		weights[i] = readout(i,0);
 	}
 
-	esn.setOutputWeights(weights, len);
+	if (nvar != NULL) nvar->setOutputWeights(weights, len);
+	else esn.setOutputWeights(weights, len);
 
 	// calculate the error
 
 }
 
+/**
+ * The contribution of a neuron is its readout weight times the root mean square of its state
+ * over the training set, so a large weight on a neuron that hardly moves does not keep it.
+ * In a random reservoir almost every neuron feeds every other one, so the removed neurons do
+ * change the kept ones; training again (with the same sets) makes up for that.
+ */
+void ESNPrediction::Prune(int budget) {
+	assert (nvar == NULL);
+	assert (set != NULL);
+	int n = esn.getReservoirSize();
+	if (budget >= n) return;
+
+	std::vector<Trial*> & trainSet = GetTrainingSet();
+	std::vector<ESN::Compute> scale(n, 0);
+	long count = 0;
+	for (unsigned int i = 0; i < trainSet.size(); i++) {
+		const WEIGHT_TYPE *states = trainSet[i]->neuronVal;
+		for (int t = 0; t < trainSet[i]->sampleSize; t++)
+			for (int j = 0; j < n; j++) scale[j] += states[t*n + j] * states[t*n + j];
+		count += trainSet[i]->sampleSize;
+	}
+	for (int j = 0; j < n; j++) scale[j] = sqrt(scale[j] / max(count, 1L));
+
+	esn.Prune(budget, &scale[0]);
+
+	for (unsigned int i = 0; i < all_trials.size(); i++) {
+		Trial *t = all_trials[i];
+		delete [] t->neuronVal;
+		delete [] t->debug;
+		t->stateSize	= esn.getReservoirSize();
+		t->neuronVal	= new WEIGHT_TYPE[t->stateSize*t->sampleSize];
+		t->debug		= new WEIGHT_TYPE[t->stateSize*t->sampleSize];
+	}
+	Train();
+}
+
 /**
  * Run the indicated test. The TEACHER_TESTING mode forces teacher input for the
  * first so-many samples and then let the system continue for itself.
@@ -190,7 +281,8 @@ void ESNPrediction::RunTest(int index, float *input, float *result) {
 	std::vector<Trial*> & testSet = GetTestSet();
 	int len = testSet[index]->sampleSize;
 	for (int i = 0; i < len; i++) input[i] = testSet[index]->outputVal[i];
-	esn.Run(testSet[index], TEACHER_TESTING);
+	if (nvar != NULL) nvar->Run(testSet[index], TEACHER_TESTING);
+	else esn.Run(testSet[index], TEACHER_TESTING);
 	for (int i = 0; i < len; i++) result[i] = testSet[index]->outputVal[i];
 
 	// test if the first samples are indeed the same
@@ -210,10 +302,11 @@ void ESNPrediction::RunTest(int index, float *input, float *result, float *state
 	std::vector<Trial*> & testSet = GetTestSet();
 	int len = testSet[index]->sampleSize;
 	for (int i = 0; i < len; i++) input[i] = testSet[index]->outputVal[i];
-	esn.Run(testSet[index], TEACHER_TESTING);
+	if (nvar != NULL) nvar->Run(testSet[index], TEACHER_TESTING);
+	else esn.Run(testSet[index], TEACHER_TESTING);
 	for (int i = 0; i < len; i++) result[i] = testSet[index]->outputVal[i];
 
-	for (int i = 0; i < len * esn.getReservoirSize(); i++) {
+	for (int i = 0; i < len * testSet[index]->stateSize; i++) {
 #ifdef SHOW_DEBUG
 		states[i] = testSet[index]->debug[i];
 #else
@@ -224,37 +317,44 @@ void ESNPrediction::RunTest(int index, float *input, float *result, float *state
 }
 
 /**
- * Same function but with "size" arguments, rather than "boundary" arguments. Just take a
- * look at the matrixmatrixmultiply arguments and you will understand...
- * This function also captures the error rather than segfaults if you hand over the wrong
- * dimensions for the matrices.
- * TODO: Just indicate what dimensions to expect for cx and cy. And warn if they are
- * incorrect.
+ * The rows of A and B of the ridge regression: the reservoir states and inputs, and the
+ * desired outputs, of all trials after the first skip samples. They are copied a block of
+ * rows at a time, so A never has to be in memory as a whole.
  */
-void matrixmatrixmultiply(const ap::real_2d_array& a,
-	     int ax,
-	     int ay,
-	     bool transa,
-	     const ap::real_2d_array& b,
-	     int bx,
-	     int by,
-	     bool transb,
-	     double alpha,
-	     ap::real_2d_array& c,
-	     int cx,
-	     int cy,
-	     double beta,
-	     ap::real_1d_array& work) {
-	try {
-		matrixmatrixmultiply(a, 0, ax-1, 0, ay-1, transa,
-				b, 0, bx-1, 0, by-1, transb, alpha,
-				c, 0, cx-1, 0, cy-1, beta, work);
-	}
-	catch (ap::ap_error err) {
-		cout << "Exception raised: " << string(err.msg) << endl;
-		return;
+struct RidgeRows {
+	std::vector<Trial*> *trials;
+	int skip;
+	int len;
+	int nof_states;
+	int nof_inputs;
+	int nof_out_neurons;
+
+	inline int Count() const { return trials->size() * (len - skip); }
+
+	inline int Columns() const { return nof_states + nof_inputs; }
+
+	//! Copy rows first..first+count-1 of A into a and of B into b
+	template<class T>
+	void Fill(int first, int count, T *a, int lda, T *b, int ldb) const {
+		for (int r = 0; r < count; r++) {
+			int tr = (first + r) / (len - skip);
+			int t = skip + (first + r) % (len - skip);
+			T *row = a + r*lda;
+			const WEIGHT_TYPE *states = (*trials)[tr]->neuronVal + t*nof_states;
+			for (int n = 0; n < nof_states; n++) {
+				row[n] = states[n];
+			}
+			// We also add the inputs to the input matrix
+			const WEIGHT_TYPE *inputs = (*trials)[tr]->inputVal + t*nof_inputs;
+			for (int n = 0; n < nof_inputs; n++) {
+				row[n+nof_states] = inputs[n];
+			}
+			for (int n = 0; n < nof_out_neurons; n++) {
+				b[r*ldb+n] = (*trials)[tr]->outputVal[t*nof_out_neurons+n];
+			}
+		}
 	}
-}
+};
 
 /**
  * Use ridge regression to compute the weights using the projected reservoir node values as desired value.
@@ -267,8 +367,49 @@ void matrixmatrixmultiply(const ap::real_2d_array& a,
  * that contains the desired outputs.
  *
  * [1] Stable Output Feedback in Reservoir Computing Using Ridge Regression by Wyffels et al. (2008)
+ *
+ * A'A + λI is symmetric and, for λ > 0, positive definite, so instead of inverting it the
+ * system is solved with its Cholesky factorisation. The products and the factorisation are
+ * done by the LinalgBackend (the system BLAS/LAPACK if there is one). For large reservoirs
+ * the nxn matrix A'A does not fit in memory any more, then conjugate gradients are used,
+ * see SetRidgeSolver().
+ *
+ * By default the system is solved in double precision. With SetSinglePrecision(true) it is
+ * solved in float, which takes half the memory and runs on twice as many elements per SIMD
+ * register, but A'A has the squared condition number of A, so only use it with a lambda that
+ * keeps A'A + λI well conditioned.
+ *
+ * With the conjugate gradient solver and warm starts (see SetCGOptions()) a W of the right
+ * size is the starting point, e.g. the readout of the previous training.
  */
 void ESNPrediction::RidgeRegression(std::vector<Trial*> & trials, ap::real_2d_array *W) {
+	if (!singlePrecision) {
+		RidgeRegression<double>(trials, W);
+		return;
+	}
+	ap::float_2d_array Wf;
+	int rows = W->gethighbound(1) - W->getlowbound(1) + 1;
+	int cols = W->gethighbound(2) - W->getlowbound(2) + 1;
+	if (rows > 0 && cols > 0) {
+		Wf.setlength(rows, cols);
+		for (int i = 0; i < rows; i++) {
+			for (int j = 0; j < cols; j++) {
+				Wf(i,j) = (*W)(i,j);
+			}
+		}
+	}
+	RidgeRegression<float>(trials, &Wf);
+	if (trials.empty()) return;
+	W->setlength(Wf.gethighbound(1) + 1, Wf.gethighbound(2) + 1);
+	for (int i = 0; i <= Wf.gethighbound(1); i++) {
+		for (int j = 0; j <= Wf.gethighbound(2); j++) {
+			(*W)(i,j) = Wf(i,j);
+		}
+	}
+}
+
+template<class T>
+void ESNPrediction::RidgeRegression(std::vector<Trial*> & trials, ap::template_2d_array<T,true> *W) {
 	if (trials.empty()) return;
 	cout << "Ridge regression on trial set of size " << trials.size() << endl;
 
@@ -279,61 +420,63 @@ void ESNPrediction::RidgeRegression(std::vector<Trial*> & trials, ap::real_2d_ar
 	assert ( esn.getOutputSize() == 1);
 
 	// set dimensions of matrices / vectors
-	int nof_trials 		= trials.size();
-	int trial_len 		= trials[0]->sampleSize;
-	int nof_neurons		= esn.getReservoirSize() + esn.getInputSize();
-	int nof_out_neurons = esn.getOutputSize();
+	RidgeRows rows;
+	rows.trials				= &trials;
+	rows.len				= trials[0]->sampleSize;
+	rows.nof_states			= trials[0]->stateSize;
+	rows.nof_inputs			= trials[0]->inputSize;
+	rows.nof_out_neurons	= esn.getOutputSize();
 
-	int skip_samples	= trial_len / 4;
+	rows.skip				= rows.len / 4;
 
 	// lambda (or alpha) is actually not allowed to be fixed but depends on reservoir
-	double lambda		= 0.2;
-
-	cout << "Skip " << skip_samples << " sample" << ((skip_samples == 1) ? "" : "s") << endl;
+	T lambda		= ridgeLambda;
 
-	// The ap library expects first rows, than columns
-	ap::real_2d_array A, B;
-
-	// Fill the matrix A with all the reservoir states
-	A.setlength(nof_trials * (trial_len - skip_samples), nof_neurons);
-	for (unsigned int tr = 0; tr < trials.size(); tr++) {
-		for (int t = skip_samples; t < trial_len; t++) {
-			int i = tr * (trial_len - skip_samples) + t - skip_samples;
-			for (int n = 0; n < esn.getReservoirSize(); n++) {
-				// row, column
-				A(i,n) = trials[tr]->neuronVal[t*esn.getReservoirSize()+n];
-			}
-			// We also add the inputs to the input matrix
-			for (int n = 0; n < esn.getInputSize(); n++) {
-				A(i,n+esn.getReservoirSize()) = trials[tr]->inputVal[t*esn.getInputSize()+n];
-			}
+	cout << "Skip " << rows.skip << " sample" << ((rows.skip == 1) ? "" : "s") << endl;
 
-		}
+	RidgeSolver solver = ridgeSolver;
+	if (solver == RIDGE_AUTO) {
+		solver = (rows.Columns() > RIDGE_CG_NEURONS) ? RIDGE_CG : RIDGE_CHOLESKY;
 	}
-
-//	WriteToFile(&A, "esn_A.txt");
-
-	// Fill the "matrix" B with all the outputs, in this case the desired ones
-	B.setlength(nof_trials * (trial_len - skip_samples), nof_out_neurons);
-	for (unsigned int tr = 0; tr < trials.size(); tr++) {
-		for (int t = skip_samples; t < trial_len; t++) {
-			for (int n = 0; n < nof_out_neurons; n++) {
-				int i = tr * (trial_len - skip_samples) + t - skip_samples;
-				B(i,0) = trials[tr]->outputVal[t*nof_out_neurons+n];
-			}
-		}
+	if (solver == RIDGE_CG) {
+		RidgeCG<T>(rows, lambda, W);
+	} else if (!RidgeCholesky<T>(rows, lambda, W)) {
+		cerr << "Falling back to conjugate gradients" << endl;
+		RidgeCG<T>(rows, lambda, W);
 	}
+}
 
-	cout << "Create correlation matrix A'*A" << endl;
-	ap::real_2d_array AtA;
+/**
+ * A'A and A'B are accumulated over blocks of rows, so next to A'A only a block of A is kept.
+ * If A'A + λI is not positive definite in the precision of T, W is zero and false returned.
+ */
+template<class T>
+bool ESNPrediction::RidgeCholesky(const RidgeRows & rows, T lambda,
+		ap::template_2d_array<T,true> *W) {
+	LinalgBackend<T> & backend = LinalgBackend<T>::Get();
+	int nof_rows = rows.Count();
+	int nof_neurons = rows.Columns();
+	int nof_out_neurons = rows.nof_out_neurons;
+
+	// The ap library expects first rows, than columns
+	ap::template_2d_array<T,true> A, B;
+	int block = min(nof_rows, RIDGE_BLOCK_ROWS);
+	A.setlength(block, nof_neurons);
+	B.setlength(block, nof_out_neurons);
 
+	cout << "Create correlation matrices A'*A and A'*B" << endl;
+	ap::template_2d_array<T,true> AtA;
 	AtA.setlength(nof_neurons, nof_neurons);
-	ap::real_1d_array work;
-	work.setlength(nof_trials * (trial_len - skip_samples) + nof_neurons);
-	matrixmatrixmultiply(
-			A,   nof_trials * (trial_len - skip_samples), nof_neurons, true,
-			A,   nof_trials * (trial_len - skip_samples), nof_neurons, false, 1.0,
-			AtA, nof_neurons, nof_neurons, 0.0, work);
+	W->setlength(nof_neurons, nof_out_neurons);
+	for (int first = 0; first < nof_rows; first += block) {
+		int count = min(block, nof_rows - first);
+		rows.Fill(first, count, &A(0,0), A.getstride(), &B(0,0), B.getstride());
+		T beta = (first == 0) ? 0 : 1;
+		backend.Syrk(true, nof_neurons, count, 1, &A(0,0), A.getstride(), beta,
+				&AtA(0,0), AtA.getstride());
+		backend.Gemm(true, false, nof_neurons, nof_out_neurons, count, 1, &A(0,0),
+				A.getstride(), &B(0,0), B.getstride(), beta, &(*W)(0,0), W->getstride());
+	}
 
 //	WriteToFile(&AtA, "esn_AtA.txt");
 
@@ -341,25 +484,177 @@ void ESNPrediction::RidgeRegression(std::vector<Trial*> & trials, ap::real_2d_ar
 	cout << "Add \\lambda*I to A'*A" << endl;
 	for (int x = 0; x < nof_neurons; ++x) AtA(x,x) += lambda;
 
-	cout << "Create inverse of A'*A" << endl;
-	rmatrixinverse(AtA, nof_neurons);
+	cout << "Cholesky factorisation of A'*A (" << backend.Name() << ")" << endl;
+	if (!backend.Potrf(nof_neurons, &AtA(0,0), AtA.getstride())) {
+		cerr << "A'*A + \\lambda*I is not positive definite" << endl;
+		for (int i = 0; i < nof_neurons; i++) {
+			for (int j = 0; j < nof_out_neurons; j++) {
+				(*W)(i,j) = 0;
+			}
+		}
+		return false;
+	}
+
+	cout << "Obtaining W" << endl;
+	backend.Potrs(nof_neurons, nof_out_neurons, &AtA(0,0), AtA.getstride(), &(*W)(0,0),
+			W->getstride());
+	return true;
+}
+
+/**
+ * Q := (A'A + λI) P, with one pass over the rows of A: Q accumulates A_k'(A_k P) over the
+ * row blocks A_k.
+ */
+template<class T>
+static void NormalProduct(LinalgBackend<T> & backend, const RidgeRows & rows, T lambda,
+		ap::template_2d_array<T,true> & P, ap::template_2d_array<T,true> & Q,
+		ap::template_2d_array<T,true> & A, ap::template_2d_array<T,true> & B,
+		ap::template_2d_array<T,true> & Y) {
+	int nof_rows = rows.Count();
+	int n = rows.Columns();
+	int m = rows.nof_out_neurons;
+	int block = A.gethighbound(1) + 1;
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < m; j++) {
+			Q(i,j) = lambda * P(i,j);
+		}
+	}
+	for (int first = 0; first < nof_rows; first += block) {
+		int count = min(block, nof_rows - first);
+		rows.Fill(first, count, &A(0,0), A.getstride(), &B(0,0), B.getstride());
+		backend.Gemm(false, false, count, m, n, 1, &A(0,0), A.getstride(), &P(0,0),
+				P.getstride(), 0, &Y(0,0), Y.getstride());
+		backend.Gemm(true, false, n, m, count, 1, &A(0,0), A.getstride(), &Y(0,0),
+				Y.getstride(), 1, &Q(0,0), Q.getstride());
+	}
+}
 
+/**
+ * Conjugate gradients on the normal equations (A'A + λI) W = A'B, each column of W on its
+ * own but with the passes over A shared. A'A is never formed: an iteration is one pass over
+ * the recorded states (see NormalProduct), so the time scales with nnz(A) times the number
+ * of iterations and the memory with the number of neurons. The iterations needed grow with
+ * the square root of the condition number of A'A + λI, which the regularisation bounds by
+ * (σ_max(A)^2 + λ) / λ.
+ *
+ * With cgJacobi the system is preconditioned with its diagonal, the squared column norms of
+ * A plus λ, which evens out the scale differences between the reservoir states and the
+ * inputs. With cgWarmStart and a W of the right size, W is the starting point.
+ *
+ * The residual is that of the normal equations, and A'A + λI is badly conditioned for
+ * reservoirs, so W itself is further off from the Cholesky solution than the tolerance
+ * suggests, although the fit A*W of the training data is close. With 1000 neurons the
+ * default tolerance takes about 30 iterations, 1e-8 about 150.
+ */
+template<class T>
+void ESNPrediction::RidgeCG(const RidgeRows & rows, T lambda,
+		ap::template_2d_array<T,true> *W) {
+	LinalgBackend<T> & backend = LinalgBackend<T>::Get();
+	int nof_rows = rows.Count();
+	int n = rows.Columns();
+	int m = rows.nof_out_neurons;
+
+	bool warm = cgWarmStart &&
+			W->gethighbound(1) - W->getlowbound(1) + 1 == n &&
+			W->gethighbound(2) - W->getlowbound(2) + 1 == m;
+	if (!warm) {
+		W->setlength(n, m);
+		for (int i = 0; i < n; i++) {
+			for (int j = 0; j < m; j++) {
+				(*W)(i,j) = 0;
+			}
+		}
+	}
+
+	ap::template_2d_array<T,true> A, B, Y;
+	int block = min(nof_rows, RIDGE_BLOCK_ROWS);
+	A.setlength(block, n);
+	B.setlength(block, m);
+	Y.setlength(block, m);
+
+	// R := A'B, the diagonal of A'A in D
+	ap::template_2d_array<T,true> R, Z, P, Q;
+	ap::template_1d_array<T,true> D;
+	R.setlength(n, m);
+	Z.setlength(n, m);
+	P.setlength(n, m);
+	Q.setlength(n, m);
+	D.setlength(n);
+	for (int i = 0; i < n; i++) D(i) = lambda;
 	cout << "Calculate A'*B" << endl;
-	ap::real_2d_array AtB;
-	AtB.setlength(nof_neurons, nof_out_neurons);
-	matrixmatrixmultiply(
-			A, nof_trials * (trial_len - skip_samples), nof_neurons,  true,
-			B, nof_trials * (trial_len - skip_samples), nof_out_neurons, false, 1.0,
-			AtB, nof_neurons, nof_out_neurons, 0.0, work);
+	for (int first = 0; first < nof_rows; first += block) {
+		int count = min(block, nof_rows - first);
+		rows.Fill(first, count, &A(0,0), A.getstride(), &B(0,0), B.getstride());
+		backend.Gemm(true, false, n, m, count, 1, &A(0,0), A.getstride(), &B(0,0),
+				B.getstride(), (first == 0) ? 0 : 1, &R(0,0), R.getstride());
+		for (int r = 0; r < count; r++) {
+			const T *row = &A(r,0);
+			for (int i = 0; i < n; i++) D(i) += row[i]*row[i];
+		}
+	}
+	if (!cgJacobi) {
+		for (int i = 0; i < n; i++) D(i) = 1;
+	}
 
-//	WriteToFile(&AtB, "esn_AtB.txt");
+	std::vector<T> bnorm(m, 0), rz(m, 0);
+	for (int j = 0; j < m; j++) {
+		for (int i = 0; i < n; i++) bnorm[j] += R(i,j)*R(i,j);
+		bnorm[j] = sqrt(bnorm[j]);
+	}
 
-	cout << "Obtaining W" << endl;
-	W->setlength(nof_neurons, nof_out_neurons);
-	matrixmatrixmultiply(
-			AtA, nof_neurons, nof_neurons,     false,
-			AtB, nof_neurons, nof_out_neurons, false, 1.0,
-			*W,  nof_neurons, nof_out_neurons, 0.0, work);
+	// R := A'B - (A'A + λI) W
+	if (warm) {
+		NormalProduct(backend, rows, lambda, *W, Q, A, B, Y);
+		for (int i = 0; i < n; i++) {
+			for (int j = 0; j < m; j++) {
+				R(i,j) -= Q(i,j);
+			}
+		}
+	}
+
+	cout << "Conjugate gradients on A'*A + \\lambda*I (" << backend.Name()
+			<< (cgJacobi ? ", Jacobi" : "") << (warm ? ", warm start" : "") << ")" << endl;
+	int it = 0;
+	T residual = 0;
+	for (;; ++it) {
+		// Relative residual of the worst column
+		residual = 0;
+		for (int j = 0; j < m; j++) {
+			T rr = 0;
+			for (int i = 0; i < n; i++) rr += R(i,j)*R(i,j);
+			if (bnorm[j] > 0) residual = max(residual, (T)sqrt(rr) / bnorm[j]);
+		}
+		if (residual <= cgTolerance || it == cgMaxIterations) break;
+
+		// Z := D^-1 R, P := Z + β P
+		for (int j = 0; j < m; j++) {
+			T rznew = 0;
+			for (int i = 0; i < n; i++) {
+				Z(i,j) = R(i,j) / D(i);
+				rznew += R(i,j)*Z(i,j);
+			}
+			T beta = (it == 0 || rz[j] == 0) ? 0 : rznew / rz[j];
+			rz[j] = rznew;
+			for (int i = 0; i < n; i++) P(i,j) = Z(i,j) + beta*P(i,j);
+		}
+
+		// W := W + α P, R := R - α (A'A + λI) P
+		NormalProduct(backend, rows, lambda, P, Q, A, B, Y);
+		for (int j = 0; j < m; j++) {
+			T pq = 0;
+			for (int i = 0; i < n; i++) pq += P(i,j)*Q(i,j);
+			T alpha = (pq > 0) ? rz[j] / pq : 0;
+			for (int i = 0; i < n; i++) {
+				(*W)(i,j) += alpha*P(i,j);
+				R(i,j) -= alpha*Q(i,j);
+			}
+		}
+	}
+	cout << "Obtaining W after " << it << " iteration" << ((it == 1) ? "" : "s")
+			<< ", relative residual " << residual << endl;
+	if (residual > cgTolerance) {
+		cerr << "Conjugate gradients did not reach tolerance " << cgTolerance << endl;
+	}
 }
 
 /**
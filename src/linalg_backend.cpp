@@ -0,0 +1,363 @@
+/**
+ * @file linalg_backend.cpp
+ * @brief
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object against this software used by the military, in the
+ * bio-industry, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2010 Anne van Rossum <anne@almende.com>
+ *
+ * @author 	Anne C. van Rossum
+ * @date	Oct 18, 2026
+ * @project	Replicator FP7
+ * @company	Almende B.V.
+ * @case
+ */
+
+
+// General files
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <iostream>
+
+#include <linalg_backend.h>
+#include <ap.h>
+#include <eigenvalues/nsevd.h>
+#include <eigenvalues/gemm.h>
+
+using namespace std;
+using namespace aNetwork;
+
+// Block size of the Cholesky factorisation of the thd backend
+#define CHOLESKY_NB			64
+
+/* **************************************************************************************
+ * Implementation of LinalgBackend
+ * **************************************************************************************/
+
+/**
+ * Each iteration does two products, so a dominant pair of complex conjugate eigenvalues (of
+ * the same absolute value) does not make the estimate oscillate.
+ */
+template<class T>
+bool LinalgBackend<T>::PowerIteration(int n, const T *a, int lda, T & radius, int maxIter,
+		T tol) {
+	radius = 0;
+	if (n == 0) return true;
+	x.assign(n, 1/sqrt((T)n));
+	y.resize(n);
+	T previous = 0;
+	for (int it = 0; it < maxIter; ++it) {
+		Gemm(false, false, n, 1, n, 1, a, lda, &x[0], 1, 0, &y[0], 1);
+		Gemm(false, false, n, 1, n, 1, a, lda, &y[0], 1, 0, &x[0], 1);
+		T norm = sqrt(ap::vdotproduct(&x[0], &x[0], n));
+		if (norm == 0) {
+			radius = 0;
+			return true;
+		}
+		radius = sqrt(norm);
+		ap::vmul(&x[0], n, 1/norm);
+		if (it > 0 && fabs(radius - previous) <= tol * radius) return true;
+		previous = radius;
+	}
+	return false;
+}
+
+/* **************************************************************************************
+ * The bundled ALGLIB code
+ * **************************************************************************************/
+
+template<class T>
+class ThdBackend: public LinalgBackend<T> {
+public:
+	const char *Name() const { return "thd"; }
+
+	void Gemm(bool transa, bool transb, int m, int n, int k, T alpha, const T *a, int lda,
+			const T *b, int ldb, T beta, T *c, int ldc) {
+		rmatrixgemm<T>(transa, transb, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+	}
+
+	/**
+	 * The upper triangle in row blocks, so only about half of the products are done.
+	 */
+	void Syrk(bool trans, int n, int k, T alpha, const T *a, int lda, T beta, T *c, int ldc) {
+		for (int i = 0; i < n; i += CHOLESKY_NB) {
+			int ib = std::min(CHOLESKY_NB, n - i);
+			const T *ai = trans ? a + i : a + i*lda;
+			rmatrixgemm<T>(trans, !trans, ib, n - i, k, alpha, ai, lda, ai, lda, beta,
+					c + i*ldc + i, ldc);
+		}
+	}
+
+	/**
+	 * Right-looking blocked Cholesky (LAPACK's DPOTRF): the diagonal block is factorised
+	 * with rank-1 updates of its rows, the rows right of it are solved with U11', and the
+	 * upper triangle of the trailing matrix is updated with RMatrixGEMM.
+	 */
+	bool Potrf(int n, T *a, int lda) {
+		for (int j = 0; j < n; j += CHOLESKY_NB) {
+			int jb = std::min(CHOLESKY_NB, n - j);
+			int w = n - j - jb;
+			T *u11 = a + j*lda + j;
+			T *u12 = u11 + jb;
+			if (!Potf2(jb, u11, lda)) return false;
+			if (w == 0) break;
+
+			// U12 := U11'^-1 * A12
+			for (int r = 0; r < jb; ++r) {
+				T *row = u12 + r*lda;
+				ap::vmul(row, w, 1/u11[r*lda+r]);
+				for (int q = r+1; q < jb; ++q) {
+					ap::vsub(u12 + q*lda, row, w, u11[r*lda+q]);
+				}
+			}
+
+			// A22 := A22 - U12'*U12, upper triangle only
+			T *a22 = a + (j+jb)*lda + j+jb;
+			for (int i = 0; i < w; i += CHOLESKY_NB) {
+				int ib = std::min(CHOLESKY_NB, w - i);
+				rmatrixgemm<T>(true, false, ib, w - i, jb, -1, u12 + i, lda, u12 + i, lda, 1,
+						a22 + i*lda + i, lda);
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Forward substitution with U' and back substitution with U, a row of B at a time.
+	 */
+	void Potrs(int n, int nrhs, const T *a, int lda, T *b, int ldb) {
+		for (int i = 0; i < n; ++i) {
+			T *bi = b + i*ldb;
+			ap::vmul(bi, nrhs, 1/a[i*lda+i]);
+			for (int j = i+1; j < n; ++j) {
+				ap::vsub(b + j*ldb, bi, nrhs, a[i*lda+j]);
+			}
+		}
+		for (int i = n-1; i >= 0; --i) {
+			T *bi = b + i*ldb;
+			for (int j = i+1; j < n; ++j) {
+				ap::vsub(bi, b + j*ldb, nrhs, a[i*lda+j]);
+			}
+			ap::vmul(bi, nrhs, 1/a[i*lda+i]);
+		}
+	}
+
+	bool Geev(int n, T *a, int lda, T *wr, T *wi) {
+		if (n == 0) return true;
+		view.attach(a, n, n, lda);
+		bool converged = rmatrixevdinplace(view, n, 0, evr, evi, vl, vr, evd);
+		memcpy(wr, &evr(0), n*sizeof(T));
+		memcpy(wi, &evi(0), n*sizeof(T));
+		return converged;
+	}
+private:
+	//! Unblocked Cholesky of an nxn block
+	bool Potf2(int n, T *a, int lda) {
+		for (int i = 0; i < n; ++i) {
+			T *ri = a + i*lda;
+			if (!(ri[i] > 0)) return false;
+			ri[i] = sqrt(ri[i]);
+			ap::vmul(ri + i+1, n-i-1, 1/ri[i]);
+			for (int j = i+1; j < n; ++j) {
+				ap::vsub(a + j*lda + j, ri + j, n-j, ri[j]);
+			}
+		}
+		return true;
+	}
+
+	ap::template_2d_array<T,true> view, vl, vr;
+	ap::template_1d_array<T,true> evr, evi;
+	template_evdworkspace<T> evd;
+};
+
+/* **************************************************************************************
+ * The system BLAS/LAPACK
+ * **************************************************************************************/
+
+#ifdef ESN_LAPACK
+
+/**
+ * The Fortran interface, which every BLAS/LAPACK has (CBLAS and LAPACKE not always). It is
+ * column-major, and a row-major matrix is its transpose in column-major order, so every
+ * call below is the transposed problem.
+ */
+extern "C" {
+void sgemm_(const char*, const char*, const int*, const int*, const int*, const float*,
+		const float*, const int*, const float*, const int*, const float*, float*, const int*);
+void dgemm_(const char*, const char*, const int*, const int*, const int*, const double*,
+		const double*, const int*, const double*, const int*, const double*, double*, const int*);
+void ssyrk_(const char*, const char*, const int*, const int*, const float*, const float*,
+		const int*, const float*, float*, const int*);
+void dsyrk_(const char*, const char*, const int*, const int*, const double*, const double*,
+		const int*, const double*, double*, const int*);
+void strsm_(const char*, const char*, const char*, const char*, const int*, const int*,
+		const float*, const float*, const int*, float*, const int*);
+void dtrsm_(const char*, const char*, const char*, const char*, const int*, const int*,
+		const double*, const double*, const int*, double*, const int*);
+void spotrf_(const char*, const int*, float*, const int*, int*);
+void dpotrf_(const char*, const int*, double*, const int*, int*);
+void sgeev_(const char*, const char*, const int*, float*, const int*, float*, float*, float*,
+		const int*, float*, const int*, float*, const int*, int*);
+void dgeev_(const char*, const char*, const int*, double*, const int*, double*, double*,
+		double*, const int*, double*, const int*, double*, const int*, int*);
+}
+
+// Overloads on the precision
+static inline void xgemm(const char *ta, const char *tb, const int *m, const int *n, const int *k,
+		const float *alpha, const float *a, const int *lda, const float *b, const int *ldb,
+		const float *beta, float *c, const int *ldc) {
+	sgemm_(ta, tb, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+}
+static inline void xgemm(const char *ta, const char *tb, const int *m, const int *n, const int *k,
+		const double *alpha, const double *a, const int *lda, const double *b, const int *ldb,
+		const double *beta, double *c, const int *ldc) {
+	dgemm_(ta, tb, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+}
+static inline void xsyrk(const char *uplo, const char *t, const int *n, const int *k,
+		const float *alpha, const float *a, const int *lda, const float *beta, float *c,
+		const int *ldc) {
+	ssyrk_(uplo, t, n, k, alpha, a, lda, beta, c, ldc);
+}
+static inline void xsyrk(const char *uplo, const char *t, const int *n, const int *k,
+		const double *alpha, const double *a, const int *lda, const double *beta, double *c,
+		const int *ldc) {
+	dsyrk_(uplo, t, n, k, alpha, a, lda, beta, c, ldc);
+}
+static inline void xtrsm(const char *side, const char *uplo, const char *t, const char *diag,
+		const int *m, const int *n, const float *alpha, const float *a, const int *lda,
+		float *b, const int *ldb) {
+	strsm_(side, uplo, t, diag, m, n, alpha, a, lda, b, ldb);
+}
+static inline void xtrsm(const char *side, const char *uplo, const char *t, const char *diag,
+		const int *m, const int *n, const double *alpha, const double *a, const int *lda,
+		double *b, const int *ldb) {
+	dtrsm_(side, uplo, t, diag, m, n, alpha, a, lda, b, ldb);
+}
+static inline void xpotrf(const char *uplo, const int *n, float *a, const int *lda, int *info) {
+	spotrf_(uplo, n, a, lda, info);
+}
+static inline void xpotrf(const char *uplo, const int *n, double *a, const int *lda, int *info) {
+	dpotrf_(uplo, n, a, lda, info);
+}
+static inline void xgeev(const int *n, float *a, const int *lda, float *wr, float *wi,
+		float *work, const int *lwork, int *info) {
+	const int one = 1;
+	sgeev_("N", "N", n, a, lda, wr, wi, NULL, &one, NULL, &one, work, lwork, info);
+}
+static inline void xgeev(const int *n, double *a, const int *lda, double *wr, double *wi,
+		double *work, const int *lwork, int *info) {
+	const int one = 1;
+	dgeev_("N", "N", n, a, lda, wr, wi, NULL, &one, NULL, &one, work, lwork, info);
+}
+
+template<class T>
+class LapackBackend: public LinalgBackend<T> {
+public:
+	const char *Name() const { return "lapack"; }
+
+	//! C' = op(B)'*op(A)'
+	void Gemm(bool transa, bool transb, int m, int n, int k, T alpha, const T *a, int lda,
+			const T *b, int ldb, T beta, T *c, int ldc) {
+		if (m == 0 || n == 0) return;
+		xgemm(transb ? "T" : "N", transa ? "T" : "N", &n, &m, &k, &alpha, b, &ldb, a, &lda,
+				&beta, c, &ldc);
+	}
+
+	//! The upper triangle of C is the lower one of C'
+	void Syrk(bool trans, int n, int k, T alpha, const T *a, int lda, T beta, T *c, int ldc) {
+		if (n == 0) return;
+		xsyrk("L", trans ? "N" : "T", &n, &k, &alpha, a, &lda, &beta, c, &ldc);
+	}
+
+	//! A = U'*U is A' = L*L' with L = U'
+	bool Potrf(int n, T *a, int lda) {
+		if (n == 0) return true;
+		int info = 0;
+		xpotrf("L", &n, a, &lda, &info);
+		return info == 0;
+	}
+
+	//! A*X = B is X'*L*L' = B', two triangular solves from the right
+	void Potrs(int n, int nrhs, const T *a, int lda, T *b, int ldb) {
+		if (n == 0 || nrhs == 0) return;
+		T one = 1;
+		xtrsm("R", "L", "T", "N", &nrhs, &n, &one, a, &lda, b, &ldb);
+		xtrsm("R", "L", "N", "N", &nrhs, &n, &one, a, &lda, b, &ldb);
+	}
+
+	//! A' has the same eigenvalues
+	bool Geev(int n, T *a, int lda, T *wr, T *wi) {
+		if (n == 0) return true;
+		int info = 0, lwork = -1;
+		T size = 0;
+		xgeev(&n, a, &lda, wr, wi, &size, &lwork, &info);
+		lwork = (int)size;
+		if ((int)work.size() < lwork) work.resize(lwork);
+		xgeev(&n, a, &lda, wr, wi, &work[0], &lwork, &info);
+		return info == 0;
+	}
+private:
+	std::vector<T> work;
+};
+
+#endif
+
+/* **************************************************************************************
+ * Selection
+ * **************************************************************************************/
+
+template<class T>
+static LinalgBackend<T> *FindBackend(const char *name) {
+	static ThdBackend<T> thd;
+	if (!strcmp(name, "thd")) return &thd;
+#ifdef ESN_LAPACK
+	static LapackBackend<T> lapack;
+	if (!strcmp(name, "lapack")) return &lapack;
+#endif
+	return NULL;
+}
+
+template<class T>
+static LinalgBackend<T> *& CurrentBackend() {
+	static LinalgBackend<T> *current = NULL;
+	return current;
+}
+
+template<class T>
+LinalgBackend<T> & LinalgBackend<T>::Get() {
+	LinalgBackend<T> *& current = CurrentBackend<T>();
+	if (current == NULL) {
+#ifdef ESN_LAPACK
+		current = FindBackend<T>("lapack");
+#else
+		current = FindBackend<T>("thd");
+#endif
+		const char *env = getenv("ESN_BACKEND");
+		if (env != NULL && !Select(env)) {
+			cerr << "Unknown linear algebra backend \"" << env << "\", using "
+					<< current->Name() << endl;
+		}
+	}
+	return *current;
+}
+
+template<class T>
+bool LinalgBackend<T>::Select(const char *name) {
+	LinalgBackend<T> *backend = FindBackend<T>(name);
+	if (backend == NULL) return false;
+	CurrentBackend<T>() = backend;
+	return true;
+}
+
+template class aNetwork::LinalgBackend<float>;
+template class aNetwork::LinalgBackend<double>;
@@ -5,10 +5,13 @@
 #include <iostream>
 #include <sstream>
 #include <stdlib.h>
+#include <time.h>
 
 #include <esn.h>
 #include <inv.h>
 #include <esn_train.h>
+#include <esn_quantized.h>
+#include <nvar.h>
 
 using namespace std;
 
@@ -21,6 +24,14 @@ using namespace std;
 //! Number of trials (min = 2)
 #define NOF_TRIALS			2
 
+//! Delayed copies of the series, the steps between them and the ridge parameter, for the NVAR comparison
+#define NVAR_DELAYS			2
+#define NVAR_STRIDE			1
+#define NVAR_LAMBDA			1e-4
+
+//! Number of neurons kept when the trained reservoir is pruned
+#define PRUNE_BUDGET		100
+
 //! Define difficulty of the problem
 #define MACKEY_GLASS_DIFFICULTY			SOFT_MACKEY_GLASS
 
@@ -185,6 +196,158 @@ void test_regression() {
 	pred.RunTrials();
 }
 
+/**
+ * Run a large sparse reservoir with and without renumbering the neurons (reverse
+ * Cuthill-McKee) and compare the time spent in ESN::Run.
+ */
+void benchmark_reorder() {
+	int N = 1000, T = 2000;
+	float connectivity = 0.01;
+	float *in = new float[T];
+	float *out = new float[T];
+	for (int i = 0; i < T; i++) {
+		in[i] = sin(i / 10.0);
+		out[i] = 0;
+	}
+	for (int reorder = 0; reorder < 2; reorder++) {
+		ESN esn(1, 1, N, connectivity);
+		esn.setReorder(reorder);
+		esn.init();
+		Trial trial;
+		trial.stateSize = N;
+		trial.neuronVal = new float[N*T];
+		trial.debug = new float[N*T];
+		trial.inputVal = in;
+		trial.inputSize = 1;
+		trial.sampleSize = T;
+		trial.outputVal = out;
+		trial.teacherTestSize = 0;
+		clock_t start = clock();
+		esn.Run(&trial, TEACHER_FORCING);
+		double duration = (clock() - start) / (double)CLOCKS_PER_SEC;
+		cout << (reorder ? "Reordered" : "Original") << " sparse reservoir: " << duration << "s for "
+				<< T << " steps" << endl;
+		delete [] trial.debug;
+	}
+	delete [] in;
+	delete [] out;
+}
+
+/**
+ * Normalized root mean square error of the prediction after the teacher forced part.
+ */
+double nrmse(float *teacher, float *prediction, int from, int len) {
+	double mean = 0, error = 0, variance = 0;
+	for (int i = from; i < len; i++) mean += teacher[i];
+	mean /= (len - from);
+	for (int i = from; i < len; i++) {
+		error += (prediction[i] - teacher[i]) * (prediction[i] - teacher[i]);
+		variance += (teacher[i] - mean) * (teacher[i] - mean);
+	}
+	return sqrt(error / variance);
+}
+
+/**
+ * Run a test trial again with the weights quantized to int8 (see QuantizedESN) and compare
+ * the error of its prediction with that of the float ESN.
+ */
+void report_quantized(ESNPrediction & pred, int index, float *teacher, float *prediction) {
+	Trial *trial = pred.GetTestSet()[index];
+	int len = trial->sampleSize;
+	for (int i = 0; i < len; i++) trial->outputVal[i] = teacher[i];
+
+	QuantizedESN quantized(pred.GetESN());
+	quantized.Run(trial, TEACHER_TESTING);
+
+	int n = pred.GetESN().getReservoirSize();
+	int in = pred.GetESN().getInputSize(), out = pred.GetESN().getOutputSize();
+	size_t floatBytes = sizeof(WEIGHT_TYPE) * ((size_t)n*n + (size_t)n*(in + out) + (size_t)out*(n + in));
+	cout << "NRMSE float " << nrmse(teacher, prediction, trial->teacherTestSize, len)
+			<< ", int8 (" << QuantizedESN::KernelName() << ") "
+			<< nrmse(teacher, trial->outputVal, trial->teacherTestSize, len)
+			<< ", weights " << floatBytes << " versus " << quantized.WeightBytes() << " bytes" << endl;
+}
+
+/**
+ * Run a test trial again with the reservoir factorized into a low-rank and a sparse part (see
+ * Network::Factorize) and compare the error of its prediction with that of the exact
+ * reservoir. The exact kernel is restored afterwards.
+ */
+void report_factorized(ESNPrediction & pred, int index, float *teacher, float *prediction,
+		float tolerance, int maxRank) {
+	Trial *trial = pred.GetTestSet()[index];
+	int len = trial->sampleSize;
+	for (int i = 0; i < len; i++) trial->outputVal[i] = teacher[i];
+
+	ESN & esn = pred.GetESN();
+	aNetwork::Network & reservoir = esn.getReservoir();
+	bool cheaper = reservoir.Factorize(tolerance, maxRank);
+	esn.Run(trial, TEACHER_TESTING);
+
+	cout << "NRMSE exact " << nrmse(teacher, prediction, trial->teacherTestSize, len)
+			<< ", factorized " << nrmse(teacher, trial->outputVal, trial->teacherTestSize, len)
+			<< " (rank " << reservoir.GetRank() << " + " << reservoir.GetResidualSize()
+			<< " weights, error " << reservoir.GetFactorError() << ", "
+			<< (cheaper ? "cheaper" : "not cheaper") << " than the exact kernel)" << endl;
+	reservoir.Pack();
+}
+
+/**
+ * Train and test an NVAR (see NVAR) on copies of the trials of the ESN, a reservoir-free
+ * alternative, and report its error and the time training and testing take.
+ */
+void report_nvar(float *bias, float *series, int *ids, int nof_trials, int trial_len) {
+	NVAR nvar(1, 1, NVAR_DELAYS, NVAR_STRIDE);
+	ESNPrediction pred(&nvar);
+	pred.SetRidgeLambda(NVAR_LAMBDA);
+
+	// the outputs are fed back and overwritten by the tests
+	std::vector<float> outputs(series, series + nof_trials*trial_len);
+	for (int t = 0; t < nof_trials; t++) {
+		pred.AddTrial(bias, &outputs[t*trial_len], trial_len, ids[t]);
+	}
+
+	clock_t start = clock();
+	pred.RunTrials();
+	std::vector<Trial*> &testSet = pred.GetTestSet();
+	std::vector<float> input(trial_len), output(trial_len);
+	for (size_t t = 0; t < testSet.size(); t++) {
+		pred.RunTest(t, &input[0], &output[0]);
+		cout << "NRMSE nvar " << nrmse(&input[0], &output[0], testSet[t]->teacherTestSize, trial_len)
+				<< " (" << nvar.getFeatureSize() << " features)" << endl;
+	}
+	cout << "NVAR trained and tested in " << (clock() - start) / (double)CLOCKS_PER_SEC << "s" << endl;
+}
+
+/**
+ * Prune the trained reservoir to budget neurons (see ESNPrediction::Prune), compare the error
+ * and the time of a test trial before and after, and save the smaller model.
+ */
+void report_pruned(ESNPrediction & pred, int index, float *teacher, int budget) {
+	Trial *trial = pred.GetTestSet()[index];
+	int len = trial->sampleSize;
+	std::vector<float> input(len), prediction(len);
+
+	int n = pred.GetESN().getReservoirSize();
+	for (int i = 0; i < len; i++) trial->outputVal[i] = teacher[i];
+	clock_t start = clock();
+	pred.RunTest(index, &input[0], &prediction[0]);
+	double before = (clock() - start) / (double)CLOCKS_PER_SEC;
+	double error = nrmse(teacher, &prediction[0], trial->teacherTestSize, len);
+
+	pred.Prune(budget);
+	for (int i = 0; i < len; i++) trial->outputVal[i] = teacher[i];
+	start = clock();
+	pred.RunTest(index, &input[0], &prediction[0]);
+	double after = (clock() - start) / (double)CLOCKS_PER_SEC;
+
+	cout << "NRMSE " << n << " neurons " << error << " in " << before << "s, pruned to "
+			<< pred.GetESN().getReservoirSize() << " neurons "
+			<< nrmse(teacher, &prediction[0], trial->teacherTestSize, len)
+			<< " in " << after << "s" << endl;
+	pred.GetESN().saveESN("mackey_glass_pruned.esn");
+}
+
 /***************************************************************************
  *
  ***************************************************************************/
@@ -194,12 +357,18 @@ void test_regression() {
  */
 int main(int argc, char*argv[]) {
 //#define TEST
+//#define BENCHMARK
 
 #ifdef TEST
 	test_regression();
 	return 1;
 #endif
 
+#ifdef BENCHMARK
+	benchmark_reorder();
+	return 1;
+#endif
+
 	int sample_all = 10000;	// total no. of samples, excluding the given initial condition
 	assert (sample_all >= 2000); // if sample_n < 2000 then the time series is incorrect!!
 	double M[sample_all];
@@ -256,7 +425,11 @@ int main(int argc, char*argv[]) {
 		pred.AddTrial(bias, S[t], trial_len, trial_id[t]);
 	}
 
+	clock_t start = clock();
 	pred.RunTrials();
+	cout << "ESN trained in " << (clock() - start) / (double)CLOCKS_PER_SEC << "s" << endl;
+
+	report_nvar(bias, &S[0][0], trial_id, nof_trials, trial_len);
 
 	std::vector<Trial*> &testSet = pred.GetTestSet();
 	if (testSet.empty()) {
@@ -282,6 +455,8 @@ int main(int argc, char*argv[]) {
 		cout << "Plot result to file " << file << endl;
 		string title0 = "A Mackey-Glass time serie";
 		string title1 = "ESN prediction";
+		report_quantized(pred, t, input, output);
+		report_factorized(pred, t, input, output, 0.05, 16);
 		plot(input, output, trial_len, title0, title1, file);
 	}
 
@@ -332,4 +507,7 @@ int main(int argc, char*argv[]) {
 		}
 	}
 	fclose( stream );
+
+	// the last test trial, its teacher is still in input
+	report_pruned(pred, testSet.size() - 1, input, PRUNE_BUDGET);
 }
@@ -22,96 +22,329 @@
  */
 
 
+// Random networks with less than this fraction of nonzero weights use the sparse kernel
+#define SPARSE_KERNEL_DENSITY		0.3
+
+// Random networks with only weights 0 and ±scale use the ternary kernel from this fraction
+// of nonzero weights on (2 bits per entry, against 8 bytes per weight of the sparse kernel),
+// below it the sparse kernel is faster
+#define TERNARY_KERNEL_DENSITY		0.125
+
+// Network::Factorize aims at this fraction of the tolerance, its norm estimates are low
+#define FACTOR_MARGIN				0.9
+
 // General files
 #include <stdlib.h>
+#include <string.h>
 #include <algorithm>
 #include <time.h>
 #include <iostream>
 #include <assert.h>
 #include <iomanip>
+#include <math.h>
 
 #include <network.h>
+#include <reservoir_cache.h>
+#include <linalg_backend.h>
 #include <ap.h>
-#include <eigenvalues/nsevd.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NETWORK_X86
+#include <immintrin.h>
+#endif
 
 using namespace std;
 using namespace aNetwork;
 
+/* **************************************************************************************
+ * Ternary kernel
+ * **************************************************************************************/
+
+//! Sum of x over the positive and over the negative weights of a row of the ternary kernel
+template<class T, class Compute>
+static void TernaryRow(const uint64_t *mask, const uint64_t *sign, const T *x, int nof_words,
+		Compute & plus, Compute & minus) {
+	plus = minus = 0;
+	for (int w = 0; w < nof_words; ++w) {
+		const T *xw = x + w*64;
+		for (uint64_t bits = mask[w] & ~sign[w]; bits != 0; bits &= bits - 1)
+			plus += xw[__builtin_ctzll(bits)];
+		for (uint64_t bits = sign[w]; bits != 0; bits &= bits - 1)
+			minus += xw[__builtin_ctzll(bits)];
+	}
+}
+
+#ifdef NETWORK_X86
+/**
+ * The bits of the planes are the masks of masked adds, 16 floats at a time, so the cost
+ * does not depend on the density. Masked loads do not touch x beyond the last neuron.
+ */
+__attribute__((target("avx512f")))
+static void TernaryRowAVX512(const uint64_t *mask, const uint64_t *sign, const float *x,
+		int nof_words, float & plus, float & minus) {
+	__m512 p[4], m[4];
+	for (int k = 0; k < 4; ++k) p[k] = m[k] = _mm512_setzero_ps();
+	for (int w = 0; w < nof_words; ++w) {
+		uint64_t pos = mask[w] & ~sign[w], neg = sign[w];
+		// one sum per quarter of the word, so the adds do not wait for each other
+		for (int k = 0; k < 4; ++k) {
+			__m512 xv = _mm512_maskz_loadu_ps((__mmask16)(mask[w] >> 16*k), x + w*64 + 16*k);
+			p[k] = _mm512_mask_add_ps(p[k], (__mmask16)(pos >> 16*k), p[k], xv);
+			m[k] = _mm512_mask_add_ps(m[k], (__mmask16)(neg >> 16*k), m[k], xv);
+		}
+	}
+	plus = _mm512_reduce_add_ps(_mm512_add_ps(_mm512_add_ps(p[0], p[1]), _mm512_add_ps(p[2], p[3])));
+	minus = _mm512_reduce_add_ps(_mm512_add_ps(_mm512_add_ps(m[0], m[1]), _mm512_add_ps(m[2], m[3])));
+}
+#endif
+
+static void TernaryRow(const uint64_t *mask, const uint64_t *sign, const float *x, int nof_words,
+		float & plus, float & minus) {
+#ifdef NETWORK_X86
+	static const bool avx512 = __builtin_cpu_supports("avx512f");
+	if (avx512) {
+		TernaryRowAVX512(mask, sign, x, nof_words, plus, minus);
+		return;
+	}
+#endif
+	TernaryRow<float,float>(mask, sign, x, nof_words, plus, minus);
+}
+
+/* **************************************************************************************
+ * Low-rank factorization
+ * **************************************************************************************/
+
+//! Uniform in [-1,1) from a local generator, so factorizing does not change the random
+//! numbers of the next network or trial
+template<class Compute>
+static Compute NextUniform(uint64_t & state) {
+	state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+	return (Compute)(state >> 11) / (Compute)(1ULL << 52) - 1;
+}
+
+/**
+ * Spectral norm of the n x n matrix e with all entries larger than threshold (in absolute
+ * value) left out, by power iteration on E'E, one pass over e per iteration. The start
+ * vector x is updated, so a next call for a threshold close by converges in a few
+ * iterations. Power iteration approaches the norm from below, so it is an estimate.
+ */
+template<class Compute>
+static Compute MaskedNorm(const Compute *e, int n, Compute threshold, std::vector<Compute> & x,
+		int nof_iterations) {
+	std::vector<Compute> z(n), masked(n);
+	Compute norm = 0;
+	for (int it = 0; it < nof_iterations; ++it) {
+		Compute yy = 0;
+		std::fill(z.begin(), z.end(), Compute(0));
+		for (int i = 0; i < n; ++i) {
+			const Compute *row = e + (long)i*n;
+			Compute y = 0;
+			for (int j = 0; j < n; ++j) {
+				masked[j] = fabs(row[j]) <= threshold ? row[j] : 0;
+				y += masked[j] * x[j];
+			}
+			for (int j = 0; j < n; ++j) z[j] += masked[j] * y;
+			yy += y*y;
+		}
+		norm = sqrt(yy);
+		Compute zz = 0;
+		for (int j = 0; j < n; ++j) zz += z[j]*z[j];
+		if (zz == 0) return 0;
+		zz = sqrt(zz);
+		for (int j = 0; j < n; ++j) x[j] = z[j] / zz;
+	}
+	return norm;
+}
+
+//! Modified Gram-Schmidt on the k rows of length n of q, dependent rows become zero
+template<class Compute>
+static void Orthonormalize(Compute *q, int k, int n) {
+	for (int i = 0; i < k; ++i) {
+		Compute *qi = q + (long)i*n;
+		Compute before = 0;
+		for (int l = 0; l < n; ++l) before += qi[l] * qi[l];
+		for (int j = 0; j < i; ++j) {
+			const Compute *qj = q + (long)j*n;
+			Compute dot = 0;
+			for (int l = 0; l < n; ++l) dot += qi[l] * qj[l];
+			for (int l = 0; l < n; ++l) qi[l] -= dot * qj[l];
+		}
+		Compute norm = 0;
+		for (int l = 0; l < n; ++l) norm += qi[l] * qi[l];
+		norm = sqrt(norm);
+		for (int l = 0; l < n; ++l) qi[l] = norm > 1e-4 * sqrt(before) ? qi[l] / norm : 0;
+	}
+}
+
+// In the precision of the arithmetic
+template<class T>
+struct TemplateNetwork<T>::EigenWorkspace {
+	ap::template_2d_array<Compute,true> a;
+	ap::template_1d_array<Compute,true> wr, wi;
+};
+
 /* **************************************************************************************
  * Implementation of Network
  * **************************************************************************************/
 
-Network::Network() {
+template<class T>
+TemplateNetwork<T>::TemplateNetwork():
+		weights(NULL),
+		mode(CREATE_RANDOM),
+		d_connectivity(0),
+		d_spectralRadius(1),
+		d_measuredRadius(-1),
+		d_excitatoryRatio(0.7),
+		d_backwardRatio(0.5),
+		structure(CREATE_RANDOM),
+		d_forward(0),
+		d_backward(0),
+		d_moduleSize(64),
+		d_interConnectivity(0.001),
+		d_couplingStrength(0.1),
+		sparse(false),
+		d_ternary(false),
+		ternary(false),
+		d_ternaryScale(0),
+		factored(false),
+		d_factorError(0),
+		d_gridWidth(0), d_gridHeight(0), d_gridDepth(1),
+		gridWidth(0), gridHeight(0),
+		d_radius(1.5),
+		indices(NULL),
+		eigen(NULL),
+		width(0), height(0), size(0) {
 	srand48(time(NULL));
 }
 
-Network::~Network() {
+template<class T>
+TemplateNetwork<T>::~TemplateNetwork() {
 	delete [] indices;
+	delete eigen;
 }
 
 //! Initialize reservoir with size width*height
-void Network::Init(WEIGHT_TYPE *weights, int width, int height) {
+template<class T>
+void TemplateNetwork<T>::Init(T *weights, int width, int height) {
+	delete [] indices;
 	this->weights = weights;
 	this->width = width;
 	this->height = height;
 	this->size = width * height;
-	indices = new int[size];
-	for (int i = 0; i < size; i++) {
-		indices[i] = i;
+	indices = NULL;
+}
+
+/**
+ * The array of indices has as many entries as there are weights, so it is only created when
+ * a random network is generated, not for weights that are loaded.
+ */
+template<class T>
+void TemplateNetwork<T>::shuffleIndices() {
+	if (indices == NULL) {
+		indices = new int[size];
+		for (int i = 0; i < size; i++) {
+			indices[i] = i;
+		}
 	}
+	std::random_shuffle(indices, indices+size);
 }
 
 //! Fill reservoir
-bool Network::Run() {
+template<class T>
+bool TemplateNetwork<T>::Run() {
+	bool result = false;
 	switch(mode) {
-	case CREATE_RANDOM: return fillRandom();
-	case CREATE_BALANCED_NETWORK: return createBalancedNetwork();
+	case CREATE_RANDOM: result = fillRandom(); break;
+	case CREATE_BALANCED_NETWORK: result = createBalancedNetwork(); break;
 //	case SCALE_FREE: fillScaleFree(); break;
-	case NORMALIZE_SPECTRUM: return normalizeSpectrum();
+	case NORMALIZE_SPECTRUM: result = normalizeSpectrum(); break;
+	case CREATE_SIMPLE_CYCLE: result = createSimpleCycle(); break;
+	case CREATE_DELAY_LINE: result = createDelayLine(false); break;
+	case CREATE_DELAY_LINE_FEEDBACK: result = createDelayLine(true); break;
+	case CREATE_MODULAR: result = createModular(); break;
+	case CREATE_SPATIAL: result = createSpatial(); break;
 	default:
 		cerr << "This connectivity type does not exist!" << endl;
 	}
-	return false;
+	if (mode != NORMALIZE_SPECTRUM) structure = mode;
+	if (result) Pack();
+	if (!result) d_measuredRadius = -1;
+	return result;
 }
 
-void Network::SetParameter(NetworkParameter param, void *value) {
+template<class T>
+void TemplateNetwork<T>::SetParameter(NetworkParameter param, void *value) {
 	switch(param) {
 	case CONNECTIVITY:
-		d_connectivity 		= *reinterpret_cast<WEIGHT_TYPE*>(value);
+		d_connectivity 		= *reinterpret_cast<Compute*>(value);
 		break;
 	case SPECTRAL_RADIUS:
-		d_spectralRadius	= *reinterpret_cast<WEIGHT_TYPE*>(value);
+		d_spectralRadius	= *reinterpret_cast<Compute*>(value);
 		break;
 	case EXCITATORY_RATIO:
-		d_excitatoryRatio	= *reinterpret_cast<WEIGHT_TYPE*>(value);
+		d_excitatoryRatio	= *reinterpret_cast<Compute*>(value);
+		break;
+	case BACKWARD_RATIO:
+		d_backwardRatio		= *reinterpret_cast<Compute*>(value);
+		break;
+	case MODULE_SIZE:
+		d_moduleSize		= *reinterpret_cast<int*>(value);
+		break;
+	case INTER_CONNECTIVITY:
+		d_interConnectivity	= *reinterpret_cast<Compute*>(value);
+		break;
+	case COUPLING_STRENGTH:
+		d_couplingStrength	= *reinterpret_cast<Compute*>(value);
+		break;
+	case GRID_WIDTH:
+		d_gridWidth			= *reinterpret_cast<int*>(value);
+		break;
+	case GRID_HEIGHT:
+		d_gridHeight		= *reinterpret_cast<int*>(value);
+		break;
+	case GRID_DEPTH:
+		d_gridDepth			= *reinterpret_cast<int*>(value);
+		break;
+	case RADIUS:
+		d_radius			= *reinterpret_cast<Compute*>(value);
+		break;
+	case TERNARY:
+		d_ternary			= *reinterpret_cast<int*>(value) != 0;
 		break;
 	default:
 		cout << "Unknown Parameter" << endl;
 	}
 }
 
-bool Network::fillRandom() {
+template<class T>
+bool TemplateNetwork<T>::fillRandom() {
+	d_measuredRadius = -1;
 	if (d_connectivity == 0) return false;
 	// First set everything to 0
-	for (int x = 0; x < size; ++x) weights[x] = WEIGHT_TYPE(0);
+	for (int x = 0; x < size; ++x) weights[x] = T(0);
 
 	// And generate just a totally random connected reservoir without spatial characteristics
-	std::random_shuffle(indices, indices+size);
+	shuffleIndices();
 	int nof_connections = size * d_connectivity;
 
 	for (int x = 0; x < nof_connections; ++x) {
-		uniform(&weights[indices[x]]);
+		if (d_ternary)
+			weights[indices[x]] = (rand() % 2) ? T(1) : T(-1);
+		else
+			uniform(&weights[indices[x]]);
 	}
 	return true;
 }
 
-bool Network::normalizeSpectrum() {
-	WEIGHT_TYPE maxEigenValue = 0;
+template<class T>
+bool TemplateNetwork<T>::normalizeSpectrum() {
+	Compute maxEigenValue = 0;
 	if (!spectralRadius(maxEigenValue)) return false;
 	if(maxEigenValue == 0) return false;
 
 	for (int x = 0; x < size; ++x)
-		weights[x] *= (d_spectralRadius/maxEigenValue);
+		weights[x] = weights[x] * (d_spectralRadius/maxEigenValue);
+	d_measuredRadius = d_spectralRadius;
 	cout << "Spectral radius becomes: " << d_spectralRadius << endl;
 	return true;
 }
@@ -122,34 +355,44 @@ bool Network::normalizeSpectrum() {
  *
  * NB: the leak rate is not considered in this calculation!
  */
-bool Network::spectralRadius(WEIGHT_TYPE & spectralRadius) {
+template<class T>
+bool TemplateNetwork<T>::spectralRadius(Compute & spectralRadius) {
 	assert (width == height);
-	int nof_nodes = width;
+	return blockSpectralRadius(0, width, spectralRadius);
+}
 
-	ap::real_2d_array a;
+/**
+ * Same as spectralRadius, but only for the nof_nodes x nof_nodes block on the diagonal at
+ * the given offset.
+ */
+template<class T>
+bool TemplateNetwork<T>::blockSpectralRadius(int offset, int nof_nodes, Compute & spectralRadius) {
+	// Reused for every module of a modular network and for every normalisation
+	if (eigen == NULL) eigen = new EigenWorkspace();
+	ap::template_2d_array<Compute,true> & a = eigen->a;
 	a.setlength(nof_nodes, nof_nodes);
 	for(int i = 0; i < nof_nodes; i++) {
-		for(int j = 0; j < nof_nodes; j++) {
-			a(i,j) = weights[i*nof_nodes + j];
-		}
+		Compute *row = &a(i,0);
+		const T *source = weights + (offset+i)*width + offset;
+		for (int j = 0; j < nof_nodes; j++) row[j] = source[j];
 	}
 
-	// Real part of the eigen value
-	ap::real_1d_array wr;
+	// Real and imaginary part of the eigen values
+	ap::template_1d_array<Compute,true> & wr = eigen->wr;
+	ap::template_1d_array<Compute,true> & wi = eigen->wi;
 	wr.setlength(nof_nodes);
-
-	// Imaginary part of the eigen value
-	ap::real_1d_array wi;
 	wi.setlength(nof_nodes);
 
-	// Eigen vectors, not needed
-	ap::real_2d_array evL, evR;
-
-	bool converged = rmatrixevd(a, nof_nodes, 0, wr, wi, evL, evR);
+	// The copy in "a" is not needed afterwards, so it is decomposed in place
+	bool converged = true;
+	if (nof_nodes > 0) {
+		converged = LinalgBackend<Compute>::Get().Geev(nof_nodes, &a(0,0), a.getstride(),
+				&wr(0), &wi(0));
+	}
 
-	WEIGHT_TYPE max = 0;
+	Compute max = 0;
 	for(int i = 0; i < nof_nodes; ++i) {
-		WEIGHT_TYPE tmp = sqrt( pow(wr(i),2) + pow(wi(i),2) );
+		Compute tmp = sqrt( pow(wr(i),2) + pow(wi(i),2) );
 		if(tmp > max)
 			max = tmp;
 	}
@@ -175,13 +418,14 @@ bool much_smaller(const float small, const float medium, const float big) {
  *
  * [1] Chaotic Balanced State in a Model of Cortical Circuits (1998), Van Vreeswijk, Sompolinksy
  */
-bool Network::createBalancedNetwork() {
+template<class T>
+bool TemplateNetwork<T>::createBalancedNetwork() {
 	assert (width == height);
 	int nof_nodes = width;
 	int N_E = d_excitatoryRatio * nof_nodes;
 	int N_I = nof_nodes - N_E;
 
-	std::random_shuffle(indices, indices+size);
+	shuffleIndices();
 	int K = d_connectivity * nof_nodes;
 	cout << "K (connectivity index): " << K << endl;
 	cout << "N_E=" << N_E << " and N_I=" << N_I << endl;
@@ -252,17 +496,776 @@ bool Network::createBalancedNetwork() {
 	printDegrees();
 	printActivity();
 
-	WEIGHT_TYPE maxEigenValue = 0;
+	Compute maxEigenValue = 0;
 	spectralRadius(maxEigenValue);
+	d_measuredRadius = maxEigenValue;
 	cout << "Spectral radius: " << maxEigenValue << endl;
 	return true;
 }
 
+/**
+ * A simple cycle reservoir (SCR) connects neuron n-1 to neuron n and closes the ring from
+ * the last neuron to the first. All weights are equal to r, the eigenvalues are the n-th
+ * roots of r^n, so the spectral radius is exactly r.
+ */
+template<class T>
+bool TemplateNetwork<T>::createSimpleCycle() {
+	assert (width == height);
+	int nof_nodes = width;
+	for (int x = 0; x < size; ++x) weights[x] = T(0);
+
+	for (int n = 0; n < nof_nodes; ++n) {
+		weights[n*nof_nodes + (n + nof_nodes - 1) % nof_nodes] = d_spectralRadius;
+	}
+	d_measuredRadius = d_spectralRadius;
+	return true;
+}
+
+/**
+ * A delay line reservoir (DLR) connects neuron n-1 to neuron n with weight r. The matrix is
+ * nilpotent, so its spectral radius is 0, and the forward weight is just set to the
+ * requested spectral radius. With feedback (DLRB) there is a backward connection from
+ * neuron n+1 to neuron n with weight b. This tridiagonal matrix with zero diagonal has
+ * eigenvalues 2 sqrt(r b) cos(k pi / (n+1)), hence r is chosen such that the largest of
+ * them is the requested spectral radius, with b = d_backwardRatio * r.
+ */
+template<class T>
+bool TemplateNetwork<T>::createDelayLine(bool feedback) {
+	assert (width == height);
+	int nof_nodes = width;
+	for (int x = 0; x < size; ++x) weights[x] = T(0);
+
+	Compute r = d_spectralRadius;
+	Compute b = 0;
+	if (feedback) {
+		if (d_backwardRatio <= 0) return false;
+		r = d_spectralRadius / (2 * sqrt(d_backwardRatio) * cos(M_PI / (nof_nodes + 1)));
+		b = d_backwardRatio * r;
+	}
+
+	for (int n = 1; n < nof_nodes; ++n) {
+		weights[n*nof_nodes + n - 1] = r;
+		weights[(n-1)*nof_nodes + n] = b;
+	}
+	d_measuredRadius = feedback ? d_spectralRadius : 0;
+	return true;
+}
+
+/**
+ * A modular reservoir consists of small randomly connected modules, each small enough to
+ * stay in cache during the update. Every module is normalized to the requested spectral
+ * radius on its own, which costs O(n m^2) instead of O(n^3). The spectral radius of the
+ * block diagonal part is hence exactly the requested one. The sparse links between the
+ * modules are weak (see COUPLING_STRENGTH) and perturb it only slightly.
+ *
+ * [1] The Art of Computer Programming, Vol. 2 (1997), Knuth, 3.4.2 Algorithm S
+ */
+template<class T>
+bool TemplateNetwork<T>::createModular() {
+	assert (width == height);
+	int nof_nodes = width;
+	if (d_connectivity == 0 || d_moduleSize < 2) return false;
+	for (int x = 0; x < size; ++x) weights[x] = T(0);
+
+	// selection sampling [1]: every slot is considered once and taken with probability the
+	// number of weights still needed over the number of slots left, so exactly that number is
+	// drawn, without duplicates, and it ends also when all slots are asked for
+	long intra_size = 0;
+	for (int offset = 0; offset < nof_nodes; offset += d_moduleSize) {
+		int m = std::min(d_moduleSize, nof_nodes - offset);
+		intra_size += (long)m * m;
+		long nof_connections = (long)m * m * d_connectivity;
+		nof_connections = std::max(1L, std::min((long)m * m, nof_connections));
+		long remaining = (long)m * m;
+		for (int i = 0; i < m && nof_connections > 0; ++i) {
+			for (int j = 0; j < m; ++j) {
+				if ((remaining--) * (rand() / (RAND_MAX + 1.0)) >= nof_connections) continue;
+				uniform(&weights[(offset+i)*nof_nodes + offset + j]);
+				--nof_connections;
+			}
+		}
+		Compute maxEigenValue = 0;
+		if (!blockSpectralRadius(offset, m, maxEigenValue)) return false;
+		if (maxEigenValue == 0) return false;
+		for (int i = 0; i < m; ++i)
+			for (int j = 0; j < m; ++j)
+				weights[(offset+i)*nof_nodes + offset + j] =
+						weights[(offset+i)*nof_nodes + offset + j] * (d_spectralRadius/maxEigenValue);
+	}
+
+	long inter_size = (long)size - intra_size;
+	long nof_links = std::min(inter_size, (long)(inter_size * d_interConnectivity));
+	long needed = nof_links, remaining = inter_size;
+	Compute coupling = d_couplingStrength * d_spectralRadius;
+	for (int i = 0; i < nof_nodes && needed > 0; ++i) {
+		for (int j = 0; j < nof_nodes; ++j) {
+			if (i / d_moduleSize == j / d_moduleSize) continue;
+			if ((remaining--) * (rand() / (RAND_MAX + 1.0)) >= needed) continue;
+			uniform(&weights[i*nof_nodes + j], -coupling, coupling);
+			--needed;
+		}
+	}
+	cout << "Spectral radius per module becomes: " << d_spectralRadius << " with " << nof_links
+			<< " links between modules" << endl;
+	d_measuredRadius = d_spectralRadius;
+	return true;
+}
+
+/**
+ * Set up the grid dimensions and the neighbour offsets within the radius.
+ */
+template<class T>
+bool TemplateNetwork<T>::initGrid() {
+	int nof_nodes = width;
+	if (d_gridDepth < 1) return false;
+	gridWidth = d_gridWidth;
+	gridHeight = d_gridHeight;
+	if (gridWidth <= 0 || gridHeight <= 0) {
+		int plane = nof_nodes / d_gridDepth;
+		gridHeight = sqrt((double)plane);
+		while (gridHeight > 1 && plane % gridHeight) gridHeight--;
+		gridWidth = plane / gridHeight;
+	}
+	if (gridWidth * gridHeight * d_gridDepth != nof_nodes) {
+		cerr << "Grid " << gridWidth << "x" << gridHeight << "x" << d_gridDepth
+				<< " does not match the number of neurons " << nof_nodes << endl;
+		assert (gridWidth * gridHeight * d_gridDepth == nof_nodes);
+		return false;
+	}
+
+	int r = d_radius;
+	int rz = d_gridDepth > 1 ? r : 0;
+	stencil.clear();
+	for (int dz = -rz; dz <= rz; ++dz)
+		for (int dy = -r; dy <= r; ++dy)
+			for (int dx = -r; dx <= r; ++dx) {
+				if ((dx == 0 && dy == 0 && dz == 0) || dx*dx + dy*dy + dz*dz > d_radius*d_radius)
+					continue;
+				stencil.push_back(dx); stencil.push_back(dy); stencil.push_back(dz);
+			}
+	return true;
+}
+
+/**
+ * A spatially embedded reservoir as on a modular robot: neurons are placed on a grid of
+ * width x height x depth and every neuron receives connections from all its neighbours
+ * within the given radius. The neighbourhood is the same for each neuron, so W x becomes a
+ * stencil computation. If the grid width and height are not set, the most square 2D grid
+ * that holds exactly all neurons is used.
+ */
+template<class T>
+bool TemplateNetwork<T>::createSpatial() {
+	assert (width == height);
+	int nof_nodes = width;
+	if (!initGrid()) return false;
+	for (int x = 0; x < size; ++x) weights[x] = T(0);
+
+	for (int n = 0; n < nof_nodes; ++n) {
+		int x = n % gridWidth, y = (n / gridWidth) % gridHeight, z = n / (gridWidth*gridHeight);
+		for (size_t k = 0; k < stencil.size(); k += 3) {
+			int nx = x + stencil[k], ny = y + stencil[k+1], nz = z + stencil[k+2];
+			if (nx < 0 || nx >= gridWidth || ny < 0 || ny >= gridHeight || nz < 0 || nz >= d_gridDepth)
+				continue;
+			uniform(&weights[n*nof_nodes + (nz*gridHeight + ny)*gridWidth + nx]);
+		}
+	}
+	cout << "Grid " << gridWidth << "x" << gridHeight << "x" << d_gridDepth << " with "
+			<< stencil.size() / 3 << " neighbours per neuron" << endl;
+	d_measuredRadius = -1;
+	return true;
+}
+
+/**
+ * The weight matrix is the authoritative representation, the kernels only keep what they
+ * need from it. Call this after the weights have been changed from outside the network.
+ */
+template<class T>
+void TemplateNetwork<T>::Pack() {
+	assert (width == height);
+	int nof_nodes = width;
+	sparse = false;
+	ternary = false;
+	factored = false;
+	lowRankU.clear();
+	lowRankV.clear();
+	eventColumns.clear();
+	eventRows.clear();
+	eventWeights.clear();
+	switch(structure) {
+	case CREATE_SIMPLE_CYCLE: case CREATE_DELAY_LINE: case CREATE_DELAY_LINE_FEEDBACK:
+		d_forward = weights[1*nof_nodes + 0];
+		d_backward = weights[0*nof_nodes + 1];
+		break;
+	case CREATE_MODULAR:
+		blocks.clear();
+		sparseRows.assign(1, 0);
+		sparseCols.clear();
+		sparseWeights.clear();
+		for (int offset = 0; offset < nof_nodes; offset += d_moduleSize) {
+			int m = std::min(d_moduleSize, nof_nodes - offset);
+			for (int i = 0; i < m; ++i)
+				blocks.insert(blocks.end(), weights + (offset+i)*nof_nodes + offset,
+						weights + (offset+i)*nof_nodes + offset + m);
+		}
+		for (int n = 0; n < nof_nodes; ++n) {
+			int module = n / d_moduleSize;
+			for (int i = 0; i < nof_nodes; ++i) {
+				if (i / d_moduleSize == module || weights[n*nof_nodes + i] == 0) continue;
+				sparseCols.push_back(i);
+				sparseWeights.push_back(weights[n*nof_nodes + i]);
+			}
+			sparseRows.push_back(sparseCols.size());
+		}
+		break;
+	case CREATE_SPATIAL:
+		initGrid();
+		planes.assign(stencil.size() / 3 * nof_nodes, T(0));
+		for (size_t k = 0; k < stencil.size(); k += 3) {
+			T *plane = &planes[k / 3 * nof_nodes];
+			int offset = stencil[k] + gridWidth * (stencil[k+1] + gridHeight * stencil[k+2]);
+			for (int n = 0; n < nof_nodes; ++n) {
+				int x = n % gridWidth + stencil[k];
+				int y = (n / gridWidth) % gridHeight + stencil[k+1];
+				int z = n / (gridWidth*gridHeight) + stencil[k+2];
+				if (x < 0 || x >= gridWidth || y < 0 || y >= gridHeight || z < 0 || z >= d_gridDepth)
+					continue;
+				plane[n] = weights[n*nof_nodes + n + offset];
+			}
+		}
+		break;
+	default: {
+		long nnz = 0;
+		Compute scale = 0;
+		ternary = true;
+		for (int x = 0; x < size; ++x) {
+			if (weights[x] == 0) continue;
+			nnz++;
+			Compute magnitude = fabs((Compute)weights[x]);
+			if (scale == 0) scale = magnitude;
+			if (magnitude != scale) ternary = false;
+		}
+		if (ternary && nnz >= TERNARY_KERNEL_DENSITY * size) {
+			int nof_words = (nof_nodes + 63) / 64;
+			d_ternaryScale = scale;
+			ternaryMask.assign((long)nof_nodes * nof_words, 0);
+			ternarySign.assign((long)nof_nodes * nof_words, 0);
+			for (int n = 0; n < nof_nodes; ++n) {
+				for (int i = 0; i < nof_nodes; ++i) {
+					Compute w = weights[n*nof_nodes + i];
+					if (w == 0) continue;
+					uint64_t bit = (uint64_t)1 << (i % 64);
+					ternaryMask[(long)n*nof_words + i/64] |= bit;
+					if (w < 0) ternarySign[(long)n*nof_words + i/64] |= bit;
+				}
+			}
+			break;
+		}
+		ternary = false;
+		if (nnz >= SPARSE_KERNEL_DENSITY * size) break;
+		sparse = true;
+		sparseRows.assign(1, 0);
+		sparseCols.clear();
+		sparseWeights.clear();
+		for (int n = 0; n < nof_nodes; ++n) {
+			for (int i = 0; i < nof_nodes; ++i) {
+				if (weights[n*nof_nodes + i] == 0) continue;
+				sparseCols.push_back(i);
+				sparseWeights.push_back(weights[n*nof_nodes + i]);
+			}
+			sparseRows.push_back(sparseCols.size());
+		}
+		break;
+	}
+	}
+}
+
+/**
+ * The recurrent product y = W x, for the minimum complexity topologies this is a shifted
+ * and scaled copy of x in O(n) rather than a dense matrix vector product.
+ */
+template<class T>
+void TemplateNetwork<T>::Multiply(const T *x, Compute *y) const {
+	int nof_nodes = width;
+	if (factored) {
+		// y = S x + U (V' x)
+		int rank = lowRankV.size() / nof_nodes;
+		for (int n = 0; n < nof_nodes; ++n) {
+			Compute sum = 0;
+			for (int k = residualRows[n]; k < residualRows[n+1]; ++k)
+				sum += x[residualCols[k]] * residualWeights[k];
+			y[n] = sum;
+		}
+		for (int r = 0; r < rank; ++r) {
+			const T *u = &lowRankU[(long)r * nof_nodes], *v = &lowRankV[(long)r * nof_nodes];
+			Compute dot = 0;
+			for (int i = 0; i < nof_nodes; ++i) dot += x[i] * v[i];
+			for (int i = 0; i < nof_nodes; ++i) y[i] += dot * u[i];
+		}
+		return;
+	}
+	switch(structure) {
+	case CREATE_SIMPLE_CYCLE:
+		y[0] = d_forward * x[nof_nodes-1];
+		for (int n = 1; n < nof_nodes; ++n) y[n] = d_forward * x[n-1];
+		break;
+	case CREATE_DELAY_LINE:
+		y[0] = 0;
+		for (int n = 1; n < nof_nodes; ++n) y[n] = d_forward * x[n-1];
+		break;
+	case CREATE_DELAY_LINE_FEEDBACK:
+		y[0] = 0;
+		for (int n = 1; n < nof_nodes; ++n) y[n] = d_forward * x[n-1];
+		for (int n = 0; n < nof_nodes-1; ++n) y[n] += d_backward * x[n+1];
+		break;
+	case CREATE_MODULAR: {
+		// every module is an independent small matrix vector product plus the few links
+		// that end in it, so modules can be divided over the cores
+		int nof_modules = (nof_nodes + d_moduleSize - 1) / d_moduleSize;
+#pragma omp parallel for schedule(static)
+		for (int b = 0; b < nof_modules; ++b) {
+			int offset = b * d_moduleSize;
+			int m = std::min(d_moduleSize, nof_nodes - offset);
+			const T *block = &blocks[(long)offset * d_moduleSize];
+			const T *xb = x + offset;
+			for (int i = 0; i < m; ++i) {
+				const T *row = block + i*m;
+				Compute sum = 0;
+				for (int j = 0; j < m; ++j) sum += xb[j] * row[j];
+				for (int k = sparseRows[offset+i]; k < sparseRows[offset+i+1]; ++k)
+					sum += x[sparseCols[k]] * sparseWeights[k];
+				y[offset+i] = sum;
+			}
+		}
+		break;
+	}
+	case CREATE_SPATIAL: {
+		// Walk over the grid row by row and apply all offsets to a row before moving on, the
+		// inner loop is contiguous in x, y and the weight plane, so it vectorizes
+		int nof_rows = gridHeight * d_gridDepth;
+		int nof_offsets = stencil.size() / 3;
+#pragma omp parallel for schedule(static)
+		for (int row = 0; row < nof_rows; ++row) {
+			int gy = row % gridHeight, gz = row / gridHeight;
+			Compute *yr = y + row * gridWidth;
+			for (int i = 0; i < gridWidth; ++i) yr[i] = 0;
+			for (int k = 0; k < nof_offsets; ++k) {
+				int dx = stencil[3*k], dy = stencil[3*k+1], dz = stencil[3*k+2];
+				if (gy + dy < 0 || gy + dy >= gridHeight || gz + dz < 0 || gz + dz >= d_gridDepth)
+					continue;
+				const T *pr = &planes[(long)k * nof_nodes + row * gridWidth];
+				const T *xr = x + row * gridWidth + dx + gridWidth * (dy + gridHeight * dz);
+				int begin = std::max(0, -dx), end = std::min(gridWidth, gridWidth - dx);
+				for (int i = begin; i < end; ++i) yr[i] += pr[i] * xr[i];
+			}
+		}
+		break;
+	}
+	default:
+		if (ternary) {
+			// only adds and subtracts, and one multiply per neuron
+			int nof_words = (nof_nodes + 63) / 64;
+			for (int n = 0; n < nof_nodes; ++n) {
+				Compute plus, minus;
+				TernaryRow(&ternaryMask[(long)n * nof_words], &ternarySign[(long)n * nof_words], x,
+						nof_words, plus, minus);
+				y[n] = d_ternaryScale * (plus - minus);
+			}
+			break;
+		}
+		if (sparse) {
+			for (int n = 0; n < nof_nodes; ++n) {
+				Compute sum = 0;
+				for (int k = sparseRows[n]; k < sparseRows[n+1]; ++k)
+					sum += x[sparseCols[k]] * sparseWeights[k];
+				y[n] = sum;
+			}
+			break;
+		}
+		for (int n = 0; n < nof_nodes; ++n) {
+			const T *row = weights + n*nof_nodes;
+			Compute sum = 0;
+			for (int i = 0; i < nof_nodes; ++i) sum += x[i] * row[i];
+			y[n] = sum;
+		}
+		break;
+	}
+}
+
+/**
+ * Only the columns of the neurons that spiked are added, so a step of a spiking reservoir
+ * costs the number of spikes times the number of outgoing connections instead of n^2. The
+ * columns are taken from the weight matrix, whatever the structure, the first time.
+ *
+ * With the ternary kernel and many spikes the rows are cheaper: the spikes that arrive over
+ * a positive and over a negative weight are counted a word at a time, with popcount.
+ */
+template<class T>
+void TemplateNetwork<T>::MultiplyEvents(const uint64_t *s, Compute *y) {
+	int nof_nodes = width;
+	int nof_words = (nof_nodes + 63) / 64;
+	if (ternary) {
+		long nof_spikes = 0, nnz = 0;
+		for (int w = 0; w < nof_words; ++w) nof_spikes += __builtin_popcountll(s[w]);
+		for (int w = 0; w < nof_words; ++w) nnz += __builtin_popcountll(ternaryMask[w]);
+		// the first row as an estimate of the number of weights per column
+		if (nof_spikes * nnz > 2L * nof_nodes * nof_words) {
+			for (int n = 0; n < nof_nodes; ++n) {
+				const uint64_t *mask = &ternaryMask[(long)n * nof_words];
+				const uint64_t *sign = &ternarySign[(long)n * nof_words];
+				long count = 0;
+				for (int w = 0; w < nof_words; ++w) {
+					count += __builtin_popcountll(mask[w] & ~sign[w] & s[w]);
+					count -= __builtin_popcountll(sign[w] & s[w]);
+				}
+				y[n] += d_ternaryScale * count;
+			}
+			return;
+		}
+	}
+	if (eventColumns.empty()) {
+		// count the weights per column, then fill the columns, both row by row
+		eventColumns.assign(nof_nodes + 1, 0);
+		for (int n = 0; n < nof_nodes; ++n)
+			for (int i = 0; i < nof_nodes; ++i)
+				if (weights[n*nof_nodes + i] != 0) eventColumns[i+1]++;
+		for (int i = 0; i < nof_nodes; ++i) eventColumns[i+1] += eventColumns[i];
+		eventRows.resize(eventColumns[nof_nodes]);
+		eventWeights.resize(eventColumns[nof_nodes]);
+		std::vector<int> next(eventColumns.begin(), eventColumns.end() - 1);
+		for (int n = 0; n < nof_nodes; ++n) {
+			for (int i = 0; i < nof_nodes; ++i) {
+				if (weights[n*nof_nodes + i] == 0) continue;
+				eventRows[next[i]] = n;
+				eventWeights[next[i]++] = weights[n*nof_nodes + i];
+			}
+		}
+	}
+	for (int w = 0; w < nof_words; ++w) {
+		for (uint64_t bits = s[w]; bits != 0; bits &= bits - 1) {
+			int i = w*64 + __builtin_ctzll(bits);
+			for (int k = eventColumns[i]; k < eventColumns[i+1]; ++k)
+				y[eventRows[k]] += eventWeights[k];
+		}
+	}
+}
+
+/**
+ * A random network scatters the nonzero weights of every row over the entire state vector,
+ * so for large networks gathering x(t-1) misses the cache. The reverse Cuthill-McKee
+ * ordering [1] renumbers the neurons such that connected neurons get nearby indices, which
+ * reduces the bandwidth of the (symmetrized) connectivity matrix. The weights are permuted
+ * in place, W'(i,j) = W(p(i),p(j)), and the caller has to permute everything else that is
+ * indexed by neuron in the same way.
+ *
+ * [1] Reducing the bandwidth of sparse symmetric matrices (1969), Cuthill, McKee
+ */
+template<class T>
+void TemplateNetwork<T>::Reorder(std::vector<int> & permutation) {
+	assert (width == height);
+	int nof_nodes = width;
+
+	// the structured topologies have their own kernel that depends on the numbering
+	if (structure != CREATE_RANDOM && structure != CREATE_BALANCED_NETWORK) {
+		permutation.resize(nof_nodes);
+		for (int n = 0; n < nof_nodes; ++n) permutation[n] = n;
+		return;
+	}
+
+	std::vector<std::vector<int> > neighbours(nof_nodes);
+	for (int n = 0; n < nof_nodes; ++n) {
+		for (int i = 0; i < nof_nodes; ++i) {
+			if (i == n) continue;
+			if (weights[n*nof_nodes + i] != 0 || weights[i*nof_nodes + n] != 0)
+				neighbours[n].push_back(i);
+		}
+	}
+
+	std::vector<int> order;
+	order.reserve(nof_nodes);
+	std::vector<bool> visited(nof_nodes, false);
+	while ((int)order.size() < nof_nodes) {
+		// start every component at an unvisited neuron of minimum degree
+		int start = -1;
+		for (int n = 0; n < nof_nodes; ++n) {
+			if (visited[n]) continue;
+			if (start < 0 || neighbours[n].size() < neighbours[start].size()) start = n;
+		}
+		visited[start] = true;
+		order.push_back(start);
+		for (size_t head = order.size() - 1; head < order.size(); ++head) {
+			std::vector<std::pair<int,int> > next;
+			const std::vector<int> & adjacent = neighbours[order[head]];
+			for (size_t k = 0; k < adjacent.size(); ++k) {
+				if (visited[adjacent[k]]) continue;
+				visited[adjacent[k]] = true;
+				next.push_back(std::make_pair((int)neighbours[adjacent[k]].size(), adjacent[k]));
+			}
+			std::sort(next.begin(), next.end());
+			for (size_t k = 0; k < next.size(); ++k) order.push_back(next[k].second);
+		}
+	}
+	permutation.assign(order.rbegin(), order.rend());
+
+	std::vector<T> original(weights, weights + size);
+	for (int n = 0; n < nof_nodes; ++n)
+		for (int i = 0; i < nof_nodes; ++i)
+			weights[n*nof_nodes + i] = original[permutation[n]*nof_nodes + permutation[i]];
+	Pack();
+}
+
+/**
+ * Approximates W by U V' + S, with U and V n x r and S sparse, such that the spectral norm of
+ * W - U V' - S stays within tolerance times that of W, as far as power iteration estimates it:
+ * the estimates are lower bounds, so the error is aimed at FACTOR_MARGIN times the tolerance
+ * and checked with more iterations afterwards, but it is not guaranteed. A product with W then costs 2 n r +
+ * nnz(S) multiply-adds instead of n^2, or nnz(W) for the sparse kernel.
+ *
+ * The range of W is found by randomized subspace iteration [1] for maxRank+8 directions, which
+ * are ordered by Gram-Schmidt with pivoting on the rows of Q'W, so the first r of them are the
+ * rank r part. For r = 0, 1, 2, 4, ..., maxRank the largest entries of the residual are kept
+ * in S, as few as the tolerance allows (bisection on the number of dropped entries), and the r
+ * with the lowest cost wins. Random reservoirs have a flat singular spectrum, so for them this
+ * mostly drops the smallest weights; reservoirs with a few dominant directions (e.g. a strong
+ * mean field) get a low rank part.
+ *
+ * The factors are only kept, and used by Multiply() until the next Pack(), when they are
+ * cheaper than the kernel of the structure; GetFactorError() is the estimated error either
+ * way. MultiplyEvents() keeps using the exact weights.
+ *
+ * [1] Finding structure with randomness (2011), Halko, Martinsson, Tropp
+ */
+template<class T>
+bool TemplateNetwork<T>::Factorize(Compute tolerance, int maxRank) {
+	assert (width == height);
+	int nof_nodes = width;
+	long nof_entries = (long)nof_nodes * nof_nodes;
+	factored = false;
+	d_factorError = 0;
+	lowRankU.clear();
+	lowRankV.clear();
+
+	// the structured topologies have their own kernel, which is already O(n) or blocked
+	if (structure != CREATE_RANDOM && structure != CREATE_BALANCED_NETWORK) return false;
+	maxRank = std::max(0, std::min(maxRank, nof_nodes));
+
+	std::vector<Compute> a(weights, weights + size);
+	uint64_t seed = 0x9e3779b97f4a7c15ULL;
+	std::vector<Compute> x(nof_nodes);
+	for (int j = 0; j < nof_nodes; ++j) x[j] = (1 + NextUniform<Compute>(seed) / 2) / sqrt((Compute)nof_nodes);
+	Compute norm = MaskedNorm(&a[0], nof_nodes, (Compute)INFINITY, x, 30);
+	if (norm == 0) return false;
+	Compute bound = tolerance * norm;
+
+	// u and v hold the rank one terms u_r v_r' row after row, with |v_r| = 1
+	std::vector<Compute> u, v;
+	if (maxRank > 0) {
+		LinalgBackend<Compute> & blas = LinalgBackend<Compute>::Get();
+		int k = std::min(nof_nodes, maxRank + 8);
+		std::vector<Compute> q((long)k * nof_nodes), p((long)k * nof_nodes);
+		for (long l = 0; l < (long)k * nof_nodes; ++l) p[l] = NextUniform<Compute>(seed);
+
+		// the rows of q span the range of W: q = p W', then twice q = (q W) W'
+		blas.Gemm(false, true, k, nof_nodes, nof_nodes, 1, &p[0], nof_nodes, &a[0], nof_nodes,
+				0, &q[0], nof_nodes);
+		Orthonormalize(&q[0], k, nof_nodes);
+		for (int it = 0; it < 2; ++it) {
+			blas.Gemm(false, false, k, nof_nodes, nof_nodes, 1, &q[0], nof_nodes, &a[0], nof_nodes,
+					0, &p[0], nof_nodes);
+			Orthonormalize(&p[0], k, nof_nodes);
+			blas.Gemm(false, true, k, nof_nodes, nof_nodes, 1, &p[0], nof_nodes, &a[0], nof_nodes,
+					0, &q[0], nof_nodes);
+			Orthonormalize(&q[0], k, nof_nodes);
+		}
+
+		// W ~ Q b with b = Q'W, and b = c V' by Gram-Schmidt on its rows, largest row first
+		std::vector<Compute> & b = p;
+		blas.Gemm(false, false, k, nof_nodes, nof_nodes, 1, &q[0], nof_nodes, &a[0], nof_nodes,
+				0, &b[0], nof_nodes);
+		std::vector<Compute> c((long)k * maxRank, 0), rest(k, 0);
+		for (int i = 0; i < k; ++i)
+			for (int l = 0; l < nof_nodes; ++l) rest[i] += b[(long)i*nof_nodes + l] * b[(long)i*nof_nodes + l];
+		Compute largest = *std::max_element(rest.begin(), rest.end());
+		for (int r = 0; r < maxRank; ++r) {
+			int pivot = std::max_element(rest.begin(), rest.end()) - rest.begin();
+			if (rest[pivot] <= 1e-8 * largest) break;
+			Compute length = sqrt(rest[pivot]);
+			for (int l = 0; l < nof_nodes; ++l) v.push_back(b[(long)pivot*nof_nodes + l] / length);
+			const Compute *vr = &v[(long)r * nof_nodes];
+			for (int i = 0; i < k; ++i) {
+				Compute *bi = &b[(long)i * nof_nodes];
+				Compute dot = 0;
+				for (int l = 0; l < nof_nodes; ++l) dot += bi[l] * vr[l];
+				c[(long)i*maxRank + r] = dot;
+				rest[i] = 0;
+				for (int l = 0; l < nof_nodes; ++l) {
+					bi[l] -= dot * vr[l];
+					rest[i] += bi[l] * bi[l];
+				}
+			}
+		}
+		int rank = v.size() / nof_nodes;
+		u.assign((long)rank * nof_nodes, 0);
+		for (int r = 0; r < rank; ++r) {
+			Compute *ur = &u[(long)r * nof_nodes];
+			for (int i = 0; i < k; ++i) {
+				Compute factor = c[(long)i*maxRank + r];
+				const Compute *qi = &q[(long)i * nof_nodes];
+				for (int l = 0; l < nof_nodes; ++l) ur[l] += factor * qi[l];
+			}
+		}
+
+		// the residual is taken with the factors as they are stored, so it makes up for
+		// their rounding as well
+		lowRankU.assign(u.begin(), u.end());
+		lowRankV.assign(v.begin(), v.end());
+		u.assign(lowRankU.begin(), lowRankU.end());
+		v.assign(lowRankV.begin(), lowRankV.end());
+	}
+
+	int rank = v.size() / nof_nodes;
+	std::vector<Compute> e(a), magnitudes(nof_entries);
+	long bestCost = -1;
+	int bestRank = 0;
+	Compute bestThreshold = 0;
+	for (int r = 0; r <= rank; ++r) {
+		if (r > 0) {
+			const Compute *ur = &u[(long)(r-1) * nof_nodes], *vr = &v[(long)(r-1) * nof_nodes];
+			for (int i = 0; i < nof_nodes; ++i)
+				for (int j = 0; j < nof_nodes; ++j) e[(long)i*nof_nodes + j] -= ur[i] * vr[j];
+		}
+		if (r != rank && (r & (r-1)) != 0) continue;
+		long lowRankCost = 2L * r * nof_nodes;
+		if (bestCost >= 0 && lowRankCost >= bestCost) break;
+
+		for (long l = 0; l < nof_entries; ++l) magnitudes[l] = fabs(e[l]);
+		std::sort(magnitudes.begin(), magnitudes.end());
+
+		// the Frobenius norm bounds the spectral norm, so dropping that many is safe
+		long low = 0;
+		Compute sum = 0;
+		while (low < nof_entries && sum + magnitudes[low]*magnitudes[low] <= bound*bound) {
+			sum += magnitudes[low]*magnitudes[low];
+			low++;
+		}
+		// entries equal to the first one that is kept are kept as well
+		if (low < nof_entries)
+			low = std::lower_bound(magnitudes.begin(), magnitudes.begin() + low, magnitudes[low]) - magnitudes.begin();
+		// the estimates are lower bounds of the norm, so they are held to a margin
+		long high = nof_entries;
+		if (MaskedNorm(&e[0], nof_nodes, magnitudes[high-1], x, 10) <= FACTOR_MARGIN * bound) low = high;
+		while (high - low > std::max(1L, nof_entries / 1024)) {
+			long middle = (low + high) / 2;
+			if (MaskedNorm(&e[0], nof_nodes, magnitudes[middle-1], x, 10) <= FACTOR_MARGIN * bound)
+				low = middle;
+			else high = middle;
+		}
+		Compute threshold = low > 0 ? magnitudes[low-1] : 0;
+		long nnz = magnitudes.end() - std::upper_bound(magnitudes.begin(), magnitudes.end(), threshold);
+		long cost = lowRankCost + nnz;
+		if (bestCost < 0 || cost < bestCost) {
+			bestCost = cost;
+			bestRank = r;
+			bestThreshold = threshold;
+		}
+	}
+
+	e = a;
+	for (int r = 0; r < bestRank; ++r) {
+		const Compute *ur = &u[(long)r * nof_nodes], *vr = &v[(long)r * nof_nodes];
+		for (int i = 0; i < nof_nodes; ++i)
+			for (int j = 0; j < nof_nodes; ++j) e[(long)i*nof_nodes + j] -= ur[i] * vr[j];
+	}
+
+	// check the choice with more iterations, and keep more entries if it is over the bound
+	d_factorError = MaskedNorm(&e[0], nof_nodes, bestThreshold, x, 30) / norm;
+	if (d_factorError > tolerance && bestThreshold > 0) {
+		for (long l = 0; l < nof_entries; ++l) magnitudes[l] = fabs(e[l]);
+		std::sort(magnitudes.begin(), magnitudes.end());
+		long low = std::lower_bound(magnitudes.begin(), magnitudes.end(), bestThreshold) - magnitudes.begin();
+		while (d_factorError > tolerance && low > 0) {
+			low = std::max(0L, low - std::max(1L, nof_entries / 1024));
+			low = std::lower_bound(magnitudes.begin(), magnitudes.begin() + low, magnitudes[low]) - magnitudes.begin();
+			bestThreshold = low > 0 ? magnitudes[low-1] : 0;
+			d_factorError = MaskedNorm(&e[0], nof_nodes, bestThreshold, x, 30) / norm;
+		}
+		bestCost = 2L * bestRank * nof_nodes +
+				(magnitudes.end() - std::upper_bound(magnitudes.begin(), magnitudes.end(), bestThreshold));
+	}
+
+	long kernelCost = ternary ? (long)nof_nodes * ((nof_nodes + 63) / 64) * 8 :
+			sparse ? (long)sparseWeights.size() : nof_entries;
+	if (bestCost >= kernelCost) {
+		lowRankU.clear();
+		lowRankV.clear();
+		return false;
+	}
+
+	lowRankU.resize((long)bestRank * nof_nodes);
+	lowRankV.resize((long)bestRank * nof_nodes);
+	residualRows.assign(1, 0);
+	residualCols.clear();
+	residualWeights.clear();
+	for (int n = 0; n < nof_nodes; ++n) {
+		for (int i = 0; i < nof_nodes; ++i) {
+			if (fabs(e[(long)n*nof_nodes + i]) <= bestThreshold) continue;
+			residualCols.push_back(i);
+			residualWeights.push_back(e[(long)n*nof_nodes + i]);
+		}
+		residualRows.push_back(residualCols.size());
+	}
+	factored = true;
+	return true;
+}
+
+/**
+ * Only the parameters that are used for the given mode are included, so changing e.g. the
+ * module size does not invalidate a cached random network. The scalar type is, because half
+ * and bfloat16 have the same size.
+ */
+template<class T>
+uint64_t TemplateNetwork<T>::Fingerprint(Mode mode, uint64_t hash) const {
+	const char *type = ScalarTraits<T>::Name();
+	hash = ReservoirCache::Hash(type, strlen(type), hash);
+	hash = ReservoirCache::Hash(&mode, sizeof(mode), hash);
+	hash = ReservoirCache::Hash(&width, sizeof(width), hash);
+	hash = ReservoirCache::Hash(&height, sizeof(height), hash);
+	hash = ReservoirCache::Hash(&d_spectralRadius, sizeof(d_spectralRadius), hash);
+	switch(mode) {
+	case CREATE_RANDOM:
+		hash = ReservoirCache::Hash(&d_connectivity, sizeof(d_connectivity), hash);
+		if (d_ternary) hash = ReservoirCache::Hash(&d_ternary, sizeof(d_ternary), hash);
+		break;
+	case CREATE_BALANCED_NETWORK:
+		hash = ReservoirCache::Hash(&d_connectivity, sizeof(d_connectivity), hash);
+		hash = ReservoirCache::Hash(&d_excitatoryRatio, sizeof(d_excitatoryRatio), hash);
+		break;
+	case CREATE_DELAY_LINE_FEEDBACK:
+		hash = ReservoirCache::Hash(&d_backwardRatio, sizeof(d_backwardRatio), hash);
+		break;
+	case CREATE_MODULAR:
+		hash = ReservoirCache::Hash(&d_connectivity, sizeof(d_connectivity), hash);
+		hash = ReservoirCache::Hash(&d_moduleSize, sizeof(d_moduleSize), hash);
+		hash = ReservoirCache::Hash(&d_interConnectivity, sizeof(d_interConnectivity), hash);
+		hash = ReservoirCache::Hash(&d_couplingStrength, sizeof(d_couplingStrength), hash);
+		break;
+	case CREATE_SPATIAL:
+		hash = ReservoirCache::Hash(&d_gridWidth, sizeof(d_gridWidth), hash);
+		hash = ReservoirCache::Hash(&d_gridHeight, sizeof(d_gridHeight), hash);
+		hash = ReservoirCache::Hash(&d_gridDepth, sizeof(d_gridDepth), hash);
+		hash = ReservoirCache::Hash(&d_radius, sizeof(d_radius), hash);
+		break;
+	default:
+		break;
+	}
+	return hash;
+}
+
 /**
  * Get weight value between given minimum and maximum. The default is -1 and +1.
  */
-void Network::uniform(WEIGHT_TYPE * value, float min, float max) {
-	WEIGHT_TYPE tmp = rand() / (WEIGHT_TYPE(RAND_MAX)+1); // between [0|1)
+template<class T>
+void TemplateNetwork<T>::uniform(T * value, float min, float max) {
+	Compute tmp = rand() / (Compute(RAND_MAX)+1); // between [0|1)
 	*value = tmp*(max-min) + min;
 }
 
@@ -274,7 +1277,8 @@ void Network::uniform(WEIGHT_TYPE * value, float min, float max) {
  * 					2: print +/- weights (positive versus negative)
  *
  */
-void Network::printWeights(int type) {
+template<class T>
+void TemplateNetwork<T>::printWeights(int type) {
 	cout << "Network weights " << width << "x" << height << endl;
 	// prints incoming weights over rows
 	for (int n = 0; n < width; ++n) {
@@ -287,7 +1291,7 @@ void Network::printWeights(int type) {
 				cout << (weights[(n*width) + i] != 0) << " ";
 				break;
 			case 2:
-				WEIGHT_TYPE w = weights[(n*width) + i];
+				Compute w = weights[(n*width) + i];
 				if (w == 0) cout << "  "; // continue;
 				else if (w < 0) cout << "- ";
 				else cout << "+ ";
@@ -298,7 +1302,8 @@ void Network::printWeights(int type) {
 	}
 }
 
-void Network::printDegrees() {
+template<class T>
+void TemplateNetwork<T>::printDegrees() {
 	assert (width == height);
 	int nof_nodes = width;
 	int print_nof_nodes = nof_nodes;
@@ -335,11 +1340,12 @@ void Network::printDegrees() {
 	cout << "Average degree is " << avg_degree << " (should be 2*K)" << endl;
 }
 
-void Network::printActivity() {
+template<class T>
+void TemplateNetwork<T>::printActivity() {
 	assert (width == height);
 	int nof_nodes = width;
 	int print_nof_nodes = nof_nodes;
-	WEIGHT_TYPE activity[nof_nodes];
+	Compute activity[nof_nodes];
 	for (int n = 0; n < nof_nodes; ++n) {
 		activity[n] = 0;
 		for (int i = 0; i < nof_nodes; ++i) {
@@ -377,3 +1383,8 @@ void Network::printActivity() {
 	cout << endl;
 #endif
 }
+
+template class aNetwork::TemplateNetwork<float>;
+template class aNetwork::TemplateNetwork<double>;
+template class aNetwork::TemplateNetwork<half>;
+template class aNetwork::TemplateNetwork<bfloat16>;
@@ -0,0 +1,127 @@
+/**
+ * @file nvar.cpp
+ * @brief Nonlinear vector autoregression, a feature engine without a reservoir
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object against this software used by the military, in the
+ * bio-industry, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2010 Anne van Rossum <anne@almende.com>
+ *
+ * @author 	Anne C. van Rossum
+ * @date	Oct 18, 2026
+ * @project	Replicator FP7
+ * @company	Almende B.V.
+ * @case
+ */
+
+
+// General files
+#include <assert.h>
+
+#include <nvar.h>
+
+/* **************************************************************************************
+ * Implementation of NVAR
+ * **************************************************************************************/
+
+template<class T>
+TemplateNVAR<T>::TemplateNVAR(int inputSize, int outputSize, int delays, int stride):
+	d_inputSize(inputSize),
+	d_outputSize(outputSize),
+	d_delays(delays),
+	d_stride(stride),
+	d_linearSize(delays * (inputSize + outputSize))
+{
+	assert (delays >= 1 && stride >= 1);
+	d_outputWeights.assign(d_outputSize * (getFeatureSize() + d_inputSize), T(0));
+	d_features.resize(getFeatureSize());
+}
+
+template<class T>
+TemplateNVAR<T>::~TemplateNVAR() {
+}
+
+template<class T>
+void TemplateNVAR<T>::setOutputWeights(T *weights, int len) {
+	assert (len == (int)d_outputWeights.size());
+	for (int i = 0; i < len; i++) {
+		d_outputWeights[i] = weights[i];
+	}
+}
+
+/**
+ * The delayed copies before the start of the trial are zero. The monomials are generated a
+ * row of the upper triangle of v v' at a time, v_i times the contiguous v_i..v_n-1, which
+ * the compiler vectorizes.
+ */
+template<class T>
+void TemplateNVAR<T>::features(const TemplateTrial<T> *trial, int t, Compute *features) const {
+	Compute *linear = features;
+	for (int k = 0; k < d_delays; k++) {
+		int s = t - k*d_stride;
+		Compute *v = linear + k*(d_inputSize + d_outputSize);
+		for (int i = 0; i < d_inputSize; i++)
+			v[i] = (s >= 0) ? (Compute)trial->inputVal[s*d_inputSize + i] : 0;
+		for (int o = 0; o < d_outputSize; o++)
+			v[d_inputSize + o] = (s >= 1) ? (Compute)trial->outputVal[(s-1)*d_outputSize + o] : 0;
+	}
+	Compute *monomials = features + d_linearSize;
+	for (int i = 0; i < d_linearSize; i++) {
+		const Compute vi = linear[i];
+		const Compute *vj = linear + i;
+		int len = d_linearSize - i;
+		for (int j = 0; j < len; j++) monomials[j] = vi * vj[j];
+		monomials += len;
+	}
+}
+
+/**
+ * See ESN::Run: with TEACHER_FORCING the outputs of the trial are the teacher values that are
+ * fed back, with TEACHER_TESTING only for the first teacherTestSize steps, after which the
+ * NVAR feeds back its own outputs.
+ */
+template<class T>
+void TemplateNVAR<T>::Run(TemplateTrial<T> *trial, SimulationType simType)
+{
+	assert (trial != NULL);
+	assert (trial->inputVal != NULL);
+	assert (trial->outputVal != NULL);
+	assert (trial->inputSize == d_inputSize);
+
+	int nof_features = getFeatureSize();
+	int stride = nof_features + d_inputSize;
+	T * states = trial->neuronVal;
+	assert (states == NULL || trial->stateSize == nof_features);
+
+	for (int t = 0; t < trial->sampleSize; ++t) {
+		Compute *f = &d_features[0];
+		features(trial, t, f);
+		if (states != NULL)
+			for (int i = 0; i < nof_features; i++) states[t*nof_features + i] = f[i];
+
+		bool setOutput = true;
+		if (simType == TEACHER_FORCING) setOutput = false;
+		if ((simType == TEACHER_TESTING) && (t < trial->teacherTestSize)) setOutput = false;
+		if (!setOutput) continue;
+		for (int o = 0; o < d_outputSize; o++) {
+			const T *w = &d_outputWeights[o*stride];
+			Compute sum = 0;
+			for (int i = 0; i < nof_features; i++) sum += w[i] * f[i];
+			for (int i = 0; i < d_inputSize; i++)
+				sum += w[nof_features + i] * (Compute)trial->inputVal[t*d_inputSize + i];
+			trial->outputVal[t*d_outputSize + o] = sum;
+		}
+	}
+}
+
+template class TemplateNVAR<float>;
+template class TemplateNVAR<double>;
+template class TemplateNVAR<aNetwork::half>;
+template class TemplateNVAR<aNetwork::bfloat16>;
@@ -0,0 +1,170 @@
+/**
+ * @file reservoir_cache.cpp
+ * @brief 
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common 
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from 
+ * thread pools and TCP/IP components to control architectures and learning algorithms. 
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object against this software used by the military, in the
+ * bio-industry, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2010 Anne van Rossum <anne@almende.com>
+ *
+ * @author 	Anne C. van Rossum
+ * @date	Oct 18, 2026
+ * @project	Replicator FP7
+ * @company	Almende B.V.
+ * @case	
+ */
+
+
+// General files
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <iostream>
+
+#include <reservoir_cache.h>
+
+using namespace std;
+using namespace aNetwork;
+
+// Magic number and version of a cache file
+#define CACHE_MAGIC			"ESNRSV"
+#define CACHE_VERSION		1
+
+// Weights start at this offset, so they are aligned when the file is mapped
+#define CACHE_HEADER_SIZE	64
+
+struct CacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t weightSize;
+	int32_t size;
+	float spectralRadius;
+	uint64_t key;
+};
+
+/* **************************************************************************************
+ * Implementation of ReservoirCache
+ * **************************************************************************************/
+
+ReservoirCache::ReservoirCache(const std::string & directory): directory(directory) {
+}
+
+ReservoirCache::~ReservoirCache() {
+}
+
+uint64_t ReservoirCache::Hash(const void *data, int len, uint64_t hash) {
+	const unsigned char *bytes = (const unsigned char*)data;
+	for (int i = 0; i < len; ++i) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+std::string ReservoirCache::FileName(uint64_t key) {
+	char name[64];
+	sprintf(name, "/reservoir-%016llx.bin", (unsigned long long)key);
+	return directory + name;
+}
+
+/**
+ * The file is mapped read-only and the weights are copied straight from the mapping. Any
+ * mismatch in the header (e.g. a hash collision or a file from another build) counts as a
+ * miss.
+ */
+template<class T>
+bool ReservoirCache::Load(uint64_t key, T *weights, int size,
+		typename ScalarTraits<T>::Compute & spectralRadius) {
+	if (!Enabled()) return false;
+	std::string file = FileName(key);
+	int fd = open(file.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+
+	size_t len = CACHE_HEADER_SIZE + (size_t)size * size * sizeof(T);
+	struct stat info;
+	if (fstat(fd, &info) != 0 || (size_t)info.st_size != len) {
+		close(fd);
+		return false;
+	}
+	void *map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) return false;
+
+	const CacheHeader *header = (const CacheHeader*)map;
+	bool valid = !strncmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) &&
+			header->version == CACHE_VERSION && header->weightSize == sizeof(T) &&
+			header->size == size && header->key == key;
+	if (valid) {
+		memcpy(weights, (const char*)map + CACHE_HEADER_SIZE, len - CACHE_HEADER_SIZE);
+		spectralRadius = header->spectralRadius;
+		cout << "Reservoir loaded from cache " << file << endl;
+	}
+	munmap(map, len);
+	return valid;
+}
+
+/**
+ * The file is written under a temporary name first and then renamed, so concurrent
+ * processes (e.g. workers of a parameter sweep) never see a partially written reservoir.
+ */
+template<class T>
+bool ReservoirCache::Store(uint64_t key, const T *weights, int size,
+		typename ScalarTraits<T>::Compute spectralRadius) {
+	if (!Enabled()) return false;
+	mkdir(directory.c_str(), 0755);
+
+	std::string file = FileName(key);
+	char suffix[32];
+	sprintf(suffix, ".%d.tmp", (int)getpid());
+	std::string tmp = file + suffix;
+	FILE *stream = fopen(tmp.c_str(), "wb");
+	if (stream == NULL) {
+		cerr << "Cannot write to reservoir cache " << directory << endl;
+		return false;
+	}
+
+	char block[CACHE_HEADER_SIZE];
+	memset(block, 0, sizeof(block));
+	CacheHeader *header = (CacheHeader*)block;
+	strncpy(header->magic, CACHE_MAGIC, sizeof(header->magic));
+	header->version = CACHE_VERSION;
+	header->weightSize = sizeof(T);
+	header->size = size;
+	header->spectralRadius = spectralRadius;
+	header->key = key;
+
+	size_t count = (size_t)size * size;
+	bool okay = fwrite(block, CACHE_HEADER_SIZE, 1, stream) == 1 &&
+			fwrite(weights, sizeof(T), count, stream) == count;
+	okay = (fclose(stream) == 0) && okay;
+	if (okay) okay = rename(tmp.c_str(), file.c_str()) == 0;
+	if (!okay) unlink(tmp.c_str());
+	return okay;
+}
+
+template bool ReservoirCache::Load<float>(uint64_t, float*, int,
+		ScalarTraits<float>::Compute &);
+template bool ReservoirCache::Load<double>(uint64_t, double*, int,
+		ScalarTraits<double>::Compute &);
+template bool ReservoirCache::Load<half>(uint64_t, half*, int,
+		ScalarTraits<half>::Compute &);
+template bool ReservoirCache::Load<bfloat16>(uint64_t, bfloat16*, int,
+		ScalarTraits<bfloat16>::Compute &);
+template bool ReservoirCache::Store<float>(uint64_t, const float*, int,
+		ScalarTraits<float>::Compute);
+template bool ReservoirCache::Store<double>(uint64_t, const double*, int,
+		ScalarTraits<double>::Compute);
+template bool ReservoirCache::Store<half>(uint64_t, const half*, int,
+		ScalarTraits<half>::Compute);
+template bool ReservoirCache::Store<bfloat16>(uint64_t, const bfloat16*, int,
+		ScalarTraits<bfloat16>::Compute);
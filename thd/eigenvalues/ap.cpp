@@ -39,21 +39,33 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 
 /********************************************************************
-Optimized ABLAS interface
+Optimized ABLAS interface. On Windows the kernels are taken from
+ablas.dll (if present), elsewhere from apsimd.cpp, where they are
+selected with cpuid. Define AP_NO_ABLAS to always use the templates.
 ********************************************************************/
-#ifdef AP_WIN32
-#include <windows.h>
+#ifndef AP_NO_ABLAS
+#define AP_ABLAS
+#endif
+
+#ifdef AP_ABLAS
 extern "C"
 {
 typedef double  (*_ddot1)(const double*, const double*, long);
-typedef void    (*_dmove1)(const double*, const double*, long);
-typedef void    (*_dmoves1)(const double*, const double*, long, double);
-typedef void    (*_dmoveneg1)(const double*, const double*, long);
-typedef void    (*_dadd1)(const double*, const double*, long);
-typedef void    (*_dadds1)(const double*, const double*, long, double);
-typedef void    (*_dsub1)(const double*, const double*, long);
-typedef void    (*_dmuls1)(const double*, long, double);
+typedef void    (*_dmove1)(double*, const double*, long);
+typedef void    (*_dmoves1)(double*, const double*, long, double);
+typedef void    (*_dmoveneg1)(double*, const double*, long);
+typedef void    (*_dadd1)(double*, const double*, long);
+typedef void    (*_dadds1)(double*, const double*, long, double);
+typedef void    (*_dsub1)(double*, const double*, long);
+typedef void    (*_dmuls1)(double*, long, double);
+typedef float   (*_sdot1)(const float*, const float*, long);
+typedef void    (*_sadds1)(float*, const float*, long, float);
+typedef void    (*_smuls1)(float*, long, float);
 }
+#endif
+
+#if defined(AP_ABLAS) && defined(AP_WIN32)
+#include <windows.h>
 HINSTANCE ABLAS = LoadLibrary("ablas.dll");
 
 static _ddot1     ddot1     = ABLAS==NULL ? NULL :     (_ddot1)  GetProcAddress(ABLAS, "ASMDotProduct1");
@@ -64,6 +76,33 @@ static _dadd1     dadd1     = ABLAS==NULL ? NULL :     (_dadd1)  GetProcAddress(
 static _dadds1    dadds1    = ABLAS==NULL ? NULL :    (_dadds1)  GetProcAddress(ABLAS, "ASMAddS1");
 static _dsub1     dsub1     = ABLAS==NULL ? NULL :     (_dsub1)  GetProcAddress(ABLAS, "ASMSub1");
 static _dmuls1    dmuls1    = ABLAS==NULL ? NULL :     (_dmuls1) GetProcAddress(ABLAS, "ASMMulS1");
+
+//
+// ablas.dll has no single precision kernels
+//
+static _sdot1     sdot1     = NULL;
+static _sadds1    sadds1    = NULL;
+static _smuls1    smuls1    = NULL;
+#elif defined(AP_ABLAS)
+#include "apsimd.h"
+
+//
+// Calls made before these are initialized (from other static
+// initializers) see NULL and use the templates
+//
+static const ap::ablaskernels& ABLAS = ap::ablasselect();
+
+static _ddot1     ddot1     = ABLAS.ddot1;
+static _dmove1    dmove1    = ABLAS.dmove1;
+static _dmoves1   dmoves1   = ABLAS.dmoves1;
+static _dmoveneg1 dmoveneg1 = ABLAS.dmoveneg1;
+static _dadd1     dadd1     = ABLAS.dadd1;
+static _dadds1    dadds1    = ABLAS.dadds1;
+static _dsub1     dsub1     = ABLAS.dsub1;
+static _dmuls1    dmuls1    = ABLAS.dmuls1;
+static _sdot1     sdot1     = ABLAS.sdot1;
+static _sadds1    sadds1    = ABLAS.sadds1;
+static _smuls1    smuls1    = ABLAS.smuls1;
 #endif
 
 const double ap::machineepsilon = 5E-16;
@@ -190,13 +229,22 @@ BLAS functions
 ********************************************************************/
 double ap::vdotproduct(const double *v1, const double *v2, int N)
 {
-#ifdef AP_WIN32
+#ifdef AP_ABLAS
     if( ddot1!=NULL )
         return ddot1(v1, v2, N);
 #endif
     return ap::_vdotproduct<double>(v1, v2, N);
 }
 
+float ap::vdotproduct(const float *v1, const float *v2, int N)
+{
+#ifdef AP_ABLAS
+    if( sdot1!=NULL )
+        return sdot1(v1, v2, N);
+#endif
+    return ap::_vdotproduct<float>(v1, v2, N);
+}
+
 ap::complex ap::vdotproduct(const ap::complex *v1, const ap::complex *v2, int N)
 {
     return ap::_vdotproduct<ap::complex>(v1, v2, N);
@@ -204,7 +252,7 @@ ap::complex ap::vdotproduct(const ap::complex *v1, const ap::complex *v2, int N)
 
 void ap::vmove(double *vdst, const double* vsrc, int N)
 {
-#ifdef AP_WIN32
+#ifdef AP_ABLAS
     if( dmove1!=NULL )
     {
         dmove1(vdst, vsrc, N);
@@ -214,6 +262,11 @@ void ap::vmove(double *vdst, const double* vsrc, int N)
     ap::_vmove<double>(vdst, vsrc, N);
 }
 
+void ap::vmove(float *vdst, const float* vsrc, int N)
+{
+    ap::_vmove<float>(vdst, vsrc, N);
+}
+
 void ap::vmove(ap::complex *vdst, const ap::complex* vsrc, int N)
 {
     ap::_vmove<ap::complex>(vdst, vsrc, N);
@@ -221,7 +274,7 @@ void ap::vmove(ap::complex *vdst, const ap::complex* vsrc, int N)
 
 void ap::vmoveneg(double *vdst, const double *vsrc, int N)
 {
-#ifdef AP_WIN32
+#ifdef AP_ABLAS
     if( dmoveneg1!=NULL )
     {
         dmoveneg1(vdst, vsrc, N);
@@ -231,6 +284,11 @@ void ap::vmoveneg(double *vdst, const double *vsrc, int N)
     ap::_vmoveneg<double>(vdst, vsrc, N);
 }
 
+void ap::vmoveneg(float *vdst, const float *vsrc, int N)
+{
+    ap::_vmoveneg<float>(vdst, vsrc, N);
+}
+
 void ap::vmoveneg(ap::complex *vdst, const ap::complex *vsrc, int N)
 {
     ap::_vmoveneg<ap::complex>(vdst, vsrc, N);
@@ -238,7 +296,7 @@ void ap::vmoveneg(ap::complex *vdst, const ap::complex *vsrc, int N)
 
 void ap::vmove(double *vdst, const double *vsrc, int N, double alpha)
 {
-#ifdef AP_WIN32
+#ifdef AP_ABLAS
     if( dmoves1!=NULL )
     {
         dmoves1(vdst, vsrc, N, alpha);
@@ -248,6 +306,11 @@ void ap::vmove(double *vdst, const double *vsrc, int N, double alpha)
     ap::_vmove<double,double>(vdst, vsrc, N, alpha);
 }
 
+void ap::vmove(float *vdst, const float *vsrc, int N, float alpha)
+{
+    ap::_vmove<float,float>(vdst, vsrc, N, alpha);
+}
+
 void ap::vmove(ap::complex *vdst, const ap::complex *vsrc, int N, double alpha)
 {
     ap::_vmove<ap::complex,double>(vdst, vsrc, N, alpha);
@@ -260,7 +323,7 @@ void ap::vmove(ap::complex *vdst, const ap::complex *vsrc, int N, ap::complex al
 
 void ap::vadd(double *vdst, const double *vsrc, int N)
 {
-#ifdef AP_WIN32
+#ifdef AP_ABLAS
     if( dadd1!=NULL )
     {
         dadd1(vdst, vsrc, N);
@@ -270,6 +333,11 @@ void ap::vadd(double *vdst, const double *vsrc, int N)
     ap::_vadd<double>(vdst, vsrc, N);
 }
 
+void ap::vadd(float *vdst, const float *vsrc, int N)
+{
+    ap::_vadd<float>(vdst, vsrc, N);
+}
+
 void ap::vadd(ap::complex *vdst, const ap::complex *vsrc, int N)
 {
     ap::_vadd<ap::complex>(vdst, vsrc, N);
@@ -277,7 +345,7 @@ void ap::vadd(ap::complex *vdst, const ap::complex *vsrc, int N)
 
 void ap::vadd(double *vdst, const double *vsrc, int N, double alpha)
 {
-#ifdef AP_WIN32
+#ifdef AP_ABLAS
     if( dadds1!=NULL )
     {
         dadds1(vdst, vsrc, N, alpha);
@@ -287,6 +355,18 @@ void ap::vadd(double *vdst, const double *vsrc, int N, double alpha)
     ap::_vadd<double,double>(vdst, vsrc, N, alpha);
 }
 
+void ap::vadd(float *vdst, const float *vsrc, int N, float alpha)
+{
+#ifdef AP_ABLAS
+    if( sadds1!=NULL )
+    {
+        sadds1(vdst, vsrc, N, alpha);
+        return;
+    }
+#endif
+    ap::_vadd<float,float>(vdst, vsrc, N, alpha);
+}
+
 void ap::vadd(ap::complex *vdst, const ap::complex *vsrc, int N, double alpha)
 {
     ap::_vadd<ap::complex,double>(vdst, vsrc, N, alpha);
@@ -299,7 +379,7 @@ void ap::vadd(ap::complex *vdst, const ap::complex *vsrc, int N, ap::complex alp
 
 void ap::vsub(double *vdst, const double *vsrc, int N)
 {
-#ifdef AP_WIN32
+#ifdef AP_ABLAS
     if( dsub1!=NULL )
     {
         dsub1(vdst, vsrc, N);
@@ -309,6 +389,11 @@ void ap::vsub(double *vdst, const double *vsrc, int N)
     ap::_vsub<double>(vdst, vsrc, N);
 }
 
+void ap::vsub(float *vdst, const float *vsrc, int N)
+{
+    ap::_vsub<float>(vdst, vsrc, N);
+}
+
 void ap::vsub(ap::complex *vdst, const ap::complex *vsrc, int N)
 {
     ap::_vsub<ap::complex>(vdst, vsrc, N);
@@ -316,7 +401,7 @@ void ap::vsub(ap::complex *vdst, const ap::complex *vsrc, int N)
 
 void ap::vsub(double *vdst, const double *vsrc, int N, double alpha)
 {
-#ifdef AP_WIN32
+#ifdef AP_ABLAS
     if( dadds1!=NULL )
     {
         dadds1(vdst, vsrc, N, -alpha);
@@ -326,6 +411,18 @@ void ap::vsub(double *vdst, const double *vsrc, int N, double alpha)
     ap::_vsub<double,double>(vdst, vsrc, N, alpha);
 }
 
+void ap::vsub(float *vdst, const float *vsrc, int N, float alpha)
+{
+#ifdef AP_ABLAS
+    if( sadds1!=NULL )
+    {
+        sadds1(vdst, vsrc, N, -alpha);
+        return;
+    }
+#endif
+    ap::_vsub<float,float>(vdst, vsrc, N, alpha);
+}
+
 void ap::vsub(ap::complex *vdst, const ap::complex *vsrc, int N, double alpha)
 {
     ap::_vsub<ap::complex,double>(vdst, vsrc, N, alpha);
@@ -338,7 +435,7 @@ void ap::vsub(ap::complex *vdst, const ap::complex *vsrc, int N, ap::complex alp
 
 void ap::vmul(double *vdst, int N, double alpha)
 {
-#ifdef AP_WIN32
+#ifdef AP_ABLAS
     if( dmuls1!=NULL )
     {
         dmuls1(vdst, N, alpha);
@@ -348,6 +445,18 @@ void ap::vmul(double *vdst, int N, double alpha)
     ap::_vmul<double,double>(vdst, N, alpha);
 }
 
+void ap::vmul(float *vdst, int N, float alpha)
+{
+#ifdef AP_ABLAS
+    if( smuls1!=NULL )
+    {
+        smuls1(vdst, N, alpha);
+        return;
+    }
+#endif
+    ap::_vmul<float,float>(vdst, N, alpha);
+}
+
 void ap::vmul(ap::complex *vdst, int N, double alpha)
 {
     ap::_vmul<ap::complex,double>(vdst, N, alpha);
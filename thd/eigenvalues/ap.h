@@ -50,9 +50,11 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #endif
 
 /********************************************************************
-Array bounds check
+Array bounds check, only in debug builds (NDEBUG not defined)
 ********************************************************************/
+#ifndef NDEBUG
 #define AP_ASSERT
+#endif
 
 #ifndef AP_ASSERT     //
 #define NO_AP_ASSERT  // This code avoids definition of the
@@ -78,6 +80,12 @@ Current environment.
 #endif
 #endif
 
+/********************************************************************
+Alignment in bytes of aligned arrays and of the rows of aligned
+matrices (a cache line, and wide enough for AVX-512).
+********************************************************************/
+#define AP_ALIGNMENT 64
+
 /********************************************************************
 This symbol is used for debugging. Do not define it and do not remove
 comments.
@@ -199,33 +207,42 @@ Templates for vector operations
 BLAS functions
 ********************************************************************/
 double vdotproduct(const double *v1, const double *v2, int N);
+float vdotproduct(const float *v1, const float *v2, int N);
 complex vdotproduct(const complex *v1, const complex *v2, int N);
 
 void vmove(double *vdst, const double* vsrc, int N);
+void vmove(float *vdst, const float* vsrc, int N);
 void vmove(complex *vdst, const complex* vsrc, int N);
 
 void vmoveneg(double *vdst, const double *vsrc, int N);
+void vmoveneg(float *vdst, const float *vsrc, int N);
 void vmoveneg(complex *vdst, const complex *vsrc, int N);
 
 void vmove(double *vdst, const double *vsrc, int N, double alpha);
+void vmove(float *vdst, const float *vsrc, int N, float alpha);
 void vmove(complex *vdst, const complex *vsrc, int N, double alpha);
 void vmove(complex *vdst, const complex *vsrc, int N, complex alpha);
 
 void vadd(double *vdst, const double *vsrc, int N);
+void vadd(float *vdst, const float *vsrc, int N);
 void vadd(complex *vdst, const complex *vsrc, int N);
 
 void vadd(double *vdst, const double *vsrc, int N, double alpha);
+void vadd(float *vdst, const float *vsrc, int N, float alpha);
 void vadd(complex *vdst, const complex *vsrc, int N, double alpha);
 void vadd(complex *vdst, const complex *vsrc, int N, complex alpha);
 
 void vsub(double *vdst, const double *vsrc, int N);
+void vsub(float *vdst, const float *vsrc, int N);
 void vsub(complex *vdst, const complex *vsrc, int N);
 
 void vsub(double *vdst, const double *vsrc, int N, double alpha);
+void vsub(float *vdst, const float *vsrc, int N, float alpha);
 void vsub(complex *vdst, const complex *vsrc, int N, double alpha);
 void vsub(complex *vdst, const complex *vsrc, int N, complex alpha);
 
 void vmul(double *vdst, int N, double alpha);
+void vmul(float *vdst, int N, float alpha);
 void vmul(complex *vdst, int N, double alpha);
 void vmul(complex *vdst, int N, complex alpha);
 
@@ -241,31 +258,47 @@ public:
     {
         m_Vec=0;
         m_iVecSize = 0;
+        m_iCapacity = 0;
         m_iLow = 0;
         m_iHigh = -1;
+        m_bOwner = true;
     };
 
     ~template_1d_array()
     {
-        if(m_Vec)
-        {
-            if( Aligned )
-                ap::afree(m_Vec);
-            else
-                delete[] m_Vec;
-        }
+        release();
     };
 
     template_1d_array(const template_1d_array &rhs)
     {
         m_Vec=0;
         m_iVecSize = 0;
+        m_iCapacity = 0;
         m_iLow = 0;
         m_iHigh = -1;
+        m_bOwner = true;
         if( rhs.m_iVecSize!=0 )
             setcontent(rhs.m_iLow, rhs.m_iHigh, rhs.getcontent());
     };
 
+#if __cplusplus >= 201103L
+    template_1d_array(template_1d_array &&rhs)
+    {
+        m_Vec=0;
+        steal(rhs);
+    };
+
+    template_1d_array& operator=(template_1d_array &&rhs)
+    {
+        if( this!=&rhs )
+        {
+            release();
+            steal(rhs);
+        }
+        return *this;
+    };
+#endif
+
 
     const template_1d_array& operator=(const template_1d_array &rhs)
     {
@@ -276,6 +309,7 @@ public:
             setcontent(rhs.m_iLow, rhs.m_iHigh, rhs.getcontent());
         else
         {
+            release();
             m_Vec=0;
             m_iVecSize = 0;
             m_iLow = 0;
@@ -303,24 +337,27 @@ public:
     };
 
 
+    //
+    // Storage that is owned and large enough is reused, the contents
+    // are zeroed in both cases.
+    //
     void setbounds( int iLow, int iHigh )
     {
-        if(m_Vec)
+        long iSize = iHigh-iLow+1;
+        if( m_Vec==0 || !m_bOwner || iSize>m_iCapacity )
         {
+            release();
             if( Aligned )
-                ap::afree(m_Vec);
+                m_Vec = (T*)ap::amalloc(iSize*sizeof(T), AP_ALIGNMENT);
             else
-                delete[] m_Vec;
+                m_Vec = new T[iSize];
+            m_iCapacity = iSize;
         }
         m_iLow = iLow;
         m_iHigh = iHigh;
-        m_iVecSize = iHigh-iLow+1;
-        if( Aligned )
-            m_Vec = (T*)ap::amalloc(m_iVecSize*sizeof(T), 16);
-        else {
-            m_Vec = new T[m_iVecSize];
-            for (int i = 0; i < m_iVecSize; ++i) m_Vec[i] = 0;
-        }
+        m_iVecSize = iSize;
+        m_bOwner = true;
+        for (long i = 0; i < m_iVecSize; ++i) m_Vec[i] = 0;
     };
 
 
@@ -329,6 +366,25 @@ public:
         setbounds(0, iLen-1);
     }
 
+    //
+    // Use existing storage of iLen elements without copying it, the
+    // array does not take ownership. Index range becomes [0..iLen-1].
+    //
+    void attach(T *pContent, int iLen)
+    {
+        release();
+        m_Vec = pContent;
+        m_iVecSize = iLen;
+        m_iLow = 0;
+        m_iHigh = iLen-1;
+        m_bOwner = false;
+    };
+
+    int getcapacity() const
+    {
+        return m_iCapacity;
+    };
+
 
     void setcontent( int iLow, int iHigh, const T *pContent )
     {
@@ -379,9 +435,44 @@ public:
 private:
     bool wrongIdx(int i) const { return i<m_iLow || i>m_iHigh; };
 
+    void release()
+    {
+        if( m_Vec && m_bOwner )
+        {
+            if( Aligned )
+                ap::afree(m_Vec);
+            else
+                delete[] m_Vec;
+        }
+        m_Vec = 0;
+        m_iCapacity = 0;
+    };
+
+    //
+    // take over the storage of rhs and leave rhs empty, the own storage
+    // must have been released
+    //
+    void steal(template_1d_array &rhs)
+    {
+        m_Vec = rhs.m_Vec;
+        m_iVecSize = rhs.m_iVecSize;
+        m_iCapacity = rhs.m_iCapacity;
+        m_iLow = rhs.m_iLow;
+        m_iHigh = rhs.m_iHigh;
+        m_bOwner = rhs.m_bOwner;
+        rhs.m_Vec = 0;
+        rhs.m_iVecSize = 0;
+        rhs.m_iCapacity = 0;
+        rhs.m_iLow = 0;
+        rhs.m_iHigh = -1;
+        rhs.m_bOwner = true;
+    };
+
     T         *m_Vec;
     long      m_iVecSize;
+    long      m_iCapacity;
     long      m_iLow, m_iHigh;
+    bool      m_bOwner;
 };
 
 
@@ -401,17 +492,15 @@ public:
         m_iHigh1 = -1;
         m_iLow2 = 0;
         m_iHigh2 = -1;
+        m_iConstOffset = 0;
+        m_iLinearMember = 0;
+        m_iCapacity = 0;
+        m_bOwner = true;
     };
 
     ~template_2d_array()
     {
-        if(m_Vec)
-        {
-            if( Aligned )
-                ap::afree(m_Vec);
-            else
-                delete[] m_Vec;
-        }
+        release();
     };
 
     template_2d_array(const template_2d_array &rhs)
@@ -422,15 +511,35 @@ public:
         m_iHigh1 = -1;
         m_iLow2 = 0;
         m_iHigh2 = -1;
+        m_iConstOffset = 0;
+        m_iLinearMember = 0;
+        m_iCapacity = 0;
+        m_bOwner = true;
         if( rhs.m_iVecSize!=0 )
         {
             setbounds(rhs.m_iLow1, rhs.m_iHigh1, rhs.m_iLow2, rhs.m_iHigh2);
-            for(int i=m_iLow1; i<=m_iHigh1; i++)
-                for(int j=m_iLow2; j<=m_iHigh2; j++)
-                    operator()(i,j) = rhs(i,j);
-                //vmove(&(operator()(i,m_iLow2)), &(rhs(i,m_iLow2)), m_iHigh2-m_iLow2+1);
+            copyrows(rhs);
+        }
+    };
+
+#if __cplusplus >= 201103L
+    template_2d_array(template_2d_array &&rhs)
+    {
+        m_Vec=0;
+        steal(rhs);
+    };
+
+    template_2d_array& operator=(template_2d_array &&rhs)
+    {
+        if( this!=&rhs )
+        {
+            release();
+            steal(rhs);
         }
+        return *this;
     };
+#endif
+
     const template_2d_array& operator=(const template_2d_array &rhs)
     {
         if( this==&rhs )
@@ -439,20 +548,11 @@ public:
         if( rhs.m_iVecSize!=0 )
         {
             setbounds(rhs.m_iLow1, rhs.m_iHigh1, rhs.m_iLow2, rhs.m_iHigh2);
-            for(int i=m_iLow1; i<=m_iHigh1; i++)
-                for(int j=m_iLow2; j<=m_iHigh2; j++)
-                    operator()(i,j) = rhs(i,j);
-                //vmove(&(operator()(i,m_iLow2)), &(rhs(i,m_iLow2)), m_iHigh2-m_iLow2+1);
+            copyrows(rhs);
         }
         else
         {
-            if(m_Vec)
-            {
-                if( Aligned )
-                    ap::afree(m_Vec);
-                else
-                    delete[] m_Vec;
-            }
+            release();
             m_Vec=0;
             m_iVecSize=0;
             m_iLow1 = 0;
@@ -481,32 +581,35 @@ public:
         return m_Vec[ m_iConstOffset + i2 +i1*m_iLinearMember];
     };
 
+    //
+    // Storage that is owned and large enough is reused, the contents
+    // are zeroed in both cases.
+    //
     void setbounds( int iLow1, int iHigh1, int iLow2, int iHigh2 )
     {
-        if(m_Vec)
-        {
-            if( Aligned )
-                ap::afree(m_Vec);
-            else
-                delete[] m_Vec;
-        }
         int n1 = iHigh1-iLow1+1;
         int n2 = iHigh2-iLow2+1;
-        m_iVecSize = n1*n2;
         if( Aligned )
         {
-            //if( n2%2!=0 )
-            while( (n2*sizeof(T))%16!=0 )
-            {
+            //
+            // every row starts at an aligned address
+            //
+            while( (n2*sizeof(T))%AP_ALIGNMENT!=0 )
                 n2++;
-                m_iVecSize += n1;
-            }
-            m_Vec = (T*)ap::amalloc(m_iVecSize*sizeof(T), 16);
         }
-        else {
-            m_Vec = new T[m_iVecSize];
-           for (int i = 0; i < m_iVecSize; ++i) m_Vec[i] = 0;
+        long iSize = (long)n1*n2;
+        if( m_Vec==0 || !m_bOwner || iSize>m_iCapacity )
+        {
+            release();
+            if( Aligned )
+                m_Vec = (T*)ap::amalloc(iSize*sizeof(T), AP_ALIGNMENT);
+            else
+                m_Vec = new T[iSize];
+            m_iCapacity = iSize;
         }
+        m_iVecSize = iSize;
+        m_bOwner = true;
+        for (long i = 0; i < m_iVecSize; ++i) m_Vec[i] = 0;
         m_iLow1  = iLow1;
         m_iHigh1 = iHigh1;
         m_iLow2  = iLow2;
@@ -521,13 +624,73 @@ public:
         setbounds(0, iLen1-1, 0, iLen2-1);
     }
 
+    //
+    // Use existing row-major storage of iLen1 rows and iLen2 columns,
+    // with rows iStride elements apart, without copying it. The array
+    // does not take ownership. Index range becomes [0..iLen1-1, 0..iLen2-1].
+    //
+    void attach(T *pContent, int iLen1, int iLen2, int iStride)
+    {
+        release();
+        m_Vec = pContent;
+        m_iVecSize = (long)iLen1*iStride;
+        m_iLow1 = 0;
+        m_iHigh1 = iLen1-1;
+        m_iLow2 = 0;
+        m_iHigh2 = iLen2-1;
+        m_iConstOffset = 0;
+        m_iLinearMember = iStride;
+        m_bOwner = false;
+    };
+
+    //
+    // Same as above, but with arbitrary index bounds. Element (iLow1,iLow2)
+    // is the first element of pContent. This allows e.g. a 1-based view on
+    // a 0-based matrix.
+    //
+    void attach(T *pContent, int iLow1, int iHigh1, int iLow2, int iHigh2, int iStride)
+    {
+        attach(pContent, iHigh1-iLow1+1, iHigh2-iLow2+1, iStride);
+        m_iLow1  = iLow1;
+        m_iHigh1 = iHigh1;
+        m_iLow2  = iLow2;
+        m_iHigh2 = iHigh2;
+        m_iConstOffset = -m_iLow2-(long)m_iLow1*iStride;
+    };
+
+    int getcapacity() const
+    {
+        return m_iCapacity;
+    };
+
+    //
+    // Distance in elements between the starts of two rows (leading dimension)
+    //
+    int getstride() const
+    {
+        return m_iLinearMember;
+    };
+
+    T* getcontent()
+    {
+        return m_Vec;
+    };
+
+    const T* getcontent() const
+    {
+        return m_Vec;
+    };
+
     void setcontent( int iLow1, int iHigh1, int iLow2, int iHigh2, const T *pContent )
     {
         setbounds(iLow1, iHigh1, iLow2, iHigh2);
-        for(int i=m_iLow1; i<=m_iHigh1; i++, pContent += m_iHigh2-m_iLow2+1)
-            for(int j=m_iLow2; j<=m_iHigh2; j++)
-                operator()(i,j) = pContent[j-m_iLow2];
-            //vmove(&(operator()(i,m_iLow2)), pContent, m_iHigh2-m_iLow2+1);
+        int n2 = m_iHigh2-m_iLow2+1;
+        for(int i=m_iLow1; i<=m_iHigh1; i++, pContent += n2)
+        {
+            T *row = &operator()(i,m_iLow2);
+            for(int j=0; j<n2; j++)
+                row[j] = pContent[j];
+        }
     };
 
     int getlowbound(int iBoundNum) const
@@ -575,20 +738,80 @@ private:
     bool wrongRow(int i) const { return i<m_iLow1 || i>m_iHigh1; };
     bool wrongColumn(int j) const { return j<m_iLow2 || j>m_iHigh2; };
 
+    void release()
+    {
+        if( m_Vec && m_bOwner )
+        {
+            if( Aligned )
+                ap::afree(m_Vec);
+            else
+                delete[] m_Vec;
+        }
+        m_Vec = 0;
+        m_iCapacity = 0;
+    };
+
+    //
+    // take over the storage of rhs and leave rhs empty, the own storage
+    // must have been released
+    //
+    void steal(template_2d_array &rhs)
+    {
+        m_Vec = rhs.m_Vec;
+        m_iVecSize = rhs.m_iVecSize;
+        m_iCapacity = rhs.m_iCapacity;
+        m_iLow1 = rhs.m_iLow1;
+        m_iHigh1 = rhs.m_iHigh1;
+        m_iLow2 = rhs.m_iLow2;
+        m_iHigh2 = rhs.m_iHigh2;
+        m_iConstOffset = rhs.m_iConstOffset;
+        m_iLinearMember = rhs.m_iLinearMember;
+        m_bOwner = rhs.m_bOwner;
+        rhs.m_Vec = 0;
+        rhs.m_iVecSize = 0;
+        rhs.m_iCapacity = 0;
+        rhs.m_iLow1 = 0;
+        rhs.m_iHigh1 = -1;
+        rhs.m_iLow2 = 0;
+        rhs.m_iHigh2 = -1;
+        rhs.m_iConstOffset = 0;
+        rhs.m_iLinearMember = 0;
+        rhs.m_bOwner = true;
+    };
+
+    //
+    // copy row by row, the strides of both arrays may differ
+    //
+    void copyrows(const template_2d_array &rhs)
+    {
+        int n2 = m_iHigh2-m_iLow2+1;
+        for(int i=m_iLow1; i<=m_iHigh1; i++)
+        {
+            T *dst = &operator()(i,m_iLow2);
+            const T *src = &rhs(i,m_iLow2);
+            for(int j=0; j<n2; j++)
+                dst[j] = src[j];
+        }
+    };
+
     T           *m_Vec;
     long        m_iVecSize;
     long        m_iLow1, m_iLow2, m_iHigh1, m_iHigh2;
     long        m_iConstOffset, m_iLinearMember;
+    long        m_iCapacity;
+    bool        m_bOwner;
 };
 
 
 typedef template_1d_array<int>          integer_1d_array;
 typedef template_1d_array<double,true>  real_1d_array;
+typedef template_1d_array<float,true>   float_1d_array;
 typedef template_1d_array<complex>      complex_1d_array;
 typedef template_1d_array<bool>         boolean_1d_array;
 
 typedef template_2d_array<int>          integer_2d_array;
 typedef template_2d_array<double,true>  real_2d_array;
+typedef template_2d_array<float,true>   float_2d_array;
 typedef template_2d_array<complex>      complex_2d_array;
 typedef template_2d_array<bool>         boolean_2d_array;
 
@@ -645,6 +868,26 @@ extern const double machineepsilon;
 extern const double maxrealnumber;
 extern const double minrealnumber;
 
+/********************************************************************
+The same constants for the precision T of the routines that are
+instantiated for both float and double
+********************************************************************/
+template<class T> struct realtraits;
+
+template<> struct realtraits<double>
+{
+    static double machineepsilon() { return 5E-16; }
+    static double maxrealnumber()  { return 1E300; }
+    static double minrealnumber()  { return 1E-300; }
+};
+
+template<> struct realtraits<float>
+{
+    static float machineepsilon() { return 3E-7f; }
+    static float maxrealnumber()  { return 1E37f; }
+    static float minrealnumber()  { return 1E-37f; }
+};
+
 int sign(double x);
 double randomreal();
 int randominteger(int maxv);
@@ -0,0 +1,777 @@
+/**
+ * @file apsimd.cpp
+ * @brief SIMD versions of the ap vector primitives, selected at startup
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object against this software used by the military, in the
+ * bio-industry, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2010 Anne van Rossum <anne@almende.com>
+ *
+ * @author 	Anne C. van Rossum
+ * @date	Oct 18, 2026
+ * @project	Replicator FP7
+ * @company	Almende B.V.
+ * @case
+ */
+
+#include "stdafx.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "apsimd.h"
+
+static const ap::ablaskernels generickernels = { "generic", 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AP_SIMD_X86
+#endif
+
+#ifdef AP_SIMD_X86
+#include <immintrin.h>
+
+/********************************************************************
+SSE2, two doubles per register
+********************************************************************/
+#define SSE2 __attribute__((target("sse2")))
+
+SSE2 static double ddot1sse2(const double *a, const double *b, long n)
+{
+    __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+    long i = 0;
+    for(; i+4<=n; i += 4)
+    {
+        s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(a+i), _mm_loadu_pd(b+i)));
+        s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(a+i+2), _mm_loadu_pd(b+i+2)));
+    }
+    s0 = _mm_add_pd(s0, s1);
+    double r[2];
+    _mm_storeu_pd(r, s0);
+    double result = r[0]+r[1];
+    for(; i<n; i++)
+        result += a[i]*b[i];
+    return result;
+}
+
+SSE2 static void dmove1sse2(double *dst, const double *src, long n)
+{
+    long i = 0;
+    for(; i+2<=n; i += 2)
+        _mm_storeu_pd(dst+i, _mm_loadu_pd(src+i));
+    for(; i<n; i++)
+        dst[i] = src[i];
+}
+
+SSE2 static void dmoves1sse2(double *dst, const double *src, long n, double alpha)
+{
+    __m128d va = _mm_set1_pd(alpha);
+    long i = 0;
+    for(; i+2<=n; i += 2)
+        _mm_storeu_pd(dst+i, _mm_mul_pd(va, _mm_loadu_pd(src+i)));
+    for(; i<n; i++)
+        dst[i] = alpha*src[i];
+}
+
+SSE2 static void dmoveneg1sse2(double *dst, const double *src, long n)
+{
+    __m128d zero = _mm_setzero_pd();
+    long i = 0;
+    for(; i+2<=n; i += 2)
+        _mm_storeu_pd(dst+i, _mm_sub_pd(zero, _mm_loadu_pd(src+i)));
+    for(; i<n; i++)
+        dst[i] = -src[i];
+}
+
+SSE2 static void dadd1sse2(double *dst, const double *src, long n)
+{
+    long i = 0;
+    for(; i+2<=n; i += 2)
+        _mm_storeu_pd(dst+i, _mm_add_pd(_mm_loadu_pd(dst+i), _mm_loadu_pd(src+i)));
+    for(; i<n; i++)
+        dst[i] += src[i];
+}
+
+SSE2 static void dadds1sse2(double *dst, const double *src, long n, double alpha)
+{
+    __m128d va = _mm_set1_pd(alpha);
+    long i = 0;
+    for(; i+2<=n; i += 2)
+        _mm_storeu_pd(dst+i, _mm_add_pd(_mm_loadu_pd(dst+i), _mm_mul_pd(va, _mm_loadu_pd(src+i))));
+    for(; i<n; i++)
+        dst[i] += alpha*src[i];
+}
+
+SSE2 static void dsub1sse2(double *dst, const double *src, long n)
+{
+    long i = 0;
+    for(; i+2<=n; i += 2)
+        _mm_storeu_pd(dst+i, _mm_sub_pd(_mm_loadu_pd(dst+i), _mm_loadu_pd(src+i)));
+    for(; i<n; i++)
+        dst[i] -= src[i];
+}
+
+SSE2 static void dmuls1sse2(double *dst, long n, double alpha)
+{
+    __m128d va = _mm_set1_pd(alpha);
+    long i = 0;
+    for(; i+2<=n; i += 2)
+        _mm_storeu_pd(dst+i, _mm_mul_pd(va, _mm_loadu_pd(dst+i)));
+    for(; i<n; i++)
+        dst[i] *= alpha;
+}
+
+SSE2 static void drot1sse2(double *x, double *y, long n, double c, double s)
+{
+    __m128d vc = _mm_set1_pd(c), vs = _mm_set1_pd(s);
+    long i = 0;
+    for(; i+2<=n; i += 2)
+    {
+        __m128d vx = _mm_loadu_pd(x+i), vy = _mm_loadu_pd(y+i);
+        _mm_storeu_pd(x+i, _mm_add_pd(_mm_mul_pd(vc, vx), _mm_mul_pd(vs, vy)));
+        _mm_storeu_pd(y+i, _mm_sub_pd(_mm_mul_pd(vc, vy), _mm_mul_pd(vs, vx)));
+    }
+    for(; i<n; i++)
+    {
+        double t = y[i];
+        y[i] = c*t-s*x[i];
+        x[i] = c*x[i]+s*t;
+    }
+}
+
+SSE2 static float sdot1sse2(const float *a, const float *b, long n)
+{
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+    long i = 0;
+    for(; i+8<=n; i += 8)
+    {
+        s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a+i+4), _mm_loadu_ps(b+i+4)));
+    }
+    s0 = _mm_add_ps(s0, s1);
+    float r[4];
+    _mm_storeu_ps(r, s0);
+    float result = (r[0]+r[1])+(r[2]+r[3]);
+    for(; i<n; i++)
+        result += a[i]*b[i];
+    return result;
+}
+
+SSE2 static void sadds1sse2(float *dst, const float *src, long n, float alpha)
+{
+    __m128 va = _mm_set1_ps(alpha);
+    long i = 0;
+    for(; i+4<=n; i += 4)
+        _mm_storeu_ps(dst+i, _mm_add_ps(_mm_loadu_ps(dst+i), _mm_mul_ps(va, _mm_loadu_ps(src+i))));
+    for(; i<n; i++)
+        dst[i] += alpha*src[i];
+}
+
+SSE2 static void smuls1sse2(float *dst, long n, float alpha)
+{
+    __m128 va = _mm_set1_ps(alpha);
+    long i = 0;
+    for(; i+4<=n; i += 4)
+        _mm_storeu_ps(dst+i, _mm_mul_ps(va, _mm_loadu_ps(dst+i)));
+    for(; i<n; i++)
+        dst[i] *= alpha;
+}
+
+SSE2 static void srot1sse2(float *x, float *y, long n, float c, float s)
+{
+    __m128 vc = _mm_set1_ps(c), vs = _mm_set1_ps(s);
+    long i = 0;
+    for(; i+4<=n; i += 4)
+    {
+        __m128 vx = _mm_loadu_ps(x+i), vy = _mm_loadu_ps(y+i);
+        _mm_storeu_ps(x+i, _mm_add_ps(_mm_mul_ps(vc, vx), _mm_mul_ps(vs, vy)));
+        _mm_storeu_ps(y+i, _mm_sub_ps(_mm_mul_ps(vc, vy), _mm_mul_ps(vs, vx)));
+    }
+    for(; i<n; i++)
+    {
+        float t = y[i];
+        y[i] = c*t-s*x[i];
+        x[i] = c*x[i]+s*t;
+    }
+}
+
+//
+// The generic GEMM micro-kernels are already written for SSE2
+//
+static const ap::ablaskernels sse2kernels = { "sse2", ddot1sse2, dmove1sse2, dmoves1sse2,
+    dmoveneg1sse2, dadd1sse2, dadds1sse2, dsub1sse2, dmuls1sse2, drot1sse2, 0, 0, 0,
+    sdot1sse2, sadds1sse2, smuls1sse2, srot1sse2, 0, 0, 0 };
+
+/********************************************************************
+AVX2 with FMA, four doubles per register
+********************************************************************/
+#define AVX2 __attribute__((target("avx2,fma")))
+
+AVX2 static double ddot1avx2(const double *a, const double *b, long n)
+{
+    __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+    __m256d s2 = _mm256_setzero_pd(), s3 = _mm256_setzero_pd();
+    long i = 0;
+    for(; i+16<=n; i += 16)
+    {
+        s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a+i), _mm256_loadu_pd(b+i), s0);
+        s1 = _mm256_fmadd_pd(_mm256_loadu_pd(a+i+4), _mm256_loadu_pd(b+i+4), s1);
+        s2 = _mm256_fmadd_pd(_mm256_loadu_pd(a+i+8), _mm256_loadu_pd(b+i+8), s2);
+        s3 = _mm256_fmadd_pd(_mm256_loadu_pd(a+i+12), _mm256_loadu_pd(b+i+12), s3);
+    }
+    for(; i+4<=n; i += 4)
+        s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a+i), _mm256_loadu_pd(b+i), s0);
+    s0 = _mm256_add_pd(_mm256_add_pd(s0, s1), _mm256_add_pd(s2, s3));
+    __m128d h = _mm_add_pd(_mm256_castpd256_pd128(s0), _mm256_extractf128_pd(s0, 1));
+    double result = _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+    for(; i<n; i++)
+        result += a[i]*b[i];
+    return result;
+}
+
+AVX2 static void dmove1avx2(double *dst, const double *src, long n)
+{
+    long i = 0;
+    for(; i+4<=n; i += 4)
+        _mm256_storeu_pd(dst+i, _mm256_loadu_pd(src+i));
+    for(; i<n; i++)
+        dst[i] = src[i];
+}
+
+AVX2 static void dmoves1avx2(double *dst, const double *src, long n, double alpha)
+{
+    __m256d va = _mm256_set1_pd(alpha);
+    long i = 0;
+    for(; i+4<=n; i += 4)
+        _mm256_storeu_pd(dst+i, _mm256_mul_pd(va, _mm256_loadu_pd(src+i)));
+    for(; i<n; i++)
+        dst[i] = alpha*src[i];
+}
+
+AVX2 static void dmoveneg1avx2(double *dst, const double *src, long n)
+{
+    __m256d zero = _mm256_setzero_pd();
+    long i = 0;
+    for(; i+4<=n; i += 4)
+        _mm256_storeu_pd(dst+i, _mm256_sub_pd(zero, _mm256_loadu_pd(src+i)));
+    for(; i<n; i++)
+        dst[i] = -src[i];
+}
+
+AVX2 static void dadd1avx2(double *dst, const double *src, long n)
+{
+    long i = 0;
+    for(; i+4<=n; i += 4)
+        _mm256_storeu_pd(dst+i, _mm256_add_pd(_mm256_loadu_pd(dst+i), _mm256_loadu_pd(src+i)));
+    for(; i<n; i++)
+        dst[i] += src[i];
+}
+
+AVX2 static void dadds1avx2(double *dst, const double *src, long n, double alpha)
+{
+    __m256d va = _mm256_set1_pd(alpha);
+    long i = 0;
+    for(; i+4<=n; i += 4)
+        _mm256_storeu_pd(dst+i, _mm256_fmadd_pd(va, _mm256_loadu_pd(src+i), _mm256_loadu_pd(dst+i)));
+    for(; i<n; i++)
+        dst[i] = fma(alpha, src[i], dst[i]);
+}
+
+AVX2 static void dsub1avx2(double *dst, const double *src, long n)
+{
+    long i = 0;
+    for(; i+4<=n; i += 4)
+        _mm256_storeu_pd(dst+i, _mm256_sub_pd(_mm256_loadu_pd(dst+i), _mm256_loadu_pd(src+i)));
+    for(; i<n; i++)
+        dst[i] -= src[i];
+}
+
+AVX2 static void dmuls1avx2(double *dst, long n, double alpha)
+{
+    __m256d va = _mm256_set1_pd(alpha);
+    long i = 0;
+    for(; i+4<=n; i += 4)
+        _mm256_storeu_pd(dst+i, _mm256_mul_pd(va, _mm256_loadu_pd(dst+i)));
+    for(; i<n; i++)
+        dst[i] *= alpha;
+}
+
+AVX2 static void drot1avx2(double *x, double *y, long n, double c, double s)
+{
+    __m256d vc = _mm256_set1_pd(c), vs = _mm256_set1_pd(s);
+    long i = 0;
+    for(; i+4<=n; i += 4)
+    {
+        __m256d vx = _mm256_loadu_pd(x+i), vy = _mm256_loadu_pd(y+i);
+        _mm256_storeu_pd(x+i, _mm256_fmadd_pd(vs, vy, _mm256_mul_pd(vc, vx)));
+        _mm256_storeu_pd(y+i, _mm256_fnmadd_pd(vs, vx, _mm256_mul_pd(vc, vy)));
+    }
+    for(; i<n; i++)
+    {
+        double t = y[i];
+        y[i] = fma(-s, x[i], c*t);
+        x[i] = fma(s, t, c*x[i]);
+    }
+}
+
+//
+// 6x8 block of C in twelve registers, two for the row of B and one for
+// the broadcast element of A
+//
+#define DGEMMAVX2ROW(i) \
+    ai = _mm256_broadcast_sd(pa+i); \
+    c##i##0 = _mm256_fmadd_pd(ai, b0, c##i##0); \
+    c##i##1 = _mm256_fmadd_pd(ai, b1, c##i##1);
+#define DGEMMAVX2STORE(i) \
+    _mm256_storeu_pd(c+i*ldc, _mm256_fmadd_pd(va, c##i##0, _mm256_loadu_pd(c+i*ldc))); \
+    _mm256_storeu_pd(c+i*ldc+4, _mm256_fmadd_pd(va, c##i##1, _mm256_loadu_pd(c+i*ldc+4)));
+
+AVX2 static void dgemm1avx2(long kc, double alpha, const double *pa, const double *pb, double *c, long ldc)
+{
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+    __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+    __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+    __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+    __m256d c40 = _mm256_setzero_pd(), c41 = _mm256_setzero_pd();
+    __m256d c50 = _mm256_setzero_pd(), c51 = _mm256_setzero_pd();
+    __m256d ai;
+    for(long p = 0; p<kc; p++, pa += 6, pb += 8)
+    {
+        __m256d b0 = _mm256_loadu_pd(pb);
+        __m256d b1 = _mm256_loadu_pd(pb+4);
+        DGEMMAVX2ROW(0) DGEMMAVX2ROW(1) DGEMMAVX2ROW(2)
+        DGEMMAVX2ROW(3) DGEMMAVX2ROW(4) DGEMMAVX2ROW(5)
+    }
+    __m256d va = _mm256_set1_pd(alpha);
+    DGEMMAVX2STORE(0) DGEMMAVX2STORE(1) DGEMMAVX2STORE(2)
+    DGEMMAVX2STORE(3) DGEMMAVX2STORE(4) DGEMMAVX2STORE(5)
+}
+
+AVX2 static float sdot1avx2(const float *a, const float *b, long n)
+{
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    __m256 s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+    long i = 0;
+    for(; i+32<=n; i += 32)
+    {
+        s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i), s0);
+        s1 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i+8), _mm256_loadu_ps(b+i+8), s1);
+        s2 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i+16), _mm256_loadu_ps(b+i+16), s2);
+        s3 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i+24), _mm256_loadu_ps(b+i+24), s3);
+    }
+    for(; i+8<=n; i += 8)
+        s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i), s0);
+    s0 = _mm256_add_ps(_mm256_add_ps(s0, s1), _mm256_add_ps(s2, s3));
+    __m128 h = _mm_add_ps(_mm256_castps256_ps128(s0), _mm256_extractf128_ps(s0, 1));
+    h = _mm_add_ps(h, _mm_movehl_ps(h, h));
+    float result = _mm_cvtss_f32(_mm_add_ss(h, _mm_shuffle_ps(h, h, 1)));
+    for(; i<n; i++)
+        result += a[i]*b[i];
+    return result;
+}
+
+AVX2 static void sadds1avx2(float *dst, const float *src, long n, float alpha)
+{
+    __m256 va = _mm256_set1_ps(alpha);
+    long i = 0;
+    for(; i+8<=n; i += 8)
+        _mm256_storeu_ps(dst+i, _mm256_fmadd_ps(va, _mm256_loadu_ps(src+i), _mm256_loadu_ps(dst+i)));
+    for(; i<n; i++)
+        dst[i] = fmaf(alpha, src[i], dst[i]);
+}
+
+AVX2 static void smuls1avx2(float *dst, long n, float alpha)
+{
+    __m256 va = _mm256_set1_ps(alpha);
+    long i = 0;
+    for(; i+8<=n; i += 8)
+        _mm256_storeu_ps(dst+i, _mm256_mul_ps(va, _mm256_loadu_ps(dst+i)));
+    for(; i<n; i++)
+        dst[i] *= alpha;
+}
+
+AVX2 static void srot1avx2(float *x, float *y, long n, float c, float s)
+{
+    __m256 vc = _mm256_set1_ps(c), vs = _mm256_set1_ps(s);
+    long i = 0;
+    for(; i+8<=n; i += 8)
+    {
+        __m256 vx = _mm256_loadu_ps(x+i), vy = _mm256_loadu_ps(y+i);
+        _mm256_storeu_ps(x+i, _mm256_fmadd_ps(vs, vy, _mm256_mul_ps(vc, vx)));
+        _mm256_storeu_ps(y+i, _mm256_fnmadd_ps(vs, vx, _mm256_mul_ps(vc, vy)));
+    }
+    for(; i<n; i++)
+    {
+        float t = y[i];
+        y[i] = fmaf(-s, x[i], c*t);
+        x[i] = fmaf(s, t, c*x[i]);
+    }
+}
+
+//
+// 6x16 block of C, the single precision layout of dgemm1avx2
+//
+#define SGEMMAVX2ROW(i) \
+    ai = _mm256_broadcast_ss(pa+i); \
+    c##i##0 = _mm256_fmadd_ps(ai, b0, c##i##0); \
+    c##i##1 = _mm256_fmadd_ps(ai, b1, c##i##1);
+#define SGEMMAVX2STORE(i) \
+    _mm256_storeu_ps(c+i*ldc, _mm256_fmadd_ps(va, c##i##0, _mm256_loadu_ps(c+i*ldc))); \
+    _mm256_storeu_ps(c+i*ldc+8, _mm256_fmadd_ps(va, c##i##1, _mm256_loadu_ps(c+i*ldc+8)));
+
+AVX2 static void sgemm1avx2(long kc, float alpha, const float *pa, const float *pb, float *c, long ldc)
+{
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+    __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+    __m256 ai;
+    for(long p = 0; p<kc; p++, pa += 6, pb += 16)
+    {
+        __m256 b0 = _mm256_loadu_ps(pb);
+        __m256 b1 = _mm256_loadu_ps(pb+8);
+        SGEMMAVX2ROW(0) SGEMMAVX2ROW(1) SGEMMAVX2ROW(2)
+        SGEMMAVX2ROW(3) SGEMMAVX2ROW(4) SGEMMAVX2ROW(5)
+    }
+    __m256 va = _mm256_set1_ps(alpha);
+    SGEMMAVX2STORE(0) SGEMMAVX2STORE(1) SGEMMAVX2STORE(2)
+    SGEMMAVX2STORE(3) SGEMMAVX2STORE(4) SGEMMAVX2STORE(5)
+}
+
+static const ap::ablaskernels avx2kernels = { "avx2", ddot1avx2, dmove1avx2, dmoves1avx2,
+    dmoveneg1avx2, dadd1avx2, dadds1avx2, dsub1avx2, dmuls1avx2, drot1avx2, dgemm1avx2, 6, 8,
+    sdot1avx2, sadds1avx2, smuls1avx2, srot1avx2, sgemm1avx2, 6, 16 };
+
+/********************************************************************
+AVX-512F, eight doubles per register, the tail is handled with a mask
+********************************************************************/
+#define AVX512 __attribute__((target("avx512f")))
+
+AVX512 static inline __mmask8 tailmask(long r)
+{
+    return (__mmask8)((1u<<r)-1);
+}
+
+AVX512 static inline __mmask16 tailmask16(long r)
+{
+    return (__mmask16)((1u<<r)-1);
+}
+
+AVX512 static double ddot1avx512(const double *a, const double *b, long n)
+{
+    __m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd();
+    long i = 0;
+    for(; i+16<=n; i += 16)
+    {
+        s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a+i), _mm512_loadu_pd(b+i), s0);
+        s1 = _mm512_fmadd_pd(_mm512_loadu_pd(a+i+8), _mm512_loadu_pd(b+i+8), s1);
+    }
+    for(; i+8<=n; i += 8)
+        s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a+i), _mm512_loadu_pd(b+i), s0);
+    if( i<n )
+    {
+        __mmask8 m = tailmask(n-i);
+        s1 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(m, a+i), _mm512_maskz_loadu_pd(m, b+i), s1);
+    }
+    return _mm512_reduce_add_pd(_mm512_add_pd(s0, s1));
+}
+
+AVX512 static void dmove1avx512(double *dst, const double *src, long n)
+{
+    long i = 0;
+    for(; i+8<=n; i += 8)
+        _mm512_storeu_pd(dst+i, _mm512_loadu_pd(src+i));
+    if( i<n )
+    {
+        __mmask8 m = tailmask(n-i);
+        _mm512_mask_storeu_pd(dst+i, m, _mm512_maskz_loadu_pd(m, src+i));
+    }
+}
+
+AVX512 static void dmoves1avx512(double *dst, const double *src, long n, double alpha)
+{
+    __m512d va = _mm512_set1_pd(alpha);
+    long i = 0;
+    for(; i+8<=n; i += 8)
+        _mm512_storeu_pd(dst+i, _mm512_mul_pd(va, _mm512_loadu_pd(src+i)));
+    if( i<n )
+    {
+        __mmask8 m = tailmask(n-i);
+        _mm512_mask_storeu_pd(dst+i, m, _mm512_mul_pd(va, _mm512_maskz_loadu_pd(m, src+i)));
+    }
+}
+
+AVX512 static void dmoveneg1avx512(double *dst, const double *src, long n)
+{
+    __m512d zero = _mm512_setzero_pd();
+    long i = 0;
+    for(; i+8<=n; i += 8)
+        _mm512_storeu_pd(dst+i, _mm512_sub_pd(zero, _mm512_loadu_pd(src+i)));
+    if( i<n )
+    {
+        __mmask8 m = tailmask(n-i);
+        _mm512_mask_storeu_pd(dst+i, m, _mm512_sub_pd(zero, _mm512_maskz_loadu_pd(m, src+i)));
+    }
+}
+
+AVX512 static void dadd1avx512(double *dst, const double *src, long n)
+{
+    long i = 0;
+    for(; i+8<=n; i += 8)
+        _mm512_storeu_pd(dst+i, _mm512_add_pd(_mm512_loadu_pd(dst+i), _mm512_loadu_pd(src+i)));
+    if( i<n )
+    {
+        __mmask8 m = tailmask(n-i);
+        _mm512_mask_storeu_pd(dst+i, m, _mm512_add_pd(_mm512_maskz_loadu_pd(m, dst+i), _mm512_maskz_loadu_pd(m, src+i)));
+    }
+}
+
+AVX512 static void dadds1avx512(double *dst, const double *src, long n, double alpha)
+{
+    __m512d va = _mm512_set1_pd(alpha);
+    long i = 0;
+    for(; i+8<=n; i += 8)
+        _mm512_storeu_pd(dst+i, _mm512_fmadd_pd(va, _mm512_loadu_pd(src+i), _mm512_loadu_pd(dst+i)));
+    if( i<n )
+    {
+        __mmask8 m = tailmask(n-i);
+        _mm512_mask_storeu_pd(dst+i, m, _mm512_fmadd_pd(va, _mm512_maskz_loadu_pd(m, src+i), _mm512_maskz_loadu_pd(m, dst+i)));
+    }
+}
+
+AVX512 static void dsub1avx512(double *dst, const double *src, long n)
+{
+    long i = 0;
+    for(; i+8<=n; i += 8)
+        _mm512_storeu_pd(dst+i, _mm512_sub_pd(_mm512_loadu_pd(dst+i), _mm512_loadu_pd(src+i)));
+    if( i<n )
+    {
+        __mmask8 m = tailmask(n-i);
+        _mm512_mask_storeu_pd(dst+i, m, _mm512_sub_pd(_mm512_maskz_loadu_pd(m, dst+i), _mm512_maskz_loadu_pd(m, src+i)));
+    }
+}
+
+AVX512 static void dmuls1avx512(double *dst, long n, double alpha)
+{
+    __m512d va = _mm512_set1_pd(alpha);
+    long i = 0;
+    for(; i+8<=n; i += 8)
+        _mm512_storeu_pd(dst+i, _mm512_mul_pd(va, _mm512_loadu_pd(dst+i)));
+    if( i<n )
+    {
+        __mmask8 m = tailmask(n-i);
+        _mm512_mask_storeu_pd(dst+i, m, _mm512_mul_pd(va, _mm512_maskz_loadu_pd(m, dst+i)));
+    }
+}
+
+AVX512 static void drot1avx512(double *x, double *y, long n, double c, double s)
+{
+    __m512d vc = _mm512_set1_pd(c), vs = _mm512_set1_pd(s);
+    long i = 0;
+    for(; i+8<=n; i += 8)
+    {
+        __m512d vx = _mm512_loadu_pd(x+i), vy = _mm512_loadu_pd(y+i);
+        _mm512_storeu_pd(x+i, _mm512_fmadd_pd(vs, vy, _mm512_mul_pd(vc, vx)));
+        _mm512_storeu_pd(y+i, _mm512_fnmadd_pd(vs, vx, _mm512_mul_pd(vc, vy)));
+    }
+    if( i<n )
+    {
+        __mmask8 m = tailmask(n-i);
+        __m512d vx = _mm512_maskz_loadu_pd(m, x+i), vy = _mm512_maskz_loadu_pd(m, y+i);
+        _mm512_mask_storeu_pd(x+i, m, _mm512_fmadd_pd(vs, vy, _mm512_mul_pd(vc, vx)));
+        _mm512_mask_storeu_pd(y+i, m, _mm512_fnmadd_pd(vs, vx, _mm512_mul_pd(vc, vy)));
+    }
+}
+
+//
+// 8x16 block of C in sixteen registers
+//
+#define DGEMMAVX512ROW(i) \
+    ai = _mm512_set1_pd(pa[i]); \
+    c##i##0 = _mm512_fmadd_pd(ai, b0, c##i##0); \
+    c##i##1 = _mm512_fmadd_pd(ai, b1, c##i##1);
+#define DGEMMAVX512STORE(i) \
+    _mm512_storeu_pd(c+i*ldc, _mm512_fmadd_pd(va, c##i##0, _mm512_loadu_pd(c+i*ldc))); \
+    _mm512_storeu_pd(c+i*ldc+8, _mm512_fmadd_pd(va, c##i##1, _mm512_loadu_pd(c+i*ldc+8)));
+
+AVX512 static void dgemm1avx512(long kc, double alpha, const double *pa, const double *pb, double *c, long ldc)
+{
+    __m512d c00 = _mm512_setzero_pd(), c01 = _mm512_setzero_pd();
+    __m512d c10 = _mm512_setzero_pd(), c11 = _mm512_setzero_pd();
+    __m512d c20 = _mm512_setzero_pd(), c21 = _mm512_setzero_pd();
+    __m512d c30 = _mm512_setzero_pd(), c31 = _mm512_setzero_pd();
+    __m512d c40 = _mm512_setzero_pd(), c41 = _mm512_setzero_pd();
+    __m512d c50 = _mm512_setzero_pd(), c51 = _mm512_setzero_pd();
+    __m512d c60 = _mm512_setzero_pd(), c61 = _mm512_setzero_pd();
+    __m512d c70 = _mm512_setzero_pd(), c71 = _mm512_setzero_pd();
+    __m512d ai;
+    for(long p = 0; p<kc; p++, pa += 8, pb += 16)
+    {
+        __m512d b0 = _mm512_loadu_pd(pb);
+        __m512d b1 = _mm512_loadu_pd(pb+8);
+        DGEMMAVX512ROW(0) DGEMMAVX512ROW(1) DGEMMAVX512ROW(2) DGEMMAVX512ROW(3)
+        DGEMMAVX512ROW(4) DGEMMAVX512ROW(5) DGEMMAVX512ROW(6) DGEMMAVX512ROW(7)
+    }
+    __m512d va = _mm512_set1_pd(alpha);
+    DGEMMAVX512STORE(0) DGEMMAVX512STORE(1) DGEMMAVX512STORE(2) DGEMMAVX512STORE(3)
+    DGEMMAVX512STORE(4) DGEMMAVX512STORE(5) DGEMMAVX512STORE(6) DGEMMAVX512STORE(7)
+}
+
+AVX512 static float sdot1avx512(const float *a, const float *b, long n)
+{
+    __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+    long i = 0;
+    for(; i+32<=n; i += 32)
+    {
+        s0 = _mm512_fmadd_ps(_mm512_loadu_ps(a+i), _mm512_loadu_ps(b+i), s0);
+        s1 = _mm512_fmadd_ps(_mm512_loadu_ps(a+i+16), _mm512_loadu_ps(b+i+16), s1);
+    }
+    for(; i+16<=n; i += 16)
+        s0 = _mm512_fmadd_ps(_mm512_loadu_ps(a+i), _mm512_loadu_ps(b+i), s0);
+    if( i<n )
+    {
+        __mmask16 m = tailmask16(n-i);
+        s1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, a+i), _mm512_maskz_loadu_ps(m, b+i), s1);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(s0, s1));
+}
+
+AVX512 static void sadds1avx512(float *dst, const float *src, long n, float alpha)
+{
+    __m512 va = _mm512_set1_ps(alpha);
+    long i = 0;
+    for(; i+16<=n; i += 16)
+        _mm512_storeu_ps(dst+i, _mm512_fmadd_ps(va, _mm512_loadu_ps(src+i), _mm512_loadu_ps(dst+i)));
+    if( i<n )
+    {
+        __mmask16 m = tailmask16(n-i);
+        _mm512_mask_storeu_ps(dst+i, m, _mm512_fmadd_ps(va, _mm512_maskz_loadu_ps(m, src+i), _mm512_maskz_loadu_ps(m, dst+i)));
+    }
+}
+
+AVX512 static void smuls1avx512(float *dst, long n, float alpha)
+{
+    __m512 va = _mm512_set1_ps(alpha);
+    long i = 0;
+    for(; i+16<=n; i += 16)
+        _mm512_storeu_ps(dst+i, _mm512_mul_ps(va, _mm512_loadu_ps(dst+i)));
+    if( i<n )
+    {
+        __mmask16 m = tailmask16(n-i);
+        _mm512_mask_storeu_ps(dst+i, m, _mm512_mul_ps(va, _mm512_maskz_loadu_ps(m, dst+i)));
+    }
+}
+
+AVX512 static void srot1avx512(float *x, float *y, long n, float c, float s)
+{
+    __m512 vc = _mm512_set1_ps(c), vs = _mm512_set1_ps(s);
+    long i = 0;
+    for(; i+16<=n; i += 16)
+    {
+        __m512 vx = _mm512_loadu_ps(x+i), vy = _mm512_loadu_ps(y+i);
+        _mm512_storeu_ps(x+i, _mm512_fmadd_ps(vs, vy, _mm512_mul_ps(vc, vx)));
+        _mm512_storeu_ps(y+i, _mm512_fnmadd_ps(vs, vx, _mm512_mul_ps(vc, vy)));
+    }
+    if( i<n )
+    {
+        __mmask16 m = tailmask16(n-i);
+        __m512 vx = _mm512_maskz_loadu_ps(m, x+i), vy = _mm512_maskz_loadu_ps(m, y+i);
+        _mm512_mask_storeu_ps(x+i, m, _mm512_fmadd_ps(vs, vy, _mm512_mul_ps(vc, vx)));
+        _mm512_mask_storeu_ps(y+i, m, _mm512_fnmadd_ps(vs, vx, _mm512_mul_ps(vc, vy)));
+    }
+}
+
+//
+// 8x32 block of C, the single precision layout of dgemm1avx512
+//
+#define SGEMMAVX512ROW(i) \
+    ai = _mm512_set1_ps(pa[i]); \
+    c##i##0 = _mm512_fmadd_ps(ai, b0, c##i##0); \
+    c##i##1 = _mm512_fmadd_ps(ai, b1, c##i##1);
+#define SGEMMAVX512STORE(i) \
+    _mm512_storeu_ps(c+i*ldc, _mm512_fmadd_ps(va, c##i##0, _mm512_loadu_ps(c+i*ldc))); \
+    _mm512_storeu_ps(c+i*ldc+16, _mm512_fmadd_ps(va, c##i##1, _mm512_loadu_ps(c+i*ldc+16)));
+
+AVX512 static void sgemm1avx512(long kc, float alpha, const float *pa, const float *pb, float *c, long ldc)
+{
+    __m512 c00 = _mm512_setzero_ps(), c01 = _mm512_setzero_ps();
+    __m512 c10 = _mm512_setzero_ps(), c11 = _mm512_setzero_ps();
+    __m512 c20 = _mm512_setzero_ps(), c21 = _mm512_setzero_ps();
+    __m512 c30 = _mm512_setzero_ps(), c31 = _mm512_setzero_ps();
+    __m512 c40 = _mm512_setzero_ps(), c41 = _mm512_setzero_ps();
+    __m512 c50 = _mm512_setzero_ps(), c51 = _mm512_setzero_ps();
+    __m512 c60 = _mm512_setzero_ps(), c61 = _mm512_setzero_ps();
+    __m512 c70 = _mm512_setzero_ps(), c71 = _mm512_setzero_ps();
+    __m512 ai;
+    for(long p = 0; p<kc; p++, pa += 8, pb += 32)
+    {
+        __m512 b0 = _mm512_loadu_ps(pb);
+        __m512 b1 = _mm512_loadu_ps(pb+16);
+        SGEMMAVX512ROW(0) SGEMMAVX512ROW(1) SGEMMAVX512ROW(2) SGEMMAVX512ROW(3)
+        SGEMMAVX512ROW(4) SGEMMAVX512ROW(5) SGEMMAVX512ROW(6) SGEMMAVX512ROW(7)
+    }
+    __m512 va = _mm512_set1_ps(alpha);
+    SGEMMAVX512STORE(0) SGEMMAVX512STORE(1) SGEMMAVX512STORE(2) SGEMMAVX512STORE(3)
+    SGEMMAVX512STORE(4) SGEMMAVX512STORE(5) SGEMMAVX512STORE(6) SGEMMAVX512STORE(7)
+}
+
+static const ap::ablaskernels avx512kernels = { "avx512", ddot1avx512, dmove1avx512, dmoves1avx512,
+    dmoveneg1avx512, dadd1avx512, dadds1avx512, dsub1avx512, dmuls1avx512, drot1avx512, dgemm1avx512, 8, 16,
+    sdot1avx512, sadds1avx512, smuls1avx512, srot1avx512, sgemm1avx512, 8, 32 };
+
+#endif
+
+
+static const ap::ablaskernels& ablasdetect()
+{
+#ifdef AP_SIMD_X86
+    //
+    // Widest set the CPU (and OS) supports, the environment may only
+    // narrow it down
+    //
+    int level = 0;
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports("sse2") )
+        level = 1;
+    if( level==1 && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") )
+        level = 2;
+    if( level==2 && __builtin_cpu_supports("avx512f") )
+        level = 3;
+
+    const char *env = getenv("AP_SIMD");
+    if( env!=NULL )
+    {
+        int requested = level;
+        if( strcmp(env, "generic")==0 ) requested = 0;
+        if( strcmp(env, "sse2")==0 )    requested = 1;
+        if( strcmp(env, "avx2")==0 )    requested = 2;
+        if( strcmp(env, "avx512")==0 )  requested = 3;
+        if( requested<level )
+            level = requested;
+    }
+    switch( level )
+    {
+    case 3:
+        return avx512kernels;
+    case 2:
+        return avx2kernels;
+    case 1:
+        return sse2kernels;
+    }
+#endif
+    return generickernels;
+}
+
+
+const ap::ablaskernels& ap::ablasselect()
+{
+    static const ap::ablaskernels& selected = ablasdetect();
+    return selected;
+}
@@ -0,0 +1,93 @@
+/**
+ * @file apsimd.h
+ * @brief SIMD versions of the ap vector primitives, selected at startup
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object against this software used by the military, in the
+ * bio-industry, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2010 Anne van Rossum <anne@almende.com>
+ *
+ * @author 	Anne C. van Rossum
+ * @date	Oct 18, 2026
+ * @project	Replicator FP7
+ * @company	Almende B.V.
+ * @case
+ */
+
+#ifndef _apsimd_h
+#define _apsimd_h
+
+namespace ap
+{
+
+/********************************************************************
+Implementations of the ABLAS hooks in ap.cpp (the same functions the
+ablas.dll of the Windows build provides):
+
+    ddot1       -   dot product
+    dmove1      -   dst := src
+    dmoves1     -   dst := alpha*src
+    dmoveneg1   -   dst := -src
+    dadd1       -   dst := dst + src
+    dadds1      -   dst := dst + alpha*src
+    dsub1       -   dst := dst - src
+    dmuls1      -   dst := alpha*dst
+    drot1       -   (x, y) := (c*x + s*y, c*y - s*x), a plane rotation of
+                    two rows
+    sdot1, sadds1, smuls1, srot1
+                -   single precision ddot1, dadds1, dmuls1 and drot1
+
+and the micro-kernels of RMatrixGEMM (gemm.cpp):
+
+    dgemm1      -   C := C + alpha*A*B for an MRxKC sliver A (packed
+                    column by column) and a KCxNR sliver B (packed row
+                    by row), with C an MRxNR block with rows LDC apart
+    dgemmmr, dgemmnr
+                -   MR and NR of dgemm1
+    sgemm1, sgemmmr, sgemmnr
+                -   the same in single precision
+
+A member is NULL if the generic template should be used.
+********************************************************************/
+struct ablaskernels
+{
+    const char *name;
+    double (*ddot1)(const double*, const double*, long);
+    void (*dmove1)(double*, const double*, long);
+    void (*dmoves1)(double*, const double*, long, double);
+    void (*dmoveneg1)(double*, const double*, long);
+    void (*dadd1)(double*, const double*, long);
+    void (*dadds1)(double*, const double*, long, double);
+    void (*dsub1)(double*, const double*, long);
+    void (*dmuls1)(double*, long, double);
+    void (*drot1)(double*, double*, long, double, double);
+    void (*dgemm1)(long, double, const double*, const double*, double*, long);
+    int dgemmmr;
+    int dgemmnr;
+    float (*sdot1)(const float*, const float*, long);
+    void (*sadds1)(float*, const float*, long, float);
+    void (*smuls1)(float*, long, float);
+    void (*srot1)(float*, float*, long, float, float);
+    void (*sgemm1)(long, float, const float*, const float*, float*, long);
+    int sgemmmr;
+    int sgemmnr;
+};
+
+/********************************************************************
+Kernels for the widest instruction set of this CPU (SSE2, AVX2 with FMA
+or AVX-512F), determined with cpuid on the first call. The environment
+variable AP_SIMD (generic, sse2, avx2 or avx512) selects a narrower set,
+e.g. for benchmarking.
+********************************************************************/
+const ablaskernels& ablasselect();
+
+}
+
+#endif
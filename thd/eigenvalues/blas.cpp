@@ -32,17 +32,19 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <stdafx.h>
 #include "blas.h"
+#include "gemm.h"
 #include <iostream>
 #include <stdio.h>
 
-double vectornorm2(const ap::real_1d_array& x, int i1, int i2)
+template<class T>
+T vectornorm2(const ap::template_1d_array<T,true>& x, int i1, int i2)
 {
-    double result;
+    T result;
     int n;
     int ix;
-    double absxi;
-    double scl;
-    double ssq;
+    T absxi;
+    T scl;
+    T ssq;
 
     n = i2-i1+1;
     if( n<1 )
@@ -78,11 +80,12 @@ double vectornorm2(const ap::real_1d_array& x, int i1, int i2)
 }
 
 
-int vectoridxabsmax(const ap::real_1d_array& x, int i1, int i2)
+template<class T>
+int vectoridxabsmax(const ap::template_1d_array<T,true>& x, int i1, int i2)
 {
     int result;
     int i;
-    double a;
+    T a;
 
     result = i1;
     a = fabs(x(result));
@@ -97,11 +100,12 @@ int vectoridxabsmax(const ap::real_1d_array& x, int i1, int i2)
 }
 
 
-int columnidxabsmax(const ap::real_2d_array& x, int i1, int i2, int j)
+template<class T>
+int columnidxabsmax(const ap::template_2d_array<T,true>& x, int i1, int i2, int j)
 {
     int result;
     int i;
-    double a;
+    T a;
 
     result = i1;
     a = fabs(x(result,j));
@@ -116,11 +120,12 @@ int columnidxabsmax(const ap::real_2d_array& x, int i1, int i2, int j)
 }
 
 
-int rowidxabsmax(const ap::real_2d_array& x, int j1, int j2, int i)
+template<class T>
+int rowidxabsmax(const ap::template_2d_array<T,true>& x, int j1, int j2, int i)
 {
     int result;
     int j;
-    double a;
+    T a;
 
     result = j1;
     a = fabs(x(i,result));
@@ -135,14 +140,15 @@ int rowidxabsmax(const ap::real_2d_array& x, int j1, int j2, int i)
 }
 
 
-double upperhessenberg1norm(const ap::real_2d_array& a,
+template<class T>
+T upperhessenberg1norm(const ap::template_2d_array<T,true>& a,
      int i1,
      int i2,
      int j1,
      int j2,
-     ap::real_1d_array& work)
+     ap::template_1d_array<T,true>& work)
 {
-    double result;
+    T result;
     int i;
     int j;
 
@@ -167,12 +173,13 @@ double upperhessenberg1norm(const ap::real_2d_array& a,
 }
 
 
-void copymatrix(const ap::real_2d_array& a,
+template<class T>
+void copymatrix(const ap::template_2d_array<T,true>& a,
      int is1,
      int is2,
      int js1,
      int js2,
-     ap::real_2d_array& b,
+     ap::template_2d_array<T,true>& b,
      int id1,
      int id2,
      int jd1,
@@ -195,12 +202,13 @@ void copymatrix(const ap::real_2d_array& a,
 }
 
 
-void inplacetranspose(ap::real_2d_array& a,
+template<class T>
+void inplacetranspose(ap::template_2d_array<T,true>& a,
      int i1,
      int i2,
      int j1,
      int j2,
-     ap::real_1d_array& work)
+     ap::template_1d_array<T,true>& work)
 {
     int i;
     int j;
@@ -226,12 +234,13 @@ void inplacetranspose(ap::real_2d_array& a,
 }
 
 
-void copyandtranspose(const ap::real_2d_array& a,
+template<class T>
+void copyandtranspose(const ap::template_2d_array<T,true>& a,
      int is1,
      int is2,
      int js1,
      int js2,
-     ap::real_2d_array& b,
+     ap::template_2d_array<T,true>& b,
      int id1,
      int id2,
      int jd1,
@@ -254,23 +263,24 @@ void copyandtranspose(const ap::real_2d_array& a,
 }
 
 
-void matrixvectormultiply(const ap::real_2d_array& a,
+template<class T>
+void matrixvectormultiply(const ap::template_2d_array<T,true>& a,
      int i1,
      int i2,
      int j1,
      int j2,
      bool trans,
-     const ap::real_1d_array& x,
+     const ap::template_1d_array<T,true>& x,
      int ix1,
      int ix2,
-     double alpha,
-     ap::real_1d_array& y,
+     T alpha,
+     ap::template_1d_array<T,true>& y,
      int iy1,
      int iy2,
-     double beta)
+     T beta)
 {
     int i;
-    double v;
+    T v;
 
     if( !trans )
     {
@@ -349,13 +359,14 @@ void matrixvectormultiply(const ap::real_2d_array& a,
 }
 
 
-double pythag2(double x, double y)
+template<class T>
+T pythag2(T x, T y)
 {
-    double result;
-    double w;
-    double xabs;
-    double yabs;
-    double z;
+    T result;
+    T w;
+    T xabs;
+    T yabs;
+    T z;
 
     xabs = fabs(x);
     yabs = fabs(y);
@@ -373,26 +384,25 @@ double pythag2(double x, double y)
 }
 
 
-void matrixmatrixmultiply(const ap::real_2d_array& a,
+template<class T>
+void matrixmatrixmultiply(const ap::template_2d_array<T,true>& a,
      int ai1,
      int ai2,
      int aj1,
      int aj2,
      bool transa,
-     const ap::real_2d_array& b,
+     const ap::template_2d_array<T,true>& b,
      int bi1,
      int bi2,
      int bj1,
      int bj2,
      bool transb,
-     double alpha,
-     ap::real_2d_array& c,
+     T alpha,
+     ap::template_2d_array<T,true>& c,
      int ci1,
-     int ci2,
      int cj1,
-     int cj2,
-     double beta,
-     ap::real_1d_array& work)
+     T beta,
+     ap::template_1d_array<T,true>& work)
 {
     int arows;
     int acols;
@@ -401,11 +411,6 @@ void matrixmatrixmultiply(const ap::real_2d_array& a,
     int crows;
     int ccols;
     int i;
-    int j;
-    int k;
-    int l;
-    int r;
-    double v;
 
 
     //
@@ -448,131 +453,71 @@ void matrixmatrixmultiply(const ap::real_2d_array& a,
     i = ap::maxint(i, bcols);
     work(1) = 0;
     work(i) = 0;
-    //
-    // Prepare C
-    //
-    if( beta==0 )
-    {
-        for(i = ci1; i <= ci2; i++)
-        {
-            for(j = cj1; j <= cj2; j++)
-            {
-                c(i,j) = 0;
-            }
-        }
-    }
-    else
-    {
-        for(i = ci1; i <= ci2; i++)
-        {
-            ap::vmul(&c(i, cj1), ap::vlen(cj1,cj2), beta);
-        }
-    }
 
     //
-    // A*B
+    // The blocked kernel handles all four combinations of transposes
     //
-    if( !transa&&!transb )
-    {
-        for(l = ai1; l <= ai2; l++)
-        {
-            for(r = bi1; r <= bi2; r++)
-            {
-                v = alpha*a(l,aj1+r-bi1);
-                k = ci1+l-ai1;
-                ap::vadd(&c(k, cj1), &b(r, bj1), ap::vlen(cj1,cj2), v);
-            }
-        }
-        return;
-    }
-
-    //
-    // A*B'
-    //
-    if( !transa&&transb )
-    {
-        if( arows*acols<brows*bcols )
-        {
-            for(r = bi1; r <= bi2; r++)
-            {
-                for(l = ai1; l <= ai2; l++)
-                {
-                    v = ap::vdotproduct(&a(l, aj1), &b(r, bj1), ap::vlen(aj1,aj2));
-                    c(ci1+l-ai1,cj1+r-bi1) = c(ci1+l-ai1,cj1+r-bi1)+alpha*v;
-                }
-            }
-            return;
-        }
-        else
-        {
-            for(l = ai1; l <= ai2; l++)
-            {
-                for(r = bi1; r <= bi2; r++)
-                {
-                    v = ap::vdotproduct(&a(l, aj1), &b(r, bj1), ap::vlen(aj1,aj2));
-                    c(ci1+l-ai1,cj1+r-bi1) = c(ci1+l-ai1,cj1+r-bi1)+alpha*v;
-                }
-            }
-            return;
-        }
-    }
-
-    //
-    // A'*B
-    //
-    if( transa&&!transb )
-    {
-        for(l = aj1; l <= aj2; l++)
-        {
-            for(r = bi1; r <= bi2; r++)
-            {
-                v = alpha*a(ai1+r-bi1,l);
-                k = ci1+l-aj1;
-                ap::vadd(&c(k, cj1), &b(r, bj1), ap::vlen(cj1,cj2), v);
-            }
-        }
-        return;
-    }
-
-    //
-    // A'*B'
-    //
-    if( transa&&transb )
-    {
-        if( arows*acols<brows*bcols )
-        {
-            for(r = bi1; r <= bi2; r++)
-            {
-                for(i = 1; i <= crows; i++)
-                {
-                    work(i) = 0.0;
-                }
-                for(l = ai1; l <= ai2; l++)
-                {
-                    v = alpha*b(r,bj1+l-ai1);
-                    k = cj1+r-bi1;
-                    ap::vadd(&work(1), &a(l, aj1), ap::vlen(1,crows), v);
-                }
-                ap::vadd(c.getcolumn(k, ci1, ci2), work.getvector(1, crows));
-            }
-            return;
-        }
-        else
-        {
-            for(l = aj1; l <= aj2; l++)
-            {
-                k = ai2-ai1+1;
-                ap::vmove(work.getvector(1, k), a.getcolumn(l, ai1, ai2));
-                for(r = bi1; r <= bi2; r++)
-                {
-                    v = ap::vdotproduct(&work(1), &b(r, bj1), ap::vlen(1,k));
-                    c(ci1+l-aj1,cj1+r-bi1) = c(ci1+l-aj1,cj1+r-bi1)+alpha*v;
-                }
-            }
-            return;
-        }
-    }
+    rmatrixgemm<T>(transa, transb, crows, ccols, acols, alpha,
+        &a(ai1, aj1), a.getstride(),
+        &b(bi1, bj1), b.getstride(),
+        beta, &c(ci1, cj1), c.getstride());
 }
 
 
-
+template float vectornorm2<float>(const ap::template_1d_array<float,true>&, int,
+     int);
+template int vectoridxabsmax<float>(const ap::template_1d_array<float,true>&,
+     int, int);
+template int columnidxabsmax<float>(const ap::template_2d_array<float,true>&,
+     int, int, int);
+template int rowidxabsmax<float>(const ap::template_2d_array<float,true>&, int,
+     int, int);
+template float upperhessenberg1norm<float>(
+     const ap::template_2d_array<float,true>&, int, int, int, int,
+     ap::template_1d_array<float,true>&);
+template void copymatrix<float>(const ap::template_2d_array<float,true>&, int,
+     int, int, int, ap::template_2d_array<float,true>&, int, int, int, int);
+template void inplacetranspose<float>(ap::template_2d_array<float,true>&, int,
+     int, int, int, ap::template_1d_array<float,true>&);
+template void copyandtranspose<float>(const ap::template_2d_array<float,true>&,
+     int, int, int, int, ap::template_2d_array<float,true>&, int, int, int,
+     int);
+template void matrixvectormultiply<float>(
+     const ap::template_2d_array<float,true>&, int, int, int, int, bool,
+     const ap::template_1d_array<float,true>&, int, int, float,
+     ap::template_1d_array<float,true>&, int, int, float);
+template float pythag2<float>(float, float);
+template void matrixmatrixmultiply<float>(
+     const ap::template_2d_array<float,true>&, int, int, int, int, bool,
+     const ap::template_2d_array<float,true>&, int, int, int, int, bool, float,
+     ap::template_2d_array<float,true>&, int, int, float,
+     ap::template_1d_array<float,true>&);
+
+template double vectornorm2<double>(const ap::template_1d_array<double,true>&,
+     int, int);
+template int vectoridxabsmax<double>(const ap::template_1d_array<double,true>&,
+     int, int);
+template int columnidxabsmax<double>(const ap::template_2d_array<double,true>&,
+     int, int, int);
+template int rowidxabsmax<double>(const ap::template_2d_array<double,true>&,
+     int, int, int);
+template double upperhessenberg1norm<double>(
+     const ap::template_2d_array<double,true>&, int, int, int, int,
+     ap::template_1d_array<double,true>&);
+template void copymatrix<double>(const ap::template_2d_array<double,true>&, int,
+     int, int, int, ap::template_2d_array<double,true>&, int, int, int, int);
+template void inplacetranspose<double>(ap::template_2d_array<double,true>&, int,
+     int, int, int, ap::template_1d_array<double,true>&);
+template void copyandtranspose<double>(
+     const ap::template_2d_array<double,true>&, int, int, int, int,
+     ap::template_2d_array<double,true>&, int, int, int, int);
+template void matrixvectormultiply<double>(
+     const ap::template_2d_array<double,true>&, int, int, int, int, bool,
+     const ap::template_1d_array<double,true>&, int, int, double,
+     ap::template_1d_array<double,true>&, int, int, double);
+template double pythag2<double>(double, double);
+template void matrixmatrixmultiply<double>(
+     const ap::template_2d_array<double,true>&, int, int, int, int, bool,
+     const ap::template_2d_array<double,true>&, int, int, int, int, bool,
+     double, ap::template_2d_array<double,true>&, int, int, double,
+     ap::template_1d_array<double,true>&);
@@ -35,97 +35,106 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "ap.h"
 
-double vectornorm2(const ap::real_1d_array& x, int i1, int i2);
+template<class T>
+T vectornorm2(const ap::template_1d_array<T,true>& x, int i1, int i2);
 
 
-int vectoridxabsmax(const ap::real_1d_array& x, int i1, int i2);
+template<class T>
+int vectoridxabsmax(const ap::template_1d_array<T,true>& x, int i1, int i2);
 
 
-int columnidxabsmax(const ap::real_2d_array& x, int i1, int i2, int j);
+template<class T>
+int columnidxabsmax(const ap::template_2d_array<T,true>& x, int i1, int i2, int j);
 
 
-int rowidxabsmax(const ap::real_2d_array& x, int j1, int j2, int i);
+template<class T>
+int rowidxabsmax(const ap::template_2d_array<T,true>& x, int j1, int j2, int i);
 
 
-double upperhessenberg1norm(const ap::real_2d_array& a,
+template<class T>
+T upperhessenberg1norm(const ap::template_2d_array<T,true>& a,
      int i1,
      int i2,
      int j1,
      int j2,
-     ap::real_1d_array& work);
+     ap::template_1d_array<T,true>& work);
 
 
-void copymatrix(const ap::real_2d_array& a,
+template<class T>
+void copymatrix(const ap::template_2d_array<T,true>& a,
      int is1,
      int is2,
      int js1,
      int js2,
-     ap::real_2d_array& b,
+     ap::template_2d_array<T,true>& b,
      int id1,
      int id2,
      int jd1,
      int jd2);
 
 
-void inplacetranspose(ap::real_2d_array& a,
+template<class T>
+void inplacetranspose(ap::template_2d_array<T,true>& a,
      int i1,
      int i2,
      int j1,
      int j2,
-     ap::real_1d_array& work);
+     ap::template_1d_array<T,true>& work);
 
 
-void copyandtranspose(const ap::real_2d_array& a,
+template<class T>
+void copyandtranspose(const ap::template_2d_array<T,true>& a,
      int is1,
      int is2,
      int js1,
      int js2,
-     ap::real_2d_array& b,
+     ap::template_2d_array<T,true>& b,
      int id1,
      int id2,
      int jd1,
      int jd2);
 
 
-void matrixvectormultiply(const ap::real_2d_array& a,
+template<class T>
+void matrixvectormultiply(const ap::template_2d_array<T,true>& a,
      int i1,
      int i2,
      int j1,
      int j2,
      bool trans,
-     const ap::real_1d_array& x,
+     const ap::template_1d_array<T,true>& x,
      int ix1,
      int ix2,
-     double alpha,
-     ap::real_1d_array& y,
+     T alpha,
+     ap::template_1d_array<T,true>& y,
      int iy1,
      int iy2,
-     double beta);
+     T beta);
 
 
-double pythag2(double x, double y);
+template<class T>
+T pythag2(T x, T y);
 
 
-void matrixmatrixmultiply(const ap::real_2d_array& a,
+template<class T>
+void matrixmatrixmultiply(const ap::template_2d_array<T,true>& a,
      int ai1,
      int ai2,
      int aj1,
      int aj2,
      bool transa,
-     const ap::real_2d_array& b,
+     const ap::template_2d_array<T,true>& b,
      int bi1,
      int bi2,
      int bj1,
      int bj2,
      bool transb,
-     double alpha,
-     ap::real_2d_array& c,
+     T alpha,
+     ap::template_2d_array<T,true>& c,
      int ci1,
-     int ci2,
      int cj1,
-     int cj2,
-     double beta,
-     ap::real_1d_array& work);
+     T beta,
+     ap::template_1d_array<T,true>& work);
 
 
 #endif
@@ -0,0 +1,408 @@
+/**
+ * @file gemm.cpp
+ * @brief Blocked matrix-matrix multiplication for the ap matrices
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object against this software used by the military, in the
+ * bio-industry, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2010 Anne van Rossum <anne@almende.com>
+ *
+ * @author 	Anne C. van Rossum
+ * @date	Oct 18, 2026
+ * @project	Replicator FP7
+ * @company	Almende B.V.
+ * @case
+ */
+
+#include <stdafx.h>
+#include "gemm.h"
+#include "ap.h"
+#include "apsimd.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*************************************************************************
+Block sizes. The micro-kernel computes an MRxNR block of C, an MRxKC sliver
+of A and a KCxNR sliver of B stay in L1, an MCxKC block of A in L2 and a
+KCxNC panel of B in L3. MR and NR are those of the portable micro-kernel
+below, the kernels of apsimd.cpp have their own.
+*************************************************************************/
+template<class T> struct gemmblocking;
+
+template<> struct gemmblocking<double>
+{
+    enum { mr = 4, nr = 4, kc = 256, mc = 96, nc = 2048 };
+};
+
+template<> struct gemmblocking<float>
+{
+    enum { mr = 4, nr = 8, kc = 256, mc = 96, nc = 4096 };
+};
+
+//
+// Largest MRxNR of all micro-kernels
+//
+static const int gemmmaxtile = 256;
+
+#ifdef __GNUC__
+//
+// A row of the micro-tile is two vectors of 16 bytes (SSE2)
+//
+template<class T> struct gemmvector
+{
+    typedef T type __attribute__((vector_size(16)));
+};
+#endif
+
+//
+// Below this number of multiply-adds the threads are not started
+//
+static const double gemmparallelflops = 2.0e6;
+
+//
+// Packing buffers of the calling thread (A and B), kept between calls and
+// only reallocated when they have to grow
+//
+struct gemmbuffer
+{
+    void *p;
+    size_t size;
+};
+static gemmbuffer gemmbuffers[2];
+#pragma omp threadprivate(gemmbuffers)
+
+static void* gemmgetbuffer(int i, size_t size)
+{
+    gemmbuffer& buf = gemmbuffers[i];
+    if( buf.size<size )
+    {
+        if( buf.p!=NULL )
+            ap::afree(buf.p);
+        buf.p = ap::amalloc(size, AP_ALIGNMENT);
+        buf.size = size;
+    }
+    return buf.p;
+}
+
+
+/*************************************************************************
+Micro-kernel in use, C := C + Alpha*A*B with A an MRxKC sliver (packed
+column by column), B a KCxNR sliver (packed row by row) and C an MRxNR
+block with rows LDC apart
+*************************************************************************/
+template<class T> struct gemmmicro
+{
+    int mr;
+    int nr;
+    void (*kernel)(long kc, T alpha, const T* pa, const T* pb, T* c, long ldc);
+};
+
+
+/*************************************************************************
+Portable micro-kernel
+*************************************************************************/
+template<class T>
+static void gemmmicrokernel(long kc, T alpha, const T* pa, const T* pb, T* c, long ldc)
+{
+    const int mr = gemmblocking<T>::mr;
+    const int nr = gemmblocking<T>::nr;
+    T ab[mr*nr];
+    int i;
+    int j;
+#ifdef __GNUC__
+    typedef typename gemmvector<T>::type vec;
+    const int vl = sizeof(vec)/sizeof(T);
+    vec c00 = {}, c01 = {}, c10 = {}, c11 = {};
+    vec c20 = {}, c21 = {}, c30 = {}, c31 = {};
+    long p;
+
+    //
+    // the accumulators are named so they stay in registers, this requires
+    // MR=4 and NR=2*VL
+    //
+    for(p = 0; p < kc; p++, pa += mr, pb += nr)
+    {
+        vec b0 = *(const vec*)(pb);
+        vec b1 = *(const vec*)(pb+vl);
+        c00 += b0*pa[0];
+        c01 += b1*pa[0];
+        c10 += b0*pa[1];
+        c11 += b1*pa[1];
+        c20 += b0*pa[2];
+        c21 += b1*pa[2];
+        c30 += b0*pa[3];
+        c31 += b1*pa[3];
+    }
+    vec tile[8] = { c00, c01, c10, c11, c20, c21, c30, c31 };
+    const T* t = (const T*)tile;
+    for(i = 0; i < mr*nr; i++)
+        ab[i] = t[i];
+#else
+    long p;
+
+    for(i = 0; i < mr*nr; i++)
+        ab[i] = 0;
+    for(p = 0; p < kc; p++, pa += mr, pb += nr)
+    {
+        for(i = 0; i < mr; i++)
+        {
+            T ai = pa[i];
+            for(j = 0; j < nr; j++)
+                ab[i*nr+j] += ai*pb[j];
+        }
+    }
+#endif
+    for(i = 0; i < mr; i++)
+        for(j = 0; j < nr; j++)
+            c[i*ldc+j] += alpha*ab[i*nr+j];
+}
+
+
+/*************************************************************************
+Widest micro-kernel for this CPU (see apsimd.h), the portable one if there
+is no SIMD kernel.
+*************************************************************************/
+template<class T> static gemmmicro<T> gemmselect();
+
+template<> gemmmicro<double> gemmselect<double>()
+{
+    const ap::ablaskernels& k = ap::ablasselect();
+    gemmmicro<double> result = { gemmblocking<double>::mr, gemmblocking<double>::nr, gemmmicrokernel<double> };
+    if( k.dgemm1!=NULL )
+    {
+        result.mr = k.dgemmmr;
+        result.nr = k.dgemmnr;
+        result.kernel = k.dgemm1;
+    }
+    return result;
+}
+
+template<> gemmmicro<float> gemmselect<float>()
+{
+    const ap::ablaskernels& k = ap::ablasselect();
+    gemmmicro<float> result = { gemmblocking<float>::mr, gemmblocking<float>::nr, gemmmicrokernel<float> };
+    if( k.sgemm1!=NULL )
+    {
+        result.mr = k.sgemmmr;
+        result.nr = k.sgemmnr;
+        result.kernel = k.sgemm1;
+    }
+    return result;
+}
+
+
+/*************************************************************************
+Copies the MCxKC block of op(A) that starts at A into slivers of MR rows.
+Element (i,p) of op(A) is at A[i*RS+p*CS]. Rows beyond MC are zero.
+*************************************************************************/
+template<class T>
+static void gemmpacka(int mr, int mc, int kc, const T* a, int rs, int cs, T* pa)
+{
+    int ir;
+    int i;
+    int p;
+
+    for(ir = 0; ir < mc; ir += mr)
+    {
+        int mreff = mc-ir<mr ? mc-ir : mr;
+        for(p = 0; p < kc; p++)
+        {
+            const T* src = a+ir*rs+p*cs;
+            for(i = 0; i < mreff; i++)
+                pa[i] = src[i*rs];
+            for(; i < mr; i++)
+                pa[i] = 0;
+            pa += mr;
+        }
+    }
+}
+
+
+/*************************************************************************
+Copies the KCxNC panel of op(B) that starts at B into slivers of NR columns.
+Element (p,j) of op(B) is at B[p*RS+j*CS]. Columns beyond NC are zero.
+*************************************************************************/
+template<class T>
+static void gemmpackb(int nr, int kc, int nc, const T* b, int rs, int cs, T* pb)
+{
+    int jr;
+    int j;
+    int p;
+
+    #pragma omp for schedule(static)
+    for(jr = 0; jr < nc; jr += nr)
+    {
+        int nreff = nc-jr<nr ? nc-jr : nr;
+        T* dst = pb+jr*kc;
+        for(p = 0; p < kc; p++)
+        {
+            const T* src = b+p*rs+jr*cs;
+            if( cs==1 )
+                for(j = 0; j < nreff; j++)
+                    dst[j] = src[j];
+            else
+                for(j = 0; j < nreff; j++)
+                    dst[j] = src[j*cs];
+            for(; j < nr; j++)
+                dst[j] = 0;
+            dst += nr;
+        }
+    }
+}
+
+
+/*************************************************************************
+C := C + Alpha*A*B for a packed MCxKC block of A and KCxNC panel of B.
+Blocks at the edges of C go through a full tile on the stack.
+*************************************************************************/
+template<class T>
+static void gemmmacrokernel(const gemmmicro<T>& micro, int mc, int nc, int kc, T alpha, const T* pa, const T* pb, T* c, int ldc)
+{
+    const int mr = micro.mr;
+    const int nr = micro.nr;
+    T ab[gemmmaxtile];
+    int ir;
+    int jr;
+    int i;
+    int j;
+
+    for(jr = 0; jr < nc; jr += nr)
+    {
+        int nreff = nc-jr<nr ? nc-jr : nr;
+        for(ir = 0; ir < mc; ir += mr)
+        {
+            int mreff = mc-ir<mr ? mc-ir : mr;
+            if( mreff==mr&&nreff==nr )
+            {
+                micro.kernel(kc, alpha, pa+ir*kc, pb+jr*kc, c+ir*ldc+jr, ldc);
+                continue;
+            }
+            for(i = 0; i < mr*nr; i++)
+                ab[i] = 0;
+            micro.kernel(kc, 1, pa+ir*kc, pb+jr*kc, ab, nr);
+            for(i = 0; i < mreff; i++)
+            {
+                T* crow = c+(ir+i)*ldc+jr;
+                for(j = 0; j < nreff; j++)
+                    crow[j] += alpha*ab[i*nr+j];
+            }
+        }
+    }
+}
+
+
+template<class T>
+void rmatrixgemm(bool transa,
+     bool transb,
+     int m,
+     int n,
+     int k,
+     T alpha,
+     const T* a,
+     int lda,
+     const T* b,
+     int ldb,
+     T beta,
+     T* c,
+     int ldc)
+{
+    const int kcmax = gemmblocking<T>::kc;
+    const int mcmax = gemmblocking<T>::mc;
+    const int ncmax = gemmblocking<T>::nc;
+    int i;
+    int j;
+
+    if( m<=0||n<=0 )
+        return;
+
+    //
+    // C := Beta*C
+    //
+    for(i = 0; i < m; i++)
+    {
+        T* crow = c+i*ldc;
+        if( beta==0 )
+            for(j = 0; j < n; j++)
+                crow[j] = 0;
+        else if( beta!=1 )
+            for(j = 0; j < n; j++)
+                crow[j] *= beta;
+    }
+    if( k<=0||alpha==0 )
+        return;
+
+    const gemmmicro<T> micro = gemmselect<T>();
+    const int mr = micro.mr;
+    const int nr = micro.nr;
+
+    //
+    // Strides of op(A) and op(B)
+    //
+    int rsa = transa ? 1 : lda;
+    int csa = transa ? lda : 1;
+    int rsb = transb ? 1 : ldb;
+    int csb = transb ? ldb : 1;
+
+    int nthreads = 1;
+    bool parallel = (double)m*n*k>=gemmparallelflops;
+#ifdef _OPENMP
+    if( parallel )
+        nthreads = omp_get_max_threads();
+#endif
+
+    //
+    // Panel of B (shared) and a block of A per thread, rounded up to full
+    // slivers
+    //
+    int kcpanel = kcmax<k ? kcmax : k;
+    int ncpanel = ((ncmax<n ? ncmax : n)+nr-1)/nr*nr;
+    int mcblock = ((mcmax<m ? mcmax : m)+mr-1)/mr*mr;
+    T* pb = (T*)gemmgetbuffer(0, sizeof(T)*kcpanel*ncpanel);
+    T* pa = (T*)gemmgetbuffer(1, sizeof(T)*kcpanel*mcblock*nthreads);
+
+    for(int jc = 0; jc < n; jc += ncmax)
+    {
+        int nc = n-jc<ncmax ? n-jc : ncmax;
+        for(int pc = 0; pc < k; pc += kcmax)
+        {
+            int kc = k-pc<kcmax ? k-pc : kcmax;
+
+            #pragma omp parallel if(parallel) num_threads(nthreads)
+            {
+                int thread = 0;
+#ifdef _OPENMP
+                thread = omp_get_thread_num();
+#endif
+                T* pathread = pa+thread*kcpanel*mcblock;
+
+                //
+                // Pack the panel of B together, implicit barrier at the end
+                //
+                gemmpackb<T>(nr, kc, nc, b+pc*rsb+jc*csb, rsb, csb, pb);
+
+                #pragma omp for schedule(dynamic)
+                for(int ic = 0; ic < m; ic += mcmax)
+                {
+                    int mc = m-ic<mcmax ? m-ic : mcmax;
+                    gemmpacka<T>(mr, mc, kc, a+ic*rsa+pc*csa, rsa, csa, pathread);
+                    gemmmacrokernel<T>(micro, mc, nc, kc, alpha, pathread, pb, c+ic*ldc+jc, ldc);
+                }
+            }
+        }
+    }
+}
+
+
+template void rmatrixgemm<float>(bool, bool, int, int, int, float, const float*, int,
+     const float*, int, float, float*, int);
+template void rmatrixgemm<double>(bool, bool, int, int, int, double, const double*, int,
+     const double*, int, double, double*, int);
@@ -0,0 +1,66 @@
+/**
+ * @file gemm.h
+ * @brief Blocked matrix-matrix multiplication for the ap matrices
+ *
+ * This file is created at Almende B.V. It is open-source software and part of the Common
+ * Hybrid Agent Platform (CHAP). A toolbox with a lot of open-source tools, ranging from
+ * thread pools and TCP/IP components to control architectures and learning algorithms.
+ * This software is published under the GNU Lesser General Public license (LGPL).
+ *
+ * It is not possible to add usage restrictions to an open-source license. Nevertheless,
+ * we personally strongly object against this software used by the military, in the
+ * bio-industry, for animal experimentation, or anything that violates the Universal
+ * Declaration of Human Rights.
+ *
+ * Copyright © 2010 Anne van Rossum <anne@almende.com>
+ *
+ * @author 	Anne C. van Rossum
+ * @date	Oct 18, 2026
+ * @project	Replicator FP7
+ * @company	Almende B.V.
+ * @case
+ */
+
+#ifndef _gemm_h
+#define _gemm_h
+
+/*************************************************************************
+General matrix-matrix multiplication of row-major matrices
+
+    C := Alpha*op(A)*op(B) + Beta*C
+
+Input parameters:
+    TransA  -   op(A)=A' if True, op(A)=A otherwise
+    TransB  -   op(B)=B' if True, op(B)=B otherwise
+    M, N, K -   op(A) is MxK, op(B) is KxN, C is MxN. A is stored as a KxM
+                matrix if TransA is True, the same holds for B.
+    A, B, C -   pointers to the first element
+    LDA, LDB, LDC
+            -   distance in elements between the starts of two rows (see
+                getstride() of the ap arrays)
+    Alpha, Beta
+            -   scalars. If Beta is zero, C is not read.
+
+The matrices are multiplied in panels that fit the caches. Every panel is
+copied ("packed") in the order in which the micro-kernel reads it, and the
+micro-kernel keeps an MRxNR block of C in registers. The row blocks of C
+are distributed over the threads when compiled with OpenMP.
+
+Instantiated for float and double.
+*************************************************************************/
+template<class T>
+void rmatrixgemm(bool transa,
+     bool transb,
+     int m,
+     int n,
+     int k,
+     T alpha,
+     const T* a,
+     int lda,
+     const T* b,
+     int ldb,
+     T beta,
+     T* c,
+     int ldc);
+
+#endif
@@ -38,6 +38,50 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <stdafx.h>
 #include "hessenberg.h"
+#include "gemm.h"
+
+//
+// Panel width of the blocked reduction, and the order of the trailing
+// matrix below which it is reduced one column at a time (NB and NX of
+// DGEHRD)
+//
+static const int hessnb = 32;
+static const int hessnx = 128;
+
+//
+// Below this number of multiply-adds a loop over the rows is not split
+// over threads
+//
+static const double hessparallelflops = 2.0e6;
+
+template<class T>
+static void hessenbergreduce(ap::template_2d_array<T,true>& a,
+     int o,
+     int n,
+     ap::template_1d_array<T,true>& tau,
+     template_hessenbergworkspace<T>& ws);
+template<class T>
+static void hessenbergpanel(ap::template_2d_array<T,true>& a,
+     int o,
+     int n,
+     int p,
+     int ib,
+     ap::template_1d_array<T,true>& tau,
+     template_hessenbergworkspace<T>& ws);
+template<class T>
+static void hessenbergcopyv(const ap::template_2d_array<T,true>& a,
+     int o,
+     int n,
+     int p,
+     int ib,
+     ap::template_2d_array<T,true>& v);
+template<class T>
+static void hessenbergunpackq(const ap::template_2d_array<T,true>& a,
+     int o,
+     int n,
+     const ap::template_1d_array<T,true>& tau,
+     ap::template_2d_array<T,true>& q,
+     template_hessenbergworkspace<T>& ws);
 
 /*************************************************************************
 Reduction of a square matrix to  upper Hessenberg form: Q'*A*Q = H,
@@ -73,13 +117,10 @@ so that v(0:i) = 0, v(i+1) = 1, v(i+2:n-1) stored in A(i+2:n-1,i).
      Courant Institute, Argonne National Lab, and Rice University
      October 31, 1992
 *************************************************************************/
-void rmatrixhessenberg(ap::real_2d_array& a, int n, ap::real_1d_array& tau)
+template<class T>
+void rmatrixhessenberg(ap::template_2d_array<T,true>& a, int n, ap::template_1d_array<T,true>& tau)
 {
-    int i;
-    double aii;
-    double v;
-    ap::real_1d_array t;
-    ap::real_1d_array work;
+    template_hessenbergworkspace<T> ws;
 
     ap::ap_error::make_assertion(n>=0, "RMatrixHessenberg: incorrect N!");
     
@@ -90,31 +131,7 @@ void rmatrixhessenberg(ap::real_2d_array& a, int n, ap::real_1d_array& tau)
     {
         return;
     }
-    tau.setbounds(0, n-2);
-    t.setbounds(1, n);
-    work.setbounds(0, n-1);
-    for(i = 0; i <= n-2; i++)
-    {
-        
-        //
-        // Compute elementary reflector H(i) to annihilate A(i+2:ihi,i)
-        //
-        ap::vmove(t.getvector(1, n-i-1), a.getcolumn(i, i+1, n-1));
-        generatereflection(t, n-i-1, v);
-        ap::vmove(a.getcolumn(i, i+1, n-1), t.getvector(1, n-i-1));
-        tau(i) = v;
-        t(1) = 1;
-        
-        //
-        // Apply H(i) to A(1:ihi,i+1:ihi) from the right
-        //
-        applyreflectionfromtheright(a, v, t, 0, n-1, i+1, n-1, work);
-        
-        //
-        // Apply H(i) to A(i+1:ihi,i+1:n) from the left
-        //
-        applyreflectionfromtheleft(a, v, t, i+1, n-1, i+1, n-1, work);
-    }
+    hessenbergreduce(a, 0, n, tau, ws);
 }
 
 
@@ -134,55 +151,19 @@ Output parameters:
   -- ALGLIB --
      Copyright 2005 by Bochkanov Sergey
 *************************************************************************/
-void rmatrixhessenbergunpackq(const ap::real_2d_array& a,
+template<class T>
+void rmatrixhessenbergunpackq(const ap::template_2d_array<T,true>& a,
      int n,
-     const ap::real_1d_array& tau,
-     ap::real_2d_array& q)
+     const ap::template_1d_array<T,true>& tau,
+     ap::template_2d_array<T,true>& q)
 {
-    int i;
-    int j;
-    ap::real_1d_array v;
-    ap::real_1d_array work;
+    template_hessenbergworkspace<T> ws;
 
     if( n==0 )
     {
         return;
     }
-    
-    //
-    // init
-    //
-    q.setbounds(0, n-1, 0, n-1);
-    v.setbounds(0, n-1);
-    work.setbounds(0, n-1);
-    for(i = 0; i <= n-1; i++)
-    {
-        for(j = 0; j <= n-1; j++)
-        {
-            if( i==j )
-            {
-                q(i,j) = 1;
-            }
-            else
-            {
-                q(i,j) = 0;
-            }
-        }
-    }
-    
-    //
-    // unpack Q
-    //
-    for(i = 0; i <= n-2; i++)
-    {
-        
-        //
-        // Apply H(i)
-        //
-        ap::vmove(v.getvector(1, n-i-1), a.getcolumn(i, i+1, n-1));
-        v(1) = 1;
-        applyreflectionfromtheright(q, tau(i), v, 0, n-1, i+1, n-1, work);
-    }
+    hessenbergunpackq(a, 0, n, tau, q, ws);
 }
 
 
@@ -199,14 +180,15 @@ Output parameters:
   -- ALGLIB --
      Copyright 2005 by Bochkanov Sergey
 *************************************************************************/
-void rmatrixhessenbergunpackh(const ap::real_2d_array& a,
+template<class T>
+void rmatrixhessenbergunpackh(const ap::template_2d_array<T,true>& a,
      int n,
-     ap::real_2d_array& h)
+     ap::template_2d_array<T,true>& h)
 {
     int i;
     int j;
-    ap::real_1d_array v;
-    ap::real_1d_array work;
+    ap::template_1d_array<T,true> v;
+    ap::template_1d_array<T,true> work;
     int ip1;
     int nmi;
 
@@ -231,16 +213,24 @@ void rmatrixhessenbergunpackh(const ap::real_2d_array& a,
 Obsolete 1-based subroutine.
 See RMatrixHessenberg for 0-based replacement.
 *************************************************************************/
-void toupperhessenberg(ap::real_2d_array& a, int n, ap::real_1d_array& tau)
+template<class T>
+void toupperhessenberg(ap::template_2d_array<T,true>& a, int n, ap::template_1d_array<T,true>& tau)
 {
-    int i;
-    int ip1;
-    int nmi;
-    double aii;
-    double v;
-    ap::real_1d_array t;
-    ap::real_1d_array work;
+    template_hessenbergworkspace<T> ws;
 
+    toupperhessenberg(a, n, tau, ws);
+}
+
+
+/*************************************************************************
+Same as above, with all temporaries taken from WS.
+*************************************************************************/
+template<class T>
+void toupperhessenberg(ap::template_2d_array<T,true>& a,
+     int n,
+     ap::template_1d_array<T,true>& tau,
+     template_hessenbergworkspace<T>& ws)
+{
     ap::ap_error::make_assertion(n>=0, "ToUpperHessenberg: incorrect N!");
     
     //
@@ -250,127 +240,537 @@ void toupperhessenberg(ap::real_2d_array& a, int n, ap::real_1d_array& tau)
     {
         return;
     }
-    tau.setbounds(1, n-1);
-    t.setbounds(1, n);
-    work.setbounds(1, n);
-    for(i = 1; i <= n-1; i++)
+    hessenbergreduce(a, 1, n, tau, ws);
+}
+
+
+/*************************************************************************
+Obsolete 1-based subroutine.
+See RMatrixHessenbergUnpackQ for 0-based replacement.
+*************************************************************************/
+template<class T>
+void unpackqfromupperhessenberg(const ap::template_2d_array<T,true>& a,
+     int n,
+     const ap::template_1d_array<T,true>& tau,
+     ap::template_2d_array<T,true>& q)
+{
+    template_hessenbergworkspace<T> ws;
+
+    unpackqfromupperhessenberg(a, n, tau, q, ws);
+}
+
+
+/*************************************************************************
+Same as above, with all temporaries taken from WS.
+*************************************************************************/
+template<class T>
+void unpackqfromupperhessenberg(const ap::template_2d_array<T,true>& a,
+     int n,
+     const ap::template_1d_array<T,true>& tau,
+     ap::template_2d_array<T,true>& q,
+     template_hessenbergworkspace<T>& ws)
+{
+    if( n==0 )
+    {
+        return;
+    }
+    hessenbergunpackq(a, 1, n, tau, q, ws);
+}
+
+
+/*************************************************************************
+Obsolete 1-based subroutine.
+See RMatrixHessenbergUnpackH for 0-based replacement.
+*************************************************************************/
+template<class T>
+void unpackhfromupperhessenberg(const ap::template_2d_array<T,true>& a,
+     int n,
+     const ap::template_1d_array<T,true>& tau,
+     ap::template_2d_array<T,true>& h)
+{
+    int i;
+    int j;
+    ap::template_1d_array<T,true> v;
+    ap::template_1d_array<T,true> work;
+    int ip1;
+    int nmi;
+
+    if( n==0 )
+    {
+        return;
+    }
+    h.setbounds(1, n, 1, n);
+    for(i = 1; i <= n; i++)
+    {
+        for(j = 1; j <= i-2; j++)
+        {
+            h(i,j) = 0;
+        }
+        j = ap::maxint(1, i-1);
+        ap::vmove(&h(i, j), &a(i, j), ap::vlen(j,n));
+    }
+}
+
+
+
+
+
+/*************************************************************************
+Reduction of A(O:O+N-1, O:O+N-1) to upper Hessenberg form, with Tau[O..
+O+N-2]. Panels of HESSNB columns are reduced by HessenbergPanel until
+HESSNX columns are left, the rest one reflection at a time.
+*************************************************************************/
+template<class T>
+static void hessenbergreduce(ap::template_2d_array<T,true>& a,
+     int o,
+     int n,
+     ap::template_1d_array<T,true>& tau,
+     template_hessenbergworkspace<T>& ws)
+{
+    int i;
+    T v;
+
+    tau.setbounds(o, o+n-2);
+    ws.t.setbounds(1, n);
+    ws.work.setbounds(o, o+n-1);
+    i = 0;
+    if( n-1>hessnx )
+    {
+        ws.v.setbounds(0, n-1, 0, hessnb-1);
+        ws.t2.setbounds(0, hessnb-1, 0, hessnb-1);
+        ws.y.setbounds(0, n-1, 0, hessnb-1);
+        ws.w.setbounds(0, hessnb-1, 0, n-1);
+        ws.w2.setbounds(0, hessnb-1, 0, n-1);
+        for(i = 0; i < n-1-hessnx; i += hessnb)
+        {
+            hessenbergpanel(a, o, n, i, hessnb, tau, ws);
+        }
+    }
+    for(; i <= n-2; i++)
     {
         
         //
         // Compute elementary reflector H(i) to annihilate A(i+2:ihi,i)
         //
-        ip1 = i+1;
-        nmi = n-i;
-        ap::vmove(t.getvector(1, nmi), a.getcolumn(i, ip1, n));
-        generatereflection(t, nmi, v);
-        ap::vmove(a.getcolumn(i, ip1, n), t.getvector(1, nmi));
-        tau(i) = v;
-        t(1) = 1;
+        ap::vmove(ws.t.getvector(1, n-i-1), a.getcolumn(o+i, o+i+1, o+n-1));
+        generatereflection(ws.t, n-i-1, v);
+        ap::vmove(a.getcolumn(o+i, o+i+1, o+n-1), ws.t.getvector(1, n-i-1));
+        tau(o+i) = v;
+        ws.t(1) = 1;
         
         //
         // Apply H(i) to A(1:ihi,i+1:ihi) from the right
         //
-        applyreflectionfromtheright(a, v, t, 1, n, i+1, n, work);
+        applyreflectionfromtheright(a, v, ws.t, o, o+n-1, o+i+1, o+n-1, ws.work);
         
         //
         // Apply H(i) to A(i+1:ihi,i+1:n) from the left
         //
-        applyreflectionfromtheleft(a, v, t, i+1, n, i+1, n, work);
+        applyreflectionfromtheleft(a, v, ws.t, o+i+1, o+n-1, o+i+1, o+n-1, ws.work);
     }
 }
 
 
 /*************************************************************************
-Obsolete 1-based subroutine.
-See RMatrixHessenbergUnpackQ for 0-based replacement.
+Reduces the columns P..P+IB-1 of A (offsets from O) and applies the
+reflections to the rest of A, as DLAHR2 followed by the updates of DGEHRD.
+
+The panel is reduced one column at a time. Each column is first brought
+up to date with the reflections of the panel that are already known,
+through Y = A*V*T and the block reflector I - V*T*V' itself, and then
+annihilated. The rest of the matrix is updated afterwards with three
+matrix products:
+
+    A(0:N-1, P+IB:N-1)   := A - Y*V'
+    A(P+1:N-1, P+IB:N-1) := (I - V*T'*V')*A
+
+and A(0:P, P+1:P+IB-1) is updated with the rows of Y above the panel.
 *************************************************************************/
-void unpackqfromupperhessenberg(const ap::real_2d_array& a,
+template<class T>
+static void hessenbergpanel(ap::template_2d_array<T,true>& a,
+     int o,
      int n,
-     const ap::real_1d_array& tau,
-     ap::real_2d_array& q)
+     int p,
+     int ib,
+     ap::template_1d_array<T,true>& tau,
+     template_hessenbergworkspace<T>& ws)
 {
-    int i;
+    ap::template_1d_array<T,true>& x = ws.t;
+    ap::template_2d_array<T,true>& v = ws.v;
+    ap::template_2d_array<T,true>& t = ws.t2;
+    ap::template_2d_array<T,true>& y = ws.y;
+    T *w = &ws.work(o);
+    int m;
     int j;
-    ap::real_1d_array v;
-    ap::real_1d_array work;
-    int ip1;
-    int nmi;
-
-    if( n==0 )
+    int c;
+    int k;
+    int d;
+    int r;
+    int len;
+    T ei;
+    T s;
+    T tauj;
+
+    m = n-p-1;
+    ei = 0;
+    for(j = 0; j <= ib-1; j++)
     {
-        return;
+        c = p+j;
+        if( j>0 )
+        {
+            
+            //
+            // Update the column below the diagonal block with the panel
+            // so far: A(P+1:N-1,C) := A - Y*V(C,:)'. The element of V on
+            // the diagonal is still set to one.
+            //
+            for(r = p+1; r <= n-1; r++)
+            {
+                a(o+r,o+c) = a(o+r,o+c)-ap::vdotproduct(&y(r, 0), &a(o+c, o+p), j);
+            }
+            
+            //
+            // Apply I - V*T'*V' to the column, b = (b1 b2) and V = (V1 V2)
+            // with V1 unit lower triangular.
+            //
+            // w := V1'*b1 + V2'*b2
+            //
+            for(k = 0; k <= j-1; k++)
+            {
+                s = a(o+p+1+k,o+c);
+                for(r = k+1; r <= j-1; r++)
+                {
+                    s = s+a(o+p+1+r,o+p+k)*a(o+p+1+r,o+c);
+                }
+                w[k] = s;
+            }
+            for(r = c+1; r <= n-1; r++)
+            {
+                ap::vadd(w, &a(o+r, o+p), j, a(o+r,o+c));
+            }
+            
+            //
+            // w := T'*w
+            //
+            for(k = j-1; k >= 0; k--)
+            {
+                s = 0;
+                for(d = 0; d <= k; d++)
+                {
+                    s = s+t(d,k)*w[d];
+                }
+                w[k] = s;
+            }
+            
+            //
+            // b2 := b2 - V2*w, b1 := b1 - V1*w
+            //
+            for(r = c+1; r <= n-1; r++)
+            {
+                a(o+r,o+c) = a(o+r,o+c)-ap::vdotproduct(&a(o+r, o+p), w, j);
+            }
+            for(r = 0; r <= j-1; r++)
+            {
+                s = w[r];
+                for(k = 0; k <= r-1; k++)
+                {
+                    s = s+a(o+p+1+r,o+p+k)*w[k];
+                }
+                a(o+p+1+r,o+c) = a(o+p+1+r,o+c)-s;
+            }
+            a(o+c,o+c-1) = ei;
+        }
+        
+        //
+        // Generate the reflection H(C) to annihilate A(C+2:N-1,C)
+        //
+        len = n-c-1;
+        ap::vmove(x.getvector(1, len), a.getcolumn(o+c, o+c+1, o+n-1));
+        generatereflection(x, len, tauj);
+        ap::vmove(a.getcolumn(o+c, o+c+1, o+n-1), x.getvector(1, len));
+        tau(o+c) = tauj;
+        ei = x(1);
+        x(1) = 1;
+        a(o+c+1,o+c) = 1;
+        
+        //
+        // w := V(C+1:N-1,0:J-1)'*v, which is also needed for T below
+        //
+        for(k = 0; k <= j-1; k++)
+        {
+            w[k] = 0;
+        }
+        for(r = c+1; r <= n-1; r++)
+        {
+            ap::vadd(w, &a(o+r, o+p), j, x(r-c));
+        }
+        
+        //
+        // Y(P+1:N-1,J) := Tau*(A(P+1:N-1,C+1:N-1)*v - Y(P+1:N-1,0:J-1)*w),
+        // the only pass over the trailing matrix per column
+        //
+        #pragma omp parallel for schedule(static) if((double)m*len>=hessparallelflops)
+        for(r = p+1; r <= n-1; r++)
+        {
+            T *yr = &y(r, 0);
+            yr[j] = tauj*(ap::vdotproduct(&a(o+r, o+c+1), &x(1), len)-ap::vdotproduct(yr, w, j));
+        }
+        
+        //
+        // T(0:J-1,J) := -Tau*T(0:J-1,0:J-1)*w
+        //
+        for(d = 0; d <= j-1; d++)
+        {
+            s = 0;
+            for(k = d; k <= j-1; k++)
+            {
+                s = s+t(d,k)*w[k];
+            }
+            t(d,j) = -tauj*s;
+        }
+        t(j,j) = tauj;
     }
+    a(o+p+ib,o+p+ib-1) = ei;
     
     //
-    // init
+    // Y(0:P,:) := A(0:P,P+1:N-1)*V*T
     //
-    q.setbounds(1, n, 1, n);
-    v.setbounds(1, n);
-    work.setbounds(1, n);
-    for(i = 1; i <= n; i++)
+    hessenbergcopyv(a, o, n, p, ib, v);
+    rmatrixgemm<T>(false, false, p+1, ib, m,
+        1.0, &a(o, o+p+1), a.getstride(),
+        &v(0, 0), v.getstride(),
+        0.0, &y(0, 0), y.getstride());
+    for(r = 0; r <= p; r++)
     {
-        for(j = 1; j <= n; j++)
+        for(k = ib-1; k >= 0; k--)
         {
-            if( i==j )
-            {
-                q(i,j) = 1;
-            }
-            else
+            s = 0;
+            for(d = 0; d <= k; d++)
             {
-                q(i,j) = 0;
+                s = s+y(r,d)*t(d,k);
             }
+            y(r,k) = s;
         }
     }
     
     //
-    // unpack Q
+    // A(0:N-1,P+IB:N-1) := A - Y*V(P+IB:N-1,:)'
     //
-    for(i = 1; i <= n-1; i++)
+    rmatrixgemm<T>(false, true, n, n-p-ib, ib,
+        -1.0, &y(0, 0), y.getstride(),
+        &v(ib-1, 0), v.getstride(),
+        1.0, &a(o, o+p+ib), a.getstride());
+    
+    //
+    // A(0:P,P+1:P+IB-1) := A - Y(0:P,0:IB-2)*V(P+1:P+IB-1,0:IB-2)'
+    //
+    for(r = 0; r <= p; r++)
     {
-        
-        //
-        // Apply H(i)
-        //
-        ip1 = i+1;
-        nmi = n-i;
-        ap::vmove(v.getvector(1, nmi), a.getcolumn(i, ip1, n));
-        v(1) = 1;
-        applyreflectionfromtheright(q, tau(i), v, 1, n, i+1, n, work);
+        for(k = 0; k <= ib-2; k++)
+        {
+            a(o+r,o+p+1+k) = a(o+r,o+p+1+k)-y(r,k)-ap::vdotproduct(&y(r, 0), &v(k, 0), k);
+        }
     }
+    
+    //
+    // A(P+1:N-1,P+IB:N-1) := A - V*(T'*(V'*A))
+    //
+    rmatrixgemm<T>(true, false, ib, n-p-ib, m,
+        1.0, &v(0, 0), v.getstride(),
+        &a(o+p+1, o+p+ib), a.getstride(),
+        0.0, &ws.w(0, 0), ws.w.getstride());
+    rmatrixgemm<T>(true, false, ib, n-p-ib, ib,
+        1.0, &t(0, 0), t.getstride(),
+        &ws.w(0, 0), ws.w.getstride(),
+        0.0, &ws.w2(0, 0), ws.w2.getstride());
+    rmatrixgemm<T>(false, false, m, n-p-ib, ib,
+        -1.0, &v(0, 0), v.getstride(),
+        &ws.w2(0, 0), ws.w2.getstride(),
+        1.0, &a(o+p+1, o+p+ib), a.getstride());
 }
 
 
 /*************************************************************************
-Obsolete 1-based subroutine.
-See RMatrixHessenbergUnpackH for 0-based replacement.
+V := the reflections P..P+IB-1 stored below the subdiagonal of A, as a
+dense (N-P-1)xIB unit lower trapezoidal matrix (row 0 is row P+1 of A)
 *************************************************************************/
-void unpackhfromupperhessenberg(const ap::real_2d_array& a,
+template<class T>
+static void hessenbergcopyv(const ap::template_2d_array<T,true>& a,
+     int o,
      int n,
-     const ap::real_1d_array& tau,
-     ap::real_2d_array& h)
+     int p,
+     int ib,
+     ap::template_2d_array<T,true>& v)
 {
+    int r;
+    int k;
+
+    for(r = 0; r <= n-p-2; r++)
+    {
+        for(k = 0; k <= ib-1; k++)
+        {
+            if( k<r )
+            {
+                v(r,k) = a(o+p+1+r,o+p+k);
+            }
+            else
+            {
+                v(r,k) = k==r ? 1 : 0;
+            }
+        }
+    }
+}
+
+
+/*************************************************************************
+Q := H(O)*...*H(O+N-2) for the output of HessenbergReduce.
+
+For larger matrices the reflections are grouped into blocks of HESSNB,
+which are applied from the left, last block first, as block reflectors
+I - V*T*V' (DORGQR with DLARFT and DLARFB).
+*************************************************************************/
+template<class T>
+static void hessenbergunpackq(const ap::template_2d_array<T,true>& a,
+     int o,
+     int n,
+     const ap::template_1d_array<T,true>& tau,
+     ap::template_2d_array<T,true>& q,
+     template_hessenbergworkspace<T>& ws)
+{
+    ap::template_2d_array<T,true>& v = ws.v;
+    ap::template_2d_array<T,true>& t = ws.t2;
+    ap::template_2d_array<T,true>& w = ws.w;
     int i;
     int j;
-    ap::real_1d_array v;
-    ap::real_1d_array work;
-    int ip1;
-    int nmi;
-
-    if( n==0 )
+    int p;
+    int ib;
+    int m;
+    int d;
+    int k;
+    T s;
+
+    q.setbounds(o, o+n-1, o, o+n-1);
+    for(i = 0; i <= n-1; i++)
+    {
+        q(o+i,o+i) = 1;
+    }
+    ws.t.setbounds(1, n);
+    ws.work.setbounds(o, o+n-1);
+    if( n-1<=hessnx )
     {
+        for(i = 0; i <= n-2; i++)
+        {
+            
+            //
+            // Apply H(i)
+            //
+            ap::vmove(ws.t.getvector(1, n-i-1), a.getcolumn(o+i, o+i+1, o+n-1));
+            ws.t(1) = 1;
+            applyreflectionfromtheright(q, tau(o+i), ws.t, o, o+n-1, o+i+1, o+n-1, ws.work);
+        }
         return;
     }
-    h.setbounds(1, n, 1, n);
-    for(i = 1; i <= n; i++)
+    ws.v.setbounds(0, n-1, 0, hessnb-1);
+    ws.t2.setbounds(0, hessnb-1, 0, hessnb-1);
+    ws.w.setbounds(0, hessnb-1, 0, n-1);
+    ws.w2.setbounds(0, hessnb-1, 0, n-1);
+    for(p = (n-2)/hessnb*hessnb; p >= 0; p -= hessnb)
     {
-        for(j = 1; j <= i-2; j++)
+        ib = ap::minint(hessnb, n-1-p);
+        m = n-p-1;
+        
+        //
+        // T of the block, from W := V'*V:
+        // T(0:J-1,J) = -Tau(J)*T(0:J-1,0:J-1)*V(:,0:J-1)'*V(:,J)
+        //
+        hessenbergcopyv(a, o, n, p, ib, v);
+        rmatrixgemm<T>(true, false, ib, ib, m,
+            1.0, &v(0, 0), v.getstride(),
+            &v(0, 0), v.getstride(),
+            0.0, &w(0, 0), w.getstride());
+        for(j = 0; j <= ib-1; j++)
         {
-            h(i,j) = 0;
+            for(d = 0; d <= j-1; d++)
+            {
+                s = 0;
+                for(k = d; k <= j-1; k++)
+                {
+                    s = s+t(d,k)*w(k,j);
+                }
+                t(d,j) = -tau(o+p+j)*s;
+            }
+            t(j,j) = tau(o+p+j);
         }
-        j = ap::maxint(1, i-1);
-        ap::vmove(&h(i, j), &a(i, j), ap::vlen(j,n));
+        
+        //
+        // Q(P+1:N-1,P+1:N-1) := Q - V*(T*(V'*Q))
+        //
+        rmatrixgemm<T>(true, false, ib, m, m,
+            1.0, &v(0, 0), v.getstride(),
+            &q(o+p+1, o+p+1), q.getstride(),
+            0.0, &w(0, 0), w.getstride());
+        rmatrixgemm<T>(false, false, ib, m, ib,
+            1.0, &t(0, 0), t.getstride(),
+            &w(0, 0), w.getstride(),
+            0.0, &ws.w2(0, 0), ws.w2.getstride());
+        rmatrixgemm<T>(false, false, m, m, ib,
+            -1.0, &v(0, 0), v.getstride(),
+            &ws.w2(0, 0), ws.w2.getstride(),
+            1.0, &q(o+p+1, o+p+1), q.getstride());
     }
 }
 
 
-
+template void rmatrixhessenberg<float>(ap::template_2d_array<float,true>&, int,
+     ap::template_1d_array<float,true>&);
+template void rmatrixhessenbergunpackq<float>(
+     const ap::template_2d_array<float,true>&, int,
+     const ap::template_1d_array<float,true>&,
+     ap::template_2d_array<float,true>&);
+template void rmatrixhessenbergunpackh<float>(
+     const ap::template_2d_array<float,true>&, int,
+     ap::template_2d_array<float,true>&);
+template void toupperhessenberg<float>(ap::template_2d_array<float,true>&, int,
+     ap::template_1d_array<float,true>&);
+template void toupperhessenberg<float>(ap::template_2d_array<float,true>&, int,
+     ap::template_1d_array<float,true>&, template_hessenbergworkspace<float>&);
+template void unpackqfromupperhessenberg<float>(
+     const ap::template_2d_array<float,true>&, int,
+     const ap::template_1d_array<float,true>&,
+     ap::template_2d_array<float,true>&);
+template void unpackqfromupperhessenberg<float>(
+     const ap::template_2d_array<float,true>&, int,
+     const ap::template_1d_array<float,true>&,
+     ap::template_2d_array<float,true>&, template_hessenbergworkspace<float>&);
+template void unpackhfromupperhessenberg<float>(
+     const ap::template_2d_array<float,true>&, int,
+     const ap::template_1d_array<float,true>&,
+     ap::template_2d_array<float,true>&);
+
+template void rmatrixhessenberg<double>(ap::template_2d_array<double,true>&,
+     int, ap::template_1d_array<double,true>&);
+template void rmatrixhessenbergunpackq<double>(
+     const ap::template_2d_array<double,true>&, int,
+     const ap::template_1d_array<double,true>&,
+     ap::template_2d_array<double,true>&);
+template void rmatrixhessenbergunpackh<double>(
+     const ap::template_2d_array<double,true>&, int,
+     ap::template_2d_array<double,true>&);
+template void toupperhessenberg<double>(ap::template_2d_array<double,true>&,
+     int, ap::template_1d_array<double,true>&);
+template void toupperhessenberg<double>(ap::template_2d_array<double,true>&,
+     int, ap::template_1d_array<double,true>&,
+     template_hessenbergworkspace<double>&);
+template void unpackqfromupperhessenberg<double>(
+     const ap::template_2d_array<double,true>&, int,
+     const ap::template_1d_array<double,true>&,
+     ap::template_2d_array<double,true>&);
+template void unpackqfromupperhessenberg<double>(
+     const ap::template_2d_array<double,true>&, int,
+     const ap::template_1d_array<double,true>&,
+     ap::template_2d_array<double,true>&,
+     template_hessenbergworkspace<double>&);
+template void unpackhfromupperhessenberg<double>(
+     const ap::template_2d_array<double,true>&, int,
+     const ap::template_1d_array<double,true>&,
+     ap::template_2d_array<double,true>&);
@@ -78,7 +78,8 @@ so that v(0:i) = 0, v(i+1) = 1, v(i+2:n-1) stored in A(i+2:n-1,i).
      Courant Institute, Argonne National Lab, and Rice University
      October 31, 1992
 *************************************************************************/
-void rmatrixhessenberg(ap::real_2d_array& a, int n, ap::real_1d_array& tau);
+template<class T>
+void rmatrixhessenberg(ap::template_2d_array<T,true>& a, int n, ap::template_1d_array<T,true>& tau);
 
 
 /*************************************************************************
@@ -97,10 +98,11 @@ Output parameters:
   -- ALGLIB --
      Copyright 2005 by Bochkanov Sergey
 *************************************************************************/
-void rmatrixhessenbergunpackq(const ap::real_2d_array& a,
+template<class T>
+void rmatrixhessenbergunpackq(const ap::template_2d_array<T,true>& a,
      int n,
-     const ap::real_1d_array& tau,
-     ap::real_2d_array& q);
+     const ap::template_1d_array<T,true>& tau,
+     ap::template_2d_array<T,true>& q);
 
 
 /*************************************************************************
@@ -116,36 +118,88 @@ Output parameters:
   -- ALGLIB --
      Copyright 2005 by Bochkanov Sergey
 *************************************************************************/
-void rmatrixhessenbergunpackh(const ap::real_2d_array& a,
+template<class T>
+void rmatrixhessenbergunpackh(const ap::template_2d_array<T,true>& a,
      int n,
-     ap::real_2d_array& h);
+     ap::template_2d_array<T,true>& h);
 
 
 /*************************************************************************
 Obsolete 1-based subroutine.
 See RMatrixHessenberg for 0-based replacement.
 *************************************************************************/
-void toupperhessenberg(ap::real_2d_array& a, int n, ap::real_1d_array& tau);
+template<class T>
+void toupperhessenberg(ap::template_2d_array<T,true>& a, int n, ap::template_1d_array<T,true>& tau);
+
+
+/*************************************************************************
+Temporaries of the Hessenberg reduction and of the unpacking of Q. Keep an
+instance alive between calls and no heap allocation is done in steady
+state.
+*************************************************************************/
+template<class T>
+struct template_hessenbergworkspace
+{
+    ap::template_1d_array<T,true> t;
+    ap::template_1d_array<T,true> work;
+
+    // block reflector I - V*T*V' of a panel and Y = A*V*T
+    ap::template_2d_array<T,true> v;
+    ap::template_2d_array<T,true> t2;
+    ap::template_2d_array<T,true> y;
+    ap::template_2d_array<T,true> w;
+    ap::template_2d_array<T,true> w2;
+};
+typedef template_hessenbergworkspace<double> hessenbergworkspace;
+
+
+/*************************************************************************
+Same as ToUpperHessenberg, with all temporaries taken from WS.
+
+Matrices larger than 128 are reduced in panels of 32 columns (LAPACK's
+DGEHRD): the reflections of a panel are accumulated into a block
+reflector I - V*T*V' and applied to the rest of the matrix with
+RMatrixGEMM. Only the reduction of the panel itself is level 2.
+*************************************************************************/
+template<class T>
+void toupperhessenberg(ap::template_2d_array<T,true>& a,
+     int n,
+     ap::template_1d_array<T,true>& tau,
+     template_hessenbergworkspace<T>& ws);
 
 
 /*************************************************************************
 Obsolete 1-based subroutine.
 See RMatrixHessenbergUnpackQ for 0-based replacement.
 *************************************************************************/
-void unpackqfromupperhessenberg(const ap::real_2d_array& a,
+template<class T>
+void unpackqfromupperhessenberg(const ap::template_2d_array<T,true>& a,
+     int n,
+     const ap::template_1d_array<T,true>& tau,
+     ap::template_2d_array<T,true>& q);
+
+
+/*************************************************************************
+Same as UnpackQFromUpperHessenberg, with all temporaries taken from WS.
+The reflections are applied in blocks of 32 with RMatrixGEMM.
+*************************************************************************/
+template<class T>
+void unpackqfromupperhessenberg(const ap::template_2d_array<T,true>& a,
      int n,
-     const ap::real_1d_array& tau,
-     ap::real_2d_array& q);
+     const ap::template_1d_array<T,true>& tau,
+     ap::template_2d_array<T,true>& q,
+     template_hessenbergworkspace<T>& ws);
 
 
 /*************************************************************************
 Obsolete 1-based subroutine.
 See RMatrixHessenbergUnpackH for 0-based replacement.
 *************************************************************************/
-void unpackhfromupperhessenberg(const ap::real_2d_array& a,
+template<class T>
+void unpackhfromupperhessenberg(const ap::template_2d_array<T,true>& a,
      int n,
-     const ap::real_1d_array& tau,
-     ap::real_2d_array& h);
+     const ap::template_1d_array<T,true>& tau,
+     ap::template_2d_array<T,true>& h);
 
 
 #endif
@@ -39,34 +39,38 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdafx.h>
 #include "hsschur.h"
 
+template<class T>
 static void internalauxschur(bool wantt,
      bool wantz,
      int n,
      int ilo,
      int ihi,
-     ap::real_2d_array& h,
-     ap::real_1d_array& wr,
-     ap::real_1d_array& wi,
+     ap::template_2d_array<T,true>& h,
+     ap::template_1d_array<T,true>& wr,
+     ap::template_1d_array<T,true>& wi,
      int iloz,
      int ihiz,
-     ap::real_2d_array& z,
-     ap::real_1d_array& work,
-     ap::real_1d_array& workv3,
-     ap::real_1d_array& workc1,
-     ap::real_1d_array& works1,
+     ap::template_2d_array<T,true>& z,
+     ap::template_1d_array<T,true>& work,
+     ap::template_1d_array<T,true>& workv3,
+     ap::template_1d_array<T,true>& workc1,
+     ap::template_1d_array<T,true>& works1,
      int& info);
-static void aux2x2schur(double& a,
-     double& b,
-     double& c,
-     double& d,
-     double& rt1r,
-     double& rt1i,
-     double& rt2r,
-     double& rt2i,
-     double& cs,
-     double& sn);
-static double extschursign(double a, double b);
-static int extschursigntoone(double b);
+template<class T>
+static void aux2x2schur(T& a,
+     T& b,
+     T& c,
+     T& d,
+     T& rt1r,
+     T& rt1i,
+     T& rt2r,
+     T& rt2i,
+     T& cs,
+     T& sn);
+template<class T>
+static T extschursign(T a, T b);
+template<class T>
+static int extschursigntoone(T b);
 
 /*************************************************************************
 Subroutine performing  the  Schur  decomposition  of  a  matrix  in  upper
@@ -111,13 +115,14 @@ Result:
 
 Algorithm implemented on the basis of subroutine DHSEQR (LAPACK 3.0 library).
 *************************************************************************/
-bool upperhessenbergschurdecomposition(ap::real_2d_array& h,
+template<class T>
+bool upperhessenbergschurdecomposition(ap::template_2d_array<T,true>& h,
      int n,
-     ap::real_2d_array& s)
+     ap::template_2d_array<T,true>& s)
 {
     bool result;
-    ap::real_1d_array wi;
-    ap::real_1d_array wr;
+    ap::template_1d_array<T,true> wi;
+    ap::template_1d_array<T,true> wr;
     int info;
 
     internalschurdecomposition(h, n, 1, 2, wr, wi, s, info);
@@ -126,16 +131,34 @@ bool upperhessenbergschurdecomposition(ap::real_2d_array& h,
 }
 
 
-void internalschurdecomposition(ap::real_2d_array& h,
+template<class T>
+void internalschurdecomposition(ap::template_2d_array<T,true>& h,
      int n,
      int tneeded,
      int zneeded,
-     ap::real_1d_array& wr,
-     ap::real_1d_array& wi,
-     ap::real_2d_array& z,
+     ap::template_1d_array<T,true>& wr,
+     ap::template_1d_array<T,true>& wi,
+     ap::template_2d_array<T,true>& z,
      int& info)
 {
-    ap::real_1d_array work;
+    template_schurworkspace<T> ws;
+
+    internalschurdecomposition(h, n, tneeded, zneeded, wr, wi, z, info, ws);
+}
+
+
+template<class T>
+void internalschurdecomposition(ap::template_2d_array<T,true>& h,
+     int n,
+     int tneeded,
+     int zneeded,
+     ap::template_1d_array<T,true>& wr,
+     ap::template_1d_array<T,true>& wi,
+     ap::template_2d_array<T,true>& z,
+     int& info,
+     template_schurworkspace<T>& ws)
+{
+    ap::template_1d_array<T,true>& work = ws.work;
     int i;
     int i1;
     int i2;
@@ -151,32 +174,32 @@ void internalschurdecomposition(ap::real_2d_array& h,
     int nr;
     int ns;
     int nv;
-    double absw;
-    double ovfl;
-    double smlnum;
-    double tau;
-    double temp;
-    double tst1;
-    double ulp;
-    double unfl;
-    ap::real_2d_array s;
-    ap::real_1d_array v;
-    ap::real_1d_array vv;
-    ap::real_1d_array workc1;
-    ap::real_1d_array works1;
-    ap::real_1d_array workv3;
-    ap::real_1d_array tmpwr;
-    ap::real_1d_array tmpwi;
+    T absw;
+    T ovfl;
+    T smlnum;
+    T tau;
+    T temp;
+    T tst1;
+    T ulp;
+    T unfl;
+    ap::template_2d_array<T,true>& s = ws.s;
+    ap::template_1d_array<T,true>& v = ws.v;
+    ap::template_1d_array<T,true>& vv = ws.vv;
+    ap::template_1d_array<T,true>& workc1 = ws.workc1;
+    ap::template_1d_array<T,true>& works1 = ws.works1;
+    ap::template_1d_array<T,true>& workv3 = ws.workv3;
+    ap::template_1d_array<T,true>& tmpwr = ws.tmpwr;
+    ap::template_1d_array<T,true>& tmpwi = ws.tmpwi;
     bool initz;
     bool wantt;
     bool wantz;
-    double cnst;
+    T cnst;
     bool failflag;
     int p1;
     int p2;
     int p3;
     int p4;
-    double vt;
+    T vt;
 
     
     //
@@ -303,9 +326,9 @@ void internalschurdecomposition(ap::real_2d_array& h,
         }
         return;
     }
-    unfl = ap::minrealnumber;
+    unfl = ap::realtraits<T>::minrealnumber();
     ovfl = 1/unfl;
-    ulp = 2*ap::machineepsilon;
+    ulp = 2*ap::realtraits<T>::machineepsilon();
     smlnum = unfl*(n/ulp);
     
     //
@@ -489,7 +512,7 @@ void internalschurdecomposition(ap::real_2d_array& h,
                         //
                         p1 = nv+1;
                         ap::vmove(&vv(1), &v(1), ap::vlen(1,p1));
-                        matrixvectormultiply(h, l, l+nv, l, l+nv-1, false, vv, 1, nv, 1.0, v, 1, nv+1, -wr(j));
+                        matrixvectormultiply(h, l, l+nv, l, l+nv-1, false, vv, 1, nv, T(1.0), v, 1, nv+1, -wr(j));
                         nv = nv+1;
                     }
                     else
@@ -502,14 +525,14 @@ void internalschurdecomposition(ap::real_2d_array& h,
                             //
                             p1 = nv+1;
                             ap::vmove(&vv(1), &v(1), ap::vlen(1,p1));
-                            matrixvectormultiply(h, l, l+nv, l, l+nv-1, false, v, 1, nv, 1.0, vv, 1, nv+1, -2*wr(j));
+                            matrixvectormultiply(h, l, l+nv, l, l+nv-1, false, v, 1, nv, T(1.0), vv, 1, nv+1, -2*wr(j));
                             itemp = vectoridxabsmax(vv, 1, nv+1);
                             temp = 1/ap::maxreal(fabs(vv(itemp)), smlnum);
                             p1 = nv+1;
                             ap::vmul(&vv(1), ap::vlen(1,p1), temp);
                             absw = pythag2(wr(j), wi(j));
                             temp = temp*absw*absw;
-                            matrixvectormultiply(h, l, l+nv+1, l, l+nv, false, vv, 1, nv+1, 1.0, v, 1, nv+2, temp);
+                            matrixvectormultiply(h, l, l+nv+1, l, l+nv, false, vv, 1, nv+1, T(1.0), v, 1, nv+2, temp);
                             nv = nv+2;
                         }
                     }
@@ -622,21 +645,22 @@ void internalschurdecomposition(ap::real_2d_array& h,
 }
 
 
+template<class T>
 static void internalauxschur(bool wantt,
      bool wantz,
      int n,
      int ilo,
      int ihi,
-     ap::real_2d_array& h,
-     ap::real_1d_array& wr,
-     ap::real_1d_array& wi,
+     ap::template_2d_array<T,true>& h,
+     ap::template_1d_array<T,true>& wr,
+     ap::template_1d_array<T,true>& wi,
      int iloz,
      int ihiz,
-     ap::real_2d_array& z,
-     ap::real_1d_array& work,
-     ap::real_1d_array& workv3,
-     ap::real_1d_array& workc1,
-     ap::real_1d_array& works1,
+     ap::template_2d_array<T,true>& z,
+     ap::template_1d_array<T,true>& work,
+     ap::template_1d_array<T,true>& workv3,
+     ap::template_1d_array<T,true>& workc1,
+     ap::template_1d_array<T,true>& works1,
      int& info)
 {
     int i;
@@ -651,51 +675,51 @@ static void internalauxschur(bool wantt,
     int nh;
     int nr;
     int nz;
-    double ave;
-    double cs;
-    double disc;
-    double h00;
-    double h10;
-    double h11;
-    double h12;
-    double h21;
-    double h22;
-    double h33;
-    double h33s;
-    double h43h34;
-    double h44;
-    double h44s;
-    double ovfl;
-    double s;
-    double smlnum;
-    double sn;
-    double sum;
-    double t1;
-    double t2;
-    double t3;
-    double tst1;
-    double unfl;
-    double v1;
-    double v2;
-    double v3;
+    T ave;
+    T cs;
+    T disc;
+    T h00;
+    T h10;
+    T h11;
+    T h12;
+    T h21;
+    T h22;
+    T h33;
+    T h33s;
+    T h43h34;
+    T h44;
+    T h44s;
+    T ovfl;
+    T s;
+    T smlnum;
+    T sn;
+    T sum;
+    T t1;
+    T t2;
+    T t3;
+    T tst1;
+    T unfl;
+    T v1;
+    T v2;
+    T v3;
     bool failflag;
-    double dat1;
-    double dat2;
+    T dat1;
+    T dat2;
     int p1;
-    double him1im1;
-    double him1i;
-    double hiim1;
-    double hii;
-    double wrim1;
-    double wri;
-    double wiim1;
-    double wii;
-    double ulp;
+    T him1im1;
+    T him1i;
+    T hiim1;
+    T hii;
+    T wrim1;
+    T wri;
+    T wiim1;
+    T wii;
+    T ulp;
 
     info = 0;
     dat1 = 0.75;
     dat2 = -0.4375;
-    ulp = ap::machineepsilon;
+    ulp = ap::realtraits<T>::machineepsilon();
     
     //
     // Quick return if possible
@@ -717,7 +741,7 @@ static void internalauxschur(bool wantt,
     // Set machine-dependent constants for the stopping criterion.
     // If norm(H) <= sqrt(OVFL), overflow should not occur.
     //
-    unfl = ap::minrealnumber;
+    unfl = ap::realtraits<T>::minrealnumber();
     ovfl = 1/unfl;
     smlnum = unfl*(nh/ulp);
     
@@ -1102,38 +1126,39 @@ static void internalauxschur(bool wantt,
 }
 
 
-static void aux2x2schur(double& a,
-     double& b,
-     double& c,
-     double& d,
-     double& rt1r,
-     double& rt1i,
-     double& rt2r,
-     double& rt2i,
-     double& cs,
-     double& sn)
+template<class T>
+static void aux2x2schur(T& a,
+     T& b,
+     T& c,
+     T& d,
+     T& rt1r,
+     T& rt1i,
+     T& rt2r,
+     T& rt2i,
+     T& cs,
+     T& sn)
 {
-    double multpl;
-    double aa;
-    double bb;
-    double bcmax;
-    double bcmis;
-    double cc;
-    double cs1;
-    double dd;
-    double eps;
-    double p;
-    double sab;
-    double sac;
-    double scl;
-    double sigma;
-    double sn1;
-    double tau;
-    double temp;
-    double z;
+    T multpl;
+    T aa;
+    T bb;
+    T bcmax;
+    T bcmis;
+    T cc;
+    T cs1;
+    T dd;
+    T eps;
+    T p;
+    T sab;
+    T sac;
+    T scl;
+    T sigma;
+    T sn1;
+    T tau;
+    T temp;
+    T z;
 
     multpl = 4.0;
-    eps = ap::machineepsilon;
+    eps = ap::realtraits<T>::machineepsilon();
     if( c==0 )
     {
         cs = 1;
@@ -1204,7 +1229,7 @@ static void aux2x2schur(double& a,
                     sigma = b+c;
                     tau = pythag2(sigma, temp);
                     cs = sqrt(0.5*(1+fabs(sigma)/tau));
-                    sn = -p/(tau*cs)*extschursign(double(1), sigma);
+                    sn = -p/(tau*cs)*extschursign(T(1), sigma);
                     
                     //
                     // Compute [ AA  BB ] = [ A  B ] [ CS -SN ]
@@ -1283,9 +1308,10 @@ static void aux2x2schur(double& a,
 }
 
 
-static double extschursign(double a, double b)
+template<class T>
+static T extschursign(T a, T b)
 {
-    double result;
+    T result;
 
     if( b>=0 )
     {
@@ -1299,7 +1325,8 @@ static double extschursign(double a, double b)
 }
 
 
-static int extschursigntoone(double b)
+template<class T>
+static int extschursigntoone(T b)
 {
     int result;
 
@@ -1315,4 +1342,27 @@ static int extschursigntoone(double b)
 }
 
 
+template bool upperhessenbergschurdecomposition<float>(
+     ap::template_2d_array<float,true>&, int,
+     ap::template_2d_array<float,true>&);
+template void internalschurdecomposition<float>(
+     ap::template_2d_array<float,true>&, int, int, int,
+     ap::template_1d_array<float,true>&, ap::template_1d_array<float,true>&,
+     ap::template_2d_array<float,true>&, int&);
+template void internalschurdecomposition<float>(
+     ap::template_2d_array<float,true>&, int, int, int,
+     ap::template_1d_array<float,true>&, ap::template_1d_array<float,true>&,
+     ap::template_2d_array<float,true>&, int&, template_schurworkspace<float>&);
 
+template bool upperhessenbergschurdecomposition<double>(
+     ap::template_2d_array<double,true>&, int,
+     ap::template_2d_array<double,true>&);
+template void internalschurdecomposition<double>(
+     ap::template_2d_array<double,true>&, int, int, int,
+     ap::template_1d_array<double,true>&, ap::template_1d_array<double,true>&,
+     ap::template_2d_array<double,true>&, int&);
+template void internalschurdecomposition<double>(
+     ap::template_2d_array<double,true>&, int, int, int,
+     ap::template_1d_array<double,true>&, ap::template_1d_array<double,true>&,
+     ap::template_2d_array<double,true>&, int&,
+     template_schurworkspace<double>&);
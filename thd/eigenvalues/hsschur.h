@@ -89,19 +89,53 @@ Result:
 
 Algorithm implemented on the basis of subroutine DHSEQR (LAPACK 3.0 library).
 *************************************************************************/
-bool upperhessenbergschurdecomposition(ap::real_2d_array& h,
+template<class T>
+bool upperhessenbergschurdecomposition(ap::template_2d_array<T,true>& h,
      int n,
-     ap::real_2d_array& s);
+     ap::template_2d_array<T,true>& s);
 
 
-void internalschurdecomposition(ap::real_2d_array& h,
+template<class T>
+void internalschurdecomposition(ap::template_2d_array<T,true>& h,
      int n,
      int tneeded,
      int zneeded,
-     ap::real_1d_array& wr,
-     ap::real_1d_array& wi,
-     ap::real_2d_array& z,
+     ap::template_1d_array<T,true>& wr,
+     ap::template_1d_array<T,true>& wi,
+     ap::template_2d_array<T,true>& z,
      int& info);
 
 
+/*************************************************************************
+Temporaries of InternalSchurDecomposition. An instance that is kept alive
+between calls is only reallocated when N grows.
+*************************************************************************/
+template<class T>
+struct template_schurworkspace
+{
+    ap::template_1d_array<T,true> work;
+    ap::template_2d_array<T,true> s;
+    ap::template_1d_array<T,true> v;
+    ap::template_1d_array<T,true> vv;
+    ap::template_1d_array<T,true> workc1;
+    ap::template_1d_array<T,true> works1;
+    ap::template_1d_array<T,true> workv3;
+    ap::template_1d_array<T,true> tmpwr;
+    ap::template_1d_array<T,true> tmpwi;
+};
+typedef template_schurworkspace<double> schurworkspace;
+
+
+template<class T>
+void internalschurdecomposition(ap::template_2d_array<T,true>& h,
+     int n,
+     int tneeded,
+     int zneeded,
+     ap::template_1d_array<T,true>& wr,
+     ap::template_1d_array<T,true>& wi,
+     ap::template_2d_array<T,true>& z,
+     int& info,
+     template_schurworkspace<T>& ws);
+
+
 #endif
@@ -39,41 +39,54 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdafx.h>
 #include "nsevd.h"
 
-static void internaltrevc(const ap::real_2d_array& t,
+template<class T>
+static void internaltrevc(const ap::template_2d_array<T,true>& t,
      int n,
      int side,
      int howmny,
      ap::boolean_1d_array vselect,
-     ap::real_2d_array& vl,
-     ap::real_2d_array& vr,
+     ap::template_2d_array<T,true>& vl,
+     ap::template_2d_array<T,true>& vr,
      int& m,
-     int& info);
+     int& info,
+     template_evdworkspace<T>& ws);
+template<class T>
 static void internalhsevdlaln2(const bool& ltrans,
      const int& na,
      const int& nw,
-     const double& smin,
-     const double& ca,
-     const ap::real_2d_array& a,
-     const double& d1,
-     const double& d2,
-     const ap::real_2d_array& b,
-     const double& wr,
-     const double& wi,
+     const T& smin,
+     const T& ca,
+     const ap::template_2d_array<T,true>& a,
+     const T& d1,
+     const T& d2,
+     const ap::template_2d_array<T,true>& b,
+     const T& wr,
+     const T& wi,
      ap::boolean_1d_array& rswap4,
      ap::boolean_1d_array& zswap4,
      ap::integer_2d_array& ipivot44,
-     ap::real_1d_array& civ4,
-     ap::real_1d_array& crv4,
-     ap::real_2d_array& x,
-     double& scl,
-     double& xnorm,
+     ap::template_1d_array<T,true>& civ4,
+     ap::template_1d_array<T,true>& crv4,
+     ap::template_2d_array<T,true>& x,
+     T& scl,
+     T& xnorm,
      int& info);
-static void internalhsevdladiv(const double& a,
-     const double& b,
-     const double& c,
-     const double& d,
-     double& p,
-     double& q);
+template<class T>
+static void internalhsevdladiv(const T& a,
+     const T& b,
+     const T& c,
+     const T& d,
+     T& p,
+     T& q);
+template<class T>
+static bool evdunpack(ap::template_2d_array<T,true>& a1,
+     int n,
+     int vneeded,
+     ap::template_1d_array<T,true>& wr,
+     ap::template_1d_array<T,true>& wi,
+     ap::template_2d_array<T,true>& vl,
+     ap::template_2d_array<T,true>& vr,
+     template_evdworkspace<T>& ws);
 
 /*************************************************************************
 Finding eigenvalues and eigenvectors of a general matrix
@@ -142,30 +155,90 @@ See also the InternalTREVC subroutine.
 
 The algorithm is based on the LAPACK 3.0 library.
 *************************************************************************/
-bool rmatrixevd(ap::real_2d_array a,
+template<class T>
+bool rmatrixevd(const ap::template_2d_array<T,true>& a,
      int n,
      int vneeded,
-     ap::real_1d_array& wr,
-     ap::real_1d_array& wi,
-     ap::real_2d_array& vl,
-     ap::real_2d_array& vr)
+     ap::template_1d_array<T,true>& wr,
+     ap::template_1d_array<T,true>& wi,
+     ap::template_2d_array<T,true>& vl,
+     ap::template_2d_array<T,true>& vr)
+{
+    template_evdworkspace<T> ws;
+
+    return rmatrixevd(a, n, vneeded, wr, wi, vl, vr, ws);
+}
+
+
+template<class T>
+bool rmatrixevd(const ap::template_2d_array<T,true>& a,
+     int n,
+     int vneeded,
+     ap::template_1d_array<T,true>& wr,
+     ap::template_1d_array<T,true>& wi,
+     ap::template_2d_array<T,true>& vl,
+     ap::template_2d_array<T,true>& vr,
+     template_evdworkspace<T>& ws)
 {
-    bool result;
-    ap::real_2d_array a1;
-    ap::real_2d_array vl1;
-    ap::real_2d_array vr1;
-    ap::real_1d_array wr1;
-    ap::real_1d_array wi1;
     int i;
-    double mx;
 
     ap::ap_error::make_assertion(vneeded>=0&&vneeded<=3, "RMatrixEVD: incorrect VNeeded!");
-    a1.setbounds(1, n, 1, n);
+    ws.a1.setbounds(1, n, 1, n);
     for(i = 1; i <= n; i++)
     {
-        ap::vmove(&a1(i, 1), &a(i-1, 0), ap::vlen(1,n));
+        ap::vmove(&ws.a1(i, 1), &a(i-1, 0), ap::vlen(1,n));
     }
-    result = nonsymmetricevd(a1, n, vneeded, wr1, wi1, vl1, vr1);
+    return evdunpack(ws.a1, n, vneeded, wr, wi, vl, vr, ws);
+}
+
+
+template<class T>
+bool rmatrixevdinplace(ap::template_2d_array<T,true>& a,
+     int n,
+     int vneeded,
+     ap::template_1d_array<T,true>& wr,
+     ap::template_1d_array<T,true>& wi,
+     ap::template_2d_array<T,true>& vl,
+     ap::template_2d_array<T,true>& vr,
+     template_evdworkspace<T>& ws)
+{
+    ap::ap_error::make_assertion(vneeded>=0&&vneeded<=3, "RMatrixEVD: incorrect VNeeded!");
+    ap::ap_error::make_assertion(a.getlowbound(1)==0&&a.getlowbound(2)==0, "RMatrixEVDInPlace: A must be 0-based!");
+    if( n==0 )
+    {
+        return evdunpack(a, n, vneeded, wr, wi, vl, vr, ws);
+    }
+
+    //
+    // 1-based view on the same storage
+    //
+    ws.view.attach(&a(0, 0), 1, n, 1, n, a.getstride());
+    return evdunpack(ws.view, n, vneeded, wr, wi, vl, vr, ws);
+}
+
+
+/*************************************************************************
+Runs the 1-based algorithm on A1 (which is overwritten) and copies the
+results to the 0-based output arrays
+*************************************************************************/
+template<class T>
+static bool evdunpack(ap::template_2d_array<T,true>& a1,
+     int n,
+     int vneeded,
+     ap::template_1d_array<T,true>& wr,
+     ap::template_1d_array<T,true>& wi,
+     ap::template_2d_array<T,true>& vl,
+     ap::template_2d_array<T,true>& vr,
+     template_evdworkspace<T>& ws)
+{
+    bool result;
+    int i;
+    ap::template_2d_array<T,true>& vl1 = ws.vl1;
+    ap::template_2d_array<T,true>& vr1 = ws.vr1;
+    ap::template_1d_array<T,true>& wr1 = ws.wr1;
+    ap::template_1d_array<T,true>& wi1 = ws.wi1;
+
+    result = nonsymmetricevd(a1, n, vneeded, wr1, wi1, vl1, vr1, ws);
     if( result )
     {
         wr.setbounds(0, n-1);
@@ -196,17 +269,34 @@ bool rmatrixevd(ap::real_2d_array a,
 /*************************************************************************
 Obsolete 1-based subroutine
 *************************************************************************/
-bool nonsymmetricevd(ap::real_2d_array a,
+template<class T>
+bool nonsymmetricevd(ap::template_2d_array<T,true> a,
      int n,
      int vneeded,
-     ap::real_1d_array& wr,
-     ap::real_1d_array& wi,
-     ap::real_2d_array& vl,
-     ap::real_2d_array& vr)
+     ap::template_1d_array<T,true>& wr,
+     ap::template_1d_array<T,true>& wi,
+     ap::template_2d_array<T,true>& vl,
+     ap::template_2d_array<T,true>& vr)
+{
+    template_evdworkspace<T> ws;
+
+    return nonsymmetricevd(a, n, vneeded, wr, wi, vl, vr, ws);
+}
+
+
+template<class T>
+bool nonsymmetricevd(ap::template_2d_array<T,true>& a,
+     int n,
+     int vneeded,
+     ap::template_1d_array<T,true>& wr,
+     ap::template_1d_array<T,true>& wi,
+     ap::template_2d_array<T,true>& vl,
+     ap::template_2d_array<T,true>& vr,
+     template_evdworkspace<T>& ws)
 {
     bool result;
-    ap::real_2d_array s;
-    ap::real_1d_array tau;
+    ap::template_2d_array<T,true>& s = ws.s;
+    ap::template_1d_array<T,true>& tau = ws.tau;
     ap::boolean_1d_array sel;
     int i;
     int info;
@@ -219,8 +309,8 @@ bool nonsymmetricevd(ap::real_2d_array a,
         //
         // Eigen values only
         //
-        toupperhessenberg(a, n, tau);
-        internalschurdecomposition(a, n, 0, 0, wr, wi, s, info);
+        toupperhessenberg(a, n, tau, ws.hessenberg);
+        internalschurdecomposition(a, n, 0, 0, wr, wi, s, info, ws.schur);
         result = info==0;
         return result;
     }
@@ -228,9 +318,9 @@ bool nonsymmetricevd(ap::real_2d_array a,
     //
     // Eigen values and vectors
     //
-    toupperhessenberg(a, n, tau);
-    unpackqfromupperhessenberg(a, n, tau, s);
-    internalschurdecomposition(a, n, 1, 1, wr, wi, s, info);
+    toupperhessenberg(a, n, tau, ws.hessenberg);
+    unpackqfromupperhessenberg(a, n, tau, s, ws.hessenberg);
+    internalschurdecomposition(a, n, 1, 1, wr, wi, s, info, ws.schur);
     result = info==0;
     if( !result )
     {
@@ -252,21 +342,23 @@ bool nonsymmetricevd(ap::real_2d_array a,
             ap::vmove(&vl(i, 1), &s(i, 1), ap::vlen(1,n));
         }
     }
-    internaltrevc(a, n, vneeded, 1, sel, vl, vr, m, info);
+    internaltrevc(a, n, vneeded, 1, sel, vl, vr, m, info, ws);
     result = info==0;
     return result;
 }
 
 
-static void internaltrevc(const ap::real_2d_array& t,
+template<class T>
+static void internaltrevc(const ap::template_2d_array<T,true>& t,
      int n,
      int side,
      int howmny,
      ap::boolean_1d_array vselect,
-     ap::real_2d_array& vl,
-     ap::real_2d_array& vr,
+     ap::template_2d_array<T,true>& vl,
+     ap::template_2d_array<T,true>& vr,
      int& m,
-     int& info)
+     int& info,
+     template_evdworkspace<T>& ws)
 {
     bool allv;
     bool bothv;
@@ -287,42 +379,42 @@ static void internaltrevc(const ap::real_2d_array& t,
     int k;
     int ki;
     int n2;
-    double beta;
-    double bignum;
-    double emax;
-    double ovfl;
-    double rec;
-    double remax;
-    double scl;
-    double smin;
-    double smlnum;
-    double ulp;
-    double unfl;
-    double vcrit;
-    double vmax;
-    double wi;
-    double wr;
-    double xnorm;
-    ap::real_2d_array x;
-    ap::real_1d_array work;
-    ap::real_1d_array temp;
-    ap::real_2d_array temp11;
-    ap::real_2d_array temp22;
-    ap::real_2d_array temp11b;
-    ap::real_2d_array temp21b;
-    ap::real_2d_array temp12b;
-    ap::real_2d_array temp22b;
+    T beta;
+    T bignum;
+    T emax;
+    T ovfl;
+    T rec;
+    T remax;
+    T scl;
+    T smin;
+    T smlnum;
+    T ulp;
+    T unfl;
+    T vcrit;
+    T vmax;
+    T wi;
+    T wr;
+    T xnorm;
+    ap::template_2d_array<T,true>& x = ws.x;
+    ap::template_1d_array<T,true>& work = ws.trevcwork;
+    ap::template_1d_array<T,true>& temp = ws.temp;
+    ap::template_2d_array<T,true>& temp11 = ws.temp11;
+    ap::template_2d_array<T,true>& temp22 = ws.temp22;
+    ap::template_2d_array<T,true>& temp11b = ws.temp11b;
+    ap::template_2d_array<T,true>& temp21b = ws.temp21b;
+    ap::template_2d_array<T,true>& temp12b = ws.temp12b;
+    ap::template_2d_array<T,true>& temp22b = ws.temp22b;
     bool skipflag;
     int k1;
     int k2;
     int k3;
     int k4;
-    double vt;
-    ap::boolean_1d_array rswap4;
-    ap::boolean_1d_array zswap4;
-    ap::integer_2d_array ipivot44;
-    ap::real_1d_array civ4;
-    ap::real_1d_array crv4;
+    T vt;
+    ap::boolean_1d_array& rswap4 = ws.rswap4;
+    ap::boolean_1d_array& zswap4 = ws.zswap4;
+    ap::integer_2d_array& ipivot44 = ws.ipivot44;
+    ap::template_1d_array<T,true>& civ4 = ws.civ4;
+    ap::template_1d_array<T,true>& crv4 = ws.crv4;
 
     x.setbounds(1, 2, 1, 2);
     temp11.setbounds(1, 1, 1, 1);
@@ -439,9 +531,9 @@ static void internaltrevc(const ap::real_2d_array& t,
     //
     // Set the constants to control overflow.
     //
-    unfl = ap::minrealnumber;
+    unfl = ap::realtraits<T>::minrealnumber();
     ovfl = 1/unfl;
-    ulp = ap::machineepsilon;
+    ulp = ap::realtraits<T>::machineepsilon();
     smlnum = unfl*(n/ulp);
     bignum = (1-ulp)/smlnum;
 
@@ -567,7 +659,7 @@ static void internaltrevc(const ap::real_2d_array& t,
                             //
                             temp11(1,1) = t(j,j);
                             temp11b(1,1) = work(j+n);
-                            internalhsevdlaln2(false, 1, 1, smin, double(1), temp11, 1.0, 1.0, temp11b, wr, 0.0, rswap4, zswap4, ipivot44, civ4, crv4, x, scl, xnorm, ierr);
+                            internalhsevdlaln2(false, 1, 1, smin, T(1), temp11, T(1.0), T(1.0), temp11b, wr, T(0.0), rswap4, zswap4, ipivot44, civ4, crv4, x, scl, xnorm, ierr);
 
                             //
                             // Scale X(1,1) to avoid overflow when updating
@@ -614,7 +706,7 @@ static void internaltrevc(const ap::real_2d_array& t,
                             temp22(2,2) = t(j,j);
                             temp21b(1,1) = work(j-1+n);
                             temp21b(2,1) = work(j+n);
-                            internalhsevdlaln2(false, 2, 1, smin, 1.0, temp22, 1.0, 1.0, temp21b, wr, double(0), rswap4, zswap4, ipivot44, civ4, crv4, x, scl, xnorm, ierr);
+                            internalhsevdlaln2(false, 2, 1, smin, T(1.0), temp22, T(1.0), T(1.0), temp21b, wr, T(0), rswap4, zswap4, ipivot44, civ4, crv4, x, scl, xnorm, ierr);
 
                             //
                             // Scale X(1,1) and X(2,1) to avoid overflow when
@@ -678,7 +770,7 @@ static void internaltrevc(const ap::real_2d_array& t,
                         if( ki>1 )
                         {
                             ap::vmove(temp.getvector(1, n), vr.getcolumn(ki, 1, n));
-                            matrixvectormultiply(vr, 1, n, 1, ki-1, false, work, 1+n, ki-1+n, 1.0, temp, 1, n, work(ki+n));
+                            matrixvectormultiply(vr, 1, n, 1, ki-1, false, work, 1+n, ki-1+n, T(1.0), temp, 1, n, work(ki+n));
                             ap::vmove(vr.getcolumn(ki, 1, n), temp.getvector(1, n));
                         }
                         ii = columnidxabsmax(vr, 1, n, ki);
@@ -749,7 +841,7 @@ static void internaltrevc(const ap::real_2d_array& t,
                             temp11(1,1) = t(j,j);
                             temp12b(1,1) = work(j+n);
                             temp12b(1,2) = work(j+n+n);
-                            internalhsevdlaln2(false, 1, 2, smin, 1.0, temp11, 1.0, 1.0, temp12b, wr, wi, rswap4, zswap4, ipivot44, civ4, crv4, x, scl, xnorm, ierr);
+                            internalhsevdlaln2(false, 1, 2, smin, T(1.0), temp11, T(1.0), T(1.0), temp12b, wr, wi, rswap4, zswap4, ipivot44, civ4, crv4, x, scl, xnorm, ierr);
 
                             //
                             // Scale X(1,1) and X(1,2) to avoid overflow when
@@ -810,7 +902,7 @@ static void internaltrevc(const ap::real_2d_array& t,
                             temp22b(1,2) = work(j-1+n+n);
                             temp22b(2,1) = work(j+n);
                             temp22b(2,2) = work(j+n+n);
-                            internalhsevdlaln2(false, 2, 2, smin, 1.0, temp22, 1.0, 1.0, temp22b, wr, wi, rswap4, zswap4, ipivot44, civ4, crv4, x, scl, xnorm, ierr);
+                            internalhsevdlaln2(false, 2, 2, smin, T(1.0), temp22, T(1.0), T(1.0), temp22b, wr, wi, rswap4, zswap4, ipivot44, civ4, crv4, x, scl, xnorm, ierr);
 
                             //
                             // Scale X to avoid overflow when updating
@@ -883,10 +975,10 @@ static void internaltrevc(const ap::real_2d_array& t,
                         if( ki>2 )
                         {
                             ap::vmove(temp.getvector(1, n), vr.getcolumn(ki-1, 1, n));
-                            matrixvectormultiply(vr, 1, n, 1, ki-2, false, work, 1+n, ki-2+n, 1.0, temp, 1, n, work(ki-1+n));
+                            matrixvectormultiply(vr, 1, n, 1, ki-2, false, work, 1+n, ki-2+n, T(1.0), temp, 1, n, work(ki-1+n));
                             ap::vmove(vr.getcolumn(ki-1, 1, n), temp.getvector(1, n));
                             ap::vmove(temp.getvector(1, n), vr.getcolumn(ki, 1, n));
-                            matrixvectormultiply(vr, 1, n, 1, ki-2, false, work, 1+n2, ki-2+n2, 1.0, temp, 1, n, work(ki+n2));
+                            matrixvectormultiply(vr, 1, n, 1, ki-2, false, work, 1+n2, ki-2+n2, T(1.0), temp, 1, n, work(ki+n2));
                             ap::vmove(vr.getcolumn(ki, 1, n), temp.getvector(1, n));
                         }
                         else
@@ -1031,7 +1123,7 @@ static void internaltrevc(const ap::real_2d_array& t,
                             //
                             temp11(1,1) = t(j,j);
                             temp11b(1,1) = work(j+n);
-                            internalhsevdlaln2(false, 1, 1, smin, 1.0, temp11, 1.0, 1.0, temp11b, wr, double(0), rswap4, zswap4, ipivot44, civ4, crv4, x, scl, xnorm, ierr);
+                            internalhsevdlaln2(false, 1, 1, smin, T(1.0), temp11, T(1.0), T(1.0), temp11b, wr, T(0), rswap4, zswap4, ipivot44, civ4, crv4, x, scl, xnorm, ierr);
 
                             //
                             // Scale if necessary
@@ -1077,7 +1169,7 @@ static void internaltrevc(const ap::real_2d_array& t,
                             temp22(2,2) = t(j+1,j+1);
                             temp21b(1,1) = work(j+n);
                             temp21b(2,1) = work(j+1+n);
-                            internalhsevdlaln2(true, 2, 1, smin, 1.0, temp22, 1.0, 1.0, temp21b, wr, double(0), rswap4, zswap4, ipivot44, civ4, crv4, x, scl, xnorm, ierr);
+                            internalhsevdlaln2(true, 2, 1, smin, T(1.0), temp22, T(1.0), T(1.0), temp21b, wr, T(0), rswap4, zswap4, ipivot44, civ4, crv4, x, scl, xnorm, ierr);
 
                             //
                             // Scale if necessary
@@ -1112,7 +1204,7 @@ static void internaltrevc(const ap::real_2d_array& t,
                         if( ki<n )
                         {
                             ap::vmove(temp.getvector(1, n), vl.getcolumn(ki, 1, n));
-                            matrixvectormultiply(vl, 1, n, ki+1, n, false, work, ki+1+n, n+n, 1.0, temp, 1, n, work(ki+n));
+                            matrixvectormultiply(vl, 1, n, ki+1, n, false, work, ki+1+n, n+n, T(1.0), temp, 1, n, work(ki+n));
                             ap::vmove(vl.getcolumn(ki, 1, n), temp.getvector(1, n));
                         }
                         ii = columnidxabsmax(vl, 1, n, ki);
@@ -1204,7 +1296,7 @@ static void internaltrevc(const ap::real_2d_array& t,
                             temp11(1,1) = t(j,j);
                             temp12b(1,1) = work(j+n);
                             temp12b(1,2) = work(j+n+n);
-                            internalhsevdlaln2(false, 1, 2, smin, 1.0, temp11, 1.0, 1.0, temp12b, wr, -wi, rswap4, zswap4, ipivot44, civ4, crv4, x, scl, xnorm, ierr);
+                            internalhsevdlaln2(false, 1, 2, smin, T(1.0), temp11, T(1.0), T(1.0), temp12b, wr, -wi, rswap4, zswap4, ipivot44, civ4, crv4, x, scl, xnorm, ierr);
 
                             //
                             // Scale if necessary
@@ -1259,7 +1351,7 @@ static void internaltrevc(const ap::real_2d_array& t,
                             temp22b(1,2) = work(j+n+n);
                             temp22b(2,1) = work(j+1+n);
                             temp22b(2,2) = work(j+1+n+n);
-                            internalhsevdlaln2(true, 2, 2, smin, 1.0, temp22, 1.0, 1.0, temp22b, wr, -wi, rswap4, zswap4, ipivot44, civ4, crv4, x, scl, xnorm, ierr);
+                            internalhsevdlaln2(true, 2, 2, smin, T(1.0), temp22, T(1.0), T(1.0), temp22b, wr, -wi, rswap4, zswap4, ipivot44, civ4, crv4, x, scl, xnorm, ierr);
 
                             //
                             // Scale if necessary
@@ -1307,10 +1399,10 @@ static void internaltrevc(const ap::real_2d_array& t,
                         if( ki<n-1 )
                         {
                             ap::vmove(temp.getvector(1, n), vl.getcolumn(ki, 1, n));
-                            matrixvectormultiply(vl, 1, n, ki+2, n, false, work, ki+2+n, n+n, 1.0, temp, 1, n, work(ki+n));
+                            matrixvectormultiply(vl, 1, n, ki+2, n, false, work, ki+2+n, n+n, T(1.0), temp, 1, n, work(ki+n));
                             ap::vmove(vl.getcolumn(ki, 1, n), temp.getvector(1, n));
                             ap::vmove(temp.getvector(1, n), vl.getcolumn(ki+1, 1, n));
-                            matrixvectormultiply(vl, 1, n, ki+2, n, false, work, ki+2+n2, n+n2, 1.0, temp, 1, n, work(ki+1+n2));
+                            matrixvectormultiply(vl, 1, n, ki+2, n, false, work, ki+2+n2, n+n2, T(1.0), temp, 1, n, work(ki+1+n2));
                             ap::vmove(vl.getcolumn(ki+1, 1, n), temp.getvector(1, n));
                         }
                         else
@@ -1349,66 +1441,67 @@ static void internaltrevc(const ap::real_2d_array& t,
 }
 
 
+template<class T>
 static void internalhsevdlaln2(const bool& ltrans,
      const int& na,
      const int& nw,
-     const double& smin,
-     const double& ca,
-     const ap::real_2d_array& a,
-     const double& d1,
-     const double& d2,
-     const ap::real_2d_array& b,
-     const double& wr,
-     const double& wi,
+     const T& smin,
+     const T& ca,
+     const ap::template_2d_array<T,true>& a,
+     const T& d1,
+     const T& d2,
+     const ap::template_2d_array<T,true>& b,
+     const T& wr,
+     const T& wi,
      ap::boolean_1d_array& rswap4,
      ap::boolean_1d_array& zswap4,
      ap::integer_2d_array& ipivot44,
-     ap::real_1d_array& civ4,
-     ap::real_1d_array& crv4,
-     ap::real_2d_array& x,
-     double& scl,
-     double& xnorm,
+     ap::template_1d_array<T,true>& civ4,
+     ap::template_1d_array<T,true>& crv4,
+     ap::template_2d_array<T,true>& x,
+     T& scl,
+     T& xnorm,
      int& info)
 {
     int icmax;
     int j;
-    double bbnd;
-    double bi1;
-    double bi2;
-    double bignum;
-    double bnorm;
-    double br1;
-    double br2;
-    double ci21;
-    double ci22;
-    double cmax;
-    double cnorm;
-    double cr21;
-    double cr22;
-    double csi;
-    double csr;
-    double li21;
-    double lr21;
-    double smini;
-    double smlnum;
-    double temp;
-    double u22abs;
-    double ui11;
-    double ui11r;
-    double ui12;
-    double ui12s;
-    double ui22;
-    double ur11;
-    double ur11r;
-    double ur12;
-    double ur12s;
-    double ur22;
-    double xi1;
-    double xi2;
-    double xr1;
-    double xr2;
-    double tmp1;
-    double tmp2;
+    T bbnd;
+    T bi1;
+    T bi2;
+    T bignum;
+    T bnorm;
+    T br1;
+    T br2;
+    T ci21;
+    T ci22;
+    T cmax;
+    T cnorm;
+    T cr21;
+    T cr22;
+    T csi;
+    T csr;
+    T li21;
+    T lr21;
+    T smini;
+    T smlnum;
+    T temp;
+    T u22abs;
+    T ui11;
+    T ui11r;
+    T ui12;
+    T ui12s;
+    T ui22;
+    T ur11;
+    T ur11r;
+    T ur12;
+    T ur12s;
+    T ur22;
+    T xi1;
+    T xi2;
+    T xr1;
+    T xr2;
+    T tmp1;
+    T tmp2;
 
     zswap4(1) = false;
     zswap4(2) = false;
@@ -1434,7 +1527,7 @@ static void internalhsevdlaln2(const bool& ltrans,
     ipivot44(2,4) = 3;
     ipivot44(3,4) = 2;
     ipivot44(4,4) = 1;
-    smlnum = 2*ap::minrealnumber;
+    smlnum = 2*ap::realtraits<T>::minrealnumber();
     bignum = 1/smlnum;
     smini = ap::maxreal(smin, smlnum);
 
@@ -1839,15 +1932,16 @@ static void internalhsevdlaln2(const bool& ltrans,
 }
 
 
-static void internalhsevdladiv(const double& a,
-     const double& b,
-     const double& c,
-     const double& d,
-     double& p,
-     double& q)
+template<class T>
+static void internalhsevdladiv(const T& a,
+     const T& b,
+     const T& c,
+     const T& d,
+     T& p,
+     T& q)
 {
-    double e;
-    double f;
+    T e;
+    T f;
 
     if( fabs(d)<fabs(c) )
     {
@@ -1866,4 +1960,44 @@ static void internalhsevdladiv(const double& a,
 }
 
 
-
+template bool rmatrixevd<float>(const ap::template_2d_array<float,true>&, int,
+     int, ap::template_1d_array<float,true>&,
+     ap::template_1d_array<float,true>&, ap::template_2d_array<float,true>&,
+     ap::template_2d_array<float,true>&);
+template bool rmatrixevd<float>(const ap::template_2d_array<float,true>&, int,
+     int, ap::template_1d_array<float,true>&,
+     ap::template_1d_array<float,true>&, ap::template_2d_array<float,true>&,
+     ap::template_2d_array<float,true>&, template_evdworkspace<float>&);
+template bool rmatrixevdinplace<float>(ap::template_2d_array<float,true>&, int,
+     int, ap::template_1d_array<float,true>&,
+     ap::template_1d_array<float,true>&, ap::template_2d_array<float,true>&,
+     ap::template_2d_array<float,true>&, template_evdworkspace<float>&);
+template bool nonsymmetricevd<float>(ap::template_2d_array<float,true>, int,
+     int, ap::template_1d_array<float,true>&,
+     ap::template_1d_array<float,true>&, ap::template_2d_array<float,true>&,
+     ap::template_2d_array<float,true>&);
+template bool nonsymmetricevd<float>(ap::template_2d_array<float,true>&, int,
+     int, ap::template_1d_array<float,true>&,
+     ap::template_1d_array<float,true>&, ap::template_2d_array<float,true>&,
+     ap::template_2d_array<float,true>&, template_evdworkspace<float>&);
+
+template bool rmatrixevd<double>(const ap::template_2d_array<double,true>&, int,
+     int, ap::template_1d_array<double,true>&,
+     ap::template_1d_array<double,true>&, ap::template_2d_array<double,true>&,
+     ap::template_2d_array<double,true>&);
+template bool rmatrixevd<double>(const ap::template_2d_array<double,true>&, int,
+     int, ap::template_1d_array<double,true>&,
+     ap::template_1d_array<double,true>&, ap::template_2d_array<double,true>&,
+     ap::template_2d_array<double,true>&, template_evdworkspace<double>&);
+template bool rmatrixevdinplace<double>(ap::template_2d_array<double,true>&,
+     int, int, ap::template_1d_array<double,true>&,
+     ap::template_1d_array<double,true>&, ap::template_2d_array<double,true>&,
+     ap::template_2d_array<double,true>&, template_evdworkspace<double>&);
+template bool nonsymmetricevd<double>(ap::template_2d_array<double,true>, int,
+     int, ap::template_1d_array<double,true>&,
+     ap::template_1d_array<double,true>&, ap::template_2d_array<double,true>&,
+     ap::template_2d_array<double,true>&);
+template bool nonsymmetricevd<double>(ap::template_2d_array<double,true>&, int,
+     int, ap::template_1d_array<double,true>&,
+     ap::template_1d_array<double,true>&, ap::template_2d_array<double,true>&,
+     ap::template_2d_array<double,true>&, template_evdworkspace<double>&);
@@ -48,6 +48,47 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "hessenberg.h"
 
 
+/*************************************************************************
+Temporaries of RMatrixEVD and the routines it calls. Keep an instance alive
+between calls of the same (or smaller) size and no heap allocation is done
+in steady state. An instance must not be shared between threads.
+*************************************************************************/
+template<class T>
+struct template_evdworkspace
+{
+    // 1-based copy of A, or a 1-based view on A for the in-place variant
+    ap::template_2d_array<T,true> a1;
+    ap::template_2d_array<T,true> view;
+    ap::template_2d_array<T,true> vl1;
+    ap::template_2d_array<T,true> vr1;
+    ap::template_1d_array<T,true> wr1;
+    ap::template_1d_array<T,true> wi1;
+
+    // Hessenberg reduction and Schur decomposition
+    ap::template_2d_array<T,true> s;
+    ap::template_1d_array<T,true> tau;
+    template_hessenbergworkspace<T> hessenberg;
+    template_schurworkspace<T> schur;
+
+    // eigenvectors of the quasi-triangular matrix (InternalTREVC)
+    ap::template_2d_array<T,true> x;
+    ap::template_1d_array<T,true> trevcwork;
+    ap::template_1d_array<T,true> temp;
+    ap::template_2d_array<T,true> temp11;
+    ap::template_2d_array<T,true> temp22;
+    ap::template_2d_array<T,true> temp11b;
+    ap::template_2d_array<T,true> temp21b;
+    ap::template_2d_array<T,true> temp12b;
+    ap::template_2d_array<T,true> temp22b;
+    ap::boolean_1d_array rswap4;
+    ap::boolean_1d_array zswap4;
+    ap::integer_2d_array ipivot44;
+    ap::template_1d_array<T,true> civ4;
+    ap::template_1d_array<T,true> crv4;
+};
+typedef template_evdworkspace<double> evdworkspace;
+
+
 /*************************************************************************
 Finding eigenvalues and eigenvectors of a general matrix
 
@@ -113,27 +154,76 @@ Note 2:
 
 See also the InternalTREVC subroutine.
 
+Instantiated for float and double (ap::float_2d_array, ap::real_2d_array).
+In float the eigenvalues have an error of about 1E-6 times the norm of A.
+
 The algorithm is based on the LAPACK 3.0 library.
 *************************************************************************/
-bool rmatrixevd(ap::real_2d_array a,
+template<class T>
+bool rmatrixevd(const ap::template_2d_array<T,true>& a,
+     int n,
+     int vneeded,
+     ap::template_1d_array<T,true>& wr,
+     ap::template_1d_array<T,true>& wi,
+     ap::template_2d_array<T,true>& vl,
+     ap::template_2d_array<T,true>& vr);
+
+
+/*************************************************************************
+Same as RMatrixEVD, with all temporaries taken from WS.
+*************************************************************************/
+template<class T>
+bool rmatrixevd(const ap::template_2d_array<T,true>& a,
      int n,
      int vneeded,
-     ap::real_1d_array& wr,
-     ap::real_1d_array& wi,
-     ap::real_2d_array& vl,
-     ap::real_2d_array& vr);
+     ap::template_1d_array<T,true>& wr,
+     ap::template_1d_array<T,true>& wi,
+     ap::template_2d_array<T,true>& vl,
+     ap::template_2d_array<T,true>& vr,
+     template_evdworkspace<T>& ws);
+
+
+/*************************************************************************
+Same as RMatrixEVD, but A is overwritten (its contents are undefined on
+return) instead of copied. A must be 0-based.
+*************************************************************************/
+template<class T>
+bool rmatrixevdinplace(ap::template_2d_array<T,true>& a,
+     int n,
+     int vneeded,
+     ap::template_1d_array<T,true>& wr,
+     ap::template_1d_array<T,true>& wi,
+     ap::template_2d_array<T,true>& vl,
+     ap::template_2d_array<T,true>& vr,
+     template_evdworkspace<T>& ws);
 
 
 /*************************************************************************
 Obsolete 1-based subroutine
 *************************************************************************/
-bool nonsymmetricevd(ap::real_2d_array a,
+template<class T>
+bool nonsymmetricevd(ap::template_2d_array<T,true> a,
+     int n,
+     int vneeded,
+     ap::template_1d_array<T,true>& wr,
+     ap::template_1d_array<T,true>& wi,
+     ap::template_2d_array<T,true>& vl,
+     ap::template_2d_array<T,true>& vr);
+
+
+/*************************************************************************
+Obsolete 1-based subroutine, A is overwritten and temporaries are taken
+from WS
+*************************************************************************/
+template<class T>
+bool nonsymmetricevd(ap::template_2d_array<T,true>& a,
      int n,
      int vneeded,
-     ap::real_1d_array& wr,
-     ap::real_1d_array& wi,
-     ap::real_2d_array& vl,
-     ap::real_2d_array& vr);
+     ap::template_1d_array<T,true>& wr,
+     ap::template_1d_array<T,true>& wi,
+     ap::template_2d_array<T,true>& vl,
+     ap::template_2d_array<T,true>& vr,
+     template_evdworkspace<T>& ws);
 
 
 #endif
@@ -83,14 +83,15 @@ MODIFICATIONS:
      Courant Institute, Argonne National Lab, and Rice University
      September 30, 1994
 *************************************************************************/
-void generatereflection(ap::real_1d_array& x, int n, double& tau)
+template<class T>
+void generatereflection(ap::template_1d_array<T,true>& x, int n, T& tau)
 {
     int j;
-    double alpha;
-    double xnorm;
-    double v;
-    double beta;
-    double mx;
+    T alpha;
+    T xnorm;
+    T v;
+    T beta;
+    T mx;
 
     
     //
@@ -174,16 +175,17 @@ Output parameters:
      Courant Institute, Argonne National Lab, and Rice University
      September 30, 1994
 *************************************************************************/
-void applyreflectionfromtheleft(ap::real_2d_array& c,
-     double tau,
-     const ap::real_1d_array& v,
+template<class T>
+void applyreflectionfromtheleft(ap::template_2d_array<T,true>& c,
+     T tau,
+     const ap::template_1d_array<T,true>& v,
      int m1,
      int m2,
      int n1,
      int n2,
-     ap::real_1d_array& work)
+     ap::template_1d_array<T,true>& work)
 {
-    double t;
+    T t;
     int i;
     int vm;
 
@@ -233,7 +235,7 @@ Input parameters:
                 Array whose index ranges within [1..N2-N1+1].
     M1, M2  -   range of rows to be transformed.
     N1, N2  -   range of columns to be transformed.
-    WORK    -   working array whose indexes goes from M1 to M2.
+    WORK    -   not used, kept for compatibility.
 
 Output parameters:
     C       -   the result of multiplying the input matrix C by the
@@ -245,18 +247,21 @@ Output parameters:
      Courant Institute, Argonne National Lab, and Rice University
      September 30, 1994
 *************************************************************************/
-void applyreflectionfromtheright(ap::real_2d_array& c,
-     double tau,
-     const ap::real_1d_array& v,
+template<class T>
+void applyreflectionfromtheright(ap::template_2d_array<T,true>& c,
+     T tau,
+     const ap::template_1d_array<T,true>& v,
      int m1,
      int m2,
      int n1,
      int n2,
-     ap::real_1d_array& work)
+     ap::template_1d_array<T,true>&)
 {
-    double t;
+    T t;
     int i;
     int vm;
+    const T *vv;
+    T *ci;
 
     if( tau==0||n1>n2||m1>m2 )
     {
@@ -264,22 +269,16 @@ void applyreflectionfromtheright(ap::real_2d_array& c,
     }
     
     //
-    // w := C * v
+    // C := C - tau * (C*v) * v', a row at a time so that the row is still
+    // in the cache when it is updated
     //
     vm = n2-n1+1;
+    vv = &v(1);
     for(i = m1; i <= m2; i++)
     {
-        t = ap::vdotproduct(&c(i, n1), &v(1), ap::vlen(n1,n2));
-        work(i) = t;
-    }
-    
-    //
-    // C := C - w * v'
-    //
-    for(i = m1; i <= m2; i++)
-    {
-        t = work(i)*tau;
-        ap::vsub(&c(i, n1), &v(1), ap::vlen(n1,n2), t);
+        ci = &c(i, n1);
+        t = ap::vdotproduct(ci, vv, vm)*tau;
+        ap::vsub(ci, vv, vm, t);
     }
 }
 
@@ -501,4 +500,24 @@ static void testreflections()
 }
 
 
-
+template void generatereflection<float>(ap::template_1d_array<float,true>&, int,
+     float&);
+template void applyreflectionfromtheleft<float>(
+     ap::template_2d_array<float,true>&, float,
+     const ap::template_1d_array<float,true>&, int, int, int, int,
+     ap::template_1d_array<float,true>&);
+template void applyreflectionfromtheright<float>(
+     ap::template_2d_array<float,true>&, float,
+     const ap::template_1d_array<float,true>&, int, int, int, int,
+     ap::template_1d_array<float,true>&);
+
+template void generatereflection<double>(ap::template_1d_array<double,true>&,
+     int, double&);
+template void applyreflectionfromtheleft<double>(
+     ap::template_2d_array<double,true>&, double,
+     const ap::template_1d_array<double,true>&, int, int, int, int,
+     ap::template_1d_array<double,true>&);
+template void applyreflectionfromtheright<double>(
+     ap::template_2d_array<double,true>&, double,
+     const ap::template_1d_array<double,true>&, int, int, int, int,
+     ap::template_1d_array<double,true>&);
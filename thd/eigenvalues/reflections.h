@@ -82,7 +82,8 @@ MODIFICATIONS:
      Courant Institute, Argonne National Lab, and Rice University
      September 30, 1994
 *************************************************************************/
-void generatereflection(ap::real_1d_array& x, int n, double& tau);
+template<class T>
+void generatereflection(ap::template_1d_array<T,true>& x, int n, T& tau);
 
 
 /*************************************************************************
@@ -113,14 +114,15 @@ Output parameters:
      Courant Institute, Argonne National Lab, and Rice University
      September 30, 1994
 *************************************************************************/
-void applyreflectionfromtheleft(ap::real_2d_array& c,
-     double tau,
-     const ap::real_1d_array& v,
+template<class T>
+void applyreflectionfromtheleft(ap::template_2d_array<T,true>& c,
+     T tau,
+     const ap::template_1d_array<T,true>& v,
      int m1,
      int m2,
      int n1,
      int n2,
-     ap::real_1d_array& work);
+     ap::template_1d_array<T,true>& work);
 
 
 /*************************************************************************
@@ -139,7 +141,7 @@ Input parameters:
                 Array whose index ranges within [1..N2-N1+1].
     M1, M2  -   range of rows to be transformed.
     N1, N2  -   range of columns to be transformed.
-    WORK    -   working array whose indexes goes from M1 to M2.
+    WORK    -   not used, kept for compatibility.
 
 Output parameters:
     C       -   the result of multiplying the input matrix C by the
@@ -151,14 +153,15 @@ Output parameters:
      Courant Institute, Argonne National Lab, and Rice University
      September 30, 1994
 *************************************************************************/
-void applyreflectionfromtheright(ap::real_2d_array& c,
-     double tau,
-     const ap::real_1d_array& v,
+template<class T>
+void applyreflectionfromtheright(ap::template_2d_array<T,true>& c,
+     T tau,
+     const ap::template_1d_array<T,true>& v,
      int m1,
      int m2,
      int n1,
      int n2,
-     ap::real_1d_array& work);
+     ap::template_1d_array<T,true>& work);
 
 
 #endif
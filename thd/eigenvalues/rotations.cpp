@@ -39,7 +39,10 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdafx.h>
 #include <stdio.h>
 #include "rotations.h"
+#include "apsimd.h"
 
+template<class T>
+static void rotaterows(T *x, T *y, int n, T c, T s);
 static void testrotations();
 
 /*************************************************************************
@@ -60,28 +63,28 @@ Input parameters:
     C,S         -   transformation coefficients.
                     Array whose index ranges within [1..M2-M1].
     A           -   processed matrix.
-    WORK        -   working array whose index ranges within [N1..N2].
+    WORK        -   not used, kept for compatibility.
 
 Output parameters:
     A           -   transformed matrix.
 
 Utility subroutine.
 *************************************************************************/
+template<class T>
 void applyrotationsfromtheleft(bool isforward,
      int m1,
      int m2,
      int n1,
      int n2,
-     const ap::real_1d_array& c,
-     const ap::real_1d_array& s,
-     ap::real_2d_array& a,
-     ap::real_1d_array& work)
+     const ap::template_1d_array<T,true>& c,
+     const ap::template_1d_array<T,true>& s,
+     ap::template_2d_array<T,true>& a,
+     ap::template_1d_array<T,true>&)
 {
     int j;
-    int jp1;
-    double ctemp;
-    double stemp;
-    double temp;
+    T ctemp;
+    T stemp;
+    T temp;
 
     if( m1>m2||n1>n2 )
     {
@@ -105,12 +108,7 @@ void applyrotationsfromtheleft(bool isforward,
                 stemp = s(j-m1+1);
                 if( ctemp!=1||stemp!=0 )
                 {
-                    jp1 = j+1;
-                    ap::vmove(&work(n1), &a(jp1, n1), ap::vlen(n1,n2), ctemp);
-                    ap::vsub(&work(n1), &a(j, n1), ap::vlen(n1,n2), stemp);
-                    ap::vmul(&a(j, n1), ap::vlen(n1,n2), ctemp);
-                    ap::vadd(&a(j, n1), &a(jp1, n1), ap::vlen(n1,n2), stemp);
-                    ap::vmove(&a(jp1, n1), &work(n1), ap::vlen(n1,n2));
+                    rotaterows(&a(j, n1), &a(j+1, n1), ap::vlen(n1,n2), ctemp, stemp);
                 }
             }
         }
@@ -147,12 +145,7 @@ void applyrotationsfromtheleft(bool isforward,
                 stemp = s(j-m1+1);
                 if( ctemp!=1||stemp!=0 )
                 {
-                    jp1 = j+1;
-                    ap::vmove(&work(n1), &a(jp1, n1), ap::vlen(n1,n2), ctemp);
-                    ap::vsub(&work(n1), &a(j, n1), ap::vlen(n1,n2), stemp);
-                    ap::vmul(&a(j, n1), ap::vlen(n1,n2), ctemp);
-                    ap::vadd(&a(j, n1), &a(jp1, n1), ap::vlen(n1,n2), stemp);
-                    ap::vmove(&a(jp1, n1), &work(n1), ap::vlen(n1,n2));
+                    rotaterows(&a(j, n1), &a(j+1, n1), ap::vlen(n1,n2), ctemp, stemp);
                 }
             }
         }
@@ -196,113 +189,69 @@ Input parameters:
     C,S         -   transformation coefficients.
                     Array whose index ranges within [1..N2-N1].
     A           -   processed matrix.
-    WORK        -   working array whose index ranges within [M1..M2].
+    WORK        -   not used, kept for compatibility.
 
 Output parameters:
     A           -   transformed matrix.
 
 Utility subroutine.
 *************************************************************************/
+template<class T>
 void applyrotationsfromtheright(bool isforward,
      int m1,
      int m2,
      int n1,
      int n2,
-     const ap::real_1d_array& c,
-     const ap::real_1d_array& s,
-     ap::real_2d_array& a,
-     ap::real_1d_array& work)
+     const ap::template_1d_array<T,true>& c,
+     const ap::template_1d_array<T,true>& s,
+     ap::template_2d_array<T,true>& a,
+     ap::template_1d_array<T,true>&)
 {
+    int i;
     int j;
-    int jp1;
-    double ctemp;
-    double stemp;
-    double temp;
-
+    T ctemp;
+    T stemp;
+    T temp;
+    T *r;
     
     //
     // Form A * P'
     //
-    if( isforward )
+    // The columns are strided, so the sequence is applied to one row at a
+    // time (the rotations act on every row independently).
+    //
+    if( m1>m2||n1>=n2 )
     {
-        if( m1!=m2 )
-        {
-            
-            //
-            // Common case: M1<>M2
-            //
-            for(j = n1; j <= n2-1; j++)
-            {
-                ctemp = c(j-n1+1);
-                stemp = s(j-n1+1);
-                if( ctemp!=1||stemp!=0 )
-                {
-                    jp1 = j+1;
-                    ap::vmove(work.getvector(m1, m2), a.getcolumn(jp1, m1, m2), ctemp);
-                    ap::vsub(work.getvector(m1, m2), a.getcolumn(j, m1, m2), stemp);
-                    ap::vmul(a.getcolumn(j, m1, m2), ctemp);
-                    ap::vadd(a.getcolumn(j, m1, m2), a.getcolumn(jp1, m1, m2), stemp);
-                    ap::vmove(a.getcolumn(jp1, m1, m2), work.getvector(m1, m2));
-                }
-            }
-        }
-        else
-        {
-            
-            //
-            // Special case: M1=M2
-            //
-            for(j = n1; j <= n2-1; j++)
-            {
-                ctemp = c(j-n1+1);
-                stemp = s(j-n1+1);
-                if( ctemp!=1||stemp!=0 )
-                {
-                    temp = a(m1,j+1);
-                    a(m1,j+1) = ctemp*temp-stemp*a(m1,j);
-                    a(m1,j) = stemp*temp+ctemp*a(m1,j);
-                }
-            }
-        }
+        return;
     }
-    else
+    for(i = m1; i <= m2; i++)
     {
-        if( m1!=m2 )
+        r = &a(i, n1);
+        if( isforward )
         {
-            
-            //
-            // Common case: M1<>M2
-            //
-            for(j = n2-1; j >= n1; j--)
+            for(j = 0; j <= n2-n1-1; j++)
             {
-                ctemp = c(j-n1+1);
-                stemp = s(j-n1+1);
+                ctemp = c(j+1);
+                stemp = s(j+1);
                 if( ctemp!=1||stemp!=0 )
                 {
-                    jp1 = j+1;
-                    ap::vmove(work.getvector(m1, m2), a.getcolumn(jp1, m1, m2), ctemp);
-                    ap::vsub(work.getvector(m1, m2), a.getcolumn(j, m1, m2), stemp);
-                    ap::vmul(a.getcolumn(j, m1, m2), ctemp);
-                    ap::vadd(a.getcolumn(j, m1, m2), a.getcolumn(jp1, m1, m2), stemp);
-                    ap::vmove(a.getcolumn(jp1, m1, m2), work.getvector(m1, m2));
+                    temp = r[j+1];
+                    r[j+1] = ctemp*temp-stemp*r[j];
+                    r[j] = stemp*temp+ctemp*r[j];
                 }
             }
         }
         else
         {
-            
-            //
-            // Special case: M1=M2
-            //
-            for(j = n2-1; j >= n1; j--)
+            for(j = n2-n1-1; j >= 0; j--)
             {
-                ctemp = c(j-n1+1);
-                stemp = s(j-n1+1);
+                ctemp = c(j+1);
+                stemp = s(j+1);
                 if( ctemp!=1||stemp!=0 )
                 {
-                    temp = a(m1,j+1);
-                    a(m1,j+1) = ctemp*temp-stemp*a(m1,j);
-                    a(m1,j) = stemp*temp+ctemp*a(m1,j);
+                    temp = r[j+1];
+                    r[j+1] = ctemp*temp-stemp*r[j];
+                    r[j] = stemp*temp+ctemp*r[j];
                 }
             }
         }
@@ -318,10 +267,11 @@ The subroutine generates the elementary rotation, so that:
 
 CS**2 + SN**2 = 1
 *************************************************************************/
-void generaterotation(double f, double g, double& cs, double& sn, double& r)
+template<class T>
+void generaterotation(T f, T g, T& cs, T& sn, T& r)
 {
-    double f1;
-    double g1;
+    T f1;
+    T g1;
 
     if( g==0 )
     {
@@ -355,6 +305,49 @@ void generaterotation(double f, double g, double& cs, double& sn, double& r)
 }
 
 
+/*************************************************************************
+SIMD kernel of apsimd.cpp for RotateRows, False if there is none
+*************************************************************************/
+static bool rotaterowssimd(double *x, double *y, int n, double c, double s)
+{
+    const ap::ablaskernels& k = ap::ablasselect();
+    if( k.drot1==NULL )
+        return false;
+    k.drot1(x, y, n, c, s);
+    return true;
+}
+
+static bool rotaterowssimd(float *x, float *y, int n, float c, float s)
+{
+    const ap::ablaskernels& k = ap::ablasselect();
+    if( k.srot1==NULL )
+        return false;
+    k.srot1(x, y, n, c, s);
+    return true;
+}
+
+
+/*************************************************************************
+(X, Y) := (C*X + S*Y, C*Y - S*X) for two rows of length N, with the SIMD
+kernel of apsimd.cpp when there is one
+*************************************************************************/
+template<class T>
+static void rotaterows(T *x, T *y, int n, T c, T s)
+{
+    int i;
+    T temp;
+
+    if( rotaterowssimd(x, y, n, c, s) )
+        return;
+    for(i = 0; i <= n-1; i++)
+    {
+        temp = y[i];
+        y[i] = c*temp-s*x[i];
+        x[i] = c*x[i]+s*temp;
+    }
+}
+
+
 static void testrotations()
 {
     ap::real_2d_array al1;
@@ -470,4 +463,23 @@ static void testrotations()
 }
 
 
-
+template void applyrotationsfromtheleft<float>(bool, int, int, int, int,
+     const ap::template_1d_array<float,true>&,
+     const ap::template_1d_array<float,true>&,
+     ap::template_2d_array<float,true>&, ap::template_1d_array<float,true>&);
+template void applyrotationsfromtheright<float>(bool, int, int, int, int,
+     const ap::template_1d_array<float,true>&,
+     const ap::template_1d_array<float,true>&,
+     ap::template_2d_array<float,true>&, ap::template_1d_array<float,true>&);
+template void generaterotation<float>(float, float, float&, float&, float&);
+
+template void applyrotationsfromtheleft<double>(bool, int, int, int, int,
+     const ap::template_1d_array<double,true>&,
+     const ap::template_1d_array<double,true>&,
+     ap::template_2d_array<double,true>&, ap::template_1d_array<double,true>&);
+template void applyrotationsfromtheright<double>(bool, int, int, int, int,
+     const ap::template_1d_array<double,true>&,
+     const ap::template_1d_array<double,true>&,
+     ap::template_2d_array<double,true>&, ap::template_1d_array<double,true>&);
+template void generaterotation<double>(double, double, double&, double&,
+     double&);
@@ -59,22 +59,23 @@ Input parameters:
     C,S         -   transformation coefficients.
                     Array whose index ranges within [1..M2-M1].
     A           -   processed matrix.
-    WORK        -   working array whose index ranges within [N1..N2].
+    WORK        -   not used, kept for compatibility.
 
 Output parameters:
     A           -   transformed matrix.
 
 Utility subroutine.
 *************************************************************************/
+template<class T>
 void applyrotationsfromtheleft(bool isforward,
      int m1,
      int m2,
      int n1,
      int n2,
-     const ap::real_1d_array& c,
-     const ap::real_1d_array& s,
-     ap::real_2d_array& a,
-     ap::real_1d_array& work);
+     const ap::template_1d_array<T,true>& c,
+     const ap::template_1d_array<T,true>& s,
+     ap::template_2d_array<T,true>& a,
+     ap::template_1d_array<T,true>& work);
 
 
 /*************************************************************************
@@ -95,22 +96,23 @@ Input parameters:
     C,S         -   transformation coefficients.
                     Array whose index ranges within [1..N2-N1].
     A           -   processed matrix.
-    WORK        -   working array whose index ranges within [M1..M2].
+    WORK        -   not used, kept for compatibility.
 
 Output parameters:
     A           -   transformed matrix.
 
 Utility subroutine.
 *************************************************************************/
+template<class T>
 void applyrotationsfromtheright(bool isforward,
      int m1,
      int m2,
      int n1,
      int n2,
-     const ap::real_1d_array& c,
-     const ap::real_1d_array& s,
-     ap::real_2d_array& a,
-     ap::real_1d_array& work);
+     const ap::template_1d_array<T,true>& c,
+     const ap::template_1d_array<T,true>& s,
+     ap::template_2d_array<T,true>& a,
+     ap::template_1d_array<T,true>& work);
 
 
 /*************************************************************************
@@ -121,7 +123,8 @@ The subroutine generates the elementary rotation, so that:
 
 CS**2 + SN**2 = 1
 *************************************************************************/
-void generaterotation(double f, double g, double& cs, double& sn, double& r);
+template<class T>
+void generaterotation(T f, T g, T& cs, T& sn, T& r);
 
 
 #endif
@@ -38,6 +38,15 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <stdafx.h>
 #include "inv.h"
+#include "../eigenvalues/gemm.h"
+
+//
+// Width of the block columns of inv(A) in RMatrixLUInverse. The column
+// interchanges are applied to the rows in parallel above INVPARALLELFLOPS
+// elements.
+//
+static const int invnb = 128;
+static const double invparallelflops = 2.0e6;
 
 /*************************************************************************
 Inversion of a matrix given by its LU decomposition.
@@ -61,19 +70,34 @@ Result:
      Courant Institute, Argonne National Lab, and Rice University
      February 29, 1992
 *************************************************************************/
-bool rmatrixluinverse(ap::real_2d_array& a,
+template<class T>
+bool rmatrixluinverse(ap::template_2d_array<T,true>& a,
      const ap::integer_1d_array& pivots,
      int n)
+{
+    template_inverseworkspace<T> ws;
+
+    return rmatrixluinverse(a, pivots, n, ws);
+}
+
+
+template<class T>
+bool rmatrixluinverse(ap::template_2d_array<T,true>& a,
+     const ap::integer_1d_array& pivots,
+     int n,
+     template_inverseworkspace<T>& ws)
 {
     bool result;
-    ap::real_1d_array work;
+    ap::template_2d_array<T,true>& wt = ws.wt;
+    ap::template_2d_array<T,true>& w = ws.w;
+    ap::template_2d_array<T,true>& d = ws.d;
+    int nb;
     int i;
-//    int iws;
     int j;
-//    int jb;
-//    int jj;
+    int jb;
+    int jj;
     int jp;
-    double v;
+    T v;
 
     result = true;
     
@@ -84,56 +108,91 @@ bool rmatrixluinverse(ap::real_2d_array& a,
     {
         return result;
     }
-    work.setbounds(0, n-1);
+    nb = invnb;
+    wt.setbounds(0, nb-1, 0, n-1);
     
     //
     // Form inv(U)
     //
-    if( !rmatrixtrinverse(a, n, true, false) )
+    if( !rmatrixtrinverse(a, n, true, false, ws.tr) )
     {
         result = false;
         return result;
     }
     
     //
-    // Solve the equation inv(A)*L = inv(U) for inv(A).
+    // Solve the equation inv(A)*L = inv(U) for inv(A), block column by
+    // block column from right to left.
     //
-    for(j = n-1; j >= 0; j--)
+    for(j = (n-1)/nb*nb; j >= 0; j -= nb)
     {
+        jb = ap::minint(nb, n-j);
         
         //
-        // Copy current column of L to WORK and replace with zeros.
+        // Copy current block column of L to WT (transposed, so that the
+        // rows of WT are the columns of L) and replace with zeros.
         //
-        for(i = j+1; i <= n-1; i++)
+        for(jj = j; jj <= j+jb-1; jj++)
         {
-            work(i) = a(i,j);
-            a(i,j) = 0;
+            for(i = jj+1; i <= n-1; i++)
+            {
+                wt(jj-j,i) = a(i,jj);
+                a(i,jj) = 0;
+            }
         }
         
         //
-        // Compute current column of inv(A).
+        // Compute current block column of inv(A). The columns right of the
+        // block are final, their contribution is a matrix product.
         //
-        if( j<n-1 )
+        if( j+jb<n )
         {
-            for(i = 0; i <= n-1; i++)
+            rmatrixgemm<T>(false, true, n, jb, n-j-jb,
+                -1.0, &a(0, j+jb), a.getstride(),
+                &wt(0, j+jb), wt.getstride(),
+                1.0, &a(0, j), a.getstride());
+        }
+        
+        //
+        // Within the block, A(:,J:J+JB-1) := A(:,J:J+JB-1)*inv(L(J:J+JB-1,J:J+JB-1))
+        // with the inverse of the unit lower triangle formed explicitly.
+        //
+        d.setbounds(0, jb-1, 0, jb-1);
+        for(jj = 0; jj <= jb-1; jj++)
+        {
+            for(i = jj+1; i <= jb-1; i++)
             {
-                v = ap::vdotproduct(&a(i, j+1), &work(j+1), ap::vlen(j+1,n-1));
-                a(i,j) = a(i,j)-v;
+                d(i,jj) = wt(jj,j+i);
             }
+            d(jj,jj) = 1;
         }
+        rmatrixtrinverse(d, jb, false, true, ws.tr);
+        w.setbounds(0, n-1, 0, jb-1);
+        for(i = 0; i <= n-1; i++)
+        {
+            ap::vmove(&w(i, 0), &a(i, j), ap::vlen(0,jb-1));
+        }
+        rmatrixgemm<T>(false, false, n, jb, jb,
+            1.0, &w(0, 0), w.getstride(),
+            &d(0, 0), d.getstride(),
+            0.0, &a(0, j), a.getstride());
     }
     
     //
-    // Apply column interchanges.
+    // Apply column interchanges, row by row.
     //
-    for(j = n-2; j >= 0; j--)
+    #pragma omp parallel for private(j, jp, v) schedule(static) if((double)n*n>=invparallelflops)
+    for(i = 0; i <= n-1; i++)
     {
-        jp = pivots(j);
-        if( jp!=j )
+        for(j = n-2; j >= 0; j--)
         {
-            ap::vmove(work.getvector(0, n-1), a.getcolumn(j, 0, n-1));
-            ap::vmove(a.getcolumn(j, 0, n-1), a.getcolumn(jp, 0, n-1));
-            ap::vmove(a.getcolumn(jp, 0, n-1), work.getvector(0, n-1));
+            jp = pivots(j);
+            if( jp!=j )
+            {
+                v = a(i,j);
+                a(i,j) = a(i,jp);
+                a(i,jp) = v;
+            }
         }
     }
     return result;
@@ -158,13 +217,22 @@ Result:
   -- ALGLIB --
      Copyright 2005 by Bochkanov Sergey
 *************************************************************************/
-bool rmatrixinverse(ap::real_2d_array& a, int n)
+template<class T>
+bool rmatrixinverse(ap::template_2d_array<T,true>& a, int n)
+{
+    template_inverseworkspace<T> ws;
+
+    return rmatrixinverse(a, n, ws);
+}
+
+
+template<class T>
+bool rmatrixinverse(ap::template_2d_array<T,true>& a, int n, template_inverseworkspace<T>& ws)
 {
     bool result;
-    ap::integer_1d_array pivots;
 
-    rmatrixlu(a, n, n, pivots);
-    result = rmatrixluinverse(a, pivots, n);
+    rmatrixlu(a, n, n, ws.pivots, ws.lu);
+    result = rmatrixluinverse(a, ws.pivots, n, ws);
     return result;
 }
 
@@ -174,12 +242,13 @@ Obsolete 1-based subroutine.
 
 See RMatrixLUInverse for 0-based replacement.
 *************************************************************************/
-bool inverselu(ap::real_2d_array& a,
+template<class T>
+bool inverselu(ap::template_2d_array<T,true>& a,
      const ap::integer_1d_array& pivots,
      int n)
 {
     bool result;
-    ap::real_1d_array work;
+    ap::template_1d_array<T,true> work;
     int i;
 //    int iws;
     int j;
@@ -187,7 +256,7 @@ bool inverselu(ap::real_2d_array& a,
 //    int jj;
     int jp;
     int jp1;
-    double v;
+    T v;
 
     result = true;
     
@@ -260,7 +329,8 @@ Obsolete 1-based subroutine.
 
 See RMatrixInverse for 0-based replacement.
 *************************************************************************/
-bool inverse(ap::real_2d_array& a, int n)
+template<class T>
+bool inverse(ap::template_2d_array<T,true>& a, int n)
 {
     bool result;
     ap::integer_1d_array pivots;
@@ -271,4 +341,24 @@ bool inverse(ap::real_2d_array& a, int n)
 }
 
 
-
+template bool rmatrixluinverse<float>(ap::template_2d_array<float,true>&,
+     const ap::integer_1d_array&, int);
+template bool rmatrixluinverse<float>(ap::template_2d_array<float,true>&,
+     const ap::integer_1d_array&, int, template_inverseworkspace<float>&);
+template bool rmatrixinverse<float>(ap::template_2d_array<float,true>&, int);
+template bool rmatrixinverse<float>(ap::template_2d_array<float,true>&, int,
+     template_inverseworkspace<float>&);
+template bool inverselu<float>(ap::template_2d_array<float,true>&,
+     const ap::integer_1d_array&, int);
+template bool inverse<float>(ap::template_2d_array<float,true>&, int);
+
+template bool rmatrixluinverse<double>(ap::template_2d_array<double,true>&,
+     const ap::integer_1d_array&, int);
+template bool rmatrixluinverse<double>(ap::template_2d_array<double,true>&,
+     const ap::integer_1d_array&, int, template_inverseworkspace<double>&);
+template bool rmatrixinverse<double>(ap::template_2d_array<double,true>&, int);
+template bool rmatrixinverse<double>(ap::template_2d_array<double,true>&, int,
+     template_inverseworkspace<double>&);
+template bool inverselu<double>(ap::template_2d_array<double,true>&,
+     const ap::integer_1d_array&, int);
+template bool inverse<double>(ap::template_2d_array<double,true>&, int);
@@ -68,11 +68,39 @@ Result:
      Courant Institute, Argonne National Lab, and Rice University
      February 29, 1992
 *************************************************************************/
-bool rmatrixluinverse(ap::real_2d_array& a,
+template<class T>
+bool rmatrixluinverse(ap::template_2d_array<T,true>& a,
      const ap::integer_1d_array& pivots,
      int n);
 
 
+/*************************************************************************
+Temporaries of RMatrixInverse and RMatrixLUInverse. An instance that is
+kept alive between calls is only reallocated when N grows.
+*************************************************************************/
+template<class T>
+struct template_inverseworkspace
+{
+    template_luworkspace<T> lu;
+    template_trinverseworkspace<T> tr;
+    ap::integer_1d_array pivots;
+    ap::template_2d_array<T,true> wt;
+    ap::template_2d_array<T,true> w;
+    ap::template_2d_array<T,true> d;
+};
+typedef template_inverseworkspace<double> inverseworkspace;
+
+
+/*************************************************************************
+Same as RMatrixLUInverse, with all temporaries taken from WS.
+*************************************************************************/
+template<class T>
+bool rmatrixluinverse(ap::template_2d_array<T,true>& a,
+     const ap::integer_1d_array& pivots,
+     int n,
+     template_inverseworkspace<T>& ws);
+
+
 /*************************************************************************
 Inversion of a general matrix.
 
@@ -88,10 +116,20 @@ Result:
     True, if the matrix is not singular.
     False, if the matrix is singular.
 
+Instantiated for float and double.
+
   -- ALGLIB --
      Copyright 2005 by Bochkanov Sergey
 *************************************************************************/
-bool rmatrixinverse(ap::real_2d_array& a, int n);
+template<class T>
+bool rmatrixinverse(ap::template_2d_array<T,true>& a, int n);
+
+
+/*************************************************************************
+Same as RMatrixInverse, with all temporaries taken from WS.
+*************************************************************************/
+template<class T>
+bool rmatrixinverse(ap::template_2d_array<T,true>& a, int n, template_inverseworkspace<T>& ws);
 
 
 /*************************************************************************
@@ -99,7 +137,8 @@ Obsolete 1-based subroutine.
 
 See RMatrixLUInverse for 0-based replacement.
 *************************************************************************/
-bool inverselu(ap::real_2d_array& a,
+template<class T>
+bool inverselu(ap::template_2d_array<T,true>& a,
      const ap::integer_1d_array& pivots,
      int n);
 
@@ -109,7 +148,8 @@ Obsolete 1-based subroutine.
 
 See RMatrixInverse for 0-based replacement.
 *************************************************************************/
-bool inverse(ap::real_2d_array& a, int n);
+template<class T>
+bool inverse(ap::template_2d_array<T,true>& a, int n);
 
 
 #endif
@@ -38,13 +38,35 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <stdafx.h>
 #include "lu.h"
-
-static const int lunb = 8;
-
-static void rmatrixlu2(ap::real_2d_array& a,
+#include "../eigenvalues/gemm.h"
+
+//
+// Width of the panels. The trailing matrix is updated with a rank-LUNB
+// matrix product. Panels are factorized recursively down to LURECNB
+// columns, below that with level 2 operations.
+//
+static const int lunb = 256;
+static const int lurecnb = 16;
+
+template<class T>
+static void rmatrixlu2(ap::template_2d_array<T,true>& a,
      int m,
      int n,
-     ap::integer_1d_array& pivots);
+     ap::integer_1d_array& pivots,
+     ap::template_1d_array<T,true>& t1);
+template<class T>
+static void rmatrixlurec(ap::template_2d_array<T,true>& a,
+     int m,
+     int n,
+     ap::integer_1d_array& pivots,
+     int p0,
+     template_luworkspace<T>& ws);
+template<class T>
+static void rmatrixlublockrow(ap::template_2d_array<T,true>& a,
+     int j1,
+     int j2,
+     int c1,
+     int c2);
 
 /*************************************************************************
 LU decomposition of a general matrix of size MxN
@@ -93,23 +115,35 @@ As we can see, the unit diagonal isn't stored.
      Courant Institute, Argonne National Lab, and Rice University
      June 30, 1992
 *************************************************************************/
-void rmatrixlu(ap::real_2d_array& a,
+template<class T>
+void rmatrixlu(ap::template_2d_array<T,true>& a,
      int m,
      int n,
      ap::integer_1d_array& pivots)
 {
-    ap::real_2d_array b;
-    ap::real_1d_array t;
-    ap::integer_1d_array bp;
+    template_luworkspace<T> ws;
+
+    rmatrixlu(a, m, n, pivots, ws);
+}
+
+
+template<class T>
+void rmatrixlu(ap::template_2d_array<T,true>& a,
+     int m,
+     int n,
+     ap::integer_1d_array& pivots,
+     template_luworkspace<T>& ws)
+{
+    ap::template_2d_array<T,true>& b = ws.b;
+    ap::template_1d_array<T,true>& t = ws.t;
+    ap::integer_1d_array& bp = ws.bp;
     int minmn;
     int i;
     int ip;
-    int j;
     int j1;
     int j2;
     int cb;
     int nb;
-    double v;
 
     ap::ap_error::make_assertion(lunb>=1, "RMatrixLU internal error");
     nb = lunb;
@@ -117,13 +151,13 @@ void rmatrixlu(ap::real_2d_array& a,
     //
     // Decide what to use - blocked or unblocked code
     //
-    if( n<=1||ap::minint(m, n)<=nb||nb==1 )
+    if( n<=1||ap::minint(m, n)<=lurecnb||nb==1 )
     {
         
         //
         // Unblocked code
         //
-        rmatrixlu2(a, m, n, pivots);
+        rmatrixlu2(a, m, n, pivots, ws.t1);
     }
     else
     {
@@ -157,7 +191,8 @@ void rmatrixlu(ap::real_2d_array& a,
             {
                 ap::vmove(&b(i-j1, 0), &a(i, j1), ap::vlen(0,cb-1));
             }
-            rmatrixlu2(b, m-j1, cb, bp);
+            bp.setbounds(0, cb-1);
+            rmatrixlurec(b, m-j1, cb, bp, 0, ws);
             for(i = j1; i <= m-1; i++)
             {
                 ap::vmove(&a(i, j1), &b(i-j1, 0), ap::vlen(j1,j2));
@@ -196,29 +231,18 @@ void rmatrixlu(ap::real_2d_array& a,
             //
             if( j2<n-1 )
             {
-                for(i = j1+1; i <= j2; i++)
-                {
-                    for(j = j1; j <= i-1; j++)
-                    {
-                        v = a(i,j);
-                        ap::vsub(&a(i, j2+1), &a(j, j2+1), ap::vlen(j2+1,n-1), v);
-                    }
-                }
+                rmatrixlublockrow(a, j1, j2, j2+1, n-1);
             }
             
             //
-            // Update trailing submatrix
+            // Update trailing submatrix, A22 := A22 - A21*A12
             //
-            if( j2<n-1 )
+            if( j2<n-1&&j2<m-1 )
             {
-                for(i = j2+1; i <= m-1; i++)
-                {
-                    for(j = j1; j <= j2; j++)
-                    {
-                        v = a(i,j);
-                        ap::vsub(&a(i, j2+1), &a(j, j2+1), ap::vlen(j2+1,n-1), v);
-                    }
-                }
+                rmatrixgemm<T>(false, false, m-j2-1, n-j2-1, cb,
+                    -1.0, &a(j2+1, j1), a.getstride(),
+                    &a(j1, j2+1), a.getstride(),
+                    1.0, &a(j2+1, j2+1), a.getstride());
             }
             
             //
@@ -235,7 +259,8 @@ void rmatrixlu(ap::real_2d_array& a,
 Obsolete 1-based subroutine. Left for backward compatibility.
 See RMatrixLU for 0-based replacement.
 *************************************************************************/
-void ludecomposition(ap::real_2d_array& a,
+template<class T>
+void ludecomposition(ap::template_2d_array<T,true>& a,
      int m,
      int n,
      ap::integer_1d_array& pivots)
@@ -243,8 +268,8 @@ void ludecomposition(ap::real_2d_array& a,
     int i;
     int j;
     int jp;
-    ap::real_1d_array t1;
-    double s;
+    ap::template_1d_array<T,true> t1;
+    T s;
 
     pivots.setbounds(1, ap::minint(m, n));
     t1.setbounds(1, ap::maxint(m, n));
@@ -320,11 +345,12 @@ void ludecomposition(ap::real_2d_array& a,
 /*************************************************************************
 Obsolete 1-based subroutine. Left for backward compatibility.
 *************************************************************************/
-void ludecompositionunpacked(ap::real_2d_array a,
+template<class T>
+void ludecompositionunpacked(ap::template_2d_array<T,true> a,
      int m,
      int n,
-     ap::real_2d_array& l,
-     ap::real_2d_array& u,
+     ap::template_2d_array<T,true>& l,
+     ap::template_2d_array<T,true>& u,
      ap::integer_1d_array& pivots)
 {
     int i;
@@ -382,16 +408,17 @@ Level 2 BLAS version of RMatrixLU
      Courant Institute, Argonne National Lab, and Rice University
      June 30, 1992
 *************************************************************************/
-static void rmatrixlu2(ap::real_2d_array& a,
+template<class T>
+static void rmatrixlu2(ap::template_2d_array<T,true>& a,
      int m,
      int n,
-     ap::integer_1d_array& pivots)
+     ap::integer_1d_array& pivots,
+     ap::template_1d_array<T,true>& t1)
 {
     int i;
     int j;
     int jp;
-    ap::real_1d_array t1;
-    double s;
+    T s;
 
     // Valgrind complains because "pivots" is allocated here
     // after it has already been passed as reference multiple times
@@ -462,3 +489,143 @@ static void rmatrixlu2(ap::real_2d_array& a,
 
 
 
+/*************************************************************************
+Recursive LU decomposition of the MxN panel A, M>=N. The left half is
+factorized, the right half is updated with a triangular solve and a matrix
+product and then factorized itself. Pivots are stored in Pivots(P0..),
+relative to the first row of A.
+
+A is usually a view (see attach) on a part of a larger matrix.
+*************************************************************************/
+template<class T>
+static void rmatrixlurec(ap::template_2d_array<T,true>& a,
+     int m,
+     int n,
+     ap::integer_1d_array& pivots,
+     int p0,
+     template_luworkspace<T>& ws)
+{
+    ap::template_2d_array<T,true> view;
+    ap::template_1d_array<T,true>& t = ws.t;
+    int n1;
+    int n2;
+    int i;
+    int ip;
+
+    if( n<=lurecnb )
+    {
+        rmatrixlu2(a, m, n, ws.bp2, ws.t1);
+        for(i = 0; i <= n-1; i++)
+        {
+            pivots(p0+i) = ws.bp2(i);
+        }
+        return;
+    }
+    n1 = n/2;
+    n2 = n-n1;
+
+    //
+    // Left half, then apply its interchanges to the right half
+    //
+    view.attach(&a(0, 0), m, n1, a.getstride());
+    rmatrixlurec(view, m, n1, pivots, p0, ws);
+    for(i = 0; i <= n1-1; i++)
+    {
+        ip = pivots(p0+i);
+        if( ip!=i )
+        {
+            ap::vmove(&t(0), &a(i, n1), ap::vlen(0,n2-1));
+            ap::vmove(&a(i, n1), &a(ip, n1), ap::vlen(n1,n-1));
+            ap::vmove(&a(ip, n1), &t(0), ap::vlen(0,n2-1));
+        }
+    }
+
+    //
+    // A12 := inv(L11)*A12, A22 := A22 - A21*A12
+    //
+    rmatrixlublockrow(a, 0, n1-1, n1, n-1);
+    rmatrixgemm<T>(false, false, m-n1, n2, n1,
+        -1.0, &a(n1, 0), a.getstride(),
+        &a(0, n1), a.getstride(),
+        1.0, &a(n1, n1), a.getstride());
+
+    //
+    // Right half, then apply its interchanges to the left half
+    //
+    view.attach(&a(n1, n1), m-n1, n2, a.getstride());
+    rmatrixlurec(view, m-n1, n2, pivots, p0+n1, ws);
+    for(i = n1; i <= n-1; i++)
+    {
+        pivots(p0+i) += n1;
+        ip = pivots(p0+i);
+        if( ip!=i )
+        {
+            ap::vmove(&t(0), &a(i, 0), ap::vlen(0,n1-1));
+            ap::vmove(&a(i, 0), &a(ip, 0), ap::vlen(0,n1-1));
+            ap::vmove(&a(ip, 0), &t(0), ap::vlen(0,n1-1));
+        }
+    }
+}
+
+
+/*************************************************************************
+Block row of U of the blocked RMatrixLU:
+
+    A(J1:J2, C1:C2) := inv(L11) * A(J1:J2, C1:C2)
+
+with L11 the unit lower triangle of A(J1:J2, J1:J2). The triangle is split
+in halves recursively, the lower half of the rows is updated with a matrix
+product.
+*************************************************************************/
+template<class T>
+static void rmatrixlublockrow(ap::template_2d_array<T,true>& a,
+     int j1,
+     int j2,
+     int c1,
+     int c2)
+{
+    int h;
+    int i;
+    int j;
+
+    if( j2-j1+1<=lurecnb )
+    {
+        for(i = j1+1; i <= j2; i++)
+        {
+            for(j = j1; j <= i-1; j++)
+            {
+                ap::vsub(&a(i, c1), &a(j, c1), ap::vlen(c1,c2), a(i,j));
+            }
+        }
+        return;
+    }
+    h = (j2-j1+1)/2;
+    rmatrixlublockrow(a, j1, j1+h-1, c1, c2);
+    rmatrixgemm<T>(false, false, j2-j1-h+1, c2-c1+1, h,
+        -1.0, &a(j1+h, j1), a.getstride(),
+        &a(j1, c1), a.getstride(),
+        1.0, &a(j1+h, c1), a.getstride());
+    rmatrixlublockrow(a, j1+h, j2, c1, c2);
+}
+
+
+template void rmatrixlu<float>(ap::template_2d_array<float,true>&, int, int,
+     ap::integer_1d_array&);
+template void rmatrixlu<float>(ap::template_2d_array<float,true>&, int, int,
+     ap::integer_1d_array&, template_luworkspace<float>&);
+template void ludecomposition<float>(ap::template_2d_array<float,true>&, int,
+     int, ap::integer_1d_array&);
+template void ludecompositionunpacked<float>(ap::template_2d_array<float,true>,
+     int, int, ap::template_2d_array<float,true>&,
+     ap::template_2d_array<float,true>&, ap::integer_1d_array&);
+
+template void rmatrixlu<double>(ap::template_2d_array<double,true>&, int, int,
+     ap::integer_1d_array&);
+template void rmatrixlu<double>(ap::template_2d_array<double,true>&, int, int,
+     ap::integer_1d_array&, template_luworkspace<double>&);
+template void ludecomposition<double>(ap::template_2d_array<double,true>&, int,
+     int, ap::integer_1d_array&);
+template void ludecompositionunpacked<double>(
+     ap::template_2d_array<double,true>, int, int,
+     ap::template_2d_array<double,true>&, ap::template_2d_array<double,true>&,
+     ap::integer_1d_array&);
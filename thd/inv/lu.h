@@ -89,17 +89,46 @@ As we can see, the unit diagonal isn't stored.
      Courant Institute, Argonne National Lab, and Rice University
      June 30, 1992
 *************************************************************************/
-void rmatrixlu(ap::real_2d_array& a,
+template<class T>
+void rmatrixlu(ap::template_2d_array<T,true>& a,
      int m,
      int n,
      ap::integer_1d_array& pivots);
 
 
+/*************************************************************************
+Temporaries of RMatrixLU. An instance that is kept alive between calls is
+only reallocated when the matrix grows.
+*************************************************************************/
+template<class T>
+struct template_luworkspace
+{
+    ap::template_2d_array<T,true> b;
+    ap::template_1d_array<T,true> t;
+    ap::template_1d_array<T,true> t1;
+    ap::integer_1d_array bp;
+    ap::integer_1d_array bp2;
+};
+typedef template_luworkspace<double> luworkspace;
+
+
+/*************************************************************************
+Same as RMatrixLU, with all temporaries taken from WS.
+*************************************************************************/
+template<class T>
+void rmatrixlu(ap::template_2d_array<T,true>& a,
+     int m,
+     int n,
+     ap::integer_1d_array& pivots,
+     template_luworkspace<T>& ws);
+
+
 /*************************************************************************
 Obsolete 1-based subroutine. Left for backward compatibility.
 See RMatrixLU for 0-based replacement.
 *************************************************************************/
-void ludecomposition(ap::real_2d_array& a,
+template<class T>
+void ludecomposition(ap::template_2d_array<T,true>& a,
      int m,
      int n,
      ap::integer_1d_array& pivots);
@@ -108,11 +137,12 @@ void ludecomposition(ap::real_2d_array& a,
 /*************************************************************************
 Obsolete 1-based subroutine. Left for backward compatibility.
 *************************************************************************/
-void ludecompositionunpacked(ap::real_2d_array a,
+template<class T>
+void ludecompositionunpacked(ap::template_2d_array<T,true> a,
      int m,
      int n,
-     ap::real_2d_array& l,
-     ap::real_2d_array& u,
+     ap::template_2d_array<T,true>& l,
+     ap::template_2d_array<T,true>& u,
      ap::integer_1d_array& pivots);
 
 
@@ -38,6 +38,46 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <stdafx.h>
 #include "trinverse.h"
+#include "../eigenvalues/gemm.h"
+
+//
+// Size of the diagonal blocks. Blocks are inverted with level 2 operations,
+// everything else is done with matrix products.
+//
+static const int trinb = 128;
+
+template<class T>
+static bool rmatrixtrinverse2(ap::template_2d_array<T,true>& a,
+     int n,
+     bool isupper,
+     bool isunittriangular,
+     ap::template_1d_array<T,true>& t);
+template<class T>
+static void rmatrixtrcopy(const ap::template_2d_array<T,true>& a,
+     int i0,
+     int cnt,
+     bool isupper,
+     bool isunittriangular,
+     ap::template_2d_array<T,true>& d);
+template<class T>
+static void rmatrixtrmmleft(ap::template_2d_array<T,true>& a,
+     int r0,
+     int cnt,
+     int c0,
+     int ccnt,
+     bool isupper,
+     bool isunittriangular,
+     template_trinverseworkspace<T>& ws);
+template<class T>
+static void rmatrixtrmmright(ap::template_2d_array<T,true>& a,
+     int r0,
+     int cnt,
+     int c0,
+     int ccnt,
+     bool isupper,
+     bool isunittriangular,
+     T alpha,
+     template_trinverseworkspace<T>& ws);
 
 /*************************************************************************
 Triangular matrix inversion
@@ -76,18 +116,107 @@ Result:
      Courant Institute, Argonne National Lab, and Rice University
      February 29, 1992
 *************************************************************************/
-bool rmatrixtrinverse(ap::real_2d_array& a,
+template<class T>
+bool rmatrixtrinverse(ap::template_2d_array<T,true>& a,
      int n,
      bool isupper,
      bool isunittriangular)
+{
+    template_trinverseworkspace<T> ws;
+
+    return rmatrixtrinverse(a, n, isupper, isunittriangular, ws);
+}
+
+
+template<class T>
+bool rmatrixtrinverse(ap::template_2d_array<T,true>& a,
+     int n,
+     bool isupper,
+     bool isunittriangular,
+     template_trinverseworkspace<T>& ws)
+{
+    ap::template_2d_array<T,true> view;
+    int nb;
+    int i;
+    int j;
+    int jb;
+
+    nb = trinb;
+    if( n<=nb )
+    {
+        return rmatrixtrinverse2(a, n, isupper, isunittriangular, ws.t);
+    }
+
+    //
+    // Test for singularity first, so that A is unchanged if it is
+    //
+    if( !isunittriangular )
+    {
+        for(i = 0; i <= n-1; i++)
+        {
+            if( a(i,i)==0 )
+            {
+                return false;
+            }
+        }
+    }
+    ws.d.setbounds(0, nb-1, 0, nb-1);
+    ws.w.setbounds(0, n-1, 0, nb-1);
+    if( isupper )
+    {
+
+        //
+        // Block columns from left to right. With A11 = inv(U11) known:
+        //
+        //     A12 := -inv(U11)*U12*inv(U22) = -A11*U12*inv(U22)
+        //
+        for(j = 0; j <= n-1; j += nb)
+        {
+            jb = ap::minint(nb, n-j);
+            rmatrixtrmmleft(a, 0, j, j, jb, true, isunittriangular, ws);
+            view.attach(&a(j, j), jb, jb, a.getstride());
+            rmatrixtrinverse2(view, jb, true, isunittriangular, ws.t);
+            rmatrixtrmmright(a, 0, j, j, jb, true, isunittriangular, T(-1.0), ws);
+        }
+    }
+    else
+    {
+
+        //
+        // Block columns from right to left. With A22 = inv(L22) known:
+        //
+        //     A21 := -inv(L22)*L21*inv(L11) = -A22*L21*inv(L11)
+        //
+        for(j = (n-1)/nb*nb; j >= 0; j -= nb)
+        {
+            jb = ap::minint(nb, n-j);
+            rmatrixtrmmleft(a, j+jb, n-j-jb, j, jb, false, isunittriangular, ws);
+            view.attach(&a(j, j), jb, jb, a.getstride());
+            rmatrixtrinverse2(view, jb, false, isunittriangular, ws.t);
+            rmatrixtrmmright(a, j+jb, n-j-jb, j, jb, false, isunittriangular, T(-1.0), ws);
+        }
+    }
+    return true;
+}
+
+
+/*************************************************************************
+Level 2 version of RMatrixTRInverse, used for small matrices and for the
+diagonal blocks of the blocked version.
+*************************************************************************/
+template<class T>
+static bool rmatrixtrinverse2(ap::template_2d_array<T,true>& a,
+     int n,
+     bool isupper,
+     bool isunittriangular,
+     ap::template_1d_array<T,true>& t)
 {
     bool result;
     bool nounit;
     int i;
     int j;
-    double v;
-    double ajj;
-    ap::real_1d_array t;
+    T v;
+    T ajj;
 
     result = true;
     t.setbounds(0, n-1);
@@ -208,7 +337,8 @@ bool rmatrixtrinverse(ap::real_2d_array& a,
 Obsolete 1-based subroutine.
 See RMatrixTRInverse for 0-based replacement.
 *************************************************************************/
-bool invtriangular(ap::real_2d_array& a,
+template<class T>
+bool invtriangular(ap::template_2d_array<T,true>& a,
      int n,
      bool isupper,
      bool isunittriangular)
@@ -220,9 +350,9 @@ bool invtriangular(ap::real_2d_array& a,
     int nmj;
     int jm1;
     int jp1;
-    double v;
-    double ajj;
-    ap::real_1d_array t;
+    T v;
+    T ajj;
+    ap::template_1d_array<T,true> t;
 
     result = true;
     t.setbounds(1, n);
@@ -343,3 +473,160 @@ bool invtriangular(ap::real_2d_array& a,
 
 
 
+/*************************************************************************
+Copies the triangle of the block A(I0:I0+Cnt-1, I0:I0+Cnt-1) to the dense
+matrix D, with zeros in the other triangle and ones on the diagonal if the
+matrix has a unit diagonal.
+*************************************************************************/
+template<class T>
+static void rmatrixtrcopy(const ap::template_2d_array<T,true>& a,
+     int i0,
+     int cnt,
+     bool isupper,
+     bool isunittriangular,
+     ap::template_2d_array<T,true>& d)
+{
+    int i;
+    int j;
+
+    for(i = 0; i <= cnt-1; i++)
+    {
+        for(j = 0; j <= cnt-1; j++)
+        {
+            if( i==j )
+            {
+                d(i,j) = isunittriangular ? 1 : a(i0+i,i0+j);
+            }
+            else if( (j>i)==isupper )
+            {
+                d(i,j) = a(i0+i,i0+j);
+            }
+            else
+            {
+                d(i,j) = 0;
+            }
+        }
+    }
+}
+
+
+/*************************************************************************
+B := T*B for the block B = A(R0:R0+Cnt-1, C0:C0+CCnt-1) and the triangle
+T of A(R0:R0+Cnt-1, R0:R0+Cnt-1), with CCnt at most TRINB.
+
+B is updated block row by block row, in the order in which the rows that
+are still needed are not yet overwritten (top down for an upper triangle).
+*************************************************************************/
+template<class T>
+static void rmatrixtrmmleft(ap::template_2d_array<T,true>& a,
+     int r0,
+     int cnt,
+     int c0,
+     int ccnt,
+     bool isupper,
+     bool isunittriangular,
+     template_trinverseworkspace<T>& ws)
+{
+    ap::template_2d_array<T,true>& d = ws.d;
+    ap::template_2d_array<T,true>& w = ws.w;
+    int nb;
+    int nblocks;
+    int q;
+    int i;
+    int ib;
+    int k1;
+    int k2;
+    int r;
+
+    if( cnt<=0 )
+    {
+        return;
+    }
+    nb = trinb;
+    nblocks = (cnt+nb-1)/nb;
+    for(q = 0; q <= nblocks-1; q++)
+    {
+        i = isupper ? r0+q*nb : r0+(nblocks-1-q)*nb;
+        ib = ap::minint(nb, r0+cnt-i);
+
+        //
+        // W := T(I,I)*B(I) + T(I,K1:K2)*B(K1:K2)
+        //
+        if( isupper )
+        {
+            k1 = i+ib;
+            k2 = r0+cnt-1;
+        }
+        else
+        {
+            k1 = r0;
+            k2 = i-1;
+        }
+        rmatrixtrcopy(a, i, ib, isupper, isunittriangular, d);
+        rmatrixgemm<T>(false, false, ib, ccnt, ib,
+            1.0, &d(0, 0), d.getstride(),
+            &a(i, c0), a.getstride(),
+            0.0, &w(0, 0), w.getstride());
+        if( k1<=k2 )
+        {
+            rmatrixgemm<T>(false, false, ib, ccnt, k2-k1+1,
+                1.0, &a(i, k1), a.getstride(),
+                &a(k1, c0), a.getstride(),
+                1.0, &w(0, 0), w.getstride());
+        }
+        for(r = 0; r <= ib-1; r++)
+        {
+            ap::vmove(&a(i+r, c0), &w(r, 0), ap::vlen(c0,c0+ccnt-1));
+        }
+    }
+}
+
+
+/*************************************************************************
+B := Alpha*B*T for the block B = A(R0:R0+Cnt-1, C0:C0+CCnt-1) and the
+triangle T of A(C0:C0+CCnt-1, C0:C0+CCnt-1), with CCnt at most TRINB.
+*************************************************************************/
+template<class T>
+static void rmatrixtrmmright(ap::template_2d_array<T,true>& a,
+     int r0,
+     int cnt,
+     int c0,
+     int ccnt,
+     bool isupper,
+     bool isunittriangular,
+     T alpha,
+     template_trinverseworkspace<T>& ws)
+{
+    ap::template_2d_array<T,true>& d = ws.d;
+    ap::template_2d_array<T,true>& w = ws.w;
+    int r;
+
+    if( cnt<=0 )
+    {
+        return;
+    }
+    rmatrixtrcopy(a, c0, ccnt, isupper, isunittriangular, d);
+    for(r = 0; r <= cnt-1; r++)
+    {
+        ap::vmove(&w(r, 0), &a(r0+r, c0), ap::vlen(0,ccnt-1));
+    }
+    rmatrixgemm<T>(false, false, cnt, ccnt, ccnt,
+        alpha, &w(0, 0), w.getstride(),
+        &d(0, 0), d.getstride(),
+        0.0, &a(r0, c0), a.getstride());
+}
+
+
+template bool rmatrixtrinverse<float>(ap::template_2d_array<float,true>&, int,
+     bool, bool);
+template bool rmatrixtrinverse<float>(ap::template_2d_array<float,true>&, int,
+     bool, bool, template_trinverseworkspace<float>&);
+template bool invtriangular<float>(ap::template_2d_array<float,true>&, int,
+     bool, bool);
+
+template bool rmatrixtrinverse<double>(ap::template_2d_array<double,true>&, int,
+     bool, bool);
+template bool rmatrixtrinverse<double>(ap::template_2d_array<double,true>&, int,
+     bool, bool, template_trinverseworkspace<double>&);
+template bool invtriangular<double>(ap::template_2d_array<double,true>&, int,
+     bool, bool);
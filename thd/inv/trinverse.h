@@ -79,17 +79,49 @@ Result:
      Courant Institute, Argonne National Lab, and Rice University
      February 29, 1992
 *************************************************************************/
-bool rmatrixtrinverse(ap::real_2d_array& a,
+template<class T>
+bool rmatrixtrinverse(ap::template_2d_array<T,true>& a,
      int n,
      bool isupper,
      bool isunittriangular);
 
 
+/*************************************************************************
+Temporaries of RMatrixTRInverse. An instance that is kept alive between
+calls is only reallocated when N grows.
+*************************************************************************/
+template<class T>
+struct template_trinverseworkspace
+{
+    ap::template_1d_array<T,true> t;
+    ap::template_2d_array<T,true> d;
+    ap::template_2d_array<T,true> w;
+};
+typedef template_trinverseworkspace<double> trinverseworkspace;
+
+
+/*************************************************************************
+Same as RMatrixTRInverse, with all temporaries taken from WS.
+
+Matrices larger than a block (128) are inverted block column by block
+column: only the diagonal blocks are inverted with level 2 operations, the
+off-diagonal blocks are updated with RMatrixGEMM. A singular matrix is
+detected before A is modified.
+*************************************************************************/
+template<class T>
+bool rmatrixtrinverse(ap::template_2d_array<T,true>& a,
+     int n,
+     bool isupper,
+     bool isunittriangular,
+     template_trinverseworkspace<T>& ws);
+
+
 /*************************************************************************
 Obsolete 1-based subroutine.
 See RMatrixTRInverse for 0-based replacement.
 *************************************************************************/
-bool invtriangular(ap::real_2d_array& a,
+template<class T>
+bool invtriangular(ap::template_2d_array<T,true>& a,
      int n,
      bool isupper,
      bool isunittriangular);